@@ -0,0 +1,185 @@
+// AssetStreamer.cpp
+
+#include "AssetStreamer.h"
+#include "MemoryTracker.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace {
+
+    float MillisecondsSince(std::chrono::steady_clock::time_point start) {
+        std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count();
+    }
+
+}
+
+AssetStreamer::AssetStreamer()
+    : loadsInFlight(0), stopping(false)
+{
+}
+
+AssetStreamer::~AssetStreamer() {
+    Stop();
+}
+
+bool AssetStreamer::Start(MeshLoader meshLoader, unsigned workerCount) {
+    if (!workers.empty() || !meshLoader) {
+        return false;
+    }
+
+    // Leave a core for the main thread
+    if (workerCount == 0) {
+        unsigned cores = std::thread::hardware_concurrency();
+        workerCount = std::max(1u, std::min(4u, (cores > 1) ? cores - 1 : 1u));
+    }
+
+    loader = meshLoader;
+    stopping = false;
+    for (unsigned i = 0; i < workerCount; ++i) {
+        workers.emplace_back(&AssetStreamer::WorkerLoop, this);
+    }
+    return true;
+}
+
+void AssetStreamer::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+}
+
+AssetHandle AssetStreamer::RequestMesh(const std::string& bakedFile, const std::string& sourceFile) {
+    std::unique_ptr<Request> request(new Request());
+    request->bakedFile = bakedFile;
+    request->sourceFile = sourceFile;
+    request->state = AssetState::Queued;
+
+    AssetHandle handle;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        requests.push_back(std::move(request));
+        handle = static_cast<AssetHandle>(requests.size());
+        loadQueue.push_back(handle);
+    }
+    workAvailable.notify_one();
+    return handle;
+}
+
+AssetState AssetStreamer::GetState(AssetHandle handle) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (handle == InvalidAssetHandle || handle > requests.size()) {
+        return AssetState::Invalid;
+    }
+    return requests[handle - 1]->state;
+}
+
+bool AssetStreamer::IsIdle() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return loadQueue.empty() && uploadQueue.empty() && loadsInFlight == 0;
+}
+
+void AssetStreamer::WorkerLoop() {
+    BOG_PROFILE_THREAD("Asset streamer");
+    MemoryTracker::SetTag(MemoryTag::Streaming);
+    while (true) {
+        Request* request = nullptr;
+        AssetHandle handle = InvalidAssetHandle;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            workAvailable.wait(lock, [this] { return stopping || !loadQueue.empty(); });
+            if (stopping) {
+                return;
+            }
+
+            handle = loadQueue.front();
+            loadQueue.pop_front();
+            request = requests[handle - 1].get();
+            request->state = AssetState::Loading;
+            ++loadsInFlight;
+        }
+
+        // File I/O and parsing happen outside the lock
+        std::unique_ptr<MeshData> data(new MeshData());
+        bool loaded = loader(request->bakedFile, request->sourceFile, *data);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            request->state = loaded ? AssetState::Loaded : AssetState::Failed;
+            if (loaded) {
+                request->data = std::move(data);
+            }
+            uploadQueue.push_back(handle);
+            --loadsInFlight;
+        }
+    }
+}
+
+AssetStreamer::UploadStats AssetStreamer::ProcessUploads(MeshUploadTarget& target, const UploadBudget& budget) {
+    UploadStats stats = {};
+    const auto start = std::chrono::steady_clock::now();
+
+    while (true) {
+        AssetHandle handle = InvalidAssetHandle;
+        Request* request = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (uploadQueue.empty()) {
+                break;
+            }
+
+            handle = uploadQueue.front();
+            request = requests[handle - 1].get();
+
+            // Stop once either budget is spent, but always upload something
+            uint64_t bytes = request->data ? request->data->GetUploadBytes() : 0;
+            bool overBudget = MillisecondsSince(start) >= budget.maxMilliseconds ||
+                stats.bytesUploaded + bytes > budget.maxBytes;
+            if (stats.meshesUploaded > 0 && overBudget) {
+                break;
+            }
+
+            uploadQueue.pop_front();
+        }
+
+        // Only this thread touches loaded requests, so the upload needs no lock
+        if (request->state == AssetState::Failed) {
+            target.OnMeshFailed(handle);
+            ++stats.meshesFailed;
+            continue;
+        }
+
+        bool uploaded = target.UploadMesh(handle, *request->data);
+        uint64_t bytes = request->data->GetUploadBytes();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            request->state = uploaded ? AssetState::Resident : AssetState::Failed;
+            request->data.reset();
+        }
+
+        if (uploaded) {
+            ++stats.meshesUploaded;
+            stats.bytesUploaded += bytes;
+        }
+        else {
+            target.OnMeshFailed(handle);
+            ++stats.meshesFailed;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.uploadsPending = static_cast<uint32_t>(uploadQueue.size());
+    }
+    stats.milliseconds = MillisecondsSince(start);
+    return stats;
+}
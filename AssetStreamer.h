@@ -0,0 +1,99 @@
+// AssetStreamer.h
+
+#pragma once
+#include "MeshData.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef uint32_t AssetHandle;
+const AssetHandle InvalidAssetHandle = 0;
+
+enum class AssetState {
+    Invalid,
+    Queued,
+    Loading,
+    Loaded,     // Waiting for its upload
+    Resident,
+    Failed
+};
+
+// Creates the GPU resources for a loaded mesh. Graphics implements this with
+// D3D11 buffers; anything else (such as a stub device) works for testing the
+// streamer without a GPU.
+class MeshUploadTarget {
+public:
+    virtual ~MeshUploadTarget() {}
+
+    virtual bool UploadMesh(AssetHandle handle, const MeshData& data) = 0;
+    virtual void OnMeshFailed(AssetHandle) {}
+};
+
+// Loads meshes on worker threads and hands them to the main thread for upload.
+// Requests return a handle straight away. ProcessUploads runs once per frame
+// and uploads finished meshes until the frame's time or byte budget is spent.
+class AssetStreamer {
+public:
+    // Parses or reads a mesh from disk. Called on worker threads.
+    typedef std::function<bool(const std::string& bakedFile, const std::string& sourceFile, MeshData& data)> MeshLoader;
+
+    struct UploadBudget {
+        float maxMilliseconds;
+        uint64_t maxBytes;
+    };
+
+    // What one ProcessUploads call did
+    struct UploadStats {
+        uint32_t meshesUploaded;
+        uint32_t meshesFailed;
+        uint64_t bytesUploaded;
+        float milliseconds;
+        uint32_t uploadsPending;    // Loaded meshes left for later frames
+    };
+
+    AssetStreamer();
+    ~AssetStreamer();
+
+    // Starts the workers. A worker count of 0 picks one from the available cores.
+    bool Start(MeshLoader loader, unsigned workerCount = 0);
+
+    // Joins the workers. Requests that have not been loaded yet are dropped.
+    void Stop();
+
+    AssetHandle RequestMesh(const std::string& bakedFile, const std::string& sourceFile);
+    AssetState GetState(AssetHandle handle) const;
+
+    // Main thread only. At least one mesh is uploaded per call whatever its size,
+    // so a mesh larger than the byte budget still makes progress.
+    UploadStats ProcessUploads(MeshUploadTarget& target, const UploadBudget& budget);
+
+    // True when nothing is queued, loading or waiting for upload
+    bool IsIdle() const;
+
+private:
+    struct Request {
+        std::string bakedFile;
+        std::string sourceFile;
+        AssetState state;
+        std::unique_ptr<MeshData> data;
+    };
+
+    void WorkerLoop();
+
+    MeshLoader loader;
+    std::vector<std::thread> workers;
+
+    mutable std::mutex mutex;
+    std::condition_variable workAvailable;
+    std::deque<std::unique_ptr<Request>> requests;     // Indexed by handle - 1
+    std::deque<AssetHandle> loadQueue;
+    std::deque<AssetHandle> uploadQueue;
+    uint32_t loadsInFlight;
+    bool stopping;
+};
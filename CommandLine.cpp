@@ -0,0 +1,54 @@
+// CommandLine.cpp
+
+#include "CommandLine.h"
+
+#include <cctype>
+#include <cstdlib>
+
+CommandLine::CommandLine(int argc, const char* const* argv) {
+    for (int i = 0; i < argc; ++i) {
+        arguments.push_back(argv[i]);
+    }
+}
+
+CommandLine::CommandLine(const std::vector<std::string>& arguments)
+    : arguments(arguments) {
+}
+
+bool CommandLine::IsCommand(const char* name) const {
+    return arguments.size() >= 2 && SameSwitch(arguments[1], name);
+}
+
+const std::string& CommandLine::GetArgument(size_t index) const {
+    static const std::string none;
+    return index + 2 < arguments.size() ? arguments[index + 2] : none;
+}
+
+size_t CommandLine::GetCount(size_t defaultCount) const {
+    return ParseCount(GetArgument(0), defaultCount);
+}
+
+size_t CommandLine::GetOption(const char* name, size_t defaultValue) const {
+    size_t value = 0;
+    for (size_t i = 1; i < arguments.size(); ++i) {
+        if (SameSwitch(arguments[i], name)) {
+            value = ParseCount(i + 1 < arguments.size() ? arguments[i + 1] : std::string(), defaultValue);
+        }
+    }
+    return value;
+}
+
+bool CommandLine::SameSwitch(const std::string& argument, const char* name) {
+    size_t i = 0;
+    for (; i < argument.size() && name[i]; ++i) {
+        if (std::tolower(static_cast<unsigned char>(argument[i])) != std::tolower(static_cast<unsigned char>(name[i]))) {
+            return false;
+        }
+    }
+    return i == argument.size() && !name[i];
+}
+
+size_t CommandLine::ParseCount(const std::string& argument, size_t defaultCount) {
+    unsigned long value = std::strtoul(argument.c_str(), nullptr, 10);
+    return value > 0 ? static_cast<size_t>(value) : defaultCount;
+}
@@ -0,0 +1,33 @@
+// CommandLine.h
+
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// The program's arguments, the program name first. Switches compare
+// case-insensitively, as Windows programs usually take them.
+class CommandLine {
+public:
+    CommandLine(int argc, const char* const* argv);
+    explicit CommandLine(const std::vector<std::string>& arguments);
+
+    // True when the first argument after the program name is the switch
+    bool IsCommand(const char* name) const;
+
+    // The arguments after the command, counting from 0; empty past the end
+    const std::string& GetArgument(size_t index) const;
+
+    // The positive number after the command, defaultCount when there is none
+    size_t GetCount(size_t defaultCount) const;
+
+    // The positive number after the switch wherever it appears,
+    // defaultValue when it has none and 0 when the switch is absent
+    size_t GetOption(const char* name, size_t defaultValue) const;
+
+private:
+    static bool SameSwitch(const std::string& argument, const char* name);
+    static size_t ParseCount(const std::string& argument, size_t defaultCount);
+
+    std::vector<std::string> arguments;
+};
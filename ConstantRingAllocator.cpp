@@ -0,0 +1,42 @@
+// ConstantRingAllocator.cpp
+
+#include "ConstantRingAllocator.h"
+
+ConstantRingAllocator::ConstantRingAllocator(uint32_t capacity)
+    : capacity(0), head(0), needsDiscard(true), counters()
+{
+    Reset(capacity);
+}
+
+void ConstantRingAllocator::Reset(uint32_t newCapacity) {
+    capacity = newCapacity - newCapacity % Alignment;
+    head = 0;
+    needsDiscard = true;
+}
+
+bool ConstantRingAllocator::Allocate(uint32_t size, Allocation& allocation) {
+    uint32_t alignedSize = (size + Alignment - 1) / Alignment * Alignment;
+    if (alignedSize == 0 || alignedSize > capacity) {
+        return false;
+    }
+
+    // Wrap around; the discard hands the driver a fresh copy of the buffer
+    if (alignedSize > capacity - head) {
+        head = 0;
+        needsDiscard = true;
+    }
+
+    allocation.offset = head;
+    allocation.size = alignedSize;
+    allocation.discard = needsDiscard;
+
+    head += alignedSize;
+    needsDiscard = false;
+
+    ++counters.allocations;
+    counters.bytes += alignedSize;
+    if (allocation.discard) {
+        ++counters.discards;
+    }
+    return true;
+}
@@ -0,0 +1,44 @@
+// ConstantRingAllocator.h
+
+#pragma once
+#include <cstdint>
+
+// Sub-allocates per-draw constants from one large dynamic buffer. Allocations
+// are appended with NO_OVERWRITE maps; when the buffer is full it restarts at
+// zero with a DISCARD map, which gives it fresh memory while the GPU keeps
+// reading the old contents. Offsets are aligned to 256 bytes, the granularity
+// of constant buffer offsets.
+class ConstantRingAllocator {
+public:
+    static const uint32_t Alignment = 256;
+
+    struct Allocation {
+        uint32_t offset;
+        uint32_t size;          // Rounded up to the alignment
+        bool discard;           // Map this one with WRITE_DISCARD
+    };
+
+    struct Counters {
+        uint32_t allocations;
+        uint32_t discards;
+        uint64_t bytes;
+    };
+
+    explicit ConstantRingAllocator(uint32_t capacity = 0);
+
+    // Capacity is rounded down to the alignment. The next allocation discards.
+    void Reset(uint32_t capacity);
+
+    // Fails only when size is larger than the whole buffer
+    bool Allocate(uint32_t size, Allocation& allocation);
+
+    uint32_t GetCapacity() const { return capacity; }
+    const Counters& GetCounters() const { return counters; }
+    void ResetCounters() { counters = Counters(); }
+
+private:
+    uint32_t capacity;
+    uint32_t head;
+    bool needsDiscard;
+    Counters counters;
+};
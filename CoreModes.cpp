@@ -0,0 +1,658 @@
+// CoreModes.cpp
+
+#include "HeadlessModes.h"
+#include "EntityWorld.h"
+#include "FramePipeline.h"
+#include "Graphics.h"
+#include "HeadlessBackend.h"
+#include "JobSystem.h"
+#include "LinearArena.h"
+#include "Log.h"
+#include "MemoryTracker.h"
+#include "Profiler.h"
+#include "SmallObjectPool.h"
+#include "TransformStore.h"
+
+#include <DirectXMath.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace DirectX;
+
+// Job system benchmark: BogEngine.exe -job-scaling-benchmark [count]
+// Rebuilds the world matrix and view depth of count objects with ParallelFor
+// on 1 thread up to one per core, logging the time and speedup of each.
+int RunJobScalingBenchmark(const CommandLine& commandLine) {
+    size_t objectCount = commandLine.GetCount(200000);
+
+    struct Object {
+        XMFLOAT3 position;
+        XMFLOAT3 rotation;
+        XMFLOAT4X4 world;
+        float depth;
+    };
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> positions(-100.0f, 100.0f);
+    std::vector<Object> objects(objectCount);
+    for (Object& object : objects) {
+        object.position = XMFLOAT3(positions(random), positions(random), positions(random));
+        object.rotation = XMFLOAT3(0.0f, 0.0f, 0.0f);
+    }
+
+    XMMATRIX view = XMMatrixLookAtLH(XMVectorSet(0.0f, 10.0f, -150.0f, 1.0f),
+        XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+
+    auto update = [&objects, &view](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            Object& object = objects[i];
+            object.rotation.x += 0.01f;
+            object.rotation.y += 0.02f;
+            XMMATRIX world = XMMatrixRotationRollPitchYaw(object.rotation.x, object.rotation.y, object.rotation.z) *
+                XMMatrixTranslation(object.position.x, object.position.y, object.position.z);
+            XMStoreFloat4x4(&object.world, world);
+            object.depth = XMVectorGetZ(XMVector3Transform(world.r[3], view));
+        }
+    };
+
+    const int frames = 100;
+    unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    double singleThreadMilliseconds = 0.0;
+    for (unsigned threads = 1; threads <= maxThreads; ++threads) {
+        JobSystem jobs;
+        if (!jobs.Initialize(threads - 1)) {
+            return 1;
+        }
+
+        // One untimed frame so the workers are up and the objects are in cache
+        jobs.ParallelFor(objectCount, 256, update);
+
+        auto start = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < frames; ++frame) {
+            jobs.ParallelFor(objectCount, 256, update);
+        }
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+        if (threads == 1) {
+            singleThreadMilliseconds = milliseconds;
+        }
+
+        LogMessage("Job scaling benchmark: %u objects, %u threads, %.3f ms per frame, %.2fx\n",
+            static_cast<unsigned>(objectCount), threads, milliseconds,
+            milliseconds > 0.0 ? singleThreadMilliseconds / milliseconds : 0.0);
+    }
+    return 0;
+}
+
+// Deque contention test: BogEngine.exe -job-deque-benchmark [count]
+// The owner pushes count items and pops every fourth while one thief per
+// remaining core steals. Fails unless every item ran exactly once.
+int RunJobDequeBenchmark(const CommandLine& commandLine) {
+    size_t itemCount = commandLine.GetCount(4000000);
+
+    std::vector<uint32_t> items(itemCount);
+    std::vector<std::atomic<uint32_t>> runs(itemCount);
+    for (size_t i = 0; i < itemCount; ++i) {
+        items[i] = static_cast<uint32_t>(i);
+        runs[i] = 0;
+    }
+
+    WorkStealingQueue<uint32_t> queue(JobSystem::QueueCapacity);
+    std::atomic<bool> pushing(true);
+    std::atomic<uint64_t> stolen(0);
+
+    unsigned thiefCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+    if (thiefCount == 0) {
+        thiefCount = 1;
+    }
+
+    std::vector<std::thread> thieves;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < thiefCount; ++i) {
+        thieves.emplace_back([&] {
+            uint64_t count = 0;
+            while (pushing.load(std::memory_order_acquire) || !queue.IsEmpty()) {
+                if (uint32_t* item = queue.Steal()) {
+                    runs[*item].fetch_add(1, std::memory_order_relaxed);
+                    ++count;
+                }
+            }
+            stolen.fetch_add(count, std::memory_order_relaxed);
+        });
+    }
+
+    for (size_t i = 0; i < itemCount; ++i) {
+        // A full deque is drained from the bottom, racing the thieves
+        while (!queue.Push(&items[i])) {
+            if (uint32_t* item = queue.Pop()) {
+                runs[*item].fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        if ((i & 3) == 3) {
+            if (uint32_t* item = queue.Pop()) {
+                runs[*item].fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+    while (!queue.IsEmpty()) {
+        if (uint32_t* item = queue.Pop()) {
+            runs[*item].fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    pushing.store(false, std::memory_order_release);
+
+    for (std::thread& thief : thieves) {
+        thief.join();
+    }
+    double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    size_t wrong = 0;
+    for (size_t i = 0; i < itemCount; ++i) {
+        if (runs[i].load(std::memory_order_relaxed) != 1) {
+            ++wrong;
+        }
+    }
+
+    LogMessage("Job deque benchmark: %u items, %u thieves, %.1f%% stolen, %.1f million items/s, %u lost or repeated\n",
+        static_cast<unsigned>(itemCount), thiefCount, itemCount ? 100.0 * stolen.load() / itemCount : 0.0,
+        milliseconds > 0.0 ? itemCount / (milliseconds * 1000.0) : 0.0, static_cast<unsigned>(wrong));
+    return wrong == 0 ? 0 : 1;
+}
+
+// Transform benchmark: BogEngine.exe -transform-benchmark [count]
+// Changes 1%, 10% and 100% of count transforms per frame and compares
+// rebuilding every matrix per object, as meshes used to, with composing the
+// dirty ones in the transform store.
+int RunTransformBenchmark(const CommandLine& commandLine) {
+    size_t transformCount = commandLine.GetCount(100000);
+
+    // The old per-mesh layout: four matrices and nine floats
+    struct ObjectTransform {
+        XMMATRIX worldMatrix;
+        XMMATRIX rotationMatrix;
+        XMMATRIX scaleMatrix;
+        XMMATRIX translationMatrix;
+        float posX, posY, posZ;
+        float rotX, rotY, rotZ;
+        float scaleX, scaleY, scaleZ;
+    };
+
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> positions(-100.0f, 100.0f);
+    std::vector<ObjectTransform> objects(transformCount);
+    TransformStore store;
+    for (ObjectTransform& object : objects) {
+        object.posX = positions(random);
+        object.posY = positions(random);
+        object.posZ = positions(random);
+        object.rotX = object.rotY = object.rotZ = 0.0f;
+        object.scaleX = object.scaleY = object.scaleZ = 1.0f;
+
+        TransformId id = store.Create();
+        store.SetPosition(id, object.posX, object.posY, object.posZ);
+    }
+    store.UpdateWorldMatrices();
+
+    const int frames = 100;
+    const size_t changedPercents[] = { 1, 10, 100 };
+    for (size_t percent : changedPercents) {
+        size_t step = 100 / percent;
+
+        auto start = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < frames; ++frame) {
+            float angle = frame * 0.01f;
+            for (size_t i = 0; i < transformCount; i += step) {
+                objects[i].rotY = angle;
+            }
+            for (ObjectTransform& object : objects) {
+                object.rotationMatrix = XMMatrixRotationRollPitchYaw(object.rotX, object.rotY, object.rotZ);
+                object.scaleMatrix = XMMatrixScaling(object.scaleX, object.scaleY, object.scaleZ);
+                object.translationMatrix = XMMatrixTranslation(object.posX, object.posY, object.posZ);
+                object.worldMatrix = object.scaleMatrix * object.rotationMatrix * object.translationMatrix;
+            }
+        }
+        double objectMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+
+        start = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < frames; ++frame) {
+            float angle = frame * 0.01f;
+            for (size_t i = 0; i < transformCount; i += step) {
+                store.SetRotation(static_cast<TransformId>(i), 0.0f, angle, 0.0f);
+            }
+            store.UpdateWorldMatrices();
+        }
+        double storeMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+
+        LogMessage("Transform benchmark: %u transforms, %u%% changed, per object %.3f ms, store %.3f ms per frame (%u composed)\n",
+            static_cast<unsigned>(transformCount), static_cast<unsigned>(percent), objectMilliseconds, storeMilliseconds,
+            store.GetStats().composed);
+    }
+    return 0;
+}
+
+// Entity benchmark: BogEngine.exe -ecs-benchmark [count]
+// Times creating count entities, iterating them on one thread and on the
+// job system, adding and removing a component on all of them, and
+// destroying them.
+int RunEntityBenchmark(const CommandLine& commandLine) {
+    size_t entityCount = commandLine.GetCount(200000);
+
+    struct Position { float x, y, z; };
+    struct Velocity { float x, y, z; };
+    struct Health { float current, max; };
+
+    typedef std::chrono::steady_clock Clock;
+    auto millisecondsSince = [](Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    };
+
+    EntityWorld world;
+    std::vector<Entity> created(entityCount);
+    auto start = Clock::now();
+    for (size_t i = 0; i < entityCount; ++i) {
+        float f = static_cast<float>(i);
+        created[i] = world.Create(Position{ f, 0.0f, 0.0f }, Velocity{ 1.0f, 0.5f, 0.25f });
+    }
+    double createMilliseconds = millisecondsSince(start);
+
+    // Integrate positions, one entity at a time and one chunk per job
+    const int passes = 20;
+    const float step = 1.0f / 60.0f;
+    start = Clock::now();
+    for (int pass = 0; pass < passes; ++pass) {
+        world.ForEach<Position, Velocity>([step](Entity, Position& position, const Velocity& velocity) {
+            position.x += velocity.x * step;
+            position.y += velocity.y * step;
+            position.z += velocity.z * step;
+        });
+    }
+    double iterateMilliseconds = millisecondsSince(start) / passes;
+
+    JobSystem jobs;
+    jobs.Initialize();
+    start = Clock::now();
+    for (int pass = 0; pass < passes; ++pass) {
+        world.ParallelForEachChunk<Position, Velocity>(jobs,
+            [step](const Entity*, uint32_t count, Position* positions, const Velocity* velocities) {
+            for (uint32_t i = 0; i < count; ++i) {
+                positions[i].x += velocities[i].x * step;
+                positions[i].y += velocities[i].y * step;
+                positions[i].z += velocities[i].z * step;
+            }
+        });
+    }
+    double parallelMilliseconds = millisecondsSince(start) / passes;
+
+    // Every entity moves to the archetype with health and back
+    start = Clock::now();
+    for (Entity entity : created) {
+        world.Add(entity, Health{ 100.0f, 100.0f });
+    }
+    double addMilliseconds = millisecondsSince(start);
+
+    start = Clock::now();
+    for (Entity entity : created) {
+        world.Remove<Health>(entity);
+    }
+    double removeMilliseconds = millisecondsSince(start);
+
+    // Positions must have moved by exactly the passes run
+    bool valid = world.GetEntityCount() == entityCount;
+    float expected = 2 * passes * 0.5f * step;
+    for (size_t i = 0; i < entityCount && valid; i += 997) {
+        const Position* position = world.Get<Position>(created[i]);
+        valid = position && !world.Get<Health>(created[i]) && std::fabs(position->y - expected) < 1e-3f;
+    }
+
+    size_t chunkCount = world.GetChunkCount();
+    start = Clock::now();
+    for (Entity entity : created) {
+        world.Destroy(entity);
+    }
+    double destroyMilliseconds = millisecondsSince(start);
+    valid = valid && world.GetEntityCount() == 0 && !world.IsAlive(created[0]);
+
+    LogMessage("Entity benchmark: %u entities in %u chunks, create %.3f ms, iterate %.3f ms (%.3f ms on %u threads), "
+        "add %.3f ms, remove %.3f ms, destroy %.3f ms%s\n",
+        static_cast<unsigned>(entityCount), static_cast<unsigned>(chunkCount), createMilliseconds, iterateMilliseconds,
+        parallelMilliseconds, jobs.GetThreadCount(), addMilliseconds, removeMilliseconds, destroyMilliseconds,
+        valid ? "" : ", FAILED");
+    return valid ? 0 : 1;
+}
+
+// Frame pipeline test: BogEngine.exe -frame-pacing-test [frames]
+// Feeds a small simulation steady, jittery and stalling frame times and
+// checks it ends up bit-identical after the same number of fixed steps,
+// then paces the headless renderer to 60 Hz and checks the frame times
+// and that every frame presents once.
+int RunFramePacingTest(const CommandLine& commandLine) {
+    size_t frames = commandLine.GetCount(120);
+
+    // A damped spring, which diverges quickly if a step ever differs
+    struct SimulationState {
+        double position, velocity;
+        uint64_t steps;
+    };
+    auto simulate = [](SimulationState& state, double step) {
+        state.velocity += (-40.0 * state.position - 0.5 * state.velocity) * step;
+        state.position += state.velocity * step;
+        ++state.steps;
+    };
+
+    // Runs frames until the target number of steps, each frame lasting what nextFrame returns
+    const FramePipeline::Settings settings;
+    const uint64_t targetSteps = frames;
+    auto runSimulation = [&](const std::function<double()>& nextFrame, SimulationState& state, bool& timingValid) {
+        FramePipeline pipeline(settings);
+        state = SimulationState{ 1.0, 0.0, 0 };
+        while (state.steps < targetSteps) {
+            FramePipeline::FrameTiming timing = pipeline.Advance(nextFrame());
+            for (uint32_t i = 0; i < timing.steps && state.steps < targetSteps; ++i) {
+                simulate(state, pipeline.GetFixedStep());
+            }
+            timingValid = timingValid && timing.interpolation >= 0.0f && timing.interpolation < 1.0f &&
+                timing.steps <= static_cast<uint32_t>(settings.maxFrameTime / settings.fixedStep) + 1;
+        }
+        return pipeline.GetStats();
+    };
+
+    std::mt19937 random(7);
+    std::uniform_real_distribution<double> jitter(0.25, 1.75);
+    uint32_t frameIndex = 0;
+
+    bool timingValid = true;
+    SimulationState steady, jittery, stalling;
+    FramePipeline::Stats steadyStats = runSimulation([&]() { return settings.fixedStep; }, steady, timingValid);
+    runSimulation([&]() { return settings.fixedStep * jitter(random); }, jittery, timingValid);
+    FramePipeline::Stats stallStats = runSimulation([&]() {
+        return (++frameIndex % 10 == 0) ? 1.0 : settings.fixedStep * 0.5;
+    }, stalling, timingValid);
+
+    // Exactly one step per frame at the fixed rate, and the stalls clamped
+    bool deterministic = std::memcmp(&steady, &jittery, sizeof(steady)) == 0 &&
+        std::memcmp(&steady, &stalling, sizeof(steady)) == 0;
+    bool valid = deterministic && timingValid && steadyStats.frames == targetSteps && steadyStats.steps == targetSteps &&
+        steadyStats.clampedFrames == 0 && stallStats.clampedFrames > 0;
+
+    // Paced headless frames: one present each, and frame times at the target
+    FramePipeline::Settings pacedSettings;
+    pacedSettings.targetFrameTime = 1.0 / 60.0;
+    FramePipeline pipeline(pacedSettings);
+    HeadlessBackend backend;
+    FramePipeline::Stats pacedStats = {};
+    uint32_t presents = 0;
+    if (backend.Initialize(320, 240)) {
+        Graphics graphics;
+        if (graphics.Initialize(&backend, 320, 240)) {
+            backend.SetMaxFrameLatency(pacedSettings.maxFrameLatency);
+            while (graphics.IsStreaming()) {
+                graphics.ProcessStreaming();
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+
+            // The first frame only starts the clock
+            pipeline.Start();
+            pipeline.BeginFrame();
+            pipeline.ResetStats();
+            for (size_t frame = 0; frame < frames; ++frame) {
+                FramePipeline::FrameTiming timing = pipeline.BeginFrame();
+                for (uint32_t i = 0; i < timing.steps; ++i) {
+                    graphics.Update(static_cast<float>(pipeline.GetFixedStep()));
+                }
+                graphics.Draw(timing.interpolation);
+                graphics.Present();
+            }
+            pacedStats = pipeline.GetStats();
+            presents = backend.GetPresentCount();
+        }
+    }
+
+    const double targetMilliseconds = pacedSettings.targetFrameTime * 1000.0;
+    bool paced = presents == frames && pacedStats.frames == frames &&
+        std::fabs(pacedStats.averageMilliseconds - targetMilliseconds) < targetMilliseconds * 0.05 &&
+        pacedStats.deviationMilliseconds < targetMilliseconds * 0.1;
+
+    LogMessage("Frame pacing test: %u steps %s across steady, jittery and stalling frames; "
+        "%u paced frames at %.3f ms (min %.3f, max %.3f, deviation %.3f), %u presents%s\n",
+        static_cast<unsigned>(targetSteps), deterministic ? "identical" : "DIFFERENT",
+        pacedStats.frames, pacedStats.averageMilliseconds, pacedStats.minMilliseconds, pacedStats.maxMilliseconds,
+        pacedStats.deviationMilliseconds, presents, (valid && paced) ? "" : ", FAILED");
+    return (valid && paced) ? 0 : 1;
+}
+
+// Frame memory test: BogEngine.exe -frame-memory-test [frames]
+// Checks that linear arena allocations made from every thread at once do
+// not overlap and that a reset arena holds the same load without growing,
+// that a frame arena keeps the previous frame's data, and that pooled
+// blocks freed on other threads are recycled. Then renders a few thousand
+// meshes on the headless backend and expects no frame after the warm-up
+// to allocate from the global heap, which only builds with
+// BOG_MEMORY_TRACKING=1, such as Debug, can see.
+int RunFrameMemoryTest(const CommandLine& commandLine) {
+    size_t frames = commandLine.GetCount(600);
+
+    bool valid = true;
+    auto expect = [&valid](bool condition, const char* failure) {
+        if (!condition) {
+            LogMessage("Frame memory test: %s\n", failure);
+            valid = false;
+        }
+    };
+    bool tracking = MemoryTracker::IsEnabled();
+    if (!tracking) {
+        LogMessage("Frame memory test: built without BOG_MEMORY_TRACKING, heap allocations are not checked\n");
+    }
+
+    JobSystem jobs;
+    jobs.Initialize();
+
+    // Every allocation is filled with its index, so an overlap shows up as a wrong value
+    const size_t allocationCount = 20000;
+    std::vector<uint32_t*> blocks(allocationCount);
+    auto allocationWords = [](size_t i) { return 4 + (i % 7) * 2; };
+    auto allocationAlignment = [](size_t i) { return size_t(4) << (i % 5); };
+    auto fill = [&](LinearArena& arena, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            uint32_t* block = static_cast<uint32_t*>(arena.Allocate(allocationWords(i) * sizeof(uint32_t), allocationAlignment(i)));
+            for (size_t word = 0; word < allocationWords(i); ++word) {
+                block[word] = static_cast<uint32_t>(i);
+            }
+            blocks[i] = block;
+        }
+    };
+    auto check = [&]() {
+        bool intact = true;
+        for (size_t i = 0; i < allocationCount; ++i) {
+            intact = intact && reinterpret_cast<uintptr_t>(blocks[i]) % allocationAlignment(i) == 0;
+            for (size_t word = 0; word < allocationWords(i); ++word) {
+                intact = intact && blocks[i][word] == i;
+            }
+        }
+        return intact;
+    };
+
+    // Starts small, so the concurrent fill has to chain on blocks
+    LinearArena arena(4096);
+    jobs.ParallelFor(allocationCount, 64, [&](size_t begin, size_t end) { fill(arena, begin, end); });
+    LinearArena::Stats grown = arena.GetStats();
+    expect(check(), "concurrent arena allocations overlap or are misaligned");
+    expect(grown.growths > 0 && grown.blocks > 1, "arena did not grow");
+
+    arena.Reset();
+    LinearArena::Stats reset = arena.GetStats();
+    expect(reset.blocks == 1 && reset.used == 0 && reset.capacity >= grown.used, "reset arena does not hold the previous load");
+
+    uint64_t heapBefore = MemoryTracker::GetTotalAllocations();
+    fill(arena, 0, allocationCount);
+    expect(check(), "arena allocations overlap after a reset");
+    expect(arena.GetStats().growths == grown.growths, "reset arena grew again under the same load");
+    expect(!tracking || MemoryTracker::GetTotalAllocations() == heapBefore, "reset arena allocated from the heap");
+
+    const uint32_t resetCount = 1000000;
+    auto resetStart = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < resetCount; ++i) {
+        arena.Allocate(64);
+        arena.Reset();
+    }
+    std::chrono::duration<double, std::nano> resetTime = std::chrono::steady_clock::now() - resetStart;
+
+    // A frame's data lasts through the next frame, then its memory is reused
+    FrameArena frameArena(4096);
+    frameArena.BeginFrame();
+    uint32_t* first = frameArena.AllocateArray<uint32_t>(256);
+    std::fill(first, first + 256, 1u);
+    frameArena.BeginFrame();
+    uint32_t* second = frameArena.AllocateArray<uint32_t>(256);
+    std::fill(second, second + 256, 2u);
+    expect(std::count(first, first + 256, 1u) == 256, "frame arena overwrote the previous frame");
+    frameArena.BeginFrame();
+    expect(frameArena.AllocateArray<uint32_t>(256) == first, "frame arena did not reuse the frame before last");
+
+    // Blocks allocated here and freed on the workers come back through the
+    // shared lists; once that is warm, no more pages are carved
+    const size_t pooledCount = 4096;
+    const uint32_t poolRounds = 200;
+    const uint32_t poolWarmupRounds = 20;
+    std::vector<uint64_t*> pooled(pooledCount);
+    uint64_t poolPages = 0;
+    bool poolIntact = true;
+    heapBefore = 0;
+    for (uint32_t round = 0; round < poolRounds; ++round) {
+        if (round == poolWarmupRounds) {
+            poolPages = SmallObjectPool::GetStats().pages;
+            heapBefore = MemoryTracker::GetTotalAllocations();
+        }
+        for (size_t i = 0; i < pooledCount; ++i) {
+            pooled[i] = static_cast<uint64_t*>(SmallObjectPool::Allocate(8 * (1 + i % 8)));
+            pooled[i][0] = round * pooledCount + i;
+        }
+        std::atomic<bool> intact(true);
+        jobs.ParallelFor(pooledCount, 64, [&, round](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                if (pooled[i][0] != round * pooledCount + i) {
+                    intact = false;
+                }
+                SmallObjectPool::Free(pooled[i], 8 * (1 + i % 8));
+            }
+        });
+        poolIntact = poolIntact && intact;
+    }
+    SmallObjectPool::Stats poolStats = SmallObjectPool::GetStats();
+    uint64_t poolHeapAllocations = MemoryTracker::GetTotalAllocations() - heapBefore;
+    expect(poolIntact, "pooled blocks were handed out twice");
+    expect(poolStats.pages == poolPages && (!tracking || poolHeapAllocations == 0),
+        "pool kept allocating when blocks were freed on other threads");
+
+    // The frame loop, with enough meshes that culling and queuing run as jobs
+    const uint32_t meshCount = 4000;
+    const uint32_t warmupFrames = 30;
+    uint32_t allocatingFrames = 0;
+    uint64_t frameAllocations = 0;
+    HeadlessBackend backend;
+    if (backend.Initialize(320, 240)) {
+        Graphics graphics;
+        if (graphics.Initialize(&backend, 320, 240)) {
+            while (graphics.IsStreaming()) {
+                graphics.ProcessStreaming();
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+
+            const uint32_t side = 80;
+            for (uint32_t i = 0; i < meshCount; ++i) {
+                XMFLOAT3 position((static_cast<float>(i % side) - side * 0.5f) * 1.5f, -2.0f, 5.0f + (i / side) * 1.5f);
+                graphics.SpawnMesh(graphics.GetMeshes().Acquire("Pyramid"), position);
+            }
+
+            for (size_t frame = 0; frame < warmupFrames + frames; ++frame) {
+                graphics.ProcessStreaming();
+                graphics.Update(1.0f / 60.0f);
+                graphics.Draw();
+                graphics.Present();
+
+                uint64_t allocations = MemoryTracker::GetFrameAllocations();
+                if (frame >= warmupFrames && allocations > 0) {
+                    if (allocatingFrames++ == 0) {
+                        MemoryTracker::LogFrameStats();
+                    }
+                    frameAllocations += allocations;
+                }
+            }
+        }
+        else {
+            expect(false, "graphics failed to initialize");
+        }
+    }
+    expect(!tracking || allocatingFrames == 0, "steady state frames allocated from the heap");
+
+    LogMessage("Frame memory test: %u frames of %u meshes after %u warm-up frames, "
+        "%llu heap allocations in %u frames; %llu pool pages, %llu batches shared between threads; arena reset %.1f ns\n",
+        static_cast<unsigned>(frames), meshCount, warmupFrames, static_cast<unsigned long long>(frameAllocations),
+        allocatingFrames, static_cast<unsigned long long>(poolStats.pages),
+        static_cast<unsigned long long>(poolStats.sharedBatches), resetTime.count() / resetCount);
+    LogMessage(valid ? "Frame memory test: passed\n" : "Frame memory test: FAILED\n");
+    return valid ? 0 : 1;
+}
+
+// Profiler overhead benchmark: BogEngine.exe -profiler-benchmark [count]
+// Times count empty zones with no capture running and while capturing,
+// against the same loop without zones, and logs the cost per zone. Builds
+// with BOG_PROFILING=0 should report no overhead.
+int RunProfilerBenchmark(const CommandLine& commandLine) {
+    size_t zoneCount = commandLine.GetCount(1000000);
+
+    // Frames are marked often enough that no thread buffer fills up
+    const size_t zonesPerFrame = Profiler::ThreadBufferSize / 2;
+    volatile uint64_t sink = 0;
+
+    typedef std::chrono::steady_clock Clock;
+    auto nanosecondsPerZone = [zoneCount](Clock::time_point start) {
+        return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / zoneCount;
+    };
+
+    auto start = Clock::now();
+    for (size_t i = 0; i < zoneCount; ++i) {
+        sink = sink + 1;
+        if (i % zonesPerFrame == 0) {
+            BOG_PROFILE_FRAME();
+        }
+    }
+    double baseline = nanosecondsPerZone(start);
+
+    start = Clock::now();
+    for (size_t i = 0; i < zoneCount; ++i) {
+        BOG_PROFILE_ZONE("Idle zone");
+        sink = sink + 1;
+        if (i % zonesPerFrame == 0) {
+            BOG_PROFILE_FRAME();
+        }
+    }
+    double idle = nanosecondsPerZone(start);
+
+    Profiler::BeginCapture();
+    start = Clock::now();
+    for (size_t i = 0; i < zoneCount; ++i) {
+        BOG_PROFILE_ZONE("Captured zone");
+        sink = sink + 1;
+        if (i % zonesPerFrame == 0) {
+            BOG_PROFILE_FRAME();
+        }
+    }
+    double captured = nanosecondsPerZone(start);
+    Profiler::EndCapture();
+
+    // Every zone and frame marker must have made it into the capture
+    size_t frameCount = (zoneCount + zonesPerFrame - 1) / zonesPerFrame;
+    size_t expected = BOG_PROFILING ? zoneCount + frameCount : 0;
+    bool valid = Profiler::GetEventCount() == expected && Profiler::GetDroppedCount() == 0;
+
+    LogMessage("Profiler benchmark: %u zones, %.2f ns per zone idle, %.2f ns captured "
+        "(%.2f ns loop), %u events%s\n",
+        static_cast<unsigned>(zoneCount), idle - baseline, captured - baseline, baseline,
+        static_cast<unsigned>(Profiler::GetEventCount()), valid ? "" : ", FAILED");
+    return valid ? 0 : 1;
+}
@@ -0,0 +1,478 @@
+// D3D11Backend.cpp
+
+#include "D3D11Backend.h"
+#include <dxgi.h>
+#include <dxgi1_2.h>
+#pragma comment(lib, "dxgi.lib")
+
+#include "Log.h"
+#include <cstring>
+
+namespace {
+
+    std::string NarrowString(const wchar_t* text) {
+        int length = WideCharToMultiByte(CP_ACP, 0, text, -1, nullptr, 0, nullptr, nullptr);
+        if (length <= 1) {
+            return std::string();
+        }
+        std::string result(static_cast<size_t>(length - 1), '\0');
+        WideCharToMultiByte(CP_ACP, 0, text, -1, &result[0], length, nullptr, nullptr);
+        return result;
+    }
+
+    ShaderDesc MakeShaderDesc(const wchar_t* filename, const char* target) {
+        ShaderDesc desc;
+        desc.sourceFile = NarrowString(filename);
+        desc.entryPoint = "main";
+        desc.target = target;
+        return desc;
+    }
+
+    DXGI_FORMAT GetEncodingFormat(VertexEncoding encoding) {
+        switch (encoding) {
+        case VertexEncoding::Float2:        return DXGI_FORMAT_R32G32_FLOAT;
+        case VertexEncoding::Float3:        return DXGI_FORMAT_R32G32B32_FLOAT;
+        case VertexEncoding::UNorm16x4:     return DXGI_FORMAT_R16G16B16A16_UNORM;
+        case VertexEncoding::OctSNorm16x2:  return DXGI_FORMAT_R16G16_SNORM;
+        case VertexEncoding::Half2:         return DXGI_FORMAT_R16G16_FLOAT;
+        case VertexEncoding::UNorm8x4:      return DXGI_FORMAT_R8G8B8A8_UNORM;
+        }
+        return DXGI_FORMAT_UNKNOWN;
+    }
+
+    // Per-vertex elements in slot 0, then for instanced pipelines the WORLD0-3 rows in slot 1
+    void BuildInputLayout(const PipelineDesc& desc, std::vector<D3D11_INPUT_ELEMENT_DESC>& layout) {
+        layout.clear();
+        for (const VertexElement& element : desc.vertexFormat->GetElements()) {
+            D3D11_INPUT_ELEMENT_DESC elementDesc = {};
+            elementDesc.SemanticName = VertexFormat::GetSemanticName(element.semantic);
+            elementDesc.SemanticIndex = 0;
+            elementDesc.Format = GetEncodingFormat(element.encoding);
+            elementDesc.InputSlot = 0;
+            elementDesc.AlignedByteOffset = element.offset;
+            elementDesc.InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
+            elementDesc.InstanceDataStepRate = 0;
+            layout.push_back(elementDesc);
+        }
+
+        if (desc.instanced) {
+            for (UINT row = 0; row < 4; ++row) {
+                D3D11_INPUT_ELEMENT_DESC elementDesc = {};
+                elementDesc.SemanticName = "WORLD";
+                elementDesc.SemanticIndex = row;
+                elementDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+                elementDesc.InputSlot = 1;
+                elementDesc.AlignedByteOffset = row * 4 * sizeof(float);
+                elementDesc.InputSlotClass = D3D11_INPUT_PER_INSTANCE_DATA;
+                elementDesc.InstanceDataStepRate = 1;
+                layout.push_back(elementDesc);
+            }
+        }
+    }
+
+}
+
+D3D11Backend::D3D11Backend() {}
+
+D3D11Backend::~D3D11Backend() {
+    for (ID3D11Buffer* buffer : buffers) {
+        if (buffer) buffer->Release();
+    }
+    for (Pipeline& pipeline : pipelines) {
+        pipeline.inputLayout->Release();
+        pipeline.vertexShader->Release();
+    }
+    for (auto& entry : pixelShaders) {
+        entry.second->Release();
+    }
+    if (depthStencilState) depthStencilState->Release();
+    if (depthStencilView) depthStencilView->Release();
+    if (depthStencilBuffer) depthStencilBuffer->Release();
+    if (renderTargetView) renderTargetView->Release();
+    if (swapChain) swapChain->Release();
+    delete renderContext;
+    if (context) context->Release();
+    if (device) device->Release();
+}
+
+const char* const D3D11Backend::ShaderCacheDirectory = "ShaderCache";
+
+void D3D11Backend::GetPipelineShaders(const PipelineDesc& desc, ShaderDesc& vertexShader, ShaderDesc& pixelShader) {
+    vertexShader = MakeShaderDesc(desc.vertexShaderFile, "vs_5_0");
+    pixelShader = MakeShaderDesc(desc.pixelShaderFile, "ps_5_0");
+}
+
+bool D3D11Backend::Initialize(HWND hwnd, int width, int height) {
+    // Without a cache directory shaders still compile, they just are not kept
+    if (!shaderCache.Initialize(ShaderCacheDirectory, &shaderCompiler)) {
+        LogMessage("Failed to create the shader cache directory %s\n", ShaderCacheDirectory);
+    }
+
+    IDXGIFactory1* pFactory = nullptr;
+    HRESULT hr = CreateDXGIFactory1(__uuidof(IDXGIFactory1), (void**)&pFactory);
+    if (FAILED(hr)) {
+        MessageBox(hwnd, L"Failed to create DXGI Factory!", L"Error", MB_OK);
+        return false;
+    }
+
+    // Enumerate adapters to find the discrete GPU
+    IDXGIAdapter1* pAdapter = nullptr;
+    IDXGIAdapter1* selectedAdapter = nullptr;
+    UINT adapterIndex = 0;
+    SIZE_T maxDedicatedVideoMemory = 0;
+
+    while (pFactory->EnumAdapters1(adapterIndex, &pAdapter) != DXGI_ERROR_NOT_FOUND) {
+        DXGI_ADAPTER_DESC1 adapterDesc;
+        pAdapter->GetDesc1(&adapterDesc);
+
+        // Skip software adapters if necessary
+        if (!(adapterDesc.Flags & DXGI_ADAPTER_FLAG_SOFTWARE)) {
+            // Prefer the adapter with the most dedicated video memory
+            if (adapterDesc.DedicatedVideoMemory > maxDedicatedVideoMemory) {
+                maxDedicatedVideoMemory = adapterDesc.DedicatedVideoMemory;
+                if (selectedAdapter) selectedAdapter->Release();
+                selectedAdapter = pAdapter;
+                // Do not release pAdapter here since we keep it as selectedAdapter
+            }
+            else {
+                pAdapter->Release();
+            }
+        }
+        else {
+            pAdapter->Release();
+        }
+
+        adapterIndex++;
+    }
+
+    if (!selectedAdapter) {
+        MessageBox(hwnd, L"No suitable graphics adapter found!", L"Error", MB_OK);
+        pFactory->Release();
+        return false;
+    }
+
+    DXGI_SWAP_CHAIN_DESC scd = {};
+    scd.BufferCount = 1;
+    scd.BufferDesc.Width = width;
+    scd.BufferDesc.Height = height;
+    scd.BufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    scd.BufferDesc.RefreshRate.Numerator = 60;
+    scd.BufferDesc.RefreshRate.Denominator = 1;
+    scd.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+    scd.OutputWindow = hwnd;
+    scd.SampleDesc.Count = 1;
+    scd.SampleDesc.Quality = 0;
+    scd.Windowed = TRUE;
+    scd.SwapEffect = DXGI_SWAP_EFFECT_DISCARD;
+
+    UINT createDeviceFlags = D3D11_CREATE_DEVICE_DEBUG;
+
+    hr = D3D11CreateDeviceAndSwapChain(
+        selectedAdapter, D3D_DRIVER_TYPE_UNKNOWN, nullptr, createDeviceFlags, nullptr, 0,
+        D3D11_SDK_VERSION, &scd, &swapChain, &device, nullptr, &context);
+
+    selectedAdapter->Release();
+    pFactory->Release();
+
+    if (FAILED(hr)) {
+        MessageBox(hwnd, L"Failed to create Direct3D device and swap chain!", L"Error", MB_OK);
+        return false;
+    }
+
+    // All draw submission goes through the render context
+    renderContext = new RenderContext();
+    if (!renderContext->Initialize(device, context)) {
+        MessageBox(hwnd, L"Failed to create the constant ring buffer!", L"Error", MB_OK);
+        return false;
+    }
+
+    // Create render target view
+    ID3D11Texture2D* backBuffer = nullptr;
+    hr = swapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), (void**)&backBuffer);
+    if (FAILED(hr)) {
+        MessageBox(hwnd, L"Failed to get back buffer!", L"Error", MB_OK);
+        return false;
+    }
+
+    hr = device->CreateRenderTargetView(backBuffer, nullptr, &renderTargetView);
+    backBuffer->Release();
+    if (FAILED(hr)) {
+        MessageBox(hwnd, L"Failed to create render target view!", L"Error", MB_OK);
+        return false;
+    }
+
+    // Create depth-stencil buffer
+    D3D11_TEXTURE2D_DESC depthStencilDesc = {};
+    depthStencilDesc.Width = width;
+    depthStencilDesc.Height = height;
+    depthStencilDesc.MipLevels = 1;
+    depthStencilDesc.ArraySize = 1;
+    depthStencilDesc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
+    depthStencilDesc.SampleDesc.Count = 1;
+    depthStencilDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
+
+    hr = device->CreateTexture2D(&depthStencilDesc, nullptr, &depthStencilBuffer);
+    if (FAILED(hr)) {
+        MessageBox(hwnd, L"Failed to create depth stencil buffer!", L"Error", MB_OK);
+        return false;
+    }
+
+    // Create depth-stencil view
+    hr = device->CreateDepthStencilView(depthStencilBuffer, nullptr, &depthStencilView);
+    if (FAILED(hr)) {
+        MessageBox(hwnd, L"Failed to create depth stencil view!", L"Error", MB_OK);
+        return false;
+    }
+
+    // Bind the render target view and depth stencil view
+    context->OMSetRenderTargets(1, &renderTargetView, depthStencilView);
+
+    // Set up the viewport
+    viewport.Width = static_cast<float>(width);
+    viewport.Height = static_cast<float>(height);
+    viewport.MinDepth = 0.0f;
+    viewport.MaxDepth = 1.0f;
+    viewport.TopLeftX = 0.0f;
+    viewport.TopLeftY = 0.0f;
+    context->RSSetViewports(1, &viewport);
+
+    // Set up the depth-stencil state
+    D3D11_DEPTH_STENCIL_DESC dsDesc = {};
+    dsDesc.DepthEnable = TRUE;
+    dsDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ALL;
+    dsDesc.DepthFunc = D3D11_COMPARISON_LESS;
+
+    hr = device->CreateDepthStencilState(&dsDesc, &depthStencilState);
+    if (FAILED(hr)) {
+        MessageBox(hwnd, L"Failed to create depth stencil state!", L"Error", MB_OK);
+        return false;
+    }
+
+    context->OMSetDepthStencilState(depthStencilState, 0);
+
+    return true;
+}
+
+ID3D11PixelShader* D3D11Backend::GetPixelShader(const wchar_t* filename) {
+    auto it = pixelShaders.find(filename);
+    if (it != pixelShaders.end()) {
+        return it->second;
+    }
+
+    std::vector<char> bytecode;
+    if (!shaderCache.GetBytecode(MakeShaderDesc(filename, "ps_5_0"), bytecode)) {
+        return nullptr;
+    }
+
+    ID3D11PixelShader* pixelShader = nullptr;
+    HRESULT hr = device->CreatePixelShader(bytecode.data(), bytecode.size(), nullptr, &pixelShader);
+    if (FAILED(hr)) {
+        return nullptr;
+    }
+
+    pixelShaders[filename] = pixelShader;
+    return pixelShader;
+}
+
+PipelineHandle D3D11Backend::CreatePipeline(const PipelineDesc& desc) {
+    Pipeline pipeline = {};
+    pipeline.pixelShader = GetPixelShader(desc.pixelShaderFile);
+    if (!pipeline.pixelShader) {
+        LogMessage("Failed to create pixel shader %ls\n", desc.pixelShaderFile);
+        return InvalidPipeline;
+    }
+
+    std::vector<char> vsBytecode;
+    if (!shaderCache.GetBytecode(MakeShaderDesc(desc.vertexShaderFile, "vs_5_0"), vsBytecode)) {
+        LogMessage("Failed to compile vertex shader %ls\n", desc.vertexShaderFile);
+        return InvalidPipeline;
+    }
+
+    // The input layout is validated against the vertex shader's signature
+    std::vector<D3D11_INPUT_ELEMENT_DESC> layoutDesc;
+    BuildInputLayout(desc, layoutDesc);
+
+    HRESULT hr = device->CreateVertexShader(vsBytecode.data(), vsBytecode.size(), nullptr, &pipeline.vertexShader);
+    if (SUCCEEDED(hr)) {
+        hr = device->CreateInputLayout(layoutDesc.data(), static_cast<UINT>(layoutDesc.size()),
+            vsBytecode.data(), vsBytecode.size(), &pipeline.inputLayout);
+        if (FAILED(hr)) {
+            pipeline.vertexShader->Release();
+        }
+    }
+    if (FAILED(hr)) {
+        LogMessage("Failed to create vertex shader or input layout for %ls\n", desc.vertexShaderFile);
+        return InvalidPipeline;
+    }
+
+    pipelines.push_back(pipeline);
+    return static_cast<PipelineHandle>(pipelines.size());
+}
+
+BufferHandle D3D11Backend::CreateBuffer(BufferUsage usage, const void* data, uint32_t size) {
+    D3D11_BUFFER_DESC desc = {};
+    desc.ByteWidth = size;
+    switch (usage) {
+    case BufferUsage::Vertex:
+        desc.Usage = D3D11_USAGE_DEFAULT;
+        desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+        break;
+    case BufferUsage::Index:
+        desc.Usage = D3D11_USAGE_DEFAULT;
+        desc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+        break;
+    case BufferUsage::DynamicVertex:
+        desc.Usage = D3D11_USAGE_DYNAMIC;
+        desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+        desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+        break;
+    }
+
+    D3D11_SUBRESOURCE_DATA initialData = {};
+    initialData.pSysMem = data;
+
+    ID3D11Buffer* buffer = nullptr;
+    HRESULT hr = device->CreateBuffer(&desc, data ? &initialData : nullptr, &buffer);
+    if (FAILED(hr)) {
+        return InvalidBuffer;
+    }
+    if (data) {
+        bufferBytes += size;
+    }
+
+    if (!freeBuffers.empty()) {
+        BufferHandle handle = freeBuffers.back();
+        freeBuffers.pop_back();
+        buffers[handle - 1] = buffer;
+        return handle;
+    }
+    buffers.push_back(buffer);
+    return static_cast<BufferHandle>(buffers.size());
+}
+
+void D3D11Backend::DestroyBuffer(BufferHandle buffer) {
+    ID3D11Buffer* d3dBuffer = GetBuffer(buffer);
+    if (d3dBuffer) {
+        d3dBuffer->Release();
+        buffers[buffer - 1] = nullptr;
+        freeBuffers.push_back(buffer);
+    }
+}
+
+ID3D11Buffer* D3D11Backend::GetBuffer(BufferHandle buffer) const {
+    return (buffer != InvalidBuffer && buffer <= buffers.size()) ? buffers[buffer - 1] : nullptr;
+}
+
+bool D3D11Backend::UpdateBuffer(BufferHandle buffer, const void* data, uint32_t size) {
+    ID3D11Buffer* d3dBuffer = GetBuffer(buffer);
+    if (!d3dBuffer) {
+        return false;
+    }
+
+    D3D11_MAPPED_SUBRESOURCE mapped = {};
+    HRESULT hr = context->Map(d3dBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
+    if (FAILED(hr)) {
+        return false;
+    }
+    std::memcpy(mapped.pData, data, size);
+    context->Unmap(d3dBuffer, 0);
+
+    bufferBytes += size;
+    return true;
+}
+
+bool D3D11Backend::WriteBuffer(BufferHandle buffer, uint32_t offset, const void* data, uint32_t size) {
+    ID3D11Buffer* d3dBuffer = GetBuffer(buffer);
+    if (!d3dBuffer) {
+        return false;
+    }
+
+    // The runtime copies the data aside if the GPU still reads the buffer
+    D3D11_BOX box = { offset, 0, 0, offset + size, 1, 1 };
+    context->UpdateSubresource(d3dBuffer, 0, &box, data, 0, 0);
+
+    bufferBytes += size;
+    return true;
+}
+
+bool D3D11Backend::CopyBuffer(BufferHandle dest, uint32_t destOffset, BufferHandle source, uint32_t sourceOffset, uint32_t size) {
+    ID3D11Buffer* destBuffer = GetBuffer(dest);
+    ID3D11Buffer* sourceBuffer = GetBuffer(source);
+    if (!destBuffer || !sourceBuffer || destBuffer == sourceBuffer) {
+        return false;
+    }
+
+    D3D11_BOX box = { sourceOffset, 0, 0, sourceOffset + size, 1, 1 };
+    context->CopySubresourceRegion(destBuffer, 0, destOffset, 0, 0, sourceBuffer, 0, &box);
+    return true;
+}
+
+void D3D11Backend::BeginFrame(const float clearColor[4]) {
+    renderContext->BeginFrame();
+
+    const RenderContext::FrameCounters& counters = renderContext->GetLastFrameCounters();
+    lastFrame.states = counters.states;
+    lastFrame.constants = counters.constants;
+    lastFrame.draws = counters.draws;
+    lastFrame.instances = instances;
+    lastFrame.triangles = triangles;
+    lastFrame.bufferBytes = bufferBytes;
+
+    instances = 0;
+    triangles = 0;
+    bufferBytes = 0;
+
+    context->ClearRenderTargetView(renderTargetView, clearColor);
+    context->ClearDepthStencilView(depthStencilView, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
+}
+
+void D3D11Backend::Present() {
+    swapChain->Present(1, 0); // 1 to enable VSync, 0 to disable
+}
+
+void D3D11Backend::SetMaxFrameLatency(uint32_t frames) {
+    IDXGIDevice1* dxgiDevice = nullptr;
+    if (!device || FAILED(device->QueryInterface(__uuidof(IDXGIDevice1), reinterpret_cast<void**>(&dxgiDevice)))) {
+        return;
+    }
+    dxgiDevice->SetMaximumFrameLatency(frames);
+    dxgiDevice->Release();
+}
+
+void D3D11Backend::SetPipeline(PipelineHandle pipeline) {
+    if (pipeline == InvalidPipeline || pipeline > pipelines.size()) {
+        return;
+    }
+
+    // The render context drops whichever parts are already bound
+    const Pipeline& bound = pipelines[pipeline - 1];
+    renderContext->SetInputLayout(bound.inputLayout);
+    renderContext->SetVertexShader(bound.vertexShader);
+    renderContext->SetPixelShader(bound.pixelShader);
+}
+
+void D3D11Backend::SetVertexBuffer(uint32_t slot, BufferHandle buffer, uint32_t stride) {
+    renderContext->SetVertexBuffer(slot, GetBuffer(buffer), stride, 0);
+}
+
+void D3D11Backend::SetIndexBuffer(BufferHandle buffer, IndexFormat format) {
+    renderContext->SetIndexBuffer(GetBuffer(buffer), (format == IndexFormat::UInt16) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT, 0);
+}
+
+bool D3D11Backend::SetVSConstants(const void* data, uint32_t size) {
+    return renderContext->SetVSConstants(data, size);
+}
+
+void D3D11Backend::DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) {
+    renderContext->SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    renderContext->DrawIndexed(indexCount, startIndex, baseVertex);
+    instances += 1;
+    triangles += indexCount / 3;
+}
+
+void D3D11Backend::DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex) {
+    renderContext->SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    renderContext->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, 0);
+    instances += instanceCount;
+    triangles += static_cast<uint64_t>(indexCount / 3) * instanceCount;
+}
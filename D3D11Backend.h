@@ -0,0 +1,91 @@
+// D3D11Backend.h
+
+#pragma once
+#include <d3d11.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "D3DShaderCompiler.h"
+#include "RenderBackend.h"
+#include "RenderContext.h"
+#include "ShaderCache.h"
+
+// Renders into a window through D3D11. Owns the device, swap chain and depth
+// buffer, and sends all draw submission through a RenderContext.
+class D3D11Backend : public RenderBackend {
+public:
+    D3D11Backend();
+    ~D3D11Backend() override;
+
+    // Picks the adapter with the most dedicated memory and creates the targets
+    bool Initialize(HWND hwnd, int width, int height);
+
+    // Compiled shaders are cached here, next to the executable's working directory
+    static const char* const ShaderCacheDirectory;
+
+    // The shader permutations a pipeline compiles, for precompiling them offline
+    static void GetPipelineShaders(const PipelineDesc& desc, ShaderDesc& vertexShader, ShaderDesc& pixelShader);
+
+    const ShaderCache& GetShaderCache() const { return shaderCache; }
+
+    PipelineHandle CreatePipeline(const PipelineDesc& desc) override;
+    BufferHandle CreateBuffer(BufferUsage usage, const void* data, uint32_t size) override;
+    void DestroyBuffer(BufferHandle buffer) override;
+    bool UpdateBuffer(BufferHandle buffer, const void* data, uint32_t size) override;
+    bool WriteBuffer(BufferHandle buffer, uint32_t offset, const void* data, uint32_t size) override;
+    bool CopyBuffer(BufferHandle dest, uint32_t destOffset, BufferHandle source, uint32_t sourceOffset, uint32_t size) override;
+
+    void BeginFrame(const float clearColor[4]) override;
+    void Present() override;
+    void SetMaxFrameLatency(uint32_t frames) override;
+
+    void SetPipeline(PipelineHandle pipeline) override;
+    void SetVertexBuffer(uint32_t slot, BufferHandle buffer, uint32_t stride) override;
+    void SetIndexBuffer(BufferHandle buffer, IndexFormat format) override;
+    bool SetVSConstants(const void* data, uint32_t size) override;
+
+    void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) override;
+    void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex) override;
+
+    const RenderStats& GetLastFrameStats() const override { return lastFrame; }
+
+private:
+    struct Pipeline {
+        ID3D11InputLayout* inputLayout;
+        ID3D11VertexShader* vertexShader;
+        ID3D11PixelShader* pixelShader;     // Owned by pixelShaders
+    };
+
+    ID3D11Buffer* GetBuffer(BufferHandle buffer) const;
+    ID3D11PixelShader* GetPixelShader(const wchar_t* filename);
+
+    ID3D11Device* device = nullptr;
+    ID3D11DeviceContext* context = nullptr;
+    IDXGISwapChain* swapChain = nullptr;
+    ID3D11RenderTargetView* renderTargetView = nullptr;
+    RenderContext* renderContext = nullptr;
+
+    // Depth buffer components
+    ID3D11Texture2D* depthStencilBuffer = nullptr;
+    ID3D11DepthStencilView* depthStencilView = nullptr;
+    ID3D11DepthStencilState* depthStencilState = nullptr;
+
+    D3D11_VIEWPORT viewport = {};
+
+    // Indexed by handle - 1; destroyed buffers leave a null slot for reuse
+    std::vector<Pipeline> pipelines;
+    std::vector<ID3D11Buffer*> buffers;
+    std::vector<BufferHandle> freeBuffers;
+
+    // Pipelines with the same pixel shader share it
+    std::unordered_map<std::wstring, ID3D11PixelShader*> pixelShaders;
+
+    D3DShaderCompiler shaderCompiler;
+    ShaderCache shaderCache;
+
+    // Counted here; the rest of the frame's stats come from the render context
+    uint32_t instances = 0;
+    uint64_t triangles = 0;
+    uint64_t bufferBytes = 0;
+    RenderStats lastFrame = {};
+};
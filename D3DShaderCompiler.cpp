@@ -0,0 +1,52 @@
+// D3DShaderCompiler.cpp
+
+#include "D3DShaderCompiler.h"
+#include <windows.h>
+#include <d3dcompiler.h>
+#pragma comment(lib, "d3dcompiler.lib")
+
+namespace {
+
+    const UINT CompileFlags = 0;
+
+    std::wstring WidenString(const std::string& text) {
+        int length = MultiByteToWideChar(CP_ACP, 0, text.c_str(), -1, nullptr, 0);
+        if (length <= 1) {
+            return std::wstring();
+        }
+        std::wstring result(static_cast<size_t>(length - 1), L'\0');
+        MultiByteToWideChar(CP_ACP, 0, text.c_str(), -1, &result[0], length);
+        return result;
+    }
+
+}
+
+uint64_t D3DShaderCompiler::GetVersion() const {
+    return (static_cast<uint64_t>(D3D_COMPILER_VERSION) << 32) | CompileFlags;
+}
+
+bool D3DShaderCompiler::Compile(const ShaderDesc& desc, std::vector<char>& bytecode, std::string& errors) {
+    // Null-terminated, as D3DCompile expects
+    std::vector<D3D_SHADER_MACRO> macros;
+    for (const ShaderDefine& define : desc.defines) {
+        macros.push_back(D3D_SHADER_MACRO{ define.name.c_str(), define.value.c_str() });
+    }
+    macros.push_back(D3D_SHADER_MACRO{ nullptr, nullptr });
+
+    ID3DBlob* shaderBlob = nullptr;
+    ID3DBlob* errorBlob = nullptr;
+    HRESULT hr = D3DCompileFromFile(WidenString(desc.sourceFile).c_str(), macros.data(), D3D_COMPILE_STANDARD_FILE_INCLUDE,
+        desc.entryPoint.c_str(), desc.target.c_str(), CompileFlags, 0, &shaderBlob, &errorBlob);
+    if (errorBlob) {
+        errors.assign(static_cast<const char*>(errorBlob->GetBufferPointer()), errorBlob->GetBufferSize());
+        errorBlob->Release();
+    }
+    if (FAILED(hr)) {
+        return false;
+    }
+
+    const char* data = static_cast<const char*>(shaderBlob->GetBufferPointer());
+    bytecode.assign(data, data + shaderBlob->GetBufferSize());
+    shaderBlob->Release();
+    return true;
+}
@@ -0,0 +1,12 @@
+// D3DShaderCompiler.h
+
+#pragma once
+#include "ShaderCache.h"
+
+// Compiles HLSL with D3DCompileFromFile. Includes resolve relative to the
+// including file.
+class D3DShaderCompiler : public ShaderCompiler {
+public:
+    uint64_t GetVersion() const override;
+    bool Compile(const ShaderDesc& desc, std::vector<char>& bytecode, std::string& errors) override;
+};
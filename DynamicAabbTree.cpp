@@ -0,0 +1,391 @@
+// DynamicAabbTree.cpp
+
+#include "DynamicAabbTree.h"
+
+#include <algorithm>
+#include <cassert>
+
+bool Aabb::Contains(const Aabb& other) const {
+    for (int axis = 0; axis < 3; ++axis) {
+        if (other.min[axis] < min[axis] || other.max[axis] > max[axis]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Aabb::Overlaps(const Aabb& other) const {
+    for (int axis = 0; axis < 3; ++axis) {
+        if (other.min[axis] > max[axis] || other.max[axis] < min[axis]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+float Aabb::SurfaceArea() const {
+    float x = max[0] - min[0];
+    float y = max[1] - min[1];
+    float z = max[2] - min[2];
+    return 2.0f * (x * y + y * z + z * x);
+}
+
+Aabb Aabb::Combine(const Aabb& a, const Aabb& b) {
+    Aabb result;
+    for (int axis = 0; axis < 3; ++axis) {
+        result.min[axis] = std::min(a.min[axis], b.min[axis]);
+        result.max[axis] = std::max(a.max[axis], b.max[axis]);
+    }
+    return result;
+}
+
+namespace {
+
+    // How far ahead of its motion a reinserted proxy's fat AABB reaches
+    const float DisplacementMultiplier = 4.0f;
+
+}
+
+DynamicAabbTree::DynamicAabbTree(float margin)
+    : root(NullNode), freeList(NullNode), proxyCount(0), margin(margin)
+{
+}
+
+int32_t DynamicAabbTree::AllocateNode() {
+    int32_t nodeId;
+    if (freeList != NullNode) {
+        nodeId = freeList;
+        freeList = nodes[nodeId].parent;
+    }
+    else {
+        nodeId = static_cast<int32_t>(nodes.size());
+        nodes.push_back(Node());
+    }
+
+    Node& node = nodes[nodeId];
+    node.userData = nullptr;
+    node.parent = NullNode;
+    node.child1 = NullNode;
+    node.child2 = NullNode;
+    node.height = 0;
+    return nodeId;
+}
+
+void DynamicAabbTree::FreeNode(int32_t nodeId) {
+    Node& node = nodes[nodeId];
+    node.parent = freeList;
+    node.height = -1;
+    freeList = nodeId;
+}
+
+int32_t DynamicAabbTree::CreateProxy(const Aabb& aabb, void* userData) {
+    int32_t proxyId = AllocateNode();
+    Node& node = nodes[proxyId];
+    for (int axis = 0; axis < 3; ++axis) {
+        node.aabb.min[axis] = aabb.min[axis] - margin;
+        node.aabb.max[axis] = aabb.max[axis] + margin;
+    }
+    node.userData = userData;
+
+    InsertLeaf(proxyId);
+    ++proxyCount;
+    return proxyId;
+}
+
+void DynamicAabbTree::DestroyProxy(int32_t proxyId) {
+    assert(nodes[proxyId].IsLeaf());
+    RemoveLeaf(proxyId);
+    FreeNode(proxyId);
+    --proxyCount;
+}
+
+bool DynamicAabbTree::MoveProxy(int32_t proxyId, const Aabb& aabb, const float displacement[3]) {
+    Node& node = nodes[proxyId];
+    if (node.aabb.Contains(aabb)) {
+        return false;
+    }
+
+    RemoveLeaf(proxyId);
+
+    // Extend the fat AABB along the motion so the next few moves fit as well
+    Aabb fat;
+    for (int axis = 0; axis < 3; ++axis) {
+        fat.min[axis] = aabb.min[axis] - margin;
+        fat.max[axis] = aabb.max[axis] + margin;
+
+        float reach = DisplacementMultiplier * displacement[axis];
+        if (reach < 0.0f) {
+            fat.min[axis] += reach;
+        }
+        else {
+            fat.max[axis] += reach;
+        }
+    }
+    nodes[proxyId].aabb = fat;
+
+    InsertLeaf(proxyId);
+    return true;
+}
+
+void DynamicAabbTree::InsertLeaf(int32_t leaf) {
+    if (root == NullNode) {
+        root = leaf;
+        nodes[root].parent = NullNode;
+        return;
+    }
+
+    // Descend towards the sibling that adds the least surface area. Going down
+    // a child costs its growth plus the growth already paid by its ancestors.
+    const Aabb leafAabb = nodes[leaf].aabb;
+    int32_t index = root;
+    while (!nodes[index].IsLeaf()) {
+        const Node& node = nodes[index];
+        float area = node.aabb.SurfaceArea();
+        float combinedArea = Aabb::Combine(node.aabb, leafAabb).SurfaceArea();
+
+        // Cost of making a new parent for this node and the leaf
+        float cost = 2.0f * combinedArea;
+
+        // Minimum cost of pushing the leaf further down
+        float inheritanceCost = 2.0f * (combinedArea - area);
+
+        float childCosts[2];
+        const int32_t children[2] = { node.child1, node.child2 };
+        for (int i = 0; i < 2; ++i) {
+            const Node& child = nodes[children[i]];
+            float childCombined = Aabb::Combine(leafAabb, child.aabb).SurfaceArea();
+            if (child.IsLeaf()) {
+                childCosts[i] = childCombined + inheritanceCost;
+            }
+            else {
+                childCosts[i] = (childCombined - child.aabb.SurfaceArea()) + inheritanceCost;
+            }
+        }
+
+        if (cost < childCosts[0] && cost < childCosts[1]) {
+            break;
+        }
+        index = (childCosts[0] < childCosts[1]) ? children[0] : children[1];
+    }
+    int32_t sibling = index;
+
+    // New parent for the sibling and the leaf
+    int32_t oldParent = nodes[sibling].parent;
+    int32_t newParent = AllocateNode();
+    nodes[newParent].parent = oldParent;
+    nodes[newParent].aabb = Aabb::Combine(leafAabb, nodes[sibling].aabb);
+    nodes[newParent].height = nodes[sibling].height + 1;
+    nodes[newParent].child1 = sibling;
+    nodes[newParent].child2 = leaf;
+    nodes[sibling].parent = newParent;
+    nodes[leaf].parent = newParent;
+
+    if (oldParent != NullNode) {
+        if (nodes[oldParent].child1 == sibling) {
+            nodes[oldParent].child1 = newParent;
+        }
+        else {
+            nodes[oldParent].child2 = newParent;
+        }
+    }
+    else {
+        root = newParent;
+    }
+
+    // Refit and rebalance the ancestors
+    index = nodes[leaf].parent;
+    while (index != NullNode) {
+        index = Balance(index);
+
+        Node& node = nodes[index];
+        node.height = 1 + std::max(nodes[node.child1].height, nodes[node.child2].height);
+        node.aabb = Aabb::Combine(nodes[node.child1].aabb, nodes[node.child2].aabb);
+        index = node.parent;
+    }
+}
+
+void DynamicAabbTree::RemoveLeaf(int32_t leaf) {
+    if (leaf == root) {
+        root = NullNode;
+        return;
+    }
+
+    // The sibling takes the parent's place
+    int32_t parent = nodes[leaf].parent;
+    int32_t grandParent = nodes[parent].parent;
+    int32_t sibling = (nodes[parent].child1 == leaf) ? nodes[parent].child2 : nodes[parent].child1;
+
+    if (grandParent != NullNode) {
+        if (nodes[grandParent].child1 == parent) {
+            nodes[grandParent].child1 = sibling;
+        }
+        else {
+            nodes[grandParent].child2 = sibling;
+        }
+        nodes[sibling].parent = grandParent;
+        FreeNode(parent);
+
+        int32_t index = grandParent;
+        while (index != NullNode) {
+            index = Balance(index);
+
+            Node& node = nodes[index];
+            node.aabb = Aabb::Combine(nodes[node.child1].aabb, nodes[node.child2].aabb);
+            node.height = 1 + std::max(nodes[node.child1].height, nodes[node.child2].height);
+            index = node.parent;
+        }
+    }
+    else {
+        root = sibling;
+        nodes[sibling].parent = NullNode;
+        FreeNode(parent);
+    }
+}
+
+// Rotates the taller grandchild up when a node's children differ in height by
+// more than one. Returns the node now at this position.
+int32_t DynamicAabbTree::Balance(int32_t iA) {
+    Node& A = nodes[iA];
+    if (A.IsLeaf() || A.height < 2) {
+        return iA;
+    }
+
+    int32_t iB = A.child1;
+    int32_t iC = A.child2;
+    Node& B = nodes[iB];
+    Node& C = nodes[iC];
+    int32_t balance = C.height - B.height;
+
+    // Rotate C up
+    if (balance > 1) {
+        int32_t iF = C.child1;
+        int32_t iG = C.child2;
+        Node& F = nodes[iF];
+        Node& G = nodes[iG];
+
+        C.child1 = iA;
+        C.parent = A.parent;
+        A.parent = iC;
+
+        if (C.parent != NullNode) {
+            if (nodes[C.parent].child1 == iA) {
+                nodes[C.parent].child1 = iC;
+            }
+            else {
+                nodes[C.parent].child2 = iC;
+            }
+        }
+        else {
+            root = iC;
+        }
+
+        // The taller of F and G stays under C, the other moves under A
+        if (F.height > G.height) {
+            C.child2 = iF;
+            A.child2 = iG;
+            G.parent = iA;
+            A.aabb = Aabb::Combine(B.aabb, G.aabb);
+            C.aabb = Aabb::Combine(A.aabb, F.aabb);
+            A.height = 1 + std::max(B.height, G.height);
+            C.height = 1 + std::max(A.height, F.height);
+        }
+        else {
+            C.child2 = iG;
+            A.child2 = iF;
+            F.parent = iA;
+            A.aabb = Aabb::Combine(B.aabb, F.aabb);
+            C.aabb = Aabb::Combine(A.aabb, G.aabb);
+            A.height = 1 + std::max(B.height, F.height);
+            C.height = 1 + std::max(A.height, G.height);
+        }
+        return iC;
+    }
+
+    // Rotate B up
+    if (balance < -1) {
+        int32_t iD = B.child1;
+        int32_t iE = B.child2;
+        Node& D = nodes[iD];
+        Node& E = nodes[iE];
+
+        B.child1 = iA;
+        B.parent = A.parent;
+        A.parent = iB;
+
+        if (B.parent != NullNode) {
+            if (nodes[B.parent].child1 == iA) {
+                nodes[B.parent].child1 = iB;
+            }
+            else {
+                nodes[B.parent].child2 = iB;
+            }
+        }
+        else {
+            root = iB;
+        }
+
+        if (D.height > E.height) {
+            B.child2 = iD;
+            A.child1 = iE;
+            E.parent = iA;
+            A.aabb = Aabb::Combine(C.aabb, E.aabb);
+            B.aabb = Aabb::Combine(A.aabb, D.aabb);
+            A.height = 1 + std::max(C.height, E.height);
+            B.height = 1 + std::max(A.height, D.height);
+        }
+        else {
+            B.child2 = iE;
+            A.child1 = iD;
+            D.parent = iA;
+            A.aabb = Aabb::Combine(C.aabb, D.aabb);
+            B.aabb = Aabb::Combine(A.aabb, E.aabb);
+            A.height = 1 + std::max(C.height, D.height);
+            B.height = 1 + std::max(A.height, E.height);
+        }
+        return iB;
+    }
+
+    return iA;
+}
+
+float DynamicAabbTree::GetAreaRatio() const {
+    if (root == NullNode) {
+        return 0.0f;
+    }
+
+    float rootArea = nodes[root].aabb.SurfaceArea();
+    float totalArea = 0.0f;
+    for (const Node& node : nodes) {
+        if (node.height > 0) {
+            totalArea += node.aabb.SurfaceArea();
+        }
+    }
+    return rootArea > 0.0f ? totalArea / rootArea : 0.0f;
+}
+
+bool DynamicAabbTree::Validate() const {
+    if (root == NullNode) {
+        return proxyCount == 0;
+    }
+    return nodes[root].parent == NullNode && ValidateNode(root, NullNode);
+}
+
+bool DynamicAabbTree::ValidateNode(int32_t nodeId, int32_t parent) const {
+    const Node& node = nodes[nodeId];
+    if (node.parent != parent) {
+        return false;
+    }
+    if (node.IsLeaf()) {
+        return node.child2 == NullNode && node.height == 0;
+    }
+
+    const Node& child1 = nodes[node.child1];
+    const Node& child2 = nodes[node.child2];
+    if (node.height != 1 + std::max(child1.height, child2.height)) {
+        return false;
+    }
+    if (!node.aabb.Contains(child1.aabb) || !node.aabb.Contains(child2.aabb)) {
+        return false;
+    }
+    return ValidateNode(node.child1, nodeId) && ValidateNode(node.child2, nodeId);
+}
@@ -0,0 +1,230 @@
+// DynamicAabbTree.h
+
+#pragma once
+#include "FrustumCulling.h"
+#include <cstdint>
+#include <vector>
+
+struct Aabb {
+    float min[3];
+    float max[3];
+
+    bool Contains(const Aabb& other) const;
+    bool Overlaps(const Aabb& other) const;
+    float SurfaceArea() const;
+    static Aabb Combine(const Aabb& a, const Aabb& b);
+};
+
+// Incrementally updated bounding volume hierarchy for moving objects. Leaves
+// store a fattened AABB, so small moves only need a containment check; larger
+// ones reinsert the leaf next to the sibling with the cheapest surface area
+// cost, and tree rotations on the way back up keep it balanced. The same tree
+// answers frustum, overlap and ray queries. Proxy ids stay valid until the
+// proxy is destroyed.
+class DynamicAabbTree {
+public:
+    static const int32_t NullNode = -1;
+
+    explicit DynamicAabbTree(float margin = 0.1f);
+
+    int32_t CreateProxy(const Aabb& aabb, void* userData);
+    void DestroyProxy(int32_t proxyId);
+
+    // Refits a proxy that has moved by displacement. Returns true when the leaf
+    // had to be reinserted; the new fat AABB is stretched along the motion.
+    bool MoveProxy(int32_t proxyId, const Aabb& aabb, const float displacement[3]);
+
+    void* GetUserData(int32_t proxyId) const { return nodes[proxyId].userData; }
+    const Aabb& GetFatAabb(int32_t proxyId) const { return nodes[proxyId].aabb; }
+
+    // Callbacks take the proxy id and return false to stop the query
+    template <typename Callback>
+    void QueryOverlap(const Aabb& aabb, Callback&& callback) const;
+
+    // Visits every proxy whose fat AABB may be inside the frustum
+    template <typename Callback>
+    void QueryFrustum(const Frustum& frustum, Callback&& callback) const;
+
+    // Visits proxies whose fat AABB the ray hits before maxDistance, nearest
+    // node first where it can. The callback gets the proxy id and returns the
+    // distance to clip the ray to: its own hit distance, the current limit to
+    // keep going, or 0 to stop.
+    template <typename Callback>
+    void RayCast(const float origin[3], const float direction[3], float maxDistance, Callback&& callback) const;
+
+    int32_t GetProxyCount() const { return proxyCount; }
+    int32_t GetHeight() const { return root == NullNode ? 0 : nodes[root].height; }
+
+    // Total surface area of the internal nodes over the root's, lower is better
+    float GetAreaRatio() const;
+
+    // Checks parent links, heights and bounds of the whole tree. Rotations keep
+    // the tree close to balanced but do not guarantee the AVL invariant.
+    bool Validate() const;
+
+private:
+    struct Node {
+        Aabb aabb;
+        void* userData;
+        int32_t parent;     // Next free node while on the free list
+        int32_t child1;
+        int32_t child2;
+        int32_t height;     // Leaves are 0, free nodes -1
+
+        bool IsLeaf() const { return child1 == NullNode; }
+    };
+
+    int32_t AllocateNode();
+    void FreeNode(int32_t nodeId);
+    void InsertLeaf(int32_t leaf);
+    void RemoveLeaf(int32_t leaf);
+    int32_t Balance(int32_t nodeId);
+    bool ValidateNode(int32_t nodeId, int32_t parent) const;
+
+    std::vector<Node> nodes;
+    int32_t root;
+    int32_t freeList;
+    int32_t proxyCount;
+    float margin;
+
+    // Reused by queries so they do not allocate; queries are not reentrant
+    mutable std::vector<int32_t> stack;
+};
+
+template <typename Callback>
+void DynamicAabbTree::QueryOverlap(const Aabb& aabb, Callback&& callback) const {
+    if (root == NullNode) {
+        return;
+    }
+
+    stack.clear();
+    stack.push_back(root);
+    while (!stack.empty()) {
+        int32_t nodeId = stack.back();
+        stack.pop_back();
+
+        const Node& node = nodes[nodeId];
+        if (!node.aabb.Overlaps(aabb)) {
+            continue;
+        }
+
+        if (node.IsLeaf()) {
+            if (!callback(nodeId)) {
+                return;
+            }
+        }
+        else {
+            stack.push_back(node.child1);
+            stack.push_back(node.child2);
+        }
+    }
+}
+
+template <typename Callback>
+void DynamicAabbTree::QueryFrustum(const Frustum& frustum, Callback&& callback) const {
+    if (root == NullNode) {
+        return;
+    }
+
+    // Subtrees fully inside skip the plane tests; the sign bit marks them
+    stack.clear();
+    stack.push_back(root);
+    while (!stack.empty()) {
+        int32_t entry = stack.back();
+        stack.pop_back();
+
+        bool inside = entry < 0;
+        int32_t nodeId = inside ? ~entry : entry;
+        const Node& node = nodes[nodeId];
+
+        if (!inside) {
+            FrustumTest test = FrustumCulling::TestAabb(frustum, node.aabb.min, node.aabb.max);
+            if (test == FrustumTest::Outside) {
+                continue;
+            }
+            inside = test == FrustumTest::Inside;
+        }
+
+        if (node.IsLeaf()) {
+            if (!callback(nodeId)) {
+                return;
+            }
+        }
+        else {
+            stack.push_back(inside ? ~node.child1 : node.child1);
+            stack.push_back(inside ? ~node.child2 : node.child2);
+        }
+    }
+}
+
+template <typename Callback>
+void DynamicAabbTree::RayCast(const float origin[3], const float direction[3], float maxDistance, Callback&& callback) const {
+    if (root == NullNode) {
+        return;
+    }
+
+    float inverse[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        inverse[axis] = 1.0f / direction[axis];
+    }
+
+    // Slab test; infinities from zero direction components work out
+    auto entryDistance = [&](const Aabb& box, float limit) {
+        float enter = 0.0f;
+        float exit = limit;
+        for (int axis = 0; axis < 3; ++axis) {
+            float t1 = (box.min[axis] - origin[axis]) * inverse[axis];
+            float t2 = (box.max[axis] - origin[axis]) * inverse[axis];
+            if (t1 > t2) {
+                float t = t1; t1 = t2; t2 = t;
+            }
+            enter = t1 > enter ? t1 : enter;
+            exit = t2 < exit ? t2 : exit;
+            if (enter > exit) {
+                return -1.0f;
+            }
+        }
+        return enter;
+    };
+
+    stack.clear();
+    stack.push_back(root);
+    while (!stack.empty()) {
+        int32_t nodeId = stack.back();
+        stack.pop_back();
+
+        const Node& node = nodes[nodeId];
+        if (entryDistance(node.aabb, maxDistance) < 0.0f) {
+            continue;
+        }
+
+        if (node.IsLeaf()) {
+            float distance = callback(nodeId);
+            if (distance <= 0.0f) {
+                return;
+            }
+            maxDistance = distance < maxDistance ? distance : maxDistance;
+            continue;
+        }
+
+        // Push the nearer child last so it is visited first
+        float distance1 = entryDistance(nodes[node.child1].aabb, maxDistance);
+        float distance2 = entryDistance(nodes[node.child2].aabb, maxDistance);
+        if (distance1 >= 0.0f && distance2 >= 0.0f) {
+            if (distance1 <= distance2) {
+                stack.push_back(node.child2);
+                stack.push_back(node.child1);
+            }
+            else {
+                stack.push_back(node.child1);
+                stack.push_back(node.child2);
+            }
+        }
+        else if (distance1 >= 0.0f) {
+            stack.push_back(node.child1);
+        }
+        else if (distance2 >= 0.0f) {
+            stack.push_back(node.child2);
+        }
+    }
+}
@@ -0,0 +1,284 @@
+// EntityWorld.cpp
+
+#include "EntityWorld.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <mutex>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace {
+
+    struct ComponentInfo {
+        uint32_t size;
+        uint32_t alignment;
+    };
+
+    // Component ids are handed out from any thread that first uses a type
+    std::mutex componentMutex;
+    std::vector<ComponentInfo> componentInfos;
+
+    // Chunks are aligned to their size, so no chunk straddles a page
+    unsigned char* AllocateChunk() {
+#ifdef _WIN32
+        return static_cast<unsigned char*>(_aligned_malloc(EntityWorld::ChunkSize, EntityWorld::ChunkSize));
+#else
+        void* data = nullptr;
+        if (posix_memalign(&data, EntityWorld::ChunkSize, EntityWorld::ChunkSize) != 0) {
+            return nullptr;
+        }
+        return static_cast<unsigned char*>(data);
+#endif
+    }
+
+    void FreeChunk(unsigned char* data) {
+#ifdef _WIN32
+        _aligned_free(data);
+#else
+        free(data);
+#endif
+    }
+
+}
+
+EntityWorld::EntityWorld() {
+    // Entities without components live in the empty archetype
+    GetArchetype(0);
+}
+
+EntityWorld::~EntityWorld() {
+    for (const auto& archetype : archetypes) {
+        for (const Chunk& chunk : archetype->chunks) {
+            FreeChunk(chunk.data);
+        }
+    }
+}
+
+ComponentId EntityWorld::RegisterComponent(uint32_t size, uint32_t alignment) {
+    std::lock_guard<std::mutex> lock(componentMutex);
+    assert(componentInfos.size() < MaxComponentTypes);
+    componentInfos.push_back(ComponentInfo{ size, alignment });
+    return static_cast<ComponentId>(componentInfos.size() - 1);
+}
+
+uint32_t EntityWorld::GetComponentSize(ComponentId id) {
+    std::lock_guard<std::mutex> lock(componentMutex);
+    return componentInfos[id].size;
+}
+
+uint32_t EntityWorld::GetComponentAlignment(ComponentId id) {
+    std::lock_guard<std::mutex> lock(componentMutex);
+    return componentInfos[id].alignment;
+}
+
+Entity EntityWorld::Create() {
+    return Allocate(archetypes[0].get());
+}
+
+void EntityWorld::Destroy(Entity entity) {
+    if (!FindRecord(entity)) {
+        return;
+    }
+
+    uint32_t index = GetIndex(entity);
+    EntityRecord& record = records[index];
+    RemoveRow(record.archetype, record.chunk, record.row);
+
+    record.archetype = nullptr;
+    record.generation = GenerationalHandle::NextGeneration(record.generation);
+    freeIndices.push_back(index);
+}
+
+bool EntityWorld::IsAlive(Entity entity) const {
+    return FindRecord(entity) != nullptr;
+}
+
+Entity EntityWorld::GetEntity(uint32_t index) const {
+    if (index >= records.size() || !records[index].archetype) {
+        return InvalidEntity;
+    }
+    return GenerationalHandle::Make(index, records[index].generation);
+}
+
+size_t EntityWorld::GetChunkCount() const {
+    size_t count = 0;
+    for (const auto& archetype : archetypes) {
+        count += archetype->chunks.size();
+    }
+    return count;
+}
+
+EntityWorld::Archetype* EntityWorld::GetArchetype(ComponentMask mask) {
+    auto it = archetypeLookup.find(mask);
+    if (it != archetypeLookup.end()) {
+        return it->second;
+    }
+
+    std::unique_ptr<Archetype> archetype(new Archetype());
+    archetype->mask = mask;
+    std::fill(std::begin(archetype->addEdges), std::end(archetype->addEdges), nullptr);
+    std::fill(std::begin(archetype->removeEdges), std::end(archetype->removeEdges), nullptr);
+
+    uint32_t rowSize = sizeof(Entity);
+    for (ComponentId id = 0; id < MaxComponentTypes; ++id) {
+        if (mask & (ComponentMask(1) << id)) {
+            archetype->components.push_back(id);
+            archetype->sizes[id] = GetComponentSize(id);
+            rowSize += archetype->sizes[id];
+        }
+    }
+
+    // As many rows as fit once each array is padded to its alignment
+    archetype->capacity = 0;
+    for (uint32_t capacity = ChunkSize / rowSize; capacity > 0; --capacity) {
+        uint32_t offset = sizeof(Entity) * capacity;
+        for (ComponentId id : archetype->components) {
+            uint32_t alignment = GetComponentAlignment(id);
+            offset = (offset + alignment - 1) / alignment * alignment;
+            archetype->offsets[id] = offset;
+            offset += archetype->sizes[id] * capacity;
+        }
+        if (offset <= ChunkSize) {
+            archetype->capacity = capacity;
+            break;
+        }
+    }
+
+    // Without a single row per chunk the archetype stays empty; AllocateRow refuses it
+    if (archetype->capacity == 0) {
+        LogMessage("Entity archetype with a %u byte row does not fit in a %u byte chunk\n", rowSize, ChunkSize);
+        assert(!"Entity archetype row larger than a chunk");
+    }
+
+    Archetype* result = archetype.get();
+    archetypes.push_back(std::move(archetype));
+    archetypeLookup[mask] = result;
+    return result;
+}
+
+EntityWorld::Archetype* EntityWorld::GetAddTarget(Archetype* archetype, ComponentId id) {
+    if (!archetype->addEdges[id]) {
+        archetype->addEdges[id] = GetArchetype(archetype->mask | (ComponentMask(1) << id));
+        archetype->addEdges[id]->removeEdges[id] = archetype;
+    }
+    return archetype->addEdges[id];
+}
+
+EntityWorld::Archetype* EntityWorld::GetRemoveTarget(Archetype* archetype, ComponentId id) {
+    if (!archetype->removeEdges[id]) {
+        archetype->removeEdges[id] = GetArchetype(archetype->mask & ~(ComponentMask(1) << id));
+        archetype->removeEdges[id]->addEdges[id] = archetype;
+    }
+    return archetype->removeEdges[id];
+}
+
+bool EntityWorld::AllocateRow(Archetype* archetype, uint32_t& chunk, uint32_t& row) {
+    if (archetype->capacity == 0) {
+        return false;
+    }
+    if (archetype->chunks.empty() || archetype->chunks.back().count == archetype->capacity) {
+        Chunk newChunk = { AllocateChunk(), 0 };
+        if (!newChunk.data) {
+            return false;
+        }
+        archetype->chunks.push_back(newChunk);
+    }
+
+    chunk = static_cast<uint32_t>(archetype->chunks.size() - 1);
+    row = archetype->chunks.back().count++;
+    return true;
+}
+
+Entity EntityWorld::Allocate(Archetype* archetype) {
+    uint32_t chunk, row;
+    if (!AllocateRow(archetype, chunk, row)) {
+        return InvalidEntity;
+    }
+
+    uint32_t index;
+    if (!freeIndices.empty()) {
+        index = freeIndices.back();
+        freeIndices.pop_back();
+    }
+    else {
+        index = static_cast<uint32_t>(records.size());
+        records.push_back(EntityRecord{ nullptr, 0, 0, GenerationalHandle::FirstGeneration });
+    }
+
+    EntityRecord& record = records[index];
+    record.archetype = archetype;
+    record.chunk = chunk;
+    record.row = row;
+
+    Entity entity = GenerationalHandle::Make(index, record.generation);
+    reinterpret_cast<Entity*>(archetype->chunks[chunk].data)[row] = entity;
+    return entity;
+}
+
+void EntityWorld::RemoveRow(Archetype* archetype, uint32_t chunk, uint32_t row) {
+    Chunk& last = archetype->chunks.back();
+    uint32_t lastChunk = static_cast<uint32_t>(archetype->chunks.size() - 1);
+    uint32_t lastRow = last.count - 1;
+
+    if (chunk != lastChunk || row != lastRow) {
+        Entity moved = reinterpret_cast<Entity*>(last.data)[lastRow];
+        reinterpret_cast<Entity*>(archetype->chunks[chunk].data)[row] = moved;
+        for (ComponentId id : archetype->components) {
+            std::memcpy(GetComponentData(archetype, chunk, row, id), GetComponentData(archetype, lastChunk, lastRow, id),
+                archetype->sizes[id]);
+        }
+
+        EntityRecord& record = records[GetIndex(moved)];
+        record.chunk = chunk;
+        record.row = row;
+    }
+
+    // Chunks are freed as soon as they empty
+    if (--last.count == 0) {
+        FreeChunk(last.data);
+        archetype->chunks.pop_back();
+    }
+}
+
+bool EntityWorld::Migrate(uint32_t index, Archetype* target) {
+    EntityRecord old = records[index];
+    uint32_t chunk, row;
+    if (!AllocateRow(target, chunk, row)) {
+        return false;
+    }
+
+    // Components the target does not share with the old archetype are left for the caller to write
+    reinterpret_cast<Entity*>(target->chunks[chunk].data)[row] = GenerationalHandle::Make(index, old.generation);
+    for (ComponentId id : target->components) {
+        if (old.archetype->mask & (ComponentMask(1) << id)) {
+            std::memcpy(GetComponentData(target, chunk, row, id), GetComponentData(old.archetype, old.chunk, old.row, id),
+                target->sizes[id]);
+        }
+    }
+
+    RemoveRow(old.archetype, old.chunk, old.row);
+
+    EntityRecord& record = records[index];
+    record.archetype = target;
+    record.chunk = chunk;
+    record.row = row;
+    return true;
+}
+
+const EntityWorld::EntityRecord* EntityWorld::FindRecord(Entity entity) const {
+    uint32_t index = GetIndex(entity);
+    if (index >= records.size()) {
+        return nullptr;
+    }
+
+    const EntityRecord& record = records[index];
+    if (!record.archetype || record.generation != GenerationalHandle::GetGeneration(entity)) {
+        return nullptr;
+    }
+    return &record;
+}
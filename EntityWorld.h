@@ -0,0 +1,270 @@
+// EntityWorld.h
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+#include "GenerationalHandle.h"
+#include "JobSystem.h"
+
+// A GenerationalHandle; 0 is never alive
+typedef uint64_t Entity;
+const Entity InvalidEntity = 0;
+
+typedef uint32_t ComponentId;
+typedef uint64_t ComponentMask;
+
+// Archetype-based entity storage. Entities with the same set of component
+// types share an archetype, which keeps them in 16 KB chunks aligned to their
+// size: an array of entity handles followed by one array per component type.
+// Every chunk but an archetype's last is full, so queries walk tightly packed
+// arrays. Adding or removing a component moves the entity to the archetype for
+// the new set.
+//
+// Components are plain data: they are copied with memcpy when entities move
+// and never constructed or destroyed. Component pointers and chunk arrays are
+// only valid until the next create, destroy, add or remove, none of which may
+// happen during a query.
+class EntityWorld {
+public:
+    static const uint32_t ChunkSize = 16 * 1024;
+    static const uint32_t MaxComponentTypes = 64;
+
+    EntityWorld();
+    ~EntityWorld();
+
+    EntityWorld(const EntityWorld&) = delete;
+    EntityWorld& operator=(const EntityWorld&) = delete;
+
+    // Numbered on first use, shared by every world
+    template <typename Component>
+    static ComponentId GetComponentId();
+
+    Entity Create();
+
+    // Creates the entity directly in the archetype for these components
+    template <typename... Components>
+    Entity Create(const Components&... components);
+
+    void Destroy(Entity entity);
+    bool IsAlive(Entity entity) const;
+
+    // The live entity in a slot, for code that can only store the slot index
+    static uint32_t GetIndex(Entity entity) { return GenerationalHandle::GetIndex(entity); }
+    Entity GetEntity(uint32_t index) const;
+
+    // Adds the component, or overwrites it if the entity already has one.
+    // Returns null for a dead entity, or when a row of the resulting
+    // components would not fit in a chunk.
+    template <typename Component>
+    Component* Add(Entity entity, const Component& component = Component());
+
+    template <typename Component>
+    void Remove(Entity entity);
+
+    // Null when the entity is dead or lacks the component
+    template <typename Component>
+    Component* Get(Entity entity);
+    template <typename Component>
+    const Component* Get(Entity entity) const;
+
+    // Calls function(const Entity* entities, uint32_t count, Components*... arrays)
+    // for every non-empty chunk whose archetype has all of the components
+    template <typename... Components, typename Function>
+    void ForEachChunk(const Function& function);
+
+    // Calls function(Entity, Components&...) for every matching entity
+    template <typename... Components, typename Function>
+    void ForEach(const Function& function);
+
+    // ForEachChunk with the chunks spread over the job system's threads
+    template <typename... Components, typename Function>
+    void ParallelForEachChunk(JobSystem& jobs, const Function& function);
+
+    size_t GetEntityCount() const { return records.size() - freeIndices.size(); }
+    size_t GetArchetypeCount() const { return archetypes.size(); }
+    size_t GetChunkCount() const;
+
+private:
+    struct Chunk {
+        unsigned char* data;
+        uint32_t count;
+    };
+
+    struct Archetype {
+        ComponentMask mask;
+        std::vector<ComponentId> components;
+        uint32_t sizes[MaxComponentTypes];      // Per component id, for those in the mask
+        uint32_t offsets[MaxComponentTypes];    // Array offsets within a chunk
+        uint32_t capacity;                      // Entities per chunk
+        std::vector<Chunk> chunks;
+
+        // Archetypes one component away, filled in as they are first needed
+        Archetype* addEdges[MaxComponentTypes];
+        Archetype* removeEdges[MaxComponentTypes];
+    };
+
+    struct EntityRecord {
+        Archetype* archetype;   // Null while the slot is free
+        uint32_t chunk;
+        uint32_t row;
+        uint32_t generation;
+    };
+
+    static ComponentId RegisterComponent(uint32_t size, uint32_t alignment);
+    static uint32_t GetComponentSize(ComponentId id);
+    static uint32_t GetComponentAlignment(ComponentId id);
+
+    template <typename... Components>
+    static ComponentMask MaskOf();
+
+    Archetype* GetArchetype(ComponentMask mask);
+    Archetype* GetAddTarget(Archetype* archetype, ComponentId id);
+    Archetype* GetRemoveTarget(Archetype* archetype, ComponentId id);
+
+    // Takes a row at the end of the archetype's last chunk, adding a chunk when it is full
+    bool AllocateRow(Archetype* archetype, uint32_t& chunk, uint32_t& row);
+
+    // Creates an entity in a new row, its components unset
+    Entity Allocate(Archetype* archetype);
+
+    // Fills the hole with the archetype's last entity
+    void RemoveRow(Archetype* archetype, uint32_t chunk, uint32_t row);
+
+    // Moves the entity to another archetype, keeping the components both share.
+    // False, leaving the entity where it was, when no row can be allocated.
+    bool Migrate(uint32_t index, Archetype* target);
+
+    const EntityRecord* FindRecord(Entity entity) const;
+    static unsigned char* GetComponentData(const Archetype* archetype, uint32_t chunk, uint32_t row, ComponentId id) {
+        return archetype->chunks[chunk].data + archetype->offsets[id] + row * archetype->sizes[id];
+    }
+
+    std::vector<EntityRecord> records;
+    std::vector<uint32_t> freeIndices;
+    std::vector<std::unique_ptr<Archetype>> archetypes;
+    std::unordered_map<ComponentMask, Archetype*> archetypeLookup;
+};
+
+template <typename Component>
+ComponentId EntityWorld::GetComponentId() {
+    static_assert(std::is_trivially_copyable<Component>::value, "Components are copied with memcpy");
+    static const ComponentId id = RegisterComponent(sizeof(Component), alignof(Component));
+    return id;
+}
+
+template <typename... Components>
+ComponentMask EntityWorld::MaskOf() {
+    ComponentMask mask = 0;
+    int expand[] = { 0, (mask |= ComponentMask(1) << GetComponentId<Components>(), 0)... };
+    (void)expand;
+    return mask;
+}
+
+template <typename... Components>
+Entity EntityWorld::Create(const Components&... components) {
+    Archetype* archetype = GetArchetype(MaskOf<Components...>());
+    Entity entity = Allocate(archetype);
+    if (entity == InvalidEntity) {
+        return InvalidEntity;
+    }
+
+    const EntityRecord& record = records[GetIndex(entity)];
+    int expand[] = { 0, (std::memcpy(GetComponentData(archetype, record.chunk, record.row, GetComponentId<Components>()),
+        &components, sizeof(Components)), 0)... };
+    (void)expand;
+    return entity;
+}
+
+template <typename Component>
+Component* EntityWorld::Add(Entity entity, const Component& component) {
+    if (!FindRecord(entity)) {
+        return nullptr;
+    }
+
+    uint32_t index = GetIndex(entity);
+    ComponentId id = GetComponentId<Component>();
+    if (!(records[index].archetype->mask & (ComponentMask(1) << id)) &&
+        !Migrate(index, GetAddTarget(records[index].archetype, id))) {
+        return nullptr;
+    }
+
+    const EntityRecord& record = records[index];
+    Component* data = reinterpret_cast<Component*>(GetComponentData(record.archetype, record.chunk, record.row, id));
+    *data = component;
+    return data;
+}
+
+template <typename Component>
+void EntityWorld::Remove(Entity entity) {
+    const EntityRecord* record = FindRecord(entity);
+    ComponentId id = GetComponentId<Component>();
+    if (record && (record->archetype->mask & (ComponentMask(1) << id))) {
+        Migrate(GetIndex(entity), GetRemoveTarget(record->archetype, id));
+    }
+}
+
+template <typename Component>
+Component* EntityWorld::Get(Entity entity) {
+    return const_cast<Component*>(static_cast<const EntityWorld*>(this)->Get<Component>(entity));
+}
+
+template <typename Component>
+const Component* EntityWorld::Get(Entity entity) const {
+    const EntityRecord* record = FindRecord(entity);
+    ComponentId id = GetComponentId<Component>();
+    if (!record || !(record->archetype->mask & (ComponentMask(1) << id))) {
+        return nullptr;
+    }
+    return reinterpret_cast<const Component*>(GetComponentData(record->archetype, record->chunk, record->row, id));
+}
+
+template <typename... Components, typename Function>
+void EntityWorld::ForEachChunk(const Function& function) {
+    const ComponentMask mask = MaskOf<Components...>();
+    for (const auto& archetype : archetypes) {
+        if ((archetype->mask & mask) != mask) {
+            continue;
+        }
+        for (const Chunk& chunk : archetype->chunks) {
+            function(reinterpret_cast<const Entity*>(chunk.data), chunk.count,
+                reinterpret_cast<Components*>(chunk.data + archetype->offsets[GetComponentId<Components>()])...);
+        }
+    }
+}
+
+template <typename... Components, typename Function>
+void EntityWorld::ForEach(const Function& function) {
+    ForEachChunk<Components...>([&function](const Entity* entities, uint32_t count, Components*... arrays) {
+        for (uint32_t i = 0; i < count; ++i) {
+            function(entities[i], arrays[i]...);
+        }
+    });
+}
+
+template <typename... Components, typename Function>
+void EntityWorld::ParallelForEachChunk(JobSystem& jobs, const Function& function) {
+    // Gather the matching chunks first so the jobs split them evenly
+    const ComponentMask mask = MaskOf<Components...>();
+    std::vector<std::pair<const Archetype*, const Chunk*>> chunks;
+    for (const auto& archetype : archetypes) {
+        if ((archetype->mask & mask) == mask) {
+            for (const Chunk& chunk : archetype->chunks) {
+                chunks.emplace_back(archetype.get(), &chunk);
+            }
+        }
+    }
+
+    jobs.ParallelFor(chunks.size(), 1, [&chunks, &function](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const Archetype* archetype = chunks[i].first;
+            const Chunk* chunk = chunks[i].second;
+            function(reinterpret_cast<const Entity*>(chunk->data), chunk->count,
+                reinterpret_cast<Components*>(chunk->data + archetype->offsets[GetComponentId<Components>()])...);
+        }
+    });
+}
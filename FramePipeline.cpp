@@ -0,0 +1,82 @@
+// FramePipeline.cpp
+
+#include "FramePipeline.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+namespace {
+
+    // Sleeps are only trusted to within this; the rest of the wait spins
+    const double SpinSeconds = 0.002;
+
+}
+
+FramePipeline::FramePipeline()
+    : FramePipeline(Settings())
+{
+}
+
+FramePipeline::FramePipeline(const Settings& settings)
+    : settings(settings), accumulator(0.0), stepCount(0)
+{
+    ResetStats();
+}
+
+void FramePipeline::Start() {
+    timer.Reset();
+    accumulator = 0.0;
+}
+
+FramePipeline::FrameTiming FramePipeline::BeginFrame() {
+    if (settings.targetFrameTime > 0.0) {
+        double remaining = settings.targetFrameTime - timer.GetElapsedSeconds();
+        if (remaining > SpinSeconds) {
+            std::this_thread::sleep_for(std::chrono::duration<double>(remaining - SpinSeconds));
+        }
+        while (timer.GetElapsedSeconds() < settings.targetFrameTime) {
+            std::this_thread::yield();
+        }
+    }
+
+    double frameSeconds = timer.GetElapsedSeconds();
+    timer.Reset();
+    return Advance(frameSeconds);
+}
+
+FramePipeline::FrameTiming FramePipeline::Advance(double frameSeconds) {
+    double milliseconds = frameSeconds * 1000.0;
+    ++stats.frames;
+    stats.minMilliseconds = (stats.frames == 1) ? milliseconds : std::min(stats.minMilliseconds, milliseconds);
+    stats.maxMilliseconds = std::max(stats.maxMilliseconds, milliseconds);
+    sumMilliseconds += milliseconds;
+    sumSquaredMilliseconds += milliseconds * milliseconds;
+    stats.averageMilliseconds = sumMilliseconds / stats.frames;
+    stats.deviationMilliseconds = std::sqrt(std::max(0.0, sumSquaredMilliseconds / stats.frames -
+        stats.averageMilliseconds * stats.averageMilliseconds));
+
+    if (frameSeconds > settings.maxFrameTime) {
+        frameSeconds = settings.maxFrameTime;
+        ++stats.clampedFrames;
+    }
+
+    FrameTiming timing = {};
+    accumulator += std::max(0.0, frameSeconds);
+    while (accumulator >= settings.fixedStep) {
+        accumulator -= settings.fixedStep;
+        ++timing.steps;
+    }
+    timing.interpolation = static_cast<float>(accumulator / settings.fixedStep);
+
+    stepCount += timing.steps;
+    stats.steps += timing.steps;
+    return timing;
+}
+
+void FramePipeline::ResetStats() {
+    stats = Stats();
+    sumMilliseconds = 0.0;
+    sumSquaredMilliseconds = 0.0;
+}
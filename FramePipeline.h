@@ -0,0 +1,73 @@
+// FramePipeline.h
+
+#pragma once
+#include <cstdint>
+#include "Timer.h"
+
+// Paces the main loop. Each frame measures the time since the previous one,
+// turns it into whole fixed simulation steps, and reports how far the frame
+// lies between the last two steps so rendering can interpolate. The
+// simulation only ever sees the fixed step, so it is deterministic no matter
+// how long frames take. With a target frame time, BeginFrame waits until the
+// frame is due.
+//
+//     FramePipeline::FrameTiming timing = pipeline.BeginFrame();
+//     for (uint32_t i = 0; i < timing.steps; ++i) Simulate(pipeline.GetFixedStep());
+//     Render(timing.interpolation);
+//     Present();
+class FramePipeline {
+public:
+    struct Settings {
+        double fixedStep = 1.0 / 60.0;
+        double maxFrameTime = 0.25;     // Longer frames are clamped so a stall does not cause a burst of steps
+        double targetFrameTime = 0.0;   // Frames are paced to this when above 0
+        uint32_t maxFrameLatency = 2;   // Frames the CPU may queue ahead of the GPU
+    };
+
+    struct FrameTiming {
+        uint32_t steps;         // Fixed steps to simulate this frame
+        float interpolation;    // 0..1 from the previous step's state to the latest
+    };
+
+    // Frame times since the last ResetStats
+    struct Stats {
+        uint32_t frames;
+        uint64_t steps;
+        uint32_t clampedFrames;
+        double averageMilliseconds;
+        double minMilliseconds;
+        double maxMilliseconds;
+        double deviationMilliseconds;   // Standard deviation
+    };
+
+    FramePipeline();
+    explicit FramePipeline(const Settings& settings);
+
+    const Settings& GetSettings() const { return settings; }
+    double GetFixedStep() const { return settings.fixedStep; }
+
+    // Total fixed steps handed out, the simulation's tick count
+    uint64_t GetStepCount() const { return stepCount; }
+
+    // Restarts the clock, so the next frame does not count the time since construction
+    void Start();
+
+    // Waits for the target frame time if there is one, then advances by the time since the last frame
+    FrameTiming BeginFrame();
+
+    // Advances by an explicit frame time instead of the clock, for tests and replays
+    FrameTiming Advance(double frameSeconds);
+
+    const Stats& GetStats() const { return stats; }
+    void ResetStats();
+
+private:
+    Settings settings;
+    Timer timer;
+    double accumulator;
+    uint64_t stepCount;
+
+    Stats stats;
+    double sumMilliseconds;
+    double sumSquaredMilliseconds;
+};
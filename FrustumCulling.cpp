@@ -0,0 +1,234 @@
+// FrustumCulling.cpp
+
+#include "FrustumCulling.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define BOG_CULLING_SSE2 1
+#include <emmintrin.h>
+#endif
+
+void BoundingVolumes::Clear() {
+    centerX.clear(); centerY.clear(); centerZ.clear(); radius.clear();
+    minX.clear(); minY.clear(); minZ.clear();
+    maxX.clear(); maxY.clear(); maxZ.clear();
+}
+
+void BoundingVolumes::Reserve(size_t count) {
+    centerX.reserve(count); centerY.reserve(count); centerZ.reserve(count); radius.reserve(count);
+    minX.reserve(count); minY.reserve(count); minZ.reserve(count);
+    maxX.reserve(count); maxY.reserve(count); maxZ.reserve(count);
+}
+
+uint32_t BoundingVolumes::Add(const float center[3], const float extents[3]) {
+    uint32_t index = static_cast<uint32_t>(Size());
+    centerX.push_back(center[0]);
+    centerY.push_back(center[1]);
+    centerZ.push_back(center[2]);
+    radius.push_back(std::sqrt(extents[0] * extents[0] + extents[1] * extents[1] + extents[2] * extents[2]));
+    minX.push_back(center[0] - extents[0]);
+    minY.push_back(center[1] - extents[1]);
+    minZ.push_back(center[2] - extents[2]);
+    maxX.push_back(center[0] + extents[0]);
+    maxY.push_back(center[1] + extents[1]);
+    maxZ.push_back(center[2] + extents[2]);
+    return index;
+}
+
+namespace {
+
+    // An AABB is outside a plane when its corner furthest along the normal is
+    // behind it. The plane is the same for every object, so which corner that
+    // is gets decided once per plane instead of per object.
+    bool IsVisible(const Frustum& frustum, const BoundingVolumes& volumes, size_t i) {
+        for (int p = 0; p < Frustum::PlaneCount; ++p) {
+            const float* plane = frustum.planes[p];
+            float x = plane[0] >= 0.0f ? volumes.maxX[i] : volumes.minX[i];
+            float y = plane[1] >= 0.0f ? volumes.maxY[i] : volumes.minY[i];
+            float z = plane[2] >= 0.0f ? volumes.maxZ[i] : volumes.minZ[i];
+            if ((plane[0] * x + plane[1] * y) + (plane[2] * z + plane[3]) < 0.0f) {
+                return false;
+            }
+        }
+
+        if (frustum.maxDistance > 0.0f) {
+            float dx = volumes.centerX[i] - frustum.eye[0];
+            float dy = volumes.centerY[i] - frustum.eye[1];
+            float dz = volumes.centerZ[i] - frustum.eye[2];
+            float reach = frustum.maxDistance + volumes.radius[i];
+            if (dx * dx + dy * dy + dz * dz > reach * reach) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void NormalizePlane(float plane[4]) {
+        float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        if (length > 0.0f) {
+            for (int i = 0; i < 4; ++i) {
+                plane[i] /= length;
+            }
+        }
+    }
+
+}
+
+void FrustumCulling::ExtractFrustum(const float viewProj[16], const float eye[3], float maxDistance, Frustum& frustum) {
+    // Clip space is v * M, so each clip coordinate is a column of M
+    float column[4][4];
+    for (int c = 0; c < 4; ++c) {
+        for (int r = 0; r < 4; ++r) {
+            column[c][r] = viewProj[r * 4 + c];
+        }
+    }
+
+    for (int i = 0; i < 4; ++i) {
+        frustum.planes[Frustum::Left][i] = column[3][i] + column[0][i];
+        frustum.planes[Frustum::Right][i] = column[3][i] - column[0][i];
+        frustum.planes[Frustum::Bottom][i] = column[3][i] + column[1][i];
+        frustum.planes[Frustum::Top][i] = column[3][i] - column[1][i];
+        frustum.planes[Frustum::Near][i] = column[2][i];
+        frustum.planes[Frustum::Far][i] = column[3][i] - column[2][i];
+    }
+    for (int p = 0; p < Frustum::PlaneCount; ++p) {
+        NormalizePlane(frustum.planes[p]);
+    }
+
+    for (int i = 0; i < 3; ++i) {
+        frustum.eye[i] = eye[i];
+    }
+    frustum.maxDistance = maxDistance;
+}
+
+FrustumTest FrustumCulling::TestAabb(const Frustum& frustum, const float boxMin[3], const float boxMax[3]) {
+    FrustumTest result = FrustumTest::Inside;
+    for (int p = 0; p < Frustum::PlaneCount; ++p) {
+        const float* plane = frustum.planes[p];
+
+        // Corners furthest along and against the plane normal
+        float outer = 0.0f;
+        float inner = 0.0f;
+        for (int axis = 0; axis < 3; ++axis) {
+            bool positive = plane[axis] >= 0.0f;
+            outer += plane[axis] * (positive ? boxMax[axis] : boxMin[axis]);
+            inner += plane[axis] * (positive ? boxMin[axis] : boxMax[axis]);
+        }
+        if (outer + plane[3] < 0.0f) {
+            return FrustumTest::Outside;
+        }
+        if (inner + plane[3] < 0.0f) {
+            result = FrustumTest::Intersecting;
+        }
+    }
+
+    if (frustum.maxDistance > 0.0f) {
+        // Nearest and furthest points of the box from the eye
+        float nearest = 0.0f;
+        float furthest = 0.0f;
+        for (int axis = 0; axis < 3; ++axis) {
+            float below = frustum.eye[axis] - boxMin[axis];
+            float above = boxMax[axis] - frustum.eye[axis];
+            float outside = std::max(0.0f, std::max(-below, -above));
+            nearest += outside * outside;
+            float span = std::max(std::fabs(below), std::fabs(above));
+            furthest += span * span;
+        }
+        float limit = frustum.maxDistance * frustum.maxDistance;
+        if (nearest > limit) {
+            return FrustumTest::Outside;
+        }
+        if (furthest > limit) {
+            result = FrustumTest::Intersecting;
+        }
+    }
+    return result;
+}
+
+size_t FrustumCulling::CullScalar(const Frustum& frustum, const BoundingVolumes& volumes, uint32_t* visible) {
+    size_t visibleCount = 0;
+    for (size_t i = 0; i < volumes.Size(); ++i) {
+        if (IsVisible(frustum, volumes, i)) {
+            visible[visibleCount++] = static_cast<uint32_t>(i);
+        }
+    }
+    return visibleCount;
+}
+
+size_t FrustumCulling::Cull(const Frustum& frustum, const BoundingVolumes& volumes, uint32_t* visible) {
+    return Cull(frustum, volumes, 0, volumes.Size(), visible);
+}
+
+size_t FrustumCulling::Cull(const Frustum& frustum, const BoundingVolumes& volumes, size_t begin, size_t end, uint32_t* visible) {
+    const size_t count = end;
+    size_t visibleCount = 0;
+    size_t i = begin;
+
+#ifdef BOG_CULLING_SSE2
+    // Pick the box corner arrays for each plane up front
+    const float* cornerX[Frustum::PlaneCount];
+    const float* cornerY[Frustum::PlaneCount];
+    const float* cornerZ[Frustum::PlaneCount];
+    __m128 planeA[Frustum::PlaneCount], planeB[Frustum::PlaneCount];
+    __m128 planeC[Frustum::PlaneCount], planeD[Frustum::PlaneCount];
+    for (int p = 0; p < Frustum::PlaneCount; ++p) {
+        const float* plane = frustum.planes[p];
+        cornerX[p] = plane[0] >= 0.0f ? volumes.maxX.data() : volumes.minX.data();
+        cornerY[p] = plane[1] >= 0.0f ? volumes.maxY.data() : volumes.minY.data();
+        cornerZ[p] = plane[2] >= 0.0f ? volumes.maxZ.data() : volumes.minZ.data();
+        planeA[p] = _mm_set1_ps(plane[0]);
+        planeB[p] = _mm_set1_ps(plane[1]);
+        planeC[p] = _mm_set1_ps(plane[2]);
+        planeD[p] = _mm_set1_ps(plane[3]);
+    }
+
+    const bool testDistance = frustum.maxDistance > 0.0f;
+    const __m128 eyeX = _mm_set1_ps(frustum.eye[0]);
+    const __m128 eyeY = _mm_set1_ps(frustum.eye[1]);
+    const __m128 eyeZ = _mm_set1_ps(frustum.eye[2]);
+    const __m128 maxDistance = _mm_set1_ps(frustum.maxDistance);
+    const __m128 zero = _mm_setzero_ps();
+
+    for (; i + 4 <= count; i += 4) {
+        // Lanes stay set while the box is in front of every plane
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < Frustum::PlaneCount; ++p) {
+            __m128 distance = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(planeA[p], _mm_loadu_ps(cornerX[p] + i)), _mm_mul_ps(planeB[p], _mm_loadu_ps(cornerY[p] + i))),
+                _mm_add_ps(_mm_mul_ps(planeC[p], _mm_loadu_ps(cornerZ[p] + i)), planeD[p]));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, zero));
+        }
+
+        if (testDistance) {
+            __m128 dx = _mm_sub_ps(_mm_loadu_ps(volumes.centerX.data() + i), eyeX);
+            __m128 dy = _mm_sub_ps(_mm_loadu_ps(volumes.centerY.data() + i), eyeY);
+            __m128 dz = _mm_sub_ps(_mm_loadu_ps(volumes.centerZ.data() + i), eyeZ);
+            __m128 reach = _mm_add_ps(maxDistance, _mm_loadu_ps(volumes.radius.data() + i));
+            __m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+            inside = _mm_and_ps(inside, _mm_cmple_ps(distanceSquared, _mm_mul_ps(reach, reach)));
+        }
+
+        // Compact without branching on each lane: always write, advance when visible
+        int mask = _mm_movemask_ps(inside);
+        uint32_t index = static_cast<uint32_t>(i);
+        visible[visibleCount] = index;
+        visibleCount += mask & 1;
+        visible[visibleCount] = index + 1;
+        visibleCount += (mask >> 1) & 1;
+        visible[visibleCount] = index + 2;
+        visibleCount += (mask >> 2) & 1;
+        visible[visibleCount] = index + 3;
+        visibleCount += (mask >> 3) & 1;
+    }
+#endif
+
+    // Leftover objects, or all of them without SSE2
+    for (; i < count; ++i) {
+        if (IsVisible(frustum, volumes, i)) {
+            visible[visibleCount++] = static_cast<uint32_t>(i);
+        }
+    }
+    return visibleCount;
+}
@@ -0,0 +1,61 @@
+// FrustumCulling.h
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// View volume for culling: six planes pointing inwards and an optional
+// spherical view distance around the eye
+struct Frustum {
+    enum PlaneIndex { Left, Right, Bottom, Top, Near, Far, PlaneCount };
+
+    float planes[PlaneCount][4];    // ax + by + cz + d >= 0 inside, normalized
+    float eye[3];
+    float maxDistance;              // 0 disables the distance test
+};
+
+enum class FrustumTest {
+    Outside,
+    Intersecting,
+    Inside
+};
+
+// World-space bounds of many objects in structure-of-arrays form, so the
+// culling kernels can load four objects per component at once. Each object
+// has an AABB for the frustum test and a bounding sphere for the view distance.
+struct BoundingVolumes {
+    std::vector<float> centerX, centerY, centerZ, radius;
+    std::vector<float> minX, minY, minZ;
+    std::vector<float> maxX, maxY, maxZ;
+
+    size_t Size() const { return centerX.size(); }
+    void Clear();
+    void Reserve(size_t count);
+
+    // Adds a box given by its center and half extents, returning its index
+    uint32_t Add(const float center[3], const float extents[3]);
+};
+
+// Frustum and view distance culling over BoundingVolumes. Cull writes the
+// indices of the objects that may be visible, in increasing order, and returns
+// how many there are. The output array needs room for every object.
+class FrustumCulling {
+public:
+    // Planes from a row-vector view-projection matrix (as DirectXMath builds
+    // them) with D3D clip depth from 0 to w. viewProj is 16 floats, row-major.
+    static void ExtractFrustum(const float viewProj[16], const float eye[3], float maxDistance, Frustum& frustum);
+
+    // Classifies one box, for hierarchies that can skip tests inside a fully visible node
+    static FrustumTest TestAabb(const Frustum& frustum, const float boxMin[3], const float boxMax[3]);
+
+    // Four objects per step with SSE2 when available
+    static size_t Cull(const Frustum& frustum, const BoundingVolumes& volumes, uint32_t* visible);
+
+    // Culls objects [begin, end) only, so disjoint ranges can run on different
+    // threads. Indices stay absolute; visible needs room for end - begin.
+    static size_t Cull(const Frustum& frustum, const BoundingVolumes& volumes, size_t begin, size_t end, uint32_t* visible);
+
+    // One object at a time; the reference the SIMD kernel has to match
+    static size_t CullScalar(const Frustum& frustum, const BoundingVolumes& volumes, uint32_t* visible);
+};
@@ -0,0 +1,25 @@
+// GenerationalHandle.h
+
+#pragma once
+#include <cstdint>
+
+// 64-bit handles to slots that get reused: the slot's generation in the high
+// half and its index in the low half. A slot's generation moves on whenever
+// the slot is freed, so handles to what it held before stop matching.
+// Generations start at 1 and skip 0 when they wrap, so no handle is ever 0.
+class GenerationalHandle {
+public:
+    static const uint32_t FirstGeneration = 1;
+
+    static uint64_t Make(uint32_t index, uint32_t generation) {
+        return (static_cast<uint64_t>(generation) << 32) | index;
+    }
+
+    static uint32_t GetIndex(uint64_t handle) { return static_cast<uint32_t>(handle); }
+    static uint32_t GetGeneration(uint64_t handle) { return static_cast<uint32_t>(handle >> 32); }
+
+    // The generation a slot moves to when it is freed
+    static uint32_t NextGeneration(uint32_t generation) {
+        return (generation + 1 == 0) ? FirstGeneration : generation + 1;
+    }
+};
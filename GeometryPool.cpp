@@ -0,0 +1,227 @@
+// GeometryPool.cpp
+
+#include "GeometryPool.h"
+#include "Log.h"
+#include <algorithm>
+#include <initializer_list>
+
+GeometryPool::GeometryPool()
+    : backend(nullptr), growths(0), defragmentations(0)
+{
+    vertexArena = Arena{ InvalidBuffer, BufferUsage::Vertex, 0, OffsetAllocator() };
+    indexArenas[static_cast<int>(IndexFormat::UInt16)] = Arena{ InvalidBuffer, BufferUsage::Index, sizeof(uint16_t), OffsetAllocator() };
+    indexArenas[static_cast<int>(IndexFormat::UInt32)] = Arena{ InvalidBuffer, BufferUsage::Index, sizeof(uint32_t), OffsetAllocator() };
+}
+
+GeometryPool::~GeometryPool() {
+    if (backend) {
+        backend->DestroyBuffer(vertexArena.buffer);
+        for (Arena& arena : indexArenas) {
+            backend->DestroyBuffer(arena.buffer);
+        }
+    }
+}
+
+bool GeometryPool::Initialize(RenderBackend* renderBackend, uint32_t vertexStride, uint32_t vertexCapacity, uint32_t indexCapacity) {
+    backend = renderBackend;
+    vertexArena.stride = vertexStride;
+    if (!Relocate(vertexArena, vertexCapacity)) {
+        return false;
+    }
+    for (Arena& arena : indexArenas) {
+        if (!Relocate(arena, indexCapacity)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+GeometryHandle GeometryPool::Allocate(const void* vertices, uint32_t vertexCount,
+    const void* indices, uint32_t indexCount, IndexFormat format) {
+    if (vertexCount == 0 || indexCount == 0) {
+        return InvalidGeometry;
+    }
+
+    // Growing one arena never moves ranges in the other
+    Arena& indexArena = indexArenas[static_cast<int>(format)];
+    Entry entry;
+    if (!AllocateRange(vertexArena, vertexCount, entry.vertices)) {
+        return InvalidGeometry;
+    }
+    if (!AllocateRange(indexArena, indexCount, entry.indices)) {
+        vertexArena.allocator.Free(entry.vertices);
+        return InvalidGeometry;
+    }
+
+    if (!backend->WriteBuffer(vertexArena.buffer, entry.vertices.offset * vertexArena.stride, vertices, vertexCount * vertexArena.stride) ||
+        !backend->WriteBuffer(indexArena.buffer, entry.indices.offset * indexArena.stride, indices, indexCount * indexArena.stride)) {
+        vertexArena.allocator.Free(entry.vertices);
+        indexArena.allocator.Free(entry.indices);
+        return InvalidGeometry;
+    }
+
+    entry.range.baseVertex = static_cast<int32_t>(entry.vertices.offset);
+    entry.range.firstIndex = entry.indices.offset;
+    entry.range.vertexCount = vertexCount;
+    entry.range.indexCount = indexCount;
+    entry.range.indexFormat = format;
+    entry.live = true;
+
+    uint32_t index;
+    if (!freeEntries.empty()) {
+        index = freeEntries.back();
+        freeEntries.pop_back();
+        entries[index] = entry;
+    }
+    else {
+        index = static_cast<uint32_t>(entries.size());
+        entries.push_back(entry);
+    }
+    return index + 1;
+}
+
+void GeometryPool::Free(GeometryHandle handle) {
+    if (handle == InvalidGeometry || handle > entries.size() || !entries[handle - 1].live) {
+        return;
+    }
+
+    Entry& entry = entries[handle - 1];
+    vertexArena.allocator.Free(entry.vertices);
+    indexArenas[static_cast<int>(entry.range.indexFormat)].allocator.Free(entry.indices);
+    entry.live = false;
+    freeEntries.push_back(handle - 1);
+}
+
+bool GeometryPool::AllocateRange(Arena& arena, uint32_t count, OffsetAllocator::Allocation& allocation) {
+    allocation = arena.allocator.Allocate(count);
+    while (allocation.offset == OffsetAllocator::NoSpace) {
+        // Relocating packs the ranges, leaving the free space in one range at
+        // the end; it can still be refused if the request rounds up past it
+        uint64_t capacity = std::max<uint64_t>(arena.allocator.GetSize(), 1) * 2;
+        uint64_t used = arena.allocator.GetStats().usedSize;
+        while (capacity < used + count) {
+            capacity *= 2;
+        }
+        if (capacity * arena.stride > 0xffffffffull) {
+            LogMessage("Geometry pool buffer cannot grow past %u bytes\n", arena.allocator.GetSize() * arena.stride);
+            return false;
+        }
+
+        if (!Relocate(arena, static_cast<uint32_t>(capacity))) {
+            return false;
+        }
+        ++growths;
+        allocation = arena.allocator.Allocate(count);
+    }
+    return true;
+}
+
+bool GeometryPool::Relocate(Arena& arena, uint32_t capacity) {
+    BufferHandle buffer = backend->CreateBuffer(arena.usage, nullptr, capacity * arena.stride);
+    if (buffer == InvalidBuffer) {
+        LogMessage("Failed to create a %u byte geometry pool buffer\n", capacity * arena.stride);
+        return false;
+    }
+
+    // Which of an entry's allocations lives in this arena, if any
+    bool vertices = (&arena == &vertexArena);
+    auto getAllocation = [this, vertices, &arena](Entry& entry) -> OffsetAllocator::Allocation* {
+        if (!entry.live) {
+            return nullptr;
+        }
+        if (vertices) {
+            return &entry.vertices;
+        }
+        return (&indexArenas[static_cast<int>(entry.range.indexFormat)] == &arena) ? &entry.indices : nullptr;
+    };
+
+    relocated.clear();
+    for (uint32_t index = 0; index < entries.size(); ++index) {
+        if (getAllocation(entries[index])) {
+            relocated.push_back(index);
+        }
+    }
+    std::sort(relocated.begin(), relocated.end(), [this, &getAllocation](uint32_t a, uint32_t b) {
+        return getAllocation(entries[a])->offset < getAllocation(entries[b])->offset;
+    });
+
+    // A fresh allocator hands out ranges back to back, so the copies keep
+    // their order and runs that were already adjacent go as one copy
+    OffsetAllocator allocator(capacity);
+    uint32_t runSource = 0, runTarget = 0, runSize = 0;
+    for (uint32_t index : relocated) {
+        Entry& entry = entries[index];
+        OffsetAllocator::Allocation* allocation = getAllocation(entry);
+        uint32_t count = arena.allocator.GetAllocationSize(*allocation);
+        OffsetAllocator::Allocation packed = allocator.Allocate(count);
+
+        if (runSize > 0 && allocation->offset != runSource + runSize) {
+            backend->CopyBuffer(buffer, runTarget * arena.stride, arena.buffer, runSource * arena.stride, runSize * arena.stride);
+            runSize = 0;
+        }
+        if (runSize == 0) {
+            runSource = allocation->offset;
+            runTarget = packed.offset;
+        }
+        runSize += count;
+
+        *allocation = packed;
+        if (vertices) {
+            entry.range.baseVertex = static_cast<int32_t>(packed.offset);
+        }
+        else {
+            entry.range.firstIndex = packed.offset;
+        }
+    }
+    if (runSize > 0) {
+        backend->CopyBuffer(buffer, runTarget * arena.stride, arena.buffer, runSource * arena.stride, runSize * arena.stride);
+    }
+
+    // Frames in flight keep the old buffer alive until they are done with it
+    backend->DestroyBuffer(arena.buffer);
+    arena.buffer = buffer;
+    arena.allocator = std::move(allocator);
+    return true;
+}
+
+bool GeometryPool::IsFragmented() const {
+    for (const Arena* arena : { &vertexArena, &indexArenas[0], &indexArenas[1] }) {
+        OffsetAllocator::Stats stats = arena->allocator.GetStats();
+        if (stats.freeSize - stats.largestFree > stats.size / 4) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool GeometryPool::Defragment() {
+    for (Arena* arena : { &vertexArena, &indexArenas[0], &indexArenas[1] }) {
+        if (arena->allocator.GetFragmentation() > 0.0f && !Relocate(*arena, arena->allocator.GetSize())) {
+            return false;
+        }
+    }
+    ++defragmentations;
+    return true;
+}
+
+GeometryPool::Stats GeometryPool::GetStats() const {
+    Stats stats = {};
+    stats.meshes = static_cast<uint32_t>(entries.size() - freeEntries.size());
+    stats.growths = growths;
+    stats.defragmentations = defragmentations;
+    for (const Arena* arena : { &vertexArena, &indexArenas[0], &indexArenas[1] }) {
+        OffsetAllocator::Stats arenaStats = arena->allocator.GetStats();
+        stats.buffers += (arena->buffer != InvalidBuffer) ? 1 : 0;
+        stats.usedBytes += static_cast<uint64_t>(arenaStats.usedSize) * arena->stride;
+        stats.capacityBytes += static_cast<uint64_t>(arenaStats.size) * arena->stride;
+        stats.fragmentation = std::max(stats.fragmentation, arena->allocator.GetFragmentation());
+    }
+    return stats;
+}
+
+void GeometryPool::LogStats() const {
+    Stats stats = GetStats();
+    LogMessage("Geometry pool: %u meshes in %u buffers, %llu of %llu bytes used, %.0f%% fragmented, %u growths, %u defragmentations\n",
+        stats.meshes, stats.buffers, static_cast<unsigned long long>(stats.usedBytes),
+        static_cast<unsigned long long>(stats.capacityBytes), stats.fragmentation * 100.0f, stats.growths, stats.defragmentations);
+}
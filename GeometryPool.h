@@ -0,0 +1,101 @@
+// GeometryPool.h
+
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "OffsetAllocator.h"
+#include "RenderBackend.h"
+
+// Index of a mesh's ranges in the pool plus one; 0 is never valid
+typedef uint32_t GeometryHandle;
+const GeometryHandle InvalidGeometry = 0;
+
+// Where one mesh's vertices and indices live in the pool's buffers
+struct GeometryRange {
+    int32_t baseVertex;         // Added to every index by the draw
+    uint32_t firstIndex;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    IndexFormat indexFormat;
+};
+
+// Static mesh geometry shared between one vertex buffer and one index buffer
+// per index format, so drawing another mesh changes the draw's base vertex and
+// first index rather than the bound buffers. Ranges come from offset
+// allocators. A full buffer grows by moving its contents into a larger one,
+// and Defragment moves them into a new buffer of the same size with the gaps
+// squeezed out; either way ranges move, so draws look them up with GetRange.
+class GeometryPool {
+public:
+    struct Stats {
+        uint32_t meshes;
+        uint32_t buffers;
+        uint64_t usedBytes;
+        uint64_t capacityBytes;
+        float fragmentation;        // The worst buffer's, see OffsetAllocator::GetFragmentation
+        uint32_t growths;
+        uint32_t defragmentations;
+    };
+
+    GeometryPool();
+    ~GeometryPool();
+
+    // Capacities are in vertices and indices, and double whenever they run out
+    bool Initialize(RenderBackend* backend, uint32_t vertexStride,
+        uint32_t vertexCapacity = 64 * 1024, uint32_t indexCapacity = 256 * 1024);
+
+    // Copies the geometry into the pool. Indices count from the mesh's first vertex.
+    GeometryHandle Allocate(const void* vertices, uint32_t vertexCount,
+        const void* indices, uint32_t indexCount, IndexFormat format);
+
+    // The caller makes sure no queued frame still draws the range
+    void Free(GeometryHandle handle);
+
+    const GeometryRange& GetRange(GeometryHandle handle) const { return entries[handle - 1].range; }
+    BufferHandle GetVertexBuffer() const { return vertexArena.buffer; }
+    BufferHandle GetIndexBuffer(IndexFormat format) const { return indexArenas[static_cast<int>(format)].buffer; }
+    uint32_t GetVertexStride() const { return vertexArena.stride; }
+
+    // True once a buffer's free space outside its largest free range exceeds a
+    // quarter of the buffer
+    bool IsFragmented() const;
+
+    // Packs every buffer's ranges together at its start. False if a new buffer
+    // could not be created; the buffers moved before that stay moved.
+    bool Defragment();
+
+    Stats GetStats() const;
+    void LogStats() const;
+
+private:
+    struct Arena {
+        BufferHandle buffer;
+        BufferUsage usage;
+        uint32_t stride;            // Bytes per vertex or index
+        OffsetAllocator allocator;
+    };
+
+    struct Entry {
+        GeometryRange range;
+        OffsetAllocator::Allocation vertices;
+        OffsetAllocator::Allocation indices;
+        bool live;
+    };
+
+    // Grows the arena until the range fits
+    bool AllocateRange(Arena& arena, uint32_t count, OffsetAllocator::Allocation& allocation);
+
+    // Moves the arena's ranges, packed in offset order, into a new buffer of the given capacity
+    bool Relocate(Arena& arena, uint32_t capacity);
+
+    RenderBackend* backend;
+    Arena vertexArena;
+    Arena indexArenas[2];           // By IndexFormat
+    std::vector<Entry> entries;
+    std::vector<uint32_t> freeEntries;
+    uint32_t growths;
+    uint32_t defragmentations;
+
+    // Ranges of the arena being relocated, by offset
+    std::vector<uint32_t> relocated;
+};
@@ -1,348 +1,523 @@
 // Graphics.cpp
 
 #include "Graphics.h"
-#include <d3dcompiler.h>
 #include <DirectXMath.h>
-#include <dxgi.h>
-#include <dxgi1_2.h>
-#pragma comment(lib, "dxgi.lib")
 
 using namespace DirectX;
 
-#pragma comment(lib, "d3dcompiler.lib")
-
+#include "Log.h"
+#include "MemoryTracker.h"
 #include "Mesh.h"
+#include "Profiler.h"
 #include "ShapeGenerator.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <vector>
 
 
-Graphics::Graphics() {}
+Graphics::Graphics()
+    : frameMemory(256 * 1024, MemoryTag::Rendering)
+{
+}
 
 Graphics::~Graphics() {
-    if (cbPerObjectBuffer) cbPerObjectBuffer->Release();
-    if (inputLayout) inputLayout->Release();
-    if (pixelShader) pixelShader->Release();
-    if (vertexShader) vertexShader->Release();
-    if (indexBuffer) indexBuffer->Release();
-    if (vertexBuffer) vertexBuffer->Release();
-    if (depthStencilState) depthStencilState->Release();
-    if (depthStencilView) depthStencilView->Release();
-    if (depthStencilBuffer) depthStencilBuffer->Release();
-    if (renderTargetView) renderTargetView->Release();
-    if (swapChain) swapChain->Release();
-    if (context) context->Release();
-    if (device) device->Release();
+    assetStreamer.Stop();
+
+    // Chunk generation runs on the job system, which is destroyed first
+    terrain.Shutdown();
+    delete instanceBatch;
 }
 
-ID3DBlob* CompileShader(const wchar_t* filename, const char* entryPoint, const char* target) {
-    ID3DBlob* shaderBlob = nullptr;
-    ID3DBlob* errorBlob = nullptr;
-    HRESULT hr = D3DCompileFromFile(filename, nullptr, nullptr, entryPoint, target, 0, 0, &shaderBlob, &errorBlob);
-    if (FAILED(hr)) {
-        if (errorBlob) {
-            OutputDebugStringA((char*)errorBlob->GetBufferPointer());
-            errorBlob->Release();
-        }
-        return nullptr; // Return nullptr on failure
-    }
-    return shaderBlob;
+// Reports the buffer sizes and LOD count of a mesh and the bytes saved by welding, quantization and 16-bit indices
+static void LogMeshStats(const char* name, const Mesh& mesh) {
+    const Mesh::Stats& stats = mesh.GetStats();
+    LogMessage("%s: %u vertices (%u bytes), %u indices (%u bytes) in %u LODs, saved %u bytes (%u welding, %u quantization, %u 16-bit indices)\n",
+        name, stats.vertexCount, stats.vertexBufferBytes, stats.indexCount, stats.indexBufferBytes, stats.lodCount,
+        stats.weldBytesSaved + stats.quantizeBytesSaved + stats.indexBytesSaved,
+        stats.weldBytesSaved, stats.quantizeBytesSaved, stats.indexBytesSaved);
 }
 
+void Graphics::GetPipelineDescs(std::vector<PipelineDesc>& pipelines) {
+    // In ShaderProgram order. Both programs read the quantized mesh vertex
+    // format; the instanced one also reads world matrices from slot 1.
+    pipelines.clear();
+    pipelines.push_back(PipelineDesc{ L"VertexShader.hlsl", L"PixelShader.hlsl", &Mesh::GetVertexFormat(), false });
+    pipelines.push_back(PipelineDesc{ L"VertexShaderInstanced.hlsl", L"PixelShader.hlsl", &Mesh::GetVertexFormat(), true });
+}
 
-bool Graphics::Initialize(HWND hwnd, int width, int height) {
-    // Calculate the aspect ratio
-    float aspectRatio = static_cast<float>(width) / static_cast<float>(height);
+bool Graphics::Initialize(RenderBackend* renderBackend, int width, int height) {
+    backend = renderBackend;
+    this->width = width;
+    this->height = height;
 
-    IDXGIFactory1* pFactory = nullptr;
-    HRESULT hr = CreateDXGIFactory1(__uuidof(IDXGIFactory1), (void**)&pFactory);
-    if (FAILED(hr)) {
-        MessageBox(hwnd, L"Failed to create DXGI Factory!", L"Error", MB_OK);
+    // One worker per core besides this thread
+    if (!jobs.Initialize()) {
+        LogMessage("Failed to start the job system\n");
         return false;
     }
 
-    // Enumerate adapters to find the discrete GPU
-    IDXGIAdapter1* pAdapter = nullptr;
-    IDXGIAdapter1* selectedAdapter = nullptr;
-    UINT adapterIndex = 0;
-    SIZE_T maxDedicatedVideoMemory = 0;
-
-    while (pFactory->EnumAdapters1(adapterIndex, &pAdapter) != DXGI_ERROR_NOT_FOUND) {
-        DXGI_ADAPTER_DESC1 adapterDesc;
-        pAdapter->GetDesc1(&adapterDesc);
-
-        // Skip software adapters if necessary
-        if (!(adapterDesc.Flags & DXGI_ADAPTER_FLAG_SOFTWARE)) {
-            // Prefer the adapter with the most dedicated video memory
-            if (adapterDesc.DedicatedVideoMemory > maxDedicatedVideoMemory) {
-                maxDedicatedVideoMemory = adapterDesc.DedicatedVideoMemory;
-                if (selectedAdapter) selectedAdapter->Release();
-                selectedAdapter = pAdapter;
-                // Do not release pAdapter here since we keep it as selectedAdapter
-            }
-            else {
-                pAdapter->Release();
-            }
-        }
-        else {
-            pAdapter->Release();
-        }
-
-        adapterIndex++;
-    }
-
-    if (!selectedAdapter) {
-        MessageBox(hwnd, L"No suitable graphics adapter found!", L"Error", MB_OK);
-        pFactory->Release();
+    // Low-resolution depth buffer for occlusion culling, same aspect as the window
+    if (!occlusionCuller.Initialize(256, std::max(1, 256 * height / width))) {
+        LogMessage("Failed to create the occlusion buffer\n");
         return false;
     }
 
-    DXGI_SWAP_CHAIN_DESC scd = {};
-    scd.BufferCount = 1;
-    scd.BufferDesc.Width = width;
-    scd.BufferDesc.Height = height;
-    scd.BufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-    scd.BufferDesc.RefreshRate.Numerator = 60;
-    scd.BufferDesc.RefreshRate.Denominator = 1;
-    scd.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
-    scd.OutputWindow = hwnd;
-    scd.SampleDesc.Count = 1;
-    scd.SampleDesc.Quality = 0;
-    scd.Windowed = TRUE;
-    scd.SwapEffect = DXGI_SWAP_EFFECT_DISCARD;
-
-    UINT createDeviceFlags = D3D11_CREATE_DEVICE_DEBUG;
-
-    hr = D3D11CreateDeviceAndSwapChain(
-        selectedAdapter, D3D_DRIVER_TYPE_UNKNOWN, nullptr, createDeviceFlags, nullptr, 0,
-        D3D11_SDK_VERSION, &scd, &swapChain, &device, nullptr, &context);
-
-    selectedAdapter->Release();
-    pFactory->Release();
-
-    if (FAILED(hr)) {
-        MessageBox(hwnd, L"Failed to create Direct3D device and swap chain!", L"Error", MB_OK);
-        return false;
+    std::vector<PipelineDesc> pipelineDescs;
+    GetPipelineDescs(pipelineDescs);
+    for (uint32_t program = 0; program < ProgramCount; ++program) {
+        programs[program] = backend->CreatePipeline(pipelineDescs[program]);
+        if (programs[program] == InvalidPipeline) {
+            LogMessage("Failed to create the shader programs\n");
+            return false;
+        }
     }
 
-    // Create render target view
-    ID3D11Texture2D* backBuffer = nullptr;
-    hr = swapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), (void**)&backBuffer);
-    if (FAILED(hr)) {
-        MessageBox(hwnd, L"Failed to get back buffer!", L"Error", MB_OK);
+    if (!geometry.Initialize(backend, Mesh::GetVertexFormat().GetStride())) {
+        LogMessage("Failed to create the geometry pool\n");
         return false;
     }
-
-    hr = device->CreateRenderTargetView(backBuffer, nullptr, &renderTargetView);
-    backBuffer->Release();
-    if (FAILED(hr)) {
-        MessageBox(hwnd, L"Failed to create render target view!", L"Error", MB_OK);
+    meshes.Initialize(backend, &geometry);
+
+    // Rolling ground a few units below the scene, centered under the camera
+    const uint32_t heightmapSize = 513;
+    if (!heightmap.GenerateFractal(heightmapSize, heightmapSize, 1.0f, 0.0f, 6.0f, 1) ||
+        !terrain.Initialize(backend, &jobs, &heightmap, Terrain::GetDefaultDesc(),
+            XMFLOAT3(-0.5f * (heightmapSize - 1), -10.0f, -0.5f * (heightmapSize - 1)))) {
+        LogMessage("Failed to create the terrain\n");
         return false;
     }
 
-    // Create depth-stencil buffer
-    D3D11_TEXTURE2D_DESC depthStencilDesc = {};
-    depthStencilDesc.Width = width;
-    depthStencilDesc.Height = height;
-    depthStencilDesc.MipLevels = 1;
-    depthStencilDesc.ArraySize = 1;
-    depthStencilDesc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
-    depthStencilDesc.SampleDesc.Count = 1;
-    depthStencilDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
-
-    hr = device->CreateTexture2D(&depthStencilDesc, nullptr, &depthStencilBuffer);
-    if (FAILED(hr)) {
-        MessageBox(hwnd, L"Failed to create depth stencil buffer!", L"Error", MB_OK);
-        return false;
-    }
+    // Generate pyramid geometry
+    std::vector<Mesh::Vertex> vertices;
+    std::vector<uint32_t> indices;
+    ShapeGenerator::CreatePyramid(vertices, indices);
 
-    // Create depth-stencil view
-    hr = device->CreateDepthStencilView(depthStencilBuffer, nullptr, &depthStencilView);
-    if (FAILED(hr)) {
-        MessageBox(hwnd, L"Failed to create depth stencil view!", L"Error", MB_OK);
+    // Create the pyramid mesh; it also hides what is behind it from the occlusion culler
+    MeshHandle pyramidMesh = meshes.Create("Pyramid", vertices, indices, true);
+    if (pyramidMesh == InvalidMesh) {
+        LogMessage("Failed to initialize pyramid mesh\n");
         return false;
     }
+    LogMeshStats("Pyramid", *meshes.Get(pyramidMesh));
 
-    // Bind the render target view and depth stencil view
-    context->OMSetRenderTargets(1, &renderTargetView, depthStencilView);
-
-    // Set up the viewport
-    viewport.Width = static_cast<float>(width);
-    viewport.Height = static_cast<float>(height);
-    viewport.MinDepth = 0.0f;
-    viewport.MaxDepth = 1.0f;
-    viewport.TopLeftX = 0.0f;
-    viewport.TopLeftY = 0.0f;
-    context->RSSetViewports(1, &viewport);
-
-    // Compile vertex shader
-    ID3DBlob* vsBlob = CompileShader(L"VertexShader.hlsl", "main", "vs_5_0");
-    if (!vsBlob) {
-        MessageBox(hwnd, L"Failed to compile vertex shader!", L"Error", MB_OK);
-        return false;
+    // Set initial transformation if needed
+    pyramid = CreateMeshEntity(pyramidMesh);
+    transforms.SetPosition(GetTransform(pyramid), 0.0f, 0.0f, -0.9f);
+    AddToScene(pyramid);
+
+    // The icosphere streams in on a worker thread and is drawn once it is resident
+    assetStreamer.Start(&Mesh::LoadMeshData);
+
+    MeshHandle icosphereMesh = meshes.Create("icosphere.bogmesh");
+    icosphere = CreateMeshEntity(icosphereMesh);
+    transforms.SetPosition(GetTransform(icosphere), 0.0f, 0.0f, -0.3f);
+
+    AssetHandle icosphereHandle = assetStreamer.RequestMesh("icosphere.bogmesh", "icosphere.obj");
+    streamedMeshes[icosphereHandle] = StreamedMesh{ icosphereMesh, icosphere, "Icosphere" };
+
+    instanceBatch = new InstanceBatch(backend);
+
+    return true;
+}
+
+void Graphics::Update(float step) {
+    BOG_PROFILE_ZONE("Graphics::Update");
+
+    // Rotate the pyramid over time; Draw blends from the previous step's angle
+    float rotationSpeed = XM_PI / 4; // 90 degrees per second
+    previousAngle = angle;
+    angle += step * rotationSpeed;
+}
+
+void Graphics::UpdateCamera() {
+    // Update view and projection matrices
+    viewMatrix = XMMatrixLookAtLH(
+        XMLoadFloat3(&cameraPosition),        // Camera position
+        XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f),  // Focus point
+        XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)   // Up direction
+    );
+
+    const float fieldOfView = XM_PIDIV4;
+    float aspectRatio = static_cast<float>(width) / static_cast<float>(height);
+    projMatrix = XMMatrixPerspectiveFovLH(
+        fieldOfView,        // Field of view angle (45 degrees)
+        aspectRatio,        // Aspect ratio
+        0.1f,               // Near clipping plane
+        200.0f              // Far clipping plane
+    );
+
+    // Meshes switch LODs while their simplification error stays under a pixel
+    lodView.cameraPosition = cameraPosition;
+    lodView.pixelsPerUnit = static_cast<float>(height) / (2.0f * std::tan(fieldOfView * 0.5f));
+    lodView.maxPixelError = 1.0f;
+
+    // Culling volume for this frame's camera
+    XMFLOAT4X4 viewProj;
+    XMStoreFloat4x4(&viewProj, viewMatrix * projMatrix);
+    const float eye[3] = { cameraPosition.x, cameraPosition.y, cameraPosition.z };
+    FrustumCulling::ExtractFrustum(&viewProj._11, eye, viewDistance, frustum);
+}
+
+void Graphics::Present() {
+    BOG_PROFILE_ZONE("Graphics::Present");
+    backend->Present();
+
+    // Meshes released a few frames ago are no longer in flight, and their
+    // ranges can be squeezed out of the pool
+    meshes.EndFrame();
+    if (geometry.IsFragmented()) {
+        geometry.Defragment();
     }
 
-    hr = device->CreateVertexShader(vsBlob->GetBufferPointer(), vsBlob->GetBufferSize(), nullptr, &vertexShader);
-    if (FAILED(hr)) {
-        vsBlob->Release();
-        MessageBox(hwnd, L"Failed to create vertex shader!", L"Error", MB_OK);
-        return false;
+    // Closes the frame's heap allocation counts, which stay at zero once the scene is loaded
+    MemoryTracker::EndFrame();
+    BOG_PROFILE_COUNTER("Heap allocations", MemoryTracker::GetFrameAllocations());
+}
+
+void Graphics::Draw(float interpolation) {
+    BOG_PROFILE_ZONE("Graphics::Draw");
+    MemoryTagScope tag(MemoryTag::Rendering);
+
+    // The lists of the frame before last are no longer read
+    frameMemory.BeginFrame();
+    UpdateCamera();
+
+    // Pose the meshes between the last two simulation steps
+    float drawAngle = previousAngle + (angle - previousAngle) * interpolation;
+    transforms.SetRotation(GetTransform(pyramid), drawAngle, drawAngle, 0.0f);
+    transforms.SetRotation(GetTransform(icosphere), drawAngle, 0.0f, 0.0f);
+
+    // Rebuild the world matrices of whatever moved, spread over the workers;
+    // the tree is not thread-safe, so its proxies are moved afterwards on this thread
+    {
+        BOG_PROFILE_ZONE("UpdateWorldMatrices");
+        transforms.UpdateWorldMatrices(&jobs);
     }
+    UpdateSceneTree();
 
-    context->VSSetShader(vertexShader, nullptr, 0);
+    // Clear the screen and start a new frame of submission stats
+    const float clearColor[4] = { 0.0f, 0.2f, 0.4f, 1.0f };
+    backend->BeginFrame(clearColor);
+    LogSubmissionCounters();
 
-    // Compile pixel shader
-    ID3DBlob* psBlob = CompileShader(L"PixelShader.hlsl", "main", "ps_5_0");
-    if (!psBlob) {
-        vsBlob->Release();
-        MessageBox(hwnd, L"Failed to compile pixel shader!", L"Error", MB_OK);
-        return false;
+    // Calculate view-projection matrix
+    XMMATRIX viewProjMatrix = viewMatrix * projMatrix;
+
+    // Cull the scene against the view volume, then against the occluders
+    CullScene();
+    if (occlusionCulling) {
+        OccludeScene();
     }
 
-    hr = device->CreatePixelShader(psBlob->GetBufferPointer(), psBlob->GetBufferSize(), nullptr, &pixelShader);
-    if (FAILED(hr)) {
-        vsBlob->Release();
-        psBlob->Release();
-        MessageBox(hwnd, L"Failed to create pixel shader!", L"Error", MB_OK);
-        return false;
+    // Queue what is visible, sort it by state and depth, then submit it
+    QueueVisibleMeshes();
+    {
+        BOG_PROFILE_ZONE("SortDraws");
+        renderQueue.Sort();
     }
 
-    context->PSSetShader(pixelShader, nullptr, 0);
+    {
+        BOG_PROFILE_ZONE("SubmitDraws");
+        BOG_PROFILE_COUNTER("Draw packets", renderQueue.GetPackets().size());
+        for (const DrawPacket& packet : renderQueue.GetPackets()) {
+            const QueuedDraw& draw = queuedDraws[packet.item];
+            BindProgram(draw.program);
+            draw.mesh->Draw(XMLoadFloat4x4(&transforms.GetWorldMatrix(draw.transform)), viewProjMatrix, lodView);
+        }
+    }
 
-    // Create the pyramid mesh
-    pyramidMesh = new Mesh(device, context);
+    BindProgram(DefaultProgram);
+    terrain.Draw(frustum, viewProjMatrix, lodView);
 
-    // Generate pyramid geometry
-    std::vector<Mesh::Vertex> vertices;
-    std::vector<UINT> indices;
-    ShapeGenerator::CreatePyramid(vertices, indices);
+    if (benchmark.mesh != InvalidMesh) {
+        BOG_PROFILE_ZONE("DrawInstancingBenchmark");
+        DrawInstancingBenchmark(viewProjMatrix);
+    }
+}
 
-    // Initialize the mesh
-    if (!pyramidMesh->Initialize(vertices, indices)) {
-        MessageBox(hwnd, L"Failed to initialize pyramid mesh!", L"Error", MB_OK);
-        return false;
+void Graphics::EnableInstancingBenchmark(uint32_t instanceCount) {
+    if (benchmark.mesh == InvalidMesh) {
+        std::vector<Mesh::Vertex> vertices;
+        std::vector<uint32_t> indices;
+        ShapeGenerator::CreatePyramid(vertices, indices);
+
+        benchmark.mesh = meshes.Create("InstancingBenchmark", vertices, indices);
+        if (benchmark.mesh == InvalidMesh) {
+            return;
+        }
     }
 
-    // Set initial transformation if needed
-    pyramidMesh->SetPosition(0.0f, 0.0f, -0.9f);
+    // A square grid behind the scene, inside the far plane
+    const float spacing = 1.5f;
+    uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(instanceCount))));
+    benchmark.positions.clear();
+    for (uint32_t i = 0; i < instanceCount; ++i) {
+        float x = (static_cast<float>(i % side) - side * 0.5f) * spacing;
+        float z = 20.0f + static_cast<float>(i / side) * spacing;
+        benchmark.positions.push_back(XMFLOAT3(x, -2.0f, z));
+    }
 
-    icosphere = new Mesh(device, context);
+    benchmark.instanced = false;
+    benchmark.frame = 0;
+    benchmark.submitMilliseconds = 0.0;
+}
 
+void Graphics::DrawInstancingBenchmark(const XMMATRIX& viewProjMatrix) {
+    // Frames measured in each mode before switching to the other
+    const uint32_t framesPerMode = 300;
 
-    if (!icosphere->LoadFromOBJFile("icosphere.obj")) {
-        MessageBox(hwnd, L"Failed to initialize icosphere mesh!", L"Error", MB_OK);
-        return false;
-    }
+    auto start = std::chrono::steady_clock::now();
 
-    icosphere->SetPosition(0.0f, 0.0f, -0.3f);
+    Mesh* mesh = meshes.Get(benchmark.mesh);
+    if (benchmark.instanced) {
+        BindProgram(InstancedProgram);
 
-    // Define the input layout
-    D3D11_INPUT_ELEMENT_DESC layoutDesc[] = {
-        { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0,   D3D11_INPUT_PER_VERTEX_DATA, 0 },
-        { "COLOR",    0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12,  D3D11_INPUT_PER_VERTEX_DATA, 0 }
-    };
+        instanceBatch->Clear();
+        for (const XMFLOAT3& position : benchmark.positions) {
+            instanceBatch->Add(XMMatrixTranslation(position.x, position.y, position.z));
+        }
+        instanceBatch->Draw(*mesh, viewProjMatrix);
 
-    hr = device->CreateInputLayout(layoutDesc, ARRAYSIZE(layoutDesc), vsBlob->GetBufferPointer(), vsBlob->GetBufferSize(), &inputLayout);
-    vsBlob->Release();
-    psBlob->Release();
-    if (FAILED(hr)) {
-        MessageBox(hwnd, L"Failed to create input layout!", L"Error", MB_OK);
-        return false;
+        BindProgram(DefaultProgram);
+    }
+    else {
+        BindProgram(DefaultProgram);
+        for (const XMFLOAT3& position : benchmark.positions) {
+            mesh->Draw(XMMatrixTranslation(position.x, position.y, position.z), viewProjMatrix);
+        }
     }
 
-    context->IASetInputLayout(inputLayout);
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    benchmark.submitMilliseconds += elapsed.count();
 
-    // Create the constant buffer
-    D3D11_BUFFER_DESC cbd = {};
-    cbd.Usage = D3D11_USAGE_DEFAULT;
-    cbd.ByteWidth = sizeof(CBPerObject);
-    cbd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    if (++benchmark.frame == framesPerMode) {
+        LogMessage("Instancing benchmark: %u copies, %s: %.3f ms CPU submission per frame\n",
+            static_cast<uint32_t>(benchmark.positions.size()), benchmark.instanced ? "instanced" : "one draw per copy",
+            benchmark.submitMilliseconds / framesPerMode);
 
-    hr = device->CreateBuffer(&cbd, nullptr, &cbPerObjectBuffer);
-    if (FAILED(hr)) {
-        MessageBox(hwnd, L"Failed to create constant buffer!", L"Error", MB_OK);
-        return false;
+        benchmark.instanced = !benchmark.instanced;
+        benchmark.frame = 0;
+        benchmark.submitMilliseconds = 0.0;
     }
+}
 
-    // Set up the depth-stencil state
-    D3D11_DEPTH_STENCIL_DESC dsDesc = {};
-    dsDesc.DepthEnable = TRUE;
-    dsDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ALL;
-    dsDesc.DepthFunc = D3D11_COMPARISON_LESS;
+static Aabb MakeAabb(const XMFLOAT3& center, const XMFLOAT3& extents) {
+    Aabb aabb = {
+        { center.x - extents.x, center.y - extents.y, center.z - extents.z },
+        { center.x + extents.x, center.y + extents.y, center.z + extents.z }
+    };
+    return aabb;
+}
 
-    hr = device->CreateDepthStencilState(&dsDesc, &depthStencilState);
-    if (FAILED(hr)) {
-        MessageBox(hwnd, L"Failed to create depth stencil state!", L"Error", MB_OK);
-        return false;
-    }
+Entity Graphics::CreateMeshEntity(MeshHandle mesh) {
+    return entities.Create(TransformComponent{ transforms.Create() }, MeshComponent{ mesh });
+}
 
-    context->OMSetDepthStencilState(depthStencilState, 0);
+Entity Graphics::SpawnMesh(MeshHandle mesh, const XMFLOAT3& position) {
+    Mesh* resident = meshes.Get(mesh);
+    if (!resident || !resident->IsResident()) {
+        meshes.Release(mesh);
+        return InvalidEntity;
+    }
 
-    return true;
+    Entity entity = CreateMeshEntity(mesh);
+    transforms.SetPosition(GetTransform(entity), position.x, position.y, position.z);
+    AddToScene(entity);
+    return entity;
 }
 
-struct CBPerObject {
-    XMMATRIX worldViewProj;
-};
+void Graphics::AddToScene(Entity entity) {
+    TransformId transform = GetTransform(entity);
+    transforms.UpdateWorldMatrix(transform);
 
-void Graphics::Update(float deltaTime) {
-    // Update view and projection matrices
-    viewMatrix = XMMatrixLookAtLH(
-        XMVectorSet(0.0f, 1.0f, -5.0f, 1.0f), // Camera position
-        XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f),  // Focus point
-        XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)   // Up direction
-    );
+    SceneTreeComponent node;
+    XMFLOAT3 extents;
+    meshes.Get(entities.Get<MeshComponent>(entity)->mesh)->GetWorldBounds(transforms.GetWorldMatrix(transform), node.center, extents);
 
-    float aspectRatio = viewport.Width / viewport.Height;
-    projMatrix = XMMatrixPerspectiveFovLH(
-        XM_PIDIV4,          // Field of view angle (45 degrees)
-        aspectRatio,        // Aspect ratio
-        0.1f,               // Near clipping plane
-        200.0f              // Far clipping plane
-    );
+    void* userData = reinterpret_cast<void*>(static_cast<uintptr_t>(EntityWorld::GetIndex(entity)));
+    node.proxy = sceneTree.CreateProxy(MakeAabb(node.center, extents), userData);
+    entities.Add(entity, node);
+}
 
-    // Rotate the pyramid over time
-    static float angle = 0.0f;
-    float rotationSpeed = XM_PI / 4; // 90 degrees per second
-    angle += deltaTime * rotationSpeed;
-    pyramidMesh->SetRotation(angle, angle, 0.0f);
+void Graphics::UpdateSceneTree() {
+    BOG_PROFILE_ZONE("UpdateSceneTree");
+    entities.ForEach<TransformComponent, MeshComponent, SceneTreeComponent>(
+        [this](Entity, const TransformComponent& transform, const MeshComponent& mesh, SceneTreeComponent& node) {
+        if (!transforms.WasChanged(transform.transform)) {
+            return;
+        }
 
-    // Update the pyramid mesh
-    pyramidMesh->Update(deltaTime);
+        XMFLOAT3 center, extents;
+        meshes.Get(mesh.mesh)->GetWorldBounds(transforms.GetWorldMatrix(transform.transform), center, extents);
 
-    icosphere->SetRotation(angle, 0.0f, 0.0f);
+        const float displacement[3] = { center.x - node.center.x, center.y - node.center.y, center.z - node.center.z };
+        sceneTree.MoveProxy(node.proxy, MakeAabb(center, extents), displacement);
+        node.center = center;
+    });
+}
+
+void Graphics::CullScene() {
+    BOG_PROFILE_ZONE("CullScene");
+    sceneBounds.Clear();
+
+    // The query can return no more than every proxy in the tree
+    sceneObjects = frameMemory.AllocateArray<SceneObject>(sceneTree.GetProxyCount());
+    sceneObjectCount = 0;
+
+    // The tree rejects whole subtrees; the SIMD pass then tests the tight bounds
+    sceneTree.QueryFrustum(frustum, [this](int32_t proxy) {
+        Entity entity = entities.GetEntity(static_cast<uint32_t>(reinterpret_cast<uintptr_t>(sceneTree.GetUserData(proxy))));
+        SceneObject object = { meshes.Get(entities.Get<MeshComponent>(entity)->mesh), GetTransform(entity) };
+
+        XMFLOAT3 center, extents;
+        object.mesh->GetWorldBounds(transforms.GetWorldMatrix(object.transform), center, extents);
+        sceneBounds.Add(&center.x, &extents.x);
+        sceneObjects[sceneObjectCount++] = object;
+        return true;
+    });
+
+    // Each chunk writes its survivors to the start of its own slice of the
+    // visible list; the slices are then packed together in order
+    const size_t chunkSize = 4096;
+    size_t objectCount = sceneObjectCount;
+    size_t chunkCount = (objectCount + chunkSize - 1) / chunkSize;
+    visibleObjects = frameMemory.AllocateArray<uint32_t>(objectCount);
+    uint32_t* chunkCounts = frameMemory.AllocateArray<uint32_t>(chunkCount);
+
+    jobs.ParallelFor(chunkCount, 1, [this, chunkSize, objectCount, chunkCounts](size_t beginChunk, size_t endChunk) {
+        for (size_t chunk = beginChunk; chunk < endChunk; ++chunk) {
+            size_t begin = chunk * chunkSize;
+            size_t end = std::min(begin + chunkSize, objectCount);
+            chunkCounts[chunk] = static_cast<uint32_t>(
+                FrustumCulling::Cull(frustum, sceneBounds, begin, end, visibleObjects + begin));
+        }
+    });
 
-    icosphere->Update(deltaTime);
+    visibleCount = 0;
+    for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+        const uint32_t* survivors = visibleObjects + chunk * chunkSize;
+        if (survivors != visibleObjects + visibleCount) {
+            std::copy(survivors, survivors + chunkCounts[chunk], visibleObjects + visibleCount);
+        }
+        visibleCount += chunkCounts[chunk];
+    }
 }
 
+void Graphics::OccludeScene() {
+    BOG_PROFILE_ZONE("OccludeScene");
+    XMFLOAT4X4 viewProj;
+    XMStoreFloat4x4(&viewProj, viewMatrix * projMatrix);
+    occlusionCuller.BeginFrame(&viewProj._11);
+
+    // Only occluders that survived frustum culling are drawn
+    for (size_t i = 0; i < visibleCount; ++i) {
+        const SceneObject& object = sceneObjects[visibleObjects[i]];
+        const Mesh* mesh = object.mesh;
+        if (mesh->IsOccluder()) {
+            const XMFLOAT4X4& world = transforms.GetWorldMatrix(object.transform);
+            occlusionCuller.AddOccluder(mesh->GetOccluderPositions().data(), mesh->GetOccluderPositions().size() / 3,
+                mesh->GetOccluderIndices().data(), mesh->GetOccluderIndices().size(), &world._11);
+        }
+    }
+    occlusionCuller.Rasterize(&jobs);
+
+    // Drop hidden objects from the visible list; occluders always stay
+    size_t kept = 0;
+    for (size_t i = 0; i < visibleCount; ++i) {
+        uint32_t object = visibleObjects[i];
+        bool visible = sceneObjects[object].mesh->IsOccluder();
+        if (!visible) {
+            const float boxMin[3] = { sceneBounds.minX[object], sceneBounds.minY[object], sceneBounds.minZ[object] };
+            const float boxMax[3] = { sceneBounds.maxX[object], sceneBounds.maxY[object], sceneBounds.maxZ[object] };
+            visible = occlusionCuller.IsVisible(boxMin, boxMax);
+        }
+        if (visible) {
+            visibleObjects[kept++] = object;
+        }
+    }
+    visibleCount = kept;
+}
 
-void Graphics::ClearScreen(float r, float g, float b, float a) {
-    float color[4] = { r, g, b, a };
-    context->ClearRenderTargetView(renderTargetView, color);
-    context->ClearDepthStencilView(depthStencilView, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
+void Graphics::QueueVisibleMeshes() {
+    BOG_PROFILE_ZONE("QueueVisibleMeshes");
+    BOG_PROFILE_COUNTER("Visible objects", visibleCount);
+    renderQueue.Clear();
+    queuedDraws = frameMemory.AllocateArray<QueuedDraw>(visibleCount);
+    DrawPacket* packets = renderQueue.Append(visibleCount);
+
+    // Packet i refers to draw i, so the jobs write disjoint slots
+    jobs.ParallelFor(visibleCount, 512, [this, packets](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const SceneObject& object = sceneObjects[visibleObjects[i]];
+
+            // View-space depth of the mesh origin
+            const XMFLOAT4X4& world = transforms.GetWorldMatrix(object.transform);
+            XMVECTOR viewPosition = XMVector3Transform(XMVectorSet(world._41, world._42, world._43, 1.0f), viewMatrix);
+            float depth = XMVectorGetZ(viewPosition);
+
+            queuedDraws[i] = { object.mesh, object.transform, DefaultProgram };
+            packets[i].key = RenderQueue::MakeKey(RenderPass::Opaque, DefaultProgram, object.mesh->GetId(), depth);
+            packets[i].item = static_cast<uint32_t>(i);
+        }
+    });
 }
 
-void Graphics::Present() {
-    swapChain->Present(1, 0); // 1 to enable VSync, 0 to disable
+void Graphics::BindProgram(ShaderProgram program) {
+    // The backend drops repeated binds
+    backend->SetPipeline(programs[program]);
 }
 
-void Graphics::Draw() {
-    // Clear the screen
-    ClearScreen(0.0f, 0.2f, 0.4f, 1.0f);
+void Graphics::LogSubmissionCounters() {
+    // Frames between reports
+    const uint32_t reportInterval = 600;
 
-    // Set the input layout
-    context->IASetInputLayout(inputLayout);
+    if (++submissionFrame < reportInterval) {
+        return;
+    }
+    submissionFrame = 0;
+
+    const RenderStats& stats = backend->GetLastFrameStats();
+    LogMessage("Submission: %u draws, %u state calls issued, %u elided, %u constant allocations (%llu bytes, %u discards), %llu buffer bytes\n",
+        stats.draws, stats.states.TotalIssued(), stats.states.TotalElided(),
+        stats.constants.allocations, static_cast<unsigned long long>(stats.constants.bytes), stats.constants.discards,
+        static_cast<unsigned long long>(stats.bufferBytes));
+
+    if (occlusionCulling) {
+        const OcclusionCuller::Stats& occlusion = occlusionCuller.GetStats();
+        LogMessage("Occlusion: %u occluders (%u triangles), %u of %u tested objects hidden, %.3f ms rasterizing\n",
+            occlusion.occluders, occlusion.rasterTriangles, occlusion.occluded, occlusion.tested, occlusion.rasterMilliseconds);
+    }
+    meshes.LogStats();
+    geometry.LogStats();
+    terrain.LogStats();
+
+    LinearArena::Stats arena = frameMemory.GetPrevious().GetStats();
+    LogMessage("Frame arena: %llu of %llu bytes used (%llu at most), %u growths\n",
+        static_cast<unsigned long long>(arena.used), static_cast<unsigned long long>(arena.capacity),
+        static_cast<unsigned long long>(arena.highWater), arena.growths);
+    MemoryTracker::LogFrameStats();
+}
 
-    // Set shaders
-    context->VSSetShader(vertexShader, nullptr, 0);
-    context->PSSetShader(pixelShader, nullptr, 0);
+void Graphics::ProcessStreaming() {
+    BOG_PROFILE_ZONE("Graphics::ProcessStreaming");
+    assetStreamer.ProcessUploads(*this, uploadBudget);
+    terrain.Update(cameraPosition);
+}
 
-    // Calculate view-projection matrix
-    XMMATRIX viewProjMatrix = viewMatrix * projMatrix;
+bool Graphics::UploadMesh(AssetHandle handle, const MeshData& data) {
+    // Geometry already resident under another name is shared rather than uploaded again
+    auto it = streamedMeshes.find(handle);
+    if (it == streamedMeshes.end() || !meshes.Upload(it->second.mesh, data)) {
+        return false;
+    }
 
-    // Draw the pyramid mesh
-    pyramidMesh->Draw(viewProjMatrix);
-    icosphere->Draw(viewProjMatrix);
+    LogMeshStats(it->second.name, *meshes.Get(it->second.mesh));
+    AddToScene(it->second.entity);
+    return true;
+}
 
-    // Present the frame
-    Present();
+void Graphics::OnMeshFailed(AssetHandle handle) {
+    auto it = streamedMeshes.find(handle);
+    LogMessage("Failed to stream mesh %s\n", (it != streamedMeshes.end()) ? it->second.name : "(unknown)");
 }
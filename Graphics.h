@@ -1,54 +1,211 @@
 // Graphics.h
 #pragma once
 
-#include <d3d11.h>
 #include <DirectXMath.h>
+#include <cstdint>
+#include "AssetStreamer.h"
+#include "DynamicAabbTree.h"
+#include "EntityWorld.h"
+#include "FrustumCulling.h"
+#include "GeometryPool.h"
+#include "Heightmap.h"
+#include "InstanceBatch.h"
+#include "JobSystem.h"
+#include "LinearArena.h"
 #include "Mesh.h"
+#include "MeshRegistry.h"
+#include "OcclusionCuller.h"
+#include "RenderBackend.h"
+#include "RenderQueue.h"
+#include "SceneComponents.h"
+#include "Terrain.h"
+#include "TransformStore.h"
+#include <unordered_map>
+#include <vector>
 
 using namespace DirectX;
 
-class Graphics {
+class Graphics : public MeshUploadTarget {
 public:
     Graphics();
     ~Graphics();
 
-    bool Initialize(HWND hwnd, int width, int height);
-    void Update(float deltaTime);
-    void DrawPyramid();
-    void ClearScreen(float r, float g, float b, float a);
+    // The backend must outlive this object
+    bool Initialize(RenderBackend* backend, int width, int height);
+
+    // Advances the simulation by one fixed step
+    void Update(float step);
     void Present();
-    void Draw();
+
+    // Renders the scene posed between the last two steps, 0 at the previous one
+    // and 1 at the latest; the caller presents
+    void Draw(float interpolation = 1.0f);
+
+    // Uploads streamed meshes that finished loading, within the upload budget,
+    // and brings in the terrain chunks around the camera
+    void ProcessStreaming();
+    void SetUploadBudget(const AssetStreamer::UploadBudget& budget) { uploadBudget = budget; }
+
+    // True while requested meshes or terrain chunks in range are still loading or waiting for upload
+    bool IsStreaming() const { return !assetStreamer.IsIdle() || terrain.IsStreaming(); }
+
+    // Objects further than this from the camera are culled, 0 for no limit
+    void SetViewDistance(float distance) { viewDistance = distance; }
+
+    // Hides objects behind occluder meshes, on by default
+    void SetOcclusionCulling(bool enabled) { occlusionCulling = enabled; }
+
+    // Adds a grid of mesh copies that alternates between one draw per copy and
+    // a single instanced draw, logging the CPU submission time of each
+    void EnableInstancingBenchmark(uint32_t instanceCount);
+
+    // Every resident scene mesh, for culling, ray casts and proximity queries.
+    // User data is the entity's slot index, see EntityWorld::GetEntity.
+    const DynamicAabbTree& GetSceneTree() const { return sceneTree; }
+
+    // Scene objects: entities with transform and mesh components, plus a scene
+    // tree component once their mesh is resident
+    EntityWorld& GetEntities() { return entities; }
+
+    // Every mesh the scene uses; each mesh component holds one reference
+    MeshRegistry& GetMeshes() { return meshes; }
+
+    // Ground under the scene
+    const Terrain& GetTerrain() const { return terrain; }
+
+    // Adds an entity drawing a resident mesh at the position to the scene. The
+    // entity takes over the caller's reference to the mesh.
+    Entity SpawnMesh(MeshHandle mesh, const DirectX::XMFLOAT3& position);
+
+    // The draw programs Initialize creates, for precompiling their shaders
+    static void GetPipelineDescs(std::vector<PipelineDesc>& pipelines);
+
+    // MeshUploadTarget
+    bool UploadMesh(AssetHandle handle, const MeshData& data) override;
+    void OnMeshFailed(AssetHandle handle) override;
 
 private:
-    ID3D11Device* device = nullptr;
-    ID3D11DeviceContext* context = nullptr;
-    IDXGISwapChain* swapChain = nullptr;
-    ID3D11RenderTargetView* renderTargetView = nullptr;
+    RenderBackend* backend = nullptr;
+    int width = 0;
+    int height = 0;
+
+    // Positions, rotations and world matrices of every mesh
+    TransformStore transforms;
+
+    // Instanced drawing
+    InstanceBatch* instanceBatch = nullptr;
+
+    // Shared geometry, and the entities that draw it. Every mesh is a range of
+    // the geometry pool's buffers, so the pool is destroyed after the registry.
+    GeometryPool geometry;
+    MeshRegistry meshes;
+    Entity pyramid = InvalidEntity;
+    Entity icosphere = InvalidEntity;
 
-    ID3D11Buffer* vertexBuffer = nullptr;
-    ID3D11Buffer* indexBuffer = nullptr;
-    ID3D11VertexShader* vertexShader = nullptr;
-    ID3D11PixelShader* pixelShader = nullptr;
-    ID3D11InputLayout* inputLayout = nullptr;
+    // Meshes are created empty and filled in when their data has streamed in;
+    // the entity drawing one joins the scene tree then
+    struct StreamedMesh {
+        MeshHandle mesh;
+        Entity entity;
+        const char* name;
+    };
 
-    ID3D11Buffer* cbPerObjectBuffer = nullptr;
+    AssetStreamer assetStreamer;
+    AssetStreamer::UploadBudget uploadBudget = { 2.0f, 8 * 1024 * 1024 };
+    std::unordered_map<AssetHandle, StreamedMesh> streamedMeshes;
 
-    // Depth buffer components
-    ID3D11Texture2D* depthStencilBuffer = nullptr;
-    ID3D11DepthStencilView* depthStencilView = nullptr;
-    ID3D11DepthStencilState* depthStencilState = nullptr;
+    // Instancing benchmark scene
+    struct InstancingBenchmark {
+        MeshHandle mesh = InvalidMesh;
+        std::vector<DirectX::XMFLOAT3> positions;
+        bool instanced = false;
+        uint32_t frame = 0;
+        double submitMilliseconds = 0.0;
+    } benchmark;
 
-    D3D11_VIEWPORT viewport = {};
+    void DrawInstancingBenchmark(const DirectX::XMMATRIX& viewProjMatrix);
 
-    Mesh* pyramidMesh;
-    Mesh* icosphere;
+    // Ground the scene stands on, drawn after the queued meshes. The terrain
+    // is destroyed first, so its jobs finish before the heightmap goes.
+    Heightmap heightmap;
+    Terrain terrain;
+
+    // Shader programs, numbered for render queue sort keys
+    enum ShaderProgram : uint32_t {
+        DefaultProgram,
+        InstancedProgram,
+        ProgramCount
+    };
+
+    PipelineHandle programs[ProgramCount] = {};
+
+    // Draw records referenced by the render queue's packets
+    struct QueuedDraw {
+        Mesh* mesh;
+        TransformId transform;
+        ShaderProgram program;
+    };
+
+    // Scene entities and the tree their bounds are kept in
+    EntityWorld entities;
+    DynamicAabbTree sceneTree;
+
+    // The entity takes over the caller's reference to the mesh
+    Entity CreateMeshEntity(MeshHandle mesh);
+    TransformId GetTransform(Entity entity) const { return entities.Get<TransformComponent>(entity)->transform; }
+    void AddToScene(Entity entity);
+    void UpdateSceneTree();
+
+    // Per-frame transform updates, culling and draw packet generation run as jobs;
+    // each stage waits for its jobs before the next one starts
+    JobSystem jobs;
+
+    // Lists that only live for a frame; Draw starts a new one
+    FrameArena frameMemory;
+
+    // Scene culling: bounds gathered each frame, what they belong to, indices
+    // of the visible ones. The arrays come from the frame arena.
+    struct SceneObject {
+        Mesh* mesh;
+        TransformId transform;
+    };
+
+    float viewDistance = 150.0f;
+    Frustum frustum = {};
+    BoundingVolumes sceneBounds;
+    SceneObject* sceneObjects = nullptr;
+    size_t sceneObjectCount = 0;
+    uint32_t* visibleObjects = nullptr;
+    size_t visibleCount = 0;
+
+    void CullScene();
+
+    // Software occlusion culling of the frustum culling results
+    OcclusionCuller occlusionCuller;
+    bool occlusionCulling = true;
+
+    void OccludeScene();
+
+    RenderQueue renderQueue;
+    QueuedDraw* queuedDraws = nullptr;
+
+    void QueueVisibleMeshes();
+    void BindProgram(ShaderProgram program);
+
+    // Reports the previous frame's submission counters every few hundred frames
+    void LogSubmissionCounters();
+    uint32_t submissionFrame = 0;
 
     DirectX::XMMATRIX viewMatrix;
     DirectX::XMMATRIX projMatrix;
 
-    struct CBPerObject
-    {
-        DirectX::XMMATRIX world;
-        DirectX::XMMATRIX worldViewProj;
-    } cbPerObject;
+    // Camera position and the LOD selection parameters derived from it
+    DirectX::XMFLOAT3 cameraPosition = DirectX::XMFLOAT3(0.0f, 1.0f, -5.0f);
+    Mesh::LodView lodView = {};
+
+    void UpdateCamera();
+
+    // Simulation state after the latest step and the one before it
+    float angle = 0.0f;
+    float previousAngle = 0.0f;
 };
@@ -0,0 +1,69 @@
+// Hash.cpp
+
+#include "Hash.h"
+#include "MappedFile.h"
+
+#include <cstring>
+
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed) {
+    const uint64_t m = 0xc6a4a7935bd1e995ULL;
+    const int r = 47;
+
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    const unsigned char* end = bytes + (size & ~size_t(7));
+    uint64_t h = seed ^ (size * m);
+
+    while (bytes != end) {
+        uint64_t k;
+        std::memcpy(&k, bytes, sizeof(k));
+        bytes += sizeof(k);
+
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+
+        h ^= k;
+        h *= m;
+    }
+
+    // Remaining tail bytes; each case deliberately falls into the next
+    switch (size & 7) {
+    case 7:
+        h ^= uint64_t(bytes[6]) << 48;
+        // Falls through
+    case 6:
+        h ^= uint64_t(bytes[5]) << 40;
+        // Falls through
+    case 5:
+        h ^= uint64_t(bytes[4]) << 32;
+        // Falls through
+    case 4:
+        h ^= uint64_t(bytes[3]) << 24;
+        // Falls through
+    case 3:
+        h ^= uint64_t(bytes[2]) << 16;
+        // Falls through
+    case 2:
+        h ^= uint64_t(bytes[1]) << 8;
+        // Falls through
+    case 1:
+        h ^= uint64_t(bytes[0]);
+        h *= m;
+    }
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+}
+
+bool HashFile(const std::string& filename, uint64_t& hash, uint64_t& size) {
+    MappedFile file;
+    if (!file.Open(filename)) {
+        return false;
+    }
+
+    hash = HashBytes(file.GetData(), file.GetSize());
+    size = file.GetSize();
+    return true;
+}
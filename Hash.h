@@ -0,0 +1,13 @@
+// Hash.h
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// 64-bit non-cryptographic content hash (MurmurHash64A). Used to detect
+// stale cached data, not for security.
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed = 0);
+
+// Hashes the full contents of a file. Returns false if it cannot be read.
+bool HashFile(const std::string& filename, uint64_t& hash, uint64_t& size);
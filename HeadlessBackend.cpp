@@ -0,0 +1,435 @@
+// HeadlessBackend.cpp
+
+#include "HeadlessBackend.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+    // Matches the D3D11 backend's render context
+    const uint32_t RingBytes = 4 * 1024 * 1024;
+
+    // Any value works, every draw is a triangle list
+    const uintptr_t TriangleListTopology = 4;
+
+    // Row-major 4x4 product for row vectors: p * a * b
+    void Multiply(const float a[16], const float b[16], float result[16]) {
+        for (int row = 0; row < 4; ++row) {
+            for (int column = 0; column < 4; ++column) {
+                result[row * 4 + column] =
+                    a[row * 4 + 0] * b[0 * 4 + column] +
+                    a[row * 4 + 1] * b[1 * 4 + column] +
+                    a[row * 4 + 2] * b[2 * 4 + column] +
+                    a[row * 4 + 3] * b[3 * 4 + column];
+            }
+        }
+    }
+
+    // Constants hold matrices transposed for the shader's column-major packing
+    void Transpose(const float source[16], float result[16]) {
+        for (int row = 0; row < 4; ++row) {
+            for (int column = 0; column < 4; ++column) {
+                result[row * 4 + column] = source[column * 4 + row];
+            }
+        }
+    }
+
+    uint32_t PackColor(float r, float g, float b) {
+        auto channel = [](float value) {
+            return static_cast<uint32_t>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+        };
+        return channel(r) | (channel(g) << 8) | (channel(b) << 16) | (255u << 24);
+    }
+
+}
+
+HeadlessBackend::HeadlessBackend()
+    : ring(RingBytes), pipeline(InvalidPipeline), vertexBuffers(), indexBuffer(InvalidBuffer),
+    indexFormat(IndexFormat::UInt32), constants(), rasterize(false), width(0), height(0),
+    draws(0), instances(0), triangles(0), bufferBytes(0), lastFrame(), presentCount(0), maxFrameLatency(3)
+{
+}
+
+bool HeadlessBackend::Initialize(int width, int height, bool rasterize) {
+    if (width <= 0 || height <= 0) {
+        return false;
+    }
+
+    this->width = width;
+    this->height = height;
+    this->rasterize = rasterize;
+    if (rasterize) {
+        colorBuffer.assign(static_cast<size_t>(width) * height, 0);
+        depthBuffer.assign(static_cast<size_t>(width) * height, 1.0f);
+    }
+    stateCache.Invalidate();
+    return true;
+}
+
+PipelineHandle HeadlessBackend::CreatePipeline(const PipelineDesc& desc) {
+    if (!desc.vertexFormat || !desc.vertexShaderFile || !desc.pixelShaderFile) {
+        return InvalidPipeline;
+    }
+
+    // Pipelines sharing a pixel shader bind it once, as they do on the device
+    auto shader = std::find(pixelShaderFiles.begin(), pixelShaderFiles.end(), desc.pixelShaderFile);
+    if (shader == pixelShaderFiles.end()) {
+        shader = pixelShaderFiles.insert(pixelShaderFiles.end(), desc.pixelShaderFile);
+    }
+
+    Pipeline created = { *desc.vertexFormat, desc.instanced, static_cast<uint32_t>(shader - pixelShaderFiles.begin()) };
+    pipelines.push_back(created);
+    return static_cast<PipelineHandle>(pipelines.size());
+}
+
+BufferHandle HeadlessBackend::CreateBuffer(BufferUsage, const void* data, uint32_t size) {
+    Buffer buffer;
+    buffer.size = size;
+    buffer.live = true;
+    if (rasterize) {
+        buffer.data.resize(size);
+        if (data) {
+            std::memcpy(buffer.data.data(), data, size);
+        }
+    }
+    if (data) {
+        bufferBytes += size;
+    }
+
+    if (!freeBuffers.empty()) {
+        BufferHandle handle = freeBuffers.back();
+        freeBuffers.pop_back();
+        buffers[handle - 1] = std::move(buffer);
+        return handle;
+    }
+    buffers.push_back(std::move(buffer));
+    return static_cast<BufferHandle>(buffers.size());
+}
+
+void HeadlessBackend::DestroyBuffer(BufferHandle buffer) {
+    if (GetBuffer(buffer)) {
+        buffers[buffer - 1] = Buffer();
+        freeBuffers.push_back(buffer);
+    }
+}
+
+const HeadlessBackend::Buffer* HeadlessBackend::GetBuffer(BufferHandle buffer) const {
+    if (buffer == InvalidBuffer || buffer > buffers.size() || !buffers[buffer - 1].live) {
+        return nullptr;
+    }
+    return &buffers[buffer - 1];
+}
+
+bool HeadlessBackend::UpdateBuffer(BufferHandle buffer, const void* data, uint32_t size) {
+    const Buffer* target = GetBuffer(buffer);
+    if (!target || size > target->size) {
+        return false;
+    }
+
+    if (rasterize) {
+        std::memcpy(buffers[buffer - 1].data.data(), data, size);
+    }
+    bufferBytes += size;
+    return true;
+}
+
+bool HeadlessBackend::WriteBuffer(BufferHandle buffer, uint32_t offset, const void* data, uint32_t size) {
+    const Buffer* target = GetBuffer(buffer);
+    if (!target || offset > target->size || size > target->size - offset) {
+        return false;
+    }
+
+    if (rasterize) {
+        std::memcpy(buffers[buffer - 1].data.data() + offset, data, size);
+    }
+    bufferBytes += size;
+    return true;
+}
+
+bool HeadlessBackend::CopyBuffer(BufferHandle dest, uint32_t destOffset, BufferHandle source, uint32_t sourceOffset, uint32_t size) {
+    const Buffer* target = GetBuffer(dest);
+    const Buffer* from = GetBuffer(source);
+    if (!target || !from || dest == source || destOffset > target->size || size > target->size - destOffset ||
+        sourceOffset > from->size || size > from->size - sourceOffset) {
+        return false;
+    }
+
+    if (rasterize) {
+        std::memcpy(buffers[dest - 1].data.data() + destOffset, from->data.data() + sourceOffset, size);
+    }
+    return true;
+}
+
+bool HeadlessBackend::ReadBuffer(BufferHandle buffer, uint32_t offset, void* data, uint32_t size) const {
+    const Buffer* source = GetBuffer(buffer);
+    if (!rasterize || !source || offset > source->size || size > source->size - offset) {
+        return false;
+    }
+    std::memcpy(data, source->data.data() + offset, size);
+    return true;
+}
+
+void HeadlessBackend::BeginFrame(const float clearColor[4]) {
+    lastFrame.states = stateCache.GetCounters();
+    lastFrame.constants = ring.GetCounters();
+    lastFrame.draws = draws;
+    lastFrame.instances = instances;
+    lastFrame.triangles = triangles;
+    lastFrame.bufferBytes = bufferBytes;
+
+    stateCache.ResetCounters();
+    ring.ResetCounters();
+    draws = 0;
+    instances = 0;
+    triangles = 0;
+    bufferBytes = 0;
+
+    if (rasterize) {
+        std::fill(colorBuffer.begin(), colorBuffer.end(), PackColor(clearColor[0], clearColor[1], clearColor[2]));
+        std::fill(depthBuffer.begin(), depthBuffer.end(), 1.0f);
+    }
+}
+
+void HeadlessBackend::SetPipeline(PipelineHandle handle) {
+    if (handle == InvalidPipeline || handle > pipelines.size()) {
+        return;
+    }
+
+    // Each pipeline has its own input layout and vertex shader
+    pipeline = handle;
+    stateCache.Update(RenderStateCache::InputLayout, handle);
+    stateCache.Update(RenderStateCache::VertexShader, handle);
+    stateCache.Update(RenderStateCache::PixelShader, pipelines[handle - 1].pixelShader);
+}
+
+void HeadlessBackend::SetVertexBuffer(uint32_t slot, BufferHandle buffer, uint32_t stride) {
+    if (slot > 1) {
+        return;
+    }
+
+    RenderStateCache::State state = static_cast<RenderStateCache::State>(RenderStateCache::VertexBuffer0 + slot);
+    stateCache.Update(state, buffer, stride, 0);
+    vertexBuffers[slot].buffer = buffer;
+    vertexBuffers[slot].stride = stride;
+}
+
+void HeadlessBackend::SetIndexBuffer(BufferHandle buffer, IndexFormat format) {
+    stateCache.Update(RenderStateCache::IndexBuffer, buffer, static_cast<uintptr_t>(format), 0);
+    indexBuffer = buffer;
+    indexFormat = format;
+}
+
+bool HeadlessBackend::SetVSConstants(const void* data, uint32_t size) {
+    ConstantRingAllocator::Allocation allocation;
+    if (!ring.Allocate(size, allocation)) {
+        return false;
+    }
+
+    std::memset(constants, 0, sizeof(constants));
+    std::memcpy(constants, data, std::min<size_t>(size, sizeof(constants)));
+
+    // Same binding as the ring buffer gets on the device: one buffer at a moving offset
+    stateCache.Update(RenderStateCache::VSConstantBuffer0, 1, allocation.offset / 16, allocation.size / 16);
+    return true;
+}
+
+void HeadlessBackend::DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) {
+    stateCache.Update(RenderStateCache::PrimitiveTopology, TriangleListTopology);
+    ++draws;
+    instances += 1;
+    triangles += indexCount / 3;
+
+    if (rasterize && pipeline != InvalidPipeline && !pipelines[pipeline - 1].instanced) {
+        float worldViewProj[16];
+        Transpose(constants, worldViewProj);
+        RasterizeRange(worldViewProj, indexCount, startIndex, baseVertex);
+    }
+}
+
+void HeadlessBackend::DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex) {
+    stateCache.Update(RenderStateCache::PrimitiveTopology, TriangleListTopology);
+    ++draws;
+    instances += instanceCount;
+    triangles += static_cast<uint64_t>(indexCount / 3) * instanceCount;
+
+    const Buffer* instanceData = GetBuffer(vertexBuffers[1].buffer);
+    if (!rasterize || pipeline == InvalidPipeline || !pipelines[pipeline - 1].instanced || !instanceData) {
+        return;
+    }
+
+    // Dequantize, then the instance's world matrix, then view-projection
+    float viewProj[16];
+    float meshTransform[16];
+    Transpose(constants, viewProj);
+    Transpose(constants + 16, meshTransform);
+
+    uint32_t stride = std::max<uint32_t>(vertexBuffers[1].stride, 16 * sizeof(float));
+    for (uint32_t instance = 0; instance < instanceCount; ++instance) {
+        if (static_cast<uint64_t>(instance + 1) * stride > instanceData->size) {
+            break;
+        }
+        float world[16];
+        std::memcpy(world, instanceData->data.data() + static_cast<size_t>(instance) * stride, sizeof(world));
+
+        float meshWorld[16];
+        float matrix[16];
+        Multiply(meshTransform, world, meshWorld);
+        Multiply(meshWorld, viewProj, matrix);
+        RasterizeRange(matrix, indexCount, startIndex, baseVertex);
+    }
+}
+
+void HeadlessBackend::RasterizeRange(const float matrix[16], uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) {
+    const Buffer* vertices = GetBuffer(vertexBuffers[0].buffer);
+    const Buffer* indices = GetBuffer(indexBuffer);
+    if (!vertices || !indices) {
+        return;
+    }
+
+    const VertexElement* position = pipelines[pipeline - 1].vertexFormat.Find(VertexSemantic::Position);
+    if (!position || (position->encoding != VertexEncoding::UNorm16x4 && position->encoding != VertexEncoding::Float3)) {
+        return;
+    }
+
+    uint32_t indexSize = (indexFormat == IndexFormat::UInt16) ? sizeof(uint16_t) : sizeof(uint32_t);
+    if (static_cast<uint64_t>(startIndex + indexCount) * indexSize > indices->size) {
+        return;
+    }
+
+    uint32_t stride = vertexBuffers[0].stride;
+    uint32_t vertexCount = (stride > 0) ? vertices->size / stride : 0;
+    const unsigned char* indexData = indices->data.data() + static_cast<size_t>(startIndex) * indexSize;
+
+    for (uint32_t i = 0; i + 2 < indexCount; i += 3) {
+        float clip[3][4];
+        bool valid = true;
+        for (int corner = 0; corner < 3; ++corner) {
+            uint32_t index = 0;
+            if (indexSize == sizeof(uint16_t)) {
+                uint16_t shortIndex;
+                std::memcpy(&shortIndex, indexData + (i + corner) * indexSize, sizeof(shortIndex));
+                index = shortIndex;
+            }
+            else {
+                std::memcpy(&index, indexData + (i + corner) * indexSize, sizeof(index));
+            }
+            index += static_cast<uint32_t>(baseVertex);
+            if (index >= vertexCount) {
+                valid = false;
+                break;
+            }
+
+            // The input assembler hands the shader a float3 either way
+            const unsigned char* source = vertices->data.data() + static_cast<size_t>(index) * stride + position->offset;
+            float p[3];
+            if (position->encoding == VertexEncoding::UNorm16x4) {
+                uint16_t quantized[3];
+                std::memcpy(quantized, source, sizeof(quantized));
+                for (int axis = 0; axis < 3; ++axis) {
+                    p[axis] = quantized[axis] / 65535.0f;
+                }
+            }
+            else {
+                std::memcpy(p, source, sizeof(p));
+            }
+
+            for (int column = 0; column < 4; ++column) {
+                clip[corner][column] = p[0] * matrix[column] + p[1] * matrix[4 + column] +
+                    p[2] * matrix[8 + column] + matrix[12 + column];
+            }
+        }
+
+        if (valid) {
+            RasterizeTriangle(clip);
+        }
+    }
+}
+
+void HeadlessBackend::RasterizeTriangle(const float clip[3][4]) {
+    float x[3], y[3], z[3], color[3][3];
+    for (int corner = 0; corner < 3; ++corner) {
+        // Anything crossing the near plane is dropped instead of clipped
+        if (clip[corner][3] <= 1e-6f || clip[corner][2] < 0.0f) {
+            return;
+        }
+
+        float inverseW = 1.0f / clip[corner][3];
+        x[corner] = (clip[corner][0] * inverseW * 0.5f + 0.5f) * width;
+        y[corner] = (0.5f - clip[corner][1] * inverseW * 0.5f) * height;
+        z[corner] = clip[corner][2] * inverseW;
+
+        // What the vertex shaders output as color
+        for (int channel = 0; channel < 3; ++channel) {
+            color[corner][channel] = (clip[corner][channel] + 1.0f) * 0.5f;
+        }
+    }
+
+    // Clockwise triangles on screen face the camera; the rest are culled like the default rasterizer state
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (area <= 0.0f) {
+        return;
+    }
+    float inverseArea = 1.0f / area;
+
+    int minX = std::max(0, static_cast<int>(std::floor(std::min(x[0], std::min(x[1], x[2])))));
+    int maxX = std::min(width - 1, static_cast<int>(std::ceil(std::max(x[0], std::max(x[1], x[2])))));
+    int minY = std::max(0, static_cast<int>(std::floor(std::min(y[0], std::min(y[1], y[2])))));
+    int maxY = std::min(height - 1, static_cast<int>(std::ceil(std::max(y[0], std::max(y[1], y[2])))));
+
+    for (int py = minY; py <= maxY; ++py) {
+        float sampleY = py + 0.5f;
+        for (int px = minX; px <= maxX; ++px) {
+            float sampleX = px + 0.5f;
+
+            // Barycentric weights from the edge functions
+            float w0 = ((x[2] - x[1]) * (sampleY - y[1]) - (y[2] - y[1]) * (sampleX - x[1])) * inverseArea;
+            float w1 = ((x[0] - x[2]) * (sampleY - y[2]) - (y[0] - y[2]) * (sampleX - x[2])) * inverseArea;
+            float w2 = 1.0f - w0 - w1;
+            if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) {
+                continue;
+            }
+
+            float depth = w0 * z[0] + w1 * z[1] + w2 * z[2];
+            size_t pixel = static_cast<size_t>(py) * width + px;
+            if (depth > 1.0f || depth >= depthBuffer[pixel]) {
+                continue;
+            }
+
+            depthBuffer[pixel] = depth;
+            colorBuffer[pixel] = PackColor(
+                w0 * color[0][0] + w1 * color[1][0] + w2 * color[2][0],
+                w0 * color[0][1] + w1 * color[1][1] + w2 * color[2][1],
+                w0 * color[0][2] + w1 * color[1][2] + w2 * color[2][2]);
+        }
+    }
+}
+
+bool HeadlessBackend::WriteImage(const char* filename) const {
+    if (colorBuffer.empty()) {
+        return false;
+    }
+
+    FILE* file = std::fopen(filename, "wb");
+    if (!file) {
+        return false;
+    }
+
+    std::fprintf(file, "P6\n%d %d\n255\n", width, height);
+    std::vector<unsigned char> row(static_cast<size_t>(width) * 3);
+    for (int py = 0; py < height; ++py) {
+        for (int px = 0; px < width; ++px) {
+            uint32_t pixel = colorBuffer[static_cast<size_t>(py) * width + px];
+            row[px * 3 + 0] = static_cast<unsigned char>(pixel & 0xff);
+            row[px * 3 + 1] = static_cast<unsigned char>((pixel >> 8) & 0xff);
+            row[px * 3 + 2] = static_cast<unsigned char>((pixel >> 16) & 0xff);
+        }
+        std::fwrite(row.data(), 1, row.size(), file);
+    }
+
+    bool written = std::ferror(file) == 0;
+    std::fclose(file);
+    return written;
+}
@@ -0,0 +1,118 @@
+// HeadlessBackend.h
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "RenderBackend.h"
+
+// Render backend without a device or window, for running the frame loop in
+// benchmarks and on machines without D3D11. Binds and constants go through
+// the same state cache and ring allocator as the D3D11 path, so the stats
+// match what a GPU frame would submit.
+//
+// With rasterization on, draws are also transformed and rasterized into an
+// in-memory color and depth buffer. Vertex processing is fixed to what the
+// engine's vertex shaders do: slot 0 constants start with the transposed
+// world-view-projection (or view-projection and dequantization for instanced
+// pipelines), and the color is the clip-space position mapped to 0..1.
+// Triangles crossing the near plane are dropped rather than clipped.
+class HeadlessBackend : public RenderBackend {
+public:
+    HeadlessBackend();
+
+    bool Initialize(int width, int height, bool rasterize = false);
+
+    PipelineHandle CreatePipeline(const PipelineDesc& desc) override;
+    BufferHandle CreateBuffer(BufferUsage usage, const void* data, uint32_t size) override;
+    void DestroyBuffer(BufferHandle buffer) override;
+    bool UpdateBuffer(BufferHandle buffer, const void* data, uint32_t size) override;
+    bool WriteBuffer(BufferHandle buffer, uint32_t offset, const void* data, uint32_t size) override;
+    bool CopyBuffer(BufferHandle dest, uint32_t destOffset, BufferHandle source, uint32_t sourceOffset, uint32_t size) override;
+
+    void BeginFrame(const float clearColor[4]) override;
+    void Present() override { ++presentCount; }
+    void SetMaxFrameLatency(uint32_t frames) override { maxFrameLatency = frames; }
+
+    void SetPipeline(PipelineHandle pipeline) override;
+    void SetVertexBuffer(uint32_t slot, BufferHandle buffer, uint32_t stride) override;
+    void SetIndexBuffer(BufferHandle buffer, IndexFormat format) override;
+    bool SetVSConstants(const void* data, uint32_t size) override;
+
+    void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) override;
+    void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex) override;
+
+    const RenderStats& GetLastFrameStats() const override { return lastFrame; }
+
+    uint32_t GetPresentCount() const { return presentCount; }
+    uint32_t GetMaxFrameLatency() const { return maxFrameLatency; }
+    int GetWidth() const { return width; }
+    int GetHeight() const { return height; }
+
+    // Buffers created and not yet destroyed
+    uint32_t GetBufferCount() const { return static_cast<uint32_t>(buffers.size() - freeBuffers.size()); }
+
+    // Copies buffer contents out, which are only kept when rasterizing
+    bool ReadBuffer(BufferHandle buffer, uint32_t offset, void* data, uint32_t size) const;
+
+    // RGBA8 pixels, top row first. Empty without rasterization.
+    const std::vector<uint32_t>& GetColorBuffer() const { return colorBuffer; }
+
+    // Writes the color buffer as a binary PPM
+    bool WriteImage(const char* filename) const;
+
+private:
+    struct Pipeline {
+        VertexFormat vertexFormat;
+        bool instanced;
+        uint32_t pixelShader;       // Index into pixelShaderFiles
+    };
+
+    struct Buffer {
+        std::vector<unsigned char> data;    // Only kept when rasterizing
+        uint32_t size;
+        bool live;
+    };
+
+    struct VertexBinding {
+        BufferHandle buffer;
+        uint32_t stride;
+    };
+
+    const Buffer* GetBuffer(BufferHandle buffer) const;
+
+    // Runs the fixed vertex transform over the indexed range and rasterizes it.
+    // The matrix is row-major for row vectors and maps slot 0 positions to clip space.
+    void RasterizeRange(const float matrix[16], uint32_t indexCount, uint32_t startIndex, int32_t baseVertex);
+    void RasterizeTriangle(const float clip[3][4]);
+
+    RenderStateCache stateCache;
+    ConstantRingAllocator ring;
+
+    std::vector<Pipeline> pipelines;            // Indexed by handle - 1
+    std::vector<Buffer> buffers;                // Indexed by handle - 1
+    std::vector<BufferHandle> freeBuffers;
+    std::vector<std::wstring> pixelShaderFiles;
+
+    // Bound state
+    PipelineHandle pipeline;
+    VertexBinding vertexBuffers[2];
+    BufferHandle indexBuffer;
+    IndexFormat indexFormat;
+    float constants[32];                        // The two matrices at the start of slot 0
+
+    // Framebuffer
+    bool rasterize;
+    int width;
+    int height;
+    std::vector<uint32_t> colorBuffer;
+    std::vector<float> depthBuffer;
+
+    uint32_t draws;
+    uint32_t instances;
+    uint64_t triangles;
+    uint64_t bufferBytes;
+    RenderStats lastFrame;
+    uint32_t presentCount;
+    uint32_t maxFrameLatency;
+};
@@ -0,0 +1,119 @@
+// HeadlessBenchmark.cpp
+
+#include "HeadlessBenchmark.h"
+#include "Graphics.h"
+#include "HeadlessBackend.h"
+#include "Log.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+namespace {
+
+    // Fixed step so every run animates the same frames
+    const float FrameSeconds = 1.0f / 60.0f;
+
+    void Accumulate(const RenderStats& stats, HeadlessBenchmark::Result& result) {
+        result.draws += stats.draws;
+        result.instances += stats.instances;
+        result.triangles += static_cast<double>(stats.triangles);
+        result.stateChanges += stats.states.TotalIssued();
+        result.stateChangesElided += stats.states.TotalElided();
+        result.bytesUploaded += static_cast<double>(stats.bufferBytes + stats.constants.bytes);
+    }
+
+}
+
+bool HeadlessBenchmark::Run(const Options& options, Result& result) {
+    result = Result();
+
+    HeadlessBackend backend;
+    if (!backend.Initialize(options.width, options.height, options.rasterize)) {
+        return false;
+    }
+
+    // Scoped so the meshes are released before the backend
+    {
+        Graphics graphics;
+        if (!graphics.Initialize(&backend, options.width, options.height)) {
+            return false;
+        }
+        if (options.instancingCopies > 0) {
+            graphics.EnableInstancingBenchmark(options.instancingCopies);
+        }
+
+        // Let the streamed meshes become resident so every measured frame draws the same scene
+        while (graphics.IsStreaming()) {
+            graphics.ProcessStreaming();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        // One unmeasured frame, so the first measured one starts with warm state
+        graphics.Update(FrameSeconds);
+        graphics.Draw();
+        graphics.Present();
+
+        if (options.traceFile) {
+            BOG_PROFILE_THREAD("Main");
+            Profiler::BeginCapture();
+        }
+
+        for (uint32_t frame = 0; frame < options.frames; ++frame) {
+            BOG_PROFILE_FRAME();
+            auto start = std::chrono::steady_clock::now();
+            graphics.ProcessStreaming();
+            graphics.Update(FrameSeconds);
+            graphics.Draw();
+            graphics.Present();
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+            result.cpuMilliseconds += elapsed.count();
+            result.maxCpuMilliseconds = std::max(result.maxCpuMilliseconds, elapsed.count());
+
+            // Draw starts a new frame of stats, so these belong to the frame before
+            if (frame > 0) {
+                Accumulate(backend.GetLastFrameStats(), result);
+            }
+        }
+
+        if (options.traceFile) {
+            Profiler::EndCapture();
+            if (!Profiler::WriteChromeTrace(options.traceFile)) {
+                LogMessage("Failed to write the profile to %s\n", options.traceFile);
+            }
+        }
+
+        if (options.rasterize && options.imageFile) {
+            backend.WriteImage(options.imageFile);
+        }
+
+        // Closes the last frame's stats
+        const float clearColor[4] = {};
+        backend.BeginFrame(clearColor);
+        if (options.frames > 0) {
+            Accumulate(backend.GetLastFrameStats(), result);
+        }
+    }
+
+    result.frames = options.frames;
+    if (result.frames > 0) {
+        double frames = static_cast<double>(result.frames);
+        result.cpuMilliseconds /= frames;
+        result.draws /= frames;
+        result.instances /= frames;
+        result.triangles /= frames;
+        result.stateChanges /= frames;
+        result.stateChangesElided /= frames;
+        result.bytesUploaded /= frames;
+    }
+    return true;
+}
+
+void HeadlessBenchmark::LogResult(const Result& result) {
+    LogMessage("Headless benchmark: %u frames, %.3f ms CPU per frame (max %.3f), %.1f draws (%.1f instances, %.0f triangles), "
+        "%.1f state changes (%.1f elided), %.0f bytes uploaded per frame\n",
+        result.frames, result.cpuMilliseconds, result.maxCpuMilliseconds, result.draws, result.instances, result.triangles,
+        result.stateChanges, result.stateChangesElided, result.bytesUploaded);
+}
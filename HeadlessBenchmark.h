@@ -0,0 +1,40 @@
+// HeadlessBenchmark.h
+
+#pragma once
+#include <cstdint>
+
+// Runs the normal Graphics Update/Draw path against a HeadlessBackend for a
+// fixed number of frames and reports CPU frame time and submission stats.
+// Needs no window or device, so the portable BogHeadless build of
+// CMakeLists.txt runs it as well as the Windows one.
+class HeadlessBenchmark {
+public:
+    struct Options {
+        uint32_t frames = 600;
+        int width = 800;
+        int height = 600;
+        bool rasterize = false;             // Also draw into the in-memory framebuffer
+        const char* imageFile = nullptr;    // Last frame as PPM, needs rasterize
+        uint32_t instancingCopies = 0;      // Adds Graphics' instancing benchmark grid
+        const char* traceFile = nullptr;    // Profile of the measured frames as a Chrome trace
+    };
+
+    // Per-frame averages over the measured frames
+    struct Result {
+        uint32_t frames;
+        double cpuMilliseconds;
+        double maxCpuMilliseconds;
+        double draws;
+        double instances;
+        double triangles;
+        double stateChanges;
+        double stateChangesElided;
+        double bytesUploaded;
+    };
+
+    // Waits for streaming to finish before the measured frames. False when
+    // Graphics fails to initialize.
+    static bool Run(const Options& options, Result& result);
+
+    static void LogResult(const Result& result);
+};
@@ -0,0 +1,19 @@
+// HeadlessMain.cpp
+
+#include "CommandLine.h"
+#include "HeadlessModes.h"
+#include "Log.h"
+
+// Entry point of the portable BogHeadless build, which leaves out the window
+// and the D3D11 backend: BogHeadless -<mode> [count]. The Windows build
+// starts in main.cpp instead and does not compile this file.
+int main(int argc, char** argv) {
+    CommandLine commandLine(argc, argv);
+    int result = RunHeadlessMode(commandLine);
+    if (result < 0) {
+        LogMessage("Usage: BogHeadless -<mode> [count], where the modes are:\n");
+        LogHeadlessModes();
+        return 1;
+    }
+    return result;
+}
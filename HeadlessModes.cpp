@@ -0,0 +1,84 @@
+// HeadlessModes.cpp
+
+#include "HeadlessModes.h"
+#include "Log.h"
+#include "Mesh.h"
+
+#include <string>
+
+namespace {
+    struct Mode {
+        const char* name;
+        int (*run)(const CommandLine& commandLine);
+    };
+
+    const Mode Modes[] = {
+        { "-bake", RunBakeCommand },
+        { "-obj-parse-benchmark", RunObjParseBenchmark },
+        { "-mesh-cache-benchmark", RunMeshCacheBenchmark },
+        { "-obj-scaling-benchmark", RunObjScalingBenchmark },
+        { "-mesh-optimize-test", RunMeshOptimizeTest },
+        { "-lod-test", RunLodTest },
+        { "-vertex-quantization-test", RunVertexQuantizationTest },
+        { "-asset-streamer-test", RunAssetStreamerTest },
+        { "-mesh-registry-test", RunMeshRegistryTest },
+        { "-offset-allocator-test", RunOffsetAllocatorTest },
+        { "-geometry-pool-benchmark", RunGeometryPoolBenchmark },
+        { "-draw-submission-test", RunDrawSubmissionTest },
+        { "-render-queue-benchmark", RunRenderQueueBenchmark },
+        { "-culling-benchmark", RunCullingBenchmark },
+        { "-aabb-tree-benchmark", RunAabbTreeBenchmark },
+        { "-occlusion-benchmark", RunOcclusionBenchmark },
+        { "-shader-cache-test", RunShaderCacheTest },
+        { "-terrain-benchmark", RunTerrainBenchmark },
+        { "-headless-benchmark", RunHeadlessBenchmark },
+        { "-headless-raster-benchmark", RunHeadlessRasterBenchmark },
+        { "-job-scaling-benchmark", RunJobScalingBenchmark },
+        { "-job-deque-benchmark", RunJobDequeBenchmark },
+        { "-transform-benchmark", RunTransformBenchmark },
+        { "-ecs-benchmark", RunEntityBenchmark },
+        { "-frame-pacing-test", RunFramePacingTest },
+        { "-frame-memory-test", RunFrameMemoryTest },
+        { "-profiler-benchmark", RunProfilerBenchmark },
+    };
+}
+
+int RunHeadlessMode(const CommandLine& commandLine) {
+    for (const Mode& mode : Modes) {
+        if (commandLine.IsCommand(mode.name)) {
+            return mode.run(commandLine);
+        }
+    }
+    return -1;
+}
+
+void LogHeadlessModes() {
+    for (const Mode& mode : Modes) {
+        LogMessage("  %s\n", mode.name);
+    }
+}
+
+uint32_t ParseInstancingBenchmark(const CommandLine& commandLine) {
+    return static_cast<uint32_t>(commandLine.GetOption("-instancing-benchmark", 10000));
+}
+
+uint32_t ParseProfileTrace(const CommandLine& commandLine) {
+    return static_cast<uint32_t>(commandLine.GetOption("-profile-trace", 300));
+}
+
+// Offline bake step: BogEngine.exe -bake input.obj [output.bogmesh]
+int RunBakeCommand(const CommandLine& commandLine) {
+    std::string sourceFile = commandLine.GetArgument(0);
+    if (sourceFile.empty()) {
+        LogMessage("Usage: BogEngine.exe -bake input.obj [output.bogmesh]\n");
+        return 1;
+    }
+
+    std::string bakedFile = commandLine.GetArgument(1);
+    if (bakedFile.empty()) {
+        size_t extension = sourceFile.find_last_of('.');
+        bakedFile = sourceFile.substr(0, extension) + ".bogmesh";
+    }
+
+    return Mesh::BakeOBJFile(sourceFile, bakedFile) ? 0 : 1;
+}
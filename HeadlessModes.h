@@ -0,0 +1,60 @@
+// HeadlessModes.h
+
+#pragma once
+#include <cstdint>
+#include "CommandLine.h"
+
+// Command-line modes that need no window or device: the offline mesh bake
+// and the tests and benchmarks, BogEngine.exe -<mode> [count]. Both the
+// Windows build and the portable BogHeadless build run them. Each mode
+// returns the process exit code.
+
+// Runs the mode the command line names. Returns -1 when it names none.
+int RunHeadlessMode(const CommandLine& commandLine);
+
+// Logs every mode's switch, for usage messages
+void LogHeadlessModes();
+
+// BogEngine.exe -instancing-benchmark [instances]
+// Returns the number of benchmark instances, 0 when the switch is absent.
+uint32_t ParseInstancingBenchmark(const CommandLine& commandLine);
+
+// BogEngine.exe -profile-trace [frames]
+// Returns the number of frames to profile, 0 when the switch is absent.
+// The trace is empty unless the build defines BOG_PROFILING=1.
+uint32_t ParseProfileTrace(const CommandLine& commandLine);
+
+// HeadlessModes.cpp
+int RunBakeCommand(const CommandLine& commandLine);
+
+// MeshModes.cpp
+int RunObjParseBenchmark(const CommandLine& commandLine);
+int RunMeshCacheBenchmark(const CommandLine& commandLine);
+int RunObjScalingBenchmark(const CommandLine& commandLine);
+int RunMeshOptimizeTest(const CommandLine& commandLine);
+int RunLodTest(const CommandLine& commandLine);
+int RunVertexQuantizationTest(const CommandLine& commandLine);
+int RunAssetStreamerTest(const CommandLine& commandLine);
+int RunMeshRegistryTest(const CommandLine& commandLine);
+int RunOffsetAllocatorTest(const CommandLine& commandLine);
+int RunGeometryPoolBenchmark(const CommandLine& commandLine);
+
+// RenderModes.cpp
+int RunDrawSubmissionTest(const CommandLine& commandLine);
+int RunRenderQueueBenchmark(const CommandLine& commandLine);
+int RunCullingBenchmark(const CommandLine& commandLine);
+int RunAabbTreeBenchmark(const CommandLine& commandLine);
+int RunOcclusionBenchmark(const CommandLine& commandLine);
+int RunShaderCacheTest(const CommandLine& commandLine);
+int RunTerrainBenchmark(const CommandLine& commandLine);
+int RunHeadlessBenchmark(const CommandLine& commandLine);
+int RunHeadlessRasterBenchmark(const CommandLine& commandLine);
+
+// CoreModes.cpp
+int RunJobScalingBenchmark(const CommandLine& commandLine);
+int RunJobDequeBenchmark(const CommandLine& commandLine);
+int RunTransformBenchmark(const CommandLine& commandLine);
+int RunEntityBenchmark(const CommandLine& commandLine);
+int RunFramePacingTest(const CommandLine& commandLine);
+int RunFrameMemoryTest(const CommandLine& commandLine);
+int RunProfilerBenchmark(const CommandLine& commandLine);
@@ -0,0 +1,161 @@
+// Heightmap.cpp
+
+#include "Heightmap.h"
+#include "Log.h"
+#include "MappedFile.h"
+#include "MemoryTracker.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+    const float SampleSteps = 65535.0f;
+
+    // Lattice value in [0, 1] for a grid point of one octave
+    float LatticeValue(int32_t x, int32_t z, uint32_t seed) {
+        uint32_t hash = static_cast<uint32_t>(x) * 0x8da6b343u ^ static_cast<uint32_t>(z) * 0xd8163841u ^ seed * 0xcb1ab31fu;
+        hash ^= hash >> 13;
+        hash *= 0x5bd1e995u;
+        hash ^= hash >> 15;
+        return static_cast<float>(hash & 0xffffff) / static_cast<float>(0xffffff);
+    }
+
+    // Lattice values blended with a smoothstep, so slopes stay continuous across cells
+    float ValueNoise(float x, float z, uint32_t seed) {
+        float cellX = std::floor(x);
+        float cellZ = std::floor(z);
+        int32_t x0 = static_cast<int32_t>(cellX);
+        int32_t z0 = static_cast<int32_t>(cellZ);
+        float u = x - cellX;
+        float v = z - cellZ;
+        u = u * u * (3.0f - 2.0f * u);
+        v = v * v * (3.0f - 2.0f * v);
+
+        float nearRow = LatticeValue(x0, z0, seed) + (LatticeValue(x0 + 1, z0, seed) - LatticeValue(x0, z0, seed)) * u;
+        float farRow = LatticeValue(x0, z0 + 1, seed) + (LatticeValue(x0 + 1, z0 + 1, seed) - LatticeValue(x0, z0 + 1, seed)) * u;
+        return nearRow + (farRow - nearRow) * v;
+    }
+
+}
+
+Heightmap::Heightmap()
+    : width(0), depth(0), spacing(1.0f), minHeight(0.0f), maxHeight(0.0f), sampleScale(0.0f)
+{
+}
+
+void Heightmap::SetRange(uint32_t width, uint32_t depth, float spacing, float minHeight, float maxHeight) {
+    this->width = width;
+    this->depth = depth;
+    this->spacing = spacing;
+    this->minHeight = minHeight;
+    this->maxHeight = maxHeight;
+    sampleScale = (maxHeight - minHeight) / SampleSteps;
+    samples.assign(size_t(width) * depth, 0);
+}
+
+bool Heightmap::Initialize(uint32_t width, uint32_t depth, const float* heights, float spacing) {
+    if (width < 2 || depth < 2 || !(spacing > 0.0f)) {
+        LogMessage("Heightmap must be at least 2x2 samples with a positive spacing\n");
+        return false;
+    }
+
+    MemoryTagScope tag(MemoryTag::Terrain);
+    size_t count = size_t(width) * depth;
+    auto range = std::minmax_element(heights, heights + count);
+    SetRange(width, depth, spacing, *range.first, *range.second);
+
+    float toSteps = (sampleScale > 0.0f) ? 1.0f / sampleScale : 0.0f;
+    for (size_t i = 0; i < count; ++i) {
+        samples[i] = static_cast<uint16_t>((heights[i] - minHeight) * toSteps + 0.5f);
+    }
+    return true;
+}
+
+bool Heightmap::LoadRaw16(const std::string& filename, uint32_t width, uint32_t depth, float spacing, float minHeight, float maxHeight) {
+    if (width < 2 || depth < 2 || !(spacing > 0.0f)) {
+        LogMessage("Heightmap must be at least 2x2 samples with a positive spacing\n");
+        return false;
+    }
+
+    MappedFile file;
+    if (!file.Open(filename)) {
+        LogMessage("Failed to open heightmap %s\n", filename.c_str());
+        return false;
+    }
+
+    size_t count = size_t(width) * depth;
+    if (file.GetSize() != count * sizeof(uint16_t)) {
+        LogMessage("Heightmap %s is %llu bytes, expected %ux%u 16-bit samples\n", filename.c_str(),
+            static_cast<unsigned long long>(file.GetSize()), width, depth);
+        return false;
+    }
+
+    MemoryTagScope tag(MemoryTag::Terrain);
+    SetRange(width, depth, spacing, minHeight, maxHeight);
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(file.GetData());
+    for (size_t i = 0; i < count; ++i) {
+        samples[i] = static_cast<uint16_t>(bytes[i * 2] | (bytes[i * 2 + 1] << 8));
+    }
+    return true;
+}
+
+bool Heightmap::GenerateFractal(uint32_t width, uint32_t depth, float spacing, float minHeight, float maxHeight,
+    uint32_t seed, uint32_t octaves) {
+    if (width < 2 || depth < 2 || !(spacing > 0.0f)) {
+        LogMessage("Heightmap must be at least 2x2 samples with a positive spacing\n");
+        return false;
+    }
+
+    // The first octave has hills about this many samples across
+    const float baseCellSize = 128.0f;
+
+    MemoryTagScope tag(MemoryTag::Terrain);
+    SetRange(width, depth, spacing, minHeight, maxHeight);
+    octaves = std::max(octaves, 1u);
+
+    float amplitudeSum = 0.0f;
+    for (uint32_t octave = 0; octave < octaves; ++octave) {
+        amplitudeSum += std::ldexp(1.0f, -static_cast<int>(octave));
+    }
+
+    for (uint32_t z = 0; z < depth; ++z) {
+        for (uint32_t x = 0; x < width; ++x) {
+            float value = 0.0f;
+            float frequency = 1.0f / baseCellSize;
+            float amplitude = 1.0f;
+            for (uint32_t octave = 0; octave < octaves; ++octave) {
+                value += ValueNoise(x * frequency, z * frequency, seed + octave) * amplitude;
+                frequency *= 2.0f;
+                amplitude *= 0.5f;
+            }
+
+            // Octave sums bunch up around the middle; spread them back over the range
+            value = std::min(std::max((value / amplitudeSum - 0.5f) * 1.8f + 0.5f, 0.0f), 1.0f);
+            samples[size_t(z) * width + x] = static_cast<uint16_t>(value * SampleSteps + 0.5f);
+        }
+    }
+    return true;
+}
+
+float Heightmap::GetHeight(float x, float z) const {
+    if (samples.empty()) {
+        return 0.0f;
+    }
+
+    float sampleX = std::min(std::max(x / spacing, 0.0f), static_cast<float>(width - 1));
+    float sampleZ = std::min(std::max(z / spacing, 0.0f), static_cast<float>(depth - 1));
+    uint32_t x0 = std::min(static_cast<uint32_t>(sampleX), width - 2);
+    uint32_t z0 = std::min(static_cast<uint32_t>(sampleZ), depth - 2);
+    float u = sampleX - x0;
+    float v = sampleZ - z0;
+
+    // Cells are split along the diagonal from (x0, z0) to (x0 + 1, z0 + 1)
+    float h00 = GetSample(x0, z0);
+    float h11 = GetSample(x0 + 1, z0 + 1);
+    if (u >= v) {
+        float h10 = GetSample(x0 + 1, z0);
+        return h00 + (h10 - h00) * u + (h11 - h10) * v;
+    }
+    float h01 = GetSample(x0, z0 + 1);
+    return h00 + (h01 - h00) * v + (h11 - h01) * u;
+}
@@ -0,0 +1,50 @@
+// Heightmap.h
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Grid of terrain heights, sample (x, z) sitting at (x, z) * spacing from the
+// map's corner. Samples are 16-bit fractions of [minHeight, maxHeight], the
+// same layout terrain tools export as RAW files, so a large map costs two
+// bytes per sample. Read-only once built, so any thread may sample it.
+class Heightmap {
+public:
+    Heightmap();
+
+    // Quantizes the heights to the range they span
+    bool Initialize(uint32_t width, uint32_t depth, const float* heights, float spacing);
+
+    // Little-endian 16-bit samples, row by row, mapped onto [minHeight, maxHeight]
+    bool LoadRaw16(const std::string& filename, uint32_t width, uint32_t depth, float spacing, float minHeight, float maxHeight);
+
+    // Sums octaves of value noise, each twice the frequency and half the
+    // amplitude of the last. The same seed always gives the same map.
+    bool GenerateFractal(uint32_t width, uint32_t depth, float spacing, float minHeight, float maxHeight,
+        uint32_t seed, uint32_t octaves = 6);
+
+    float GetSample(uint32_t x, uint32_t z) const { return minHeight + samples[size_t(z) * width + x] * sampleScale; }
+
+    // Interpolated between the samples around a position relative to the map's
+    // corner, clamped to the edges. Follows the triangles terrain chunks are drawn with.
+    float GetHeight(float x, float z) const;
+
+    uint32_t GetWidth() const { return width; }
+    uint32_t GetDepth() const { return depth; }
+    float GetSpacing() const { return spacing; }
+    float GetMinHeight() const { return minHeight; }
+    float GetMaxHeight() const { return maxHeight; }
+    uint64_t GetMemoryBytes() const { return samples.size() * sizeof(uint16_t); }
+
+private:
+    void SetRange(uint32_t width, uint32_t depth, float spacing, float minHeight, float maxHeight);
+
+    std::vector<uint16_t> samples;
+    uint32_t width;
+    uint32_t depth;
+    float spacing;
+    float minHeight;
+    float maxHeight;
+    float sampleScale;      // Height of one sample step
+};
@@ -0,0 +1,69 @@
+// InstanceBatch.cpp
+
+#include "InstanceBatch.h"
+#include "Mesh.h"
+
+using namespace DirectX;
+
+namespace {
+
+    const uint32_t MinInstanceCapacity = 256;
+
+}
+
+InstanceBatch::InstanceBatch(RenderBackend* backend)
+    : backend(backend), instanceBuffer(InvalidBuffer), capacity(0)
+{
+}
+
+InstanceBatch::~InstanceBatch() {
+    backend->DestroyBuffer(instanceBuffer);
+}
+
+void InstanceBatch::Add(const XMMATRIX& worldMatrix) {
+    // Rows are stored as they are; the shader rebuilds the matrix from them
+    XMFLOAT4X4 instance;
+    XMStoreFloat4x4(&instance, worldMatrix);
+    instances.push_back(instance);
+}
+
+bool InstanceBatch::Reserve(uint32_t instanceCount) {
+    if (instanceCount <= capacity) {
+        return true;
+    }
+
+    // Grow geometrically so a slowly rising count does not recreate the buffer every frame
+    uint32_t newCapacity = (capacity > 0) ? capacity : MinInstanceCapacity;
+    while (newCapacity < instanceCount) {
+        newCapacity *= 2;
+    }
+
+    BufferHandle buffer = backend->CreateBuffer(BufferUsage::DynamicVertex, nullptr, newCapacity * sizeof(XMFLOAT4X4));
+    if (buffer == InvalidBuffer) {
+        return false;
+    }
+
+    backend->DestroyBuffer(instanceBuffer);
+    instanceBuffer = buffer;
+    capacity = newCapacity;
+    return true;
+}
+
+bool InstanceBatch::Draw(Mesh& mesh, const XMMATRIX& viewProjMatrix, uint32_t lod) {
+    uint32_t instanceCount = GetInstanceCount();
+    if (instanceCount == 0 || !mesh.IsResident()) {
+        return true;
+    }
+
+    if (!Reserve(instanceCount)) {
+        return false;
+    }
+
+    // Upload every instance in one update
+    if (!backend->UpdateBuffer(instanceBuffer, instances.data(), instanceCount * sizeof(XMFLOAT4X4))) {
+        return false;
+    }
+
+    mesh.DrawInstanced(instanceBuffer, instanceCount, viewProjMatrix, lod);
+    return true;
+}
@@ -0,0 +1,36 @@
+// InstanceBatch.h
+
+#pragma once
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+#include "RenderBackend.h"
+
+class Mesh;
+
+// Collects world matrices for many copies of one mesh and draws them with a
+// single DrawIndexedInstanced. The matrices go to a dynamic vertex buffer in
+// slot 1 that grows as needed and is rewritten in full each draw. Needs an
+// instanced pipeline bound.
+class InstanceBatch {
+public:
+    explicit InstanceBatch(RenderBackend* backend);
+    ~InstanceBatch();
+
+    void Clear() { instances.clear(); }
+    void Add(const DirectX::XMMATRIX& worldMatrix);
+    uint32_t GetInstanceCount() const { return static_cast<uint32_t>(instances.size()); }
+
+    // Uploads the instances and draws the given LOD of the mesh for all of them
+    bool Draw(Mesh& mesh, const DirectX::XMMATRIX& viewProjMatrix, uint32_t lod = 0);
+
+private:
+    bool Reserve(uint32_t instanceCount);
+
+    RenderBackend* backend;
+
+    BufferHandle instanceBuffer;
+    uint32_t capacity;
+
+    std::vector<DirectX::XMFLOAT4X4> instances;
+};
@@ -0,0 +1,214 @@
+// JobSystem.cpp
+
+#include "JobSystem.h"
+#include "Profiler.h"
+
+namespace {
+
+    // Identifies the deque of the calling thread, if it has one
+    thread_local const JobSystem* currentSystem = nullptr;
+    thread_local unsigned currentQueue = 0;
+
+}
+
+JobSystem::JobSystem()
+    : queuedJobs(0), sleepingWorkers(0), stopping(false)
+{
+}
+
+JobSystem::~JobSystem() {
+    Shutdown();
+}
+
+bool JobSystem::Initialize(unsigned workerCount) {
+    if (!queues.empty()) {
+        return false;
+    }
+
+    if (workerCount == 0) {
+        unsigned cores = std::thread::hardware_concurrency();
+        workerCount = (cores > 1) ? cores - 1 : 0;
+    }
+
+    for (unsigned i = 0; i <= workerCount; ++i) {
+        queues.emplace_back(new WorkStealingQueue<Job>(QueueCapacity));
+    }
+
+    currentSystem = this;
+    currentQueue = 0;
+
+    stopping = false;
+    for (unsigned i = 1; i <= workerCount; ++i) {
+        workers.emplace_back(&JobSystem::WorkerLoop, this, i);
+    }
+    return true;
+}
+
+void JobSystem::Shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+
+    // Drop whatever was never run
+    for (auto& queue : queues) {
+        while (Job* job = queue->Pop()) {
+            DestroyJob(job);
+        }
+    }
+    queues.clear();
+    for (Job* job : sharedQueue) {
+        DestroyJob(job);
+    }
+    sharedQueue.clear();
+    queuedJobs = 0;
+
+    if (currentSystem == this) {
+        currentSystem = nullptr;
+    }
+}
+
+void JobSystem::DestroyJob(Job* job) {
+    job->call(*job, false);
+    SmallObjectPool::Delete(job);
+}
+
+void JobSystem::Dispatch(Job* job) {
+    if (queues.empty() || !Submit(job)) {
+        Execute(job);
+    }
+}
+
+void JobSystem::DispatchAfter(JobCounter& dependency, Job* job) {
+    {
+        // Finish takes the continuations under the same lock it drops the count to zero in
+        std::lock_guard<std::mutex> lock(dependency.mutex);
+        if (!dependency.IsDone()) {
+            dependency.continuations.push_back(job);
+            return;
+        }
+    }
+    Dispatch(job);
+}
+
+bool JobSystem::Submit(Job* job) {
+    queuedJobs.fetch_add(1, std::memory_order_seq_cst);
+    if (currentSystem == this) {
+        if (!queues[currentQueue]->Push(job)) {
+            queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+            return false;
+        }
+    }
+    else {
+        std::lock_guard<std::mutex> lock(sharedMutex);
+        sharedQueue.push_back(job);
+    }
+
+    // Only take the lock when someone may be asleep
+    if (sleepingWorkers.load(std::memory_order_seq_cst) > 0) {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        wake.notify_one();
+    }
+    return true;
+}
+
+Job* JobSystem::FindJob(unsigned queue) {
+    Job* job = nullptr;
+    bool ownsQueue = currentSystem == this;
+    if (ownsQueue) {
+        job = queues[queue]->Pop();
+    }
+
+    if (!job) {
+        std::lock_guard<std::mutex> lock(sharedMutex);
+        if (!sharedQueue.empty()) {
+            job = sharedQueue.front();
+            sharedQueue.pop_front();
+        }
+    }
+
+    // Steal, starting after our own deque so the thieves spread out
+    unsigned queueCount = static_cast<unsigned>(queues.size());
+    for (unsigned i = ownsQueue ? 1 : 0; !job && i < queueCount; ++i) {
+        job = queues[(queue + i) % queueCount]->Steal();
+    }
+
+    if (job) {
+        queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+void JobSystem::Execute(Job* job) {
+    {
+        BOG_PROFILE_ZONE("Job");
+        job->call(*job, true);
+    }
+    JobCounter* counter = job->counter;
+    SmallObjectPool::Delete(job);
+
+    if (counter) {
+        Finish(counter);
+    }
+}
+
+void JobSystem::Finish(JobCounter* counter) {
+    std::vector<Job*> ready;
+    {
+        std::lock_guard<std::mutex> lock(counter->mutex);
+        if (counter->pending.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+            return;
+        }
+        ready.swap(counter->continuations);
+    }
+
+    // The counter may be gone once unlocked; only the jobs are touched now
+    for (Job* job : ready) {
+        Dispatch(job);
+    }
+}
+
+void JobSystem::Wait(JobCounter& counter) {
+    unsigned queue = (currentSystem == this) ? currentQueue : 0;
+    while (!counter.IsDone()) {
+        Job* job = queues.empty() ? nullptr : FindJob(queue);
+        if (job) {
+            Execute(job);
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+
+    // Let the thread that finished the last job leave the counter's lock
+    std::lock_guard<std::mutex> lock(counter.mutex);
+}
+
+void JobSystem::WorkerLoop(unsigned queue) {
+    BOG_PROFILE_THREAD("Job worker");
+    currentSystem = this;
+    currentQueue = queue;
+
+    while (!stopping.load(std::memory_order_relaxed)) {
+        Job* job = FindJob(queue);
+        if (job) {
+            Execute(job);
+            continue;
+        }
+
+        // Sleep until something is queued. Submit reads sleepingWorkers after
+        // bumping queuedJobs, so one of the two always sees the other.
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepingWorkers.fetch_add(1, std::memory_order_seq_cst);
+        wake.wait(lock, [this] {
+            return stopping.load(std::memory_order_relaxed) || queuedJobs.load(std::memory_order_seq_cst) > 0;
+        });
+        sleepingWorkers.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
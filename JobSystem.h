@@ -0,0 +1,277 @@
+// JobSystem.h
+
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "SmallObjectPool.h"
+
+struct Job;
+
+// Fixed-size Chase-Lev deque. The owning thread pushes and pops at the bottom
+// without locks; any other thread may steal from the top. Steal returns null
+// both when the deque is empty and when it loses a race for the last item.
+template <typename T>
+class WorkStealingQueue {
+public:
+    // Capacity must be a power of two
+    explicit WorkStealingQueue(uint32_t capacity)
+        : items(new std::atomic<T*>[capacity]), mask(capacity - 1), top(0), bottom(0)
+    {
+    }
+
+    // Owner only. False when the deque is full.
+    bool Push(T* item) {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        if (b - t > static_cast<int64_t>(mask)) {
+            return false;
+        }
+        items[b & mask].store(item, std::memory_order_relaxed);
+        bottom.store(b + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Owner only. Newest item first.
+    T* Pop() {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(b, std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_seq_cst);
+        if (t > b) {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        T* item = items[b & mask].load(std::memory_order_relaxed);
+        if (t == b) {
+            // Last item: race the thieves for it
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                item = nullptr;
+            }
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return item;
+    }
+
+    // Any thread. Oldest item first.
+    T* Steal() {
+        int64_t t = top.load(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_seq_cst);
+        if (t >= b) {
+            return nullptr;
+        }
+
+        T* item = items[t & mask].load(std::memory_order_relaxed);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return item;
+    }
+
+    // Approximate when other threads are pushing or stealing
+    bool IsEmpty() const {
+        return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::unique_ptr<std::atomic<T*>[]> items;
+    const int64_t mask;
+    std::atomic<int64_t> top;
+    std::atomic<int64_t> bottom;
+};
+
+// Counts unfinished jobs. Jobs can wait on one with JobSystem::Wait or be
+// queued to start once it reaches zero with JobSystem::RunAfter. Wait on a
+// counter before destroying it.
+class JobCounter {
+public:
+    JobCounter() : pending(0) {}
+
+    bool IsDone() const { return pending.load(std::memory_order_acquire) == 0; }
+
+private:
+    friend class JobSystem;
+
+    std::atomic<int32_t> pending;
+    std::mutex mutex;                   // Guards continuations and the final decrement
+    std::vector<Job*> continuations;
+};
+
+// Pool of worker threads that each own a work-stealing deque. Jobs queued from
+// a worker (or from the thread that called Initialize, which counts as one)
+// go to that thread's deque; idle threads steal from the others. Jobs queued
+// from any other thread go through a shared locked queue. Waiting threads run
+// jobs instead of blocking, so jobs may wait on other jobs.
+//
+// Jobs come from SmallObjectPool and hold their function inline when its
+// captures fit in InlineFunctionSize bytes, so queuing one does not touch the
+// heap; larger functions are moved to a heap allocation of their own.
+class JobSystem {
+public:
+    // Per-thread deque size; a job that does not fit runs immediately
+    static const uint32_t QueueCapacity = 4096;
+
+    static const size_t InlineFunctionSize = 48;
+
+    JobSystem();
+    ~JobSystem();
+
+    // Starts workerCount threads besides the calling one. 0 picks one per core
+    // after the first. Without Initialize every job runs inline.
+    bool Initialize(unsigned workerCount = 0);
+
+    // Joins the workers. Jobs still queued are dropped.
+    void Shutdown();
+
+    // Workers plus the initializing thread
+    unsigned GetThreadCount() const { return static_cast<unsigned>(queues.size()); }
+
+    // Queues a job calling function(). The counter, if any, counts it until it has finished.
+    template <typename Function>
+    void Run(Function&& function, JobCounter* counter = nullptr);
+
+    // Queues a job once dependency reaches zero
+    template <typename Function>
+    void RunAfter(JobCounter& dependency, Function&& function, JobCounter* counter = nullptr);
+
+    // Runs jobs on this thread until the counter reaches zero
+    void Wait(JobCounter& counter);
+
+    // Calls function(begin, end) over [0, count) in batches of at least
+    // minBatch items, spread over the threads, and returns when all are done.
+    // A range that fits in one batch runs inline.
+    template <typename Function>
+    void ParallelFor(size_t count, size_t minBatch, const Function& function);
+
+private:
+    template <typename Function>
+    static Job* CreateJob(Function&& function, JobCounter* counter);
+
+    // Frees a job without running it
+    static void DestroyJob(Job* job);
+
+    void Dispatch(Job* job);
+    void DispatchAfter(JobCounter& dependency, Job* job);
+    bool Submit(Job* job);
+    Job* FindJob(unsigned queue);
+    void Execute(Job* job);
+    void Finish(JobCounter* counter);
+    void WorkerLoop(unsigned queue);
+
+    // Index 0 belongs to the initializing thread
+    std::vector<std::unique_ptr<WorkStealingQueue<Job>>> queues;
+    std::vector<std::thread> workers;
+
+    // Jobs from threads without a deque
+    std::mutex sharedMutex;
+    std::deque<Job*> sharedQueue;
+
+    // Idle workers sleep until a job is queued
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<int64_t> queuedJobs;
+    std::atomic<uint32_t> sleepingWorkers;
+    std::atomic<bool> stopping;
+};
+
+struct Job {
+    // Runs the function when asked to, then destroys it
+    void (*call)(Job& job, bool run);
+    JobCounter* counter;
+    alignas(std::max_align_t) unsigned char function[JobSystem::InlineFunctionSize];
+};
+
+// Keeps a job's function inline when it fits, and on the heap when it does not
+template <typename Function,
+    bool Inline = (sizeof(Function) <= JobSystem::InlineFunctionSize && alignof(Function) <= alignof(std::max_align_t))>
+struct JobFunctionStorage {
+    template <typename Source>
+    static void Store(Job& job, Source&& function) {
+        new (job.function) Function(std::forward<Source>(function));
+        job.call = &Call;
+    }
+
+    static void Call(Job& job, bool run) {
+        Function& function = *reinterpret_cast<Function*>(job.function);
+        if (run) {
+            function();
+        }
+        function.~Function();
+    }
+};
+
+template <typename Function>
+struct JobFunctionStorage<Function, false> {
+    template <typename Source>
+    static void Store(Job& job, Source&& function) {
+        *reinterpret_cast<Function**>(job.function) = new Function(std::forward<Source>(function));
+        job.call = &Call;
+    }
+
+    static void Call(Job& job, bool run) {
+        Function* function = *reinterpret_cast<Function**>(job.function);
+        if (run) {
+            (*function)();
+        }
+        delete function;
+    }
+};
+
+template <typename Function>
+Job* JobSystem::CreateJob(Function&& function, JobCounter* counter) {
+    typedef typename std::decay<Function>::type StoredFunction;
+    Job* job = SmallObjectPool::New<Job>();
+    job->counter = counter;
+    JobFunctionStorage<StoredFunction>::Store(*job, std::forward<Function>(function));
+    return job;
+}
+
+template <typename Function>
+void JobSystem::Run(Function&& function, JobCounter* counter) {
+    if (counter) {
+        counter->pending.fetch_add(1, std::memory_order_relaxed);
+    }
+    Dispatch(CreateJob(std::forward<Function>(function), counter));
+}
+
+template <typename Function>
+void JobSystem::RunAfter(JobCounter& dependency, Function&& function, JobCounter* counter) {
+    if (counter) {
+        counter->pending.fetch_add(1, std::memory_order_relaxed);
+    }
+    DispatchAfter(dependency, CreateJob(std::forward<Function>(function), counter));
+}
+
+template <typename Function>
+void JobSystem::ParallelFor(size_t count, size_t minBatch, const Function& function) {
+    if (count == 0) {
+        return;
+    }
+
+    // A few batches per thread so stealing can even out uneven batches
+    size_t batch = std::max<size_t>(std::max<size_t>(minBatch, 1), count / (GetThreadCount() * 4 + 1) + 1);
+    if (batch >= count || queues.empty()) {
+        function(static_cast<size_t>(0), count);
+        return;
+    }
+
+    JobCounter counter;
+    for (size_t begin = batch; begin < count; begin += batch) {
+        size_t end = std::min(begin + batch, count);
+        Run([&function, begin, end] { function(begin, end); }, &counter);
+    }
+
+    // The first batch runs here while the others are picked up
+    function(static_cast<size_t>(0), std::min(batch, count));
+    Wait(counter);
+}
@@ -0,0 +1,121 @@
+// LinearArena.cpp
+
+#include "LinearArena.h"
+#include <algorithm>
+
+LinearArena::LinearArena(size_t capacity, MemoryTag tag)
+    : tag(tag), current(nullptr), highWater(0), growths(0)
+{
+    if (capacity > 0) {
+        current.store(CreateBlock(capacity, nullptr), std::memory_order_relaxed);
+    }
+}
+
+LinearArena::~LinearArena() {
+    DestroyBlocks(current.load(std::memory_order_relaxed));
+}
+
+LinearArena::Block* LinearArena::CreateBlock(size_t capacity, Block* previous) {
+    MemoryTagScope scope(tag);
+    void* memory = ::operator new(HeaderSize + capacity, std::nothrow);
+    if (!memory) {
+        return nullptr;
+    }
+
+    Block* block = new (memory) Block;
+    block->previous = previous;
+    block->capacity = capacity;
+    block->head.store(0, std::memory_order_relaxed);
+    return block;
+}
+
+void LinearArena::DestroyBlocks(Block* block) {
+    while (block) {
+        Block* previous = block->previous;
+        block->~Block();
+        ::operator delete(block);
+        block = previous;
+    }
+}
+
+void* LinearArena::Allocate(size_t size, size_t alignment) {
+    while (true) {
+        Block* block = current.load(std::memory_order_acquire);
+        if (block) {
+            uintptr_t data = reinterpret_cast<uintptr_t>(GetData(block));
+            size_t head = block->head.load(std::memory_order_relaxed);
+            while (true) {
+                uintptr_t start = (data + head + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+                size_t end = static_cast<size_t>(start - data) + size;
+                if (end > block->capacity) {
+                    break;
+                }
+                if (block->head.compare_exchange_weak(head, end, std::memory_order_relaxed)) {
+                    return reinterpret_cast<void*>(start);
+                }
+            }
+        }
+
+        if (!Grow(block, size + alignment)) {
+            return nullptr;
+        }
+    }
+}
+
+bool LinearArena::Grow(Block* full, size_t size) {
+    std::lock_guard<std::mutex> lock(growMutex);
+    if (current.load(std::memory_order_relaxed) != full) {
+        return true;
+    }
+
+    size_t capacity = std::max(full ? full->capacity * 2 : MinBlockSize, size);
+    Block* block = CreateBlock(capacity, full);
+    if (!block) {
+        return false;
+    }
+    if (full) {
+        ++growths;
+    }
+    current.store(block, std::memory_order_release);
+    return true;
+}
+
+void LinearArena::Reset() {
+    Block* block = current.load(std::memory_order_relaxed);
+    if (!block) {
+        return;
+    }
+
+    Stats stats = GetStats();
+    highWater = std::max(highWater, stats.used);
+
+    // Whatever a chain held fits in one block from now on
+    if (block->previous) {
+        DestroyBlocks(block);
+        current.store(CreateBlock(stats.capacity, nullptr), std::memory_order_relaxed);
+        return;
+    }
+    block->head.store(0, std::memory_order_relaxed);
+}
+
+LinearArena::Stats LinearArena::GetStats() const {
+    Stats stats = {};
+    for (Block* block = current.load(std::memory_order_acquire); block; block = block->previous) {
+        stats.capacity += block->capacity;
+        stats.used += block->head.load(std::memory_order_relaxed);
+        ++stats.blocks;
+    }
+    stats.highWater = std::max(highWater, stats.used);
+    stats.growths = growths;
+    return stats;
+}
+
+FrameArena::FrameArena(size_t capacity, MemoryTag tag)
+    : even(capacity, tag), odd(capacity, tag), frame(0)
+{
+}
+
+void FrameArena::BeginFrame() {
+    ++frame;
+    GetCurrent().Reset();
+}
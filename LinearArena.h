@@ -0,0 +1,137 @@
+// LinearArena.h
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <vector>
+#include "MemoryTracker.h"
+
+// Bump allocator for data that is thrown away all at once. Allocate is
+// lock-free and may be called from any thread; Reset empties the arena and
+// must not race with it. Nothing is destroyed, so only trivially destructible
+// data belongs in an arena.
+//
+// When the current block runs out another, at least twice as large, is
+// chained on. The next Reset replaces the chain with one block that holds all
+// of it, so an arena that sees the same load every frame stops touching the
+// heap after the first and resets by rewinding one offset.
+class LinearArena {
+public:
+    static const size_t DefaultAlignment = 16;
+    static const size_t MinBlockSize = 64 * 1024;
+
+    struct Stats {
+        size_t capacity;        // Bytes in every block
+        size_t used;            // Bytes handed out since the last Reset, alignment included
+        size_t highWater;       // Most bytes used between two Resets
+        uint32_t blocks;
+        uint32_t growths;       // Blocks chained on because the arena was full
+    };
+
+    // Blocks are heap allocations counted against the tag
+    explicit LinearArena(size_t capacity = 0, MemoryTag tag = MemoryTag::General);
+    ~LinearArena();
+
+    LinearArena(const LinearArena&) = delete;
+    LinearArena& operator=(const LinearArena&) = delete;
+
+    // Alignment must be a power of two. Null only when the heap is exhausted.
+    void* Allocate(size_t size, size_t alignment = DefaultAlignment);
+
+    // Uninitialized room for count objects
+    template <typename T>
+    T* AllocateArray(size_t count) { return static_cast<T*>(Allocate(count * sizeof(T), alignof(T))); }
+
+    void Reset();
+
+    Stats GetStats() const;
+
+private:
+    // Header in front of each block's data
+    struct Block {
+        Block* previous;
+        size_t capacity;
+        std::atomic<size_t> head;
+    };
+
+    static const size_t HeaderSize = (sizeof(Block) + DefaultAlignment - 1) & ~(DefaultAlignment - 1);
+
+    static char* GetData(Block* block) { return reinterpret_cast<char*>(block) + HeaderSize; }
+
+    Block* CreateBlock(size_t capacity, Block* previous);
+    void DestroyBlocks(Block* block);
+
+    // Chains on a block with room for size bytes unless another thread already replaced full
+    bool Grow(Block* full, size_t size);
+
+    MemoryTag tag;
+    std::atomic<Block*> current;
+    std::mutex growMutex;
+    size_t highWater;
+    uint32_t growths;
+};
+
+// Standard allocator over a LinearArena, for containers that live no longer
+// than the arena's next Reset. Deallocation does nothing.
+template <typename T>
+class ArenaAllocator {
+public:
+    typedef T value_type;
+
+    explicit ArenaAllocator(LinearArena& arena) : arena(&arena) {}
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(size_t count) {
+        void* pointer = arena->Allocate(count * sizeof(T), alignof(T));
+        if (!pointer) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(pointer);
+    }
+
+    void deallocate(T*, size_t) {}
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+
+private:
+    template <typename U>
+    friend class ArenaAllocator;
+
+    LinearArena* arena;
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+// Two arenas that take turns, one per frame. BeginFrame empties the one the
+// frame before last used, so what a frame allocates stays valid until the end
+// of the next one, for whatever reads the previous frame's lists.
+class FrameArena {
+public:
+    explicit FrameArena(size_t capacity = 0, MemoryTag tag = MemoryTag::General);
+
+    void BeginFrame();
+
+    LinearArena& GetCurrent() { return (frame & 1) ? odd : even; }
+    const LinearArena& GetCurrent() const { return (frame & 1) ? odd : even; }
+    const LinearArena& GetPrevious() const { return (frame & 1) ? even : odd; }
+
+    void* Allocate(size_t size, size_t alignment = LinearArena::DefaultAlignment) { return GetCurrent().Allocate(size, alignment); }
+
+    template <typename T>
+    T* AllocateArray(size_t count) { return GetCurrent().AllocateArray<T>(count); }
+
+private:
+    LinearArena even;
+    LinearArena odd;
+    uint64_t frame;
+};
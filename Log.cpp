@@ -0,0 +1,23 @@
+// Log.cpp
+
+#include "Log.h"
+
+#include <cstdarg>
+#include <cstdio>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+void LogMessage(const char* format, ...) {
+    char message[512];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+
+#ifdef _WIN32
+    OutputDebugStringA(message);
+#endif
+    fputs(message, stderr);
+}
@@ -0,0 +1,7 @@
+// Log.h
+
+#pragma once
+
+// printf-style diagnostics. Goes to stderr, so console runs of the tests and
+// benchmarks show it, and on Windows to the debugger output as well.
+void LogMessage(const char* format, ...);
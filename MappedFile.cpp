@@ -0,0 +1,120 @@
+// MappedFile.cpp
+
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+    :
+#ifdef _WIN32
+    fileHandle(INVALID_HANDLE_VALUE), mappingHandle(nullptr),
+#else
+    fileDescriptor(-1),
+#endif
+    data(nullptr), size(0)
+{
+}
+
+MappedFile::~MappedFile() {
+    Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const std::string& filename) {
+    Close();
+
+    fileHandle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize = {};
+    if (!GetFileSizeEx(fileHandle, &fileSize)) {
+        Close();
+        return false;
+    }
+
+    // Empty files cannot be mapped, but they are still valid files
+    size = static_cast<size_t>(fileSize.QuadPart);
+    if (size == 0) {
+        return true;
+    }
+
+    mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mappingHandle) {
+        Close();
+        return false;
+    }
+
+    data = static_cast<const char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    if (!data) {
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+void MappedFile::Close() {
+    if (data) UnmapViewOfFile(data);
+    if (mappingHandle) CloseHandle(mappingHandle);
+    if (fileHandle != INVALID_HANDLE_VALUE) CloseHandle(fileHandle);
+
+    fileHandle = INVALID_HANDLE_VALUE;
+    mappingHandle = nullptr;
+    data = nullptr;
+    size = 0;
+}
+
+#else
+
+bool MappedFile::Open(const std::string& filename) {
+    Close();
+
+    fileDescriptor = open(filename.c_str(), O_RDONLY);
+    if (fileDescriptor < 0) {
+        return false;
+    }
+
+    struct stat fileStat = {};
+    if (fstat(fileDescriptor, &fileStat) != 0) {
+        Close();
+        return false;
+    }
+
+    // Empty files cannot be mapped, but they are still valid files
+    size = static_cast<size_t>(fileStat.st_size);
+    if (size == 0) {
+        return true;
+    }
+
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+    if (mapped == MAP_FAILED) {
+        Close();
+        return false;
+    }
+
+    madvise(mapped, size, MADV_SEQUENTIAL);
+    data = static_cast<const char*>(mapped);
+    return true;
+}
+
+void MappedFile::Close() {
+    if (data) munmap(const_cast<char*>(data), size);
+    if (fileDescriptor >= 0) close(fileDescriptor);
+
+    fileDescriptor = -1;
+    data = nullptr;
+    size = 0;
+}
+
+#endif
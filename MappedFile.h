@@ -0,0 +1,33 @@
+// MappedFile.h
+
+#pragma once
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file. The mapped bytes stay valid until
+// Close() is called or the object is destroyed.
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool Open(const std::string& filename);
+    void Close();
+
+    const char* GetData() const { return data; }
+    size_t GetSize() const { return size; }
+
+private:
+#ifdef _WIN32
+    void* fileHandle;
+    void* mappingHandle;
+#else
+    int fileDescriptor;
+#endif
+
+    const char* data;
+    size_t size;
+};
@@ -0,0 +1,201 @@
+// MemoryTracker.cpp
+
+#include "MemoryTracker.h"
+#include "Log.h"
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+    const size_t TagCount = static_cast<size_t>(MemoryTag::Count);
+
+    const char* const TagNames[TagCount] = {
+        "General", "Rendering", "Jobs", "Import", "Streaming", "Pools", "Terrain"
+    };
+
+    // Zero-initialized before any constructor runs, so allocations made
+    // during static initialization are counted too
+    std::atomic<uint64_t> allocations[TagCount];
+    std::atomic<uint64_t> frees[TagCount];
+    std::atomic<uint64_t> allocatedBytes[TagCount];
+    std::atomic<uint64_t> freedBytes[TagCount];
+
+    thread_local MemoryTag currentTag = MemoryTag::General;
+
+    // Totals when the last frame closed, and what that frame added to them
+    MemoryTracker::Stats frameStart[TagCount];
+    MemoryTracker::Stats frameStats[TagCount];
+
+#if BOG_MEMORY_TRACKING
+    // In front of every block; 16 bytes keeps the malloc alignment
+    struct AllocationHeader {
+        uint64_t size;
+        uint32_t tag;
+        uint32_t marker;
+    };
+
+    static_assert(sizeof(AllocationHeader) == 16, "Allocation header must keep 16 byte alignment");
+
+    const uint32_t HeaderMarker = 0x626f676d;
+#endif
+
+}
+
+MemoryTag MemoryTracker::GetTag() {
+    return currentTag;
+}
+
+void MemoryTracker::SetTag(MemoryTag tag) {
+    currentTag = tag;
+}
+
+const char* MemoryTracker::GetTagName(MemoryTag tag) {
+    return TagNames[static_cast<size_t>(tag)];
+}
+
+MemoryTracker::Stats MemoryTracker::GetTotalStats(MemoryTag tag) {
+    size_t index = static_cast<size_t>(tag);
+    Stats stats;
+    stats.allocations = allocations[index].load(std::memory_order_relaxed);
+    stats.frees = frees[index].load(std::memory_order_relaxed);
+    stats.allocatedBytes = allocatedBytes[index].load(std::memory_order_relaxed);
+    stats.freedBytes = freedBytes[index].load(std::memory_order_relaxed);
+    return stats;
+}
+
+uint64_t MemoryTracker::GetTotalAllocations() {
+    uint64_t total = 0;
+    for (size_t index = 0; index < TagCount; ++index) {
+        total += allocations[index].load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+const MemoryTracker::Stats& MemoryTracker::GetFrameStats(MemoryTag tag) {
+    return frameStats[static_cast<size_t>(tag)];
+}
+
+uint64_t MemoryTracker::GetFrameAllocations() {
+    uint64_t total = 0;
+    for (const Stats& stats : frameStats) {
+        total += stats.allocations;
+    }
+    return total;
+}
+
+void MemoryTracker::EndFrame() {
+    for (size_t index = 0; index < TagCount; ++index) {
+        Stats total = GetTotalStats(static_cast<MemoryTag>(index));
+        frameStats[index].allocations = total.allocations - frameStart[index].allocations;
+        frameStats[index].frees = total.frees - frameStart[index].frees;
+        frameStats[index].allocatedBytes = total.allocatedBytes - frameStart[index].allocatedBytes;
+        frameStats[index].freedBytes = total.freedBytes - frameStart[index].freedBytes;
+        frameStart[index] = total;
+    }
+}
+
+void MemoryTracker::LogFrameStats() {
+    if (!IsEnabled()) {
+        return;
+    }
+
+    LogMessage("Memory: %llu heap allocations last frame\n", static_cast<unsigned long long>(GetFrameAllocations()));
+    for (size_t index = 0; index < TagCount; ++index) {
+        MemoryTag tag = static_cast<MemoryTag>(index);
+        Stats total = GetTotalStats(tag);
+        const Stats& frame = frameStats[index];
+        LogMessage("  %s: %llu allocations (%llu bytes), %llu frees last frame, %llu bytes live\n", GetTagName(tag),
+            static_cast<unsigned long long>(frame.allocations), static_cast<unsigned long long>(frame.allocatedBytes),
+            static_cast<unsigned long long>(frame.frees),
+            static_cast<unsigned long long>(total.allocatedBytes - total.freedBytes));
+    }
+}
+
+#if BOG_MEMORY_TRACKING
+
+void* MemoryTracker::Allocate(size_t size) {
+    AllocationHeader* header = static_cast<AllocationHeader*>(std::malloc(size + sizeof(AllocationHeader)));
+    if (!header) {
+        return nullptr;
+    }
+
+    size_t tag = static_cast<size_t>(currentTag);
+    header->size = size;
+    header->tag = static_cast<uint32_t>(tag);
+    header->marker = HeaderMarker;
+    allocations[tag].fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes[tag].fetch_add(size, std::memory_order_relaxed);
+    return header + 1;
+}
+
+void MemoryTracker::Free(void* pointer) {
+    if (!pointer) {
+        return;
+    }
+
+    AllocationHeader* header = static_cast<AllocationHeader*>(pointer) - 1;
+    assert(header->marker == HeaderMarker && "Block was not allocated by the tracker or was freed twice");
+    size_t tag = header->tag;
+    frees[tag].fetch_add(1, std::memory_order_relaxed);
+    freedBytes[tag].fetch_add(header->size, std::memory_order_relaxed);
+    header->marker = 0;
+    std::free(header);
+}
+
+void* operator new(size_t size) {
+    void* pointer = MemoryTracker::Allocate(size);
+    if (!pointer) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return MemoryTracker::Allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return MemoryTracker::Allocate(size);
+}
+
+void operator delete(void* pointer) noexcept {
+    MemoryTracker::Free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    MemoryTracker::Free(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+    MemoryTracker::Free(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+    MemoryTracker::Free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    MemoryTracker::Free(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+    MemoryTracker::Free(pointer);
+}
+
+#else
+
+void* MemoryTracker::Allocate(size_t size) {
+    return std::malloc(size);
+}
+
+void MemoryTracker::Free(void* pointer) {
+    std::free(pointer);
+}
+
+#endif
@@ -0,0 +1,80 @@
+// MemoryTracker.h
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Off unless the build defines BOG_MEMORY_TRACKING=1, as the Debug
+// configurations do. Without it the default global operator new is kept and
+// the tracker reports nothing.
+#ifndef BOG_MEMORY_TRACKING
+#define BOG_MEMORY_TRACKING 0
+#endif
+
+// What an allocation is for. Each thread has a current tag, General unless a
+// MemoryTagScope says otherwise, and every heap allocation counts against it.
+enum class MemoryTag : uint8_t {
+    General,
+    Rendering,      // Per-frame scene and draw data
+    Jobs,
+    Import,         // Parsing and processing source assets
+    Streaming,
+    Pools,          // Pages of SmallObjectPool
+    Terrain,        // Heightmaps and chunk generation
+    Count
+};
+
+// Counts every global heap allocation by tag. The global operator new and
+// delete are replaced to keep a small header in front of each block, so frees
+// are charged to the tag that allocated them. EndFrame closes a frame's
+// counts; GetFrameStats then holds what that frame allocated, which in a
+// steady state frame should be nothing.
+//
+//     MemoryTagScope tag(MemoryTag::Import);  // Rest of the scope counts as Import
+//     ...
+//     MemoryTracker::EndFrame();              // Once per frame on the main thread
+class MemoryTracker {
+public:
+    struct Stats {
+        uint64_t allocations;
+        uint64_t frees;
+        uint64_t allocatedBytes;
+        uint64_t freedBytes;
+    };
+
+    static bool IsEnabled() { return BOG_MEMORY_TRACKING != 0; }
+
+    static MemoryTag GetTag();
+    static void SetTag(MemoryTag tag);
+    static const char* GetTagName(MemoryTag tag);
+
+    // Since startup
+    static Stats GetTotalStats(MemoryTag tag);
+    static uint64_t GetTotalAllocations();
+
+    // The last frame EndFrame closed
+    static const Stats& GetFrameStats(MemoryTag tag);
+    static uint64_t GetFrameAllocations();
+
+    static void EndFrame();
+
+    // One line per tag that allocated in the last frame, plus the live bytes of each tag
+    static void LogFrameStats();
+
+    // Used by the replaced global operator new and delete
+    static void* Allocate(size_t size);
+    static void Free(void* pointer);
+};
+
+// Sets the calling thread's tag for the rest of the scope
+class MemoryTagScope {
+public:
+    explicit MemoryTagScope(MemoryTag tag) : previous(MemoryTracker::GetTag()) { MemoryTracker::SetTag(tag); }
+    ~MemoryTagScope() { MemoryTracker::SetTag(previous); }
+
+    MemoryTagScope(const MemoryTagScope&) = delete;
+    MemoryTagScope& operator=(const MemoryTagScope&) = delete;
+
+private:
+    MemoryTag previous;
+};
@@ -1,182 +1,517 @@
 // Mesh.cpp
 
 #include "Mesh.h"
-#include <d3dcompiler.h>
+#include "Hash.h"
+#include "MeshCache.h"
+#include "MemoryTracker.h"
+#include "MeshProcessing.h"
+#include "ObjParser.h"
+#include "Profiler.h"
 #include <DirectXMath.h>
 using namespace DirectX;
 
-#include <fstream>
-#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
 #include <string>
 #include <vector>
 
-Mesh::Mesh(ID3D11Device* device, ID3D11DeviceContext* context)
-    : device(device), context(context),
-    vertexBuffer(nullptr), indexBuffer(nullptr), constantBuffer(nullptr),
-    posX(0.0f), posY(0.0f), posZ(0.0f),
-    rotX(0.0f), rotY(0.0f), rotZ(0.0f),
-    scaleX(1.0f), scaleY(1.0f), scaleZ(1.0f),
-    indexCount(0)
+namespace {
+
+    uint32_t NextMeshId() {
+        static uint32_t nextId = 0;
+        return nextId++;
+    }
+
+}
+
+Mesh::Mesh(RenderBackend* backend, GeometryPool* geometryPool)
+    : vertexBuffer(InvalidBuffer), indexBuffer(InvalidBuffer), geometryPool(geometryPool), geometry(InvalidGeometry),
+    positionTransform(XMMatrixIdentity()),
+    backend(backend), indexCount(0), indexFormat(IndexFormat::UInt32),
+    boundingRadius(0.0f), boundsCenter(0.0f, 0.0f, 0.0f), boundsExtents(0.0f, 0.0f, 0.0f), occluder(false),
+    stats(), id(NextMeshId())
 {
 }
 
 Mesh::~Mesh() {
-    if (constantBuffer) constantBuffer->Release();
-    if (indexBuffer) indexBuffer->Release();
-    if (vertexBuffer) vertexBuffer->Release();
+    if (geometryPool) {
+        geometryPool->Free(geometry);
+    }
+    backend->DestroyBuffer(indexBuffer);
+    backend->DestroyBuffer(vertexBuffer);
 }
 
-bool Mesh::Initialize(const std::vector<Vertex>& vertices, const std::vector<UINT>& indices) {
-    // Store the index count
-    indexCount = static_cast<UINT>(indices.size());
+namespace {
+
+    // LOD error targets as a fraction of the bounding box diagonal
+    const float DefaultLodErrors[] = { 0.005f, 0.01f, 0.02f, 0.05f };
 
-    // Create the vertex buffer
-    D3D11_BUFFER_DESC vbDesc = {};
-    vbDesc.Usage = D3D11_USAGE_DEFAULT;
-    vbDesc.ByteWidth = sizeof(Vertex) * static_cast<UINT>(vertices.size());
-    vbDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+    // Welds the geometry in place and returns the number of vertex bytes saved
+    uint32_t WeldGeometry(std::vector<Mesh::Vertex>& vertices, std::vector<uint32_t>& indices) {
+        size_t originalCount = vertices.size();
+        size_t uniqueCount = MeshProcessing::WeldVertices(vertices.data(), vertices.size(), sizeof(Mesh::Vertex),
+            indices.data(), indices.size());
+        vertices.resize(uniqueCount);
+        return static_cast<uint32_t>((originalCount - uniqueCount) * sizeof(Mesh::Vertex));
+    }
 
-    D3D11_SUBRESOURCE_DATA vbData = {};
-    vbData.pSysMem = vertices.data();
+    // Encodes processed geometry into upload-ready mesh data with the narrowest index format
+    void BuildMeshData(const std::vector<Mesh::Vertex>& vertices, const std::vector<uint32_t>& indices,
+        const std::vector<MeshProcessing::Lod>& lods, MeshData& data) {
+        data.vertexCount = static_cast<uint32_t>(vertices.size());
+        data.indexCount = static_cast<uint32_t>(indices.size());
+        data.lods = lods;
+
+        // Rebuilt from bounds so it matches the range a baked file recreates from its header
+        VertexQuantization::PositionRange range =
+            VertexQuantization::ComputePositionRange(vertices.data(), sizeof(Mesh::Vertex), data.vertexCount);
+        float boundsMin[3], boundsMax[3];
+        for (int axis = 0; axis < 3; ++axis) {
+            boundsMin[axis] = range.offset[axis];
+            boundsMax[axis] = range.offset[axis] + range.scale[axis];
+        }
+        data.positionRange = VertexQuantization::PositionRangeFromBounds(boundsMin, boundsMax);
+        Mesh::EncodeVertices(vertices.data(), data.vertexCount, data.positionRange, data.vertices);
 
-    HRESULT hr = device->CreateBuffer(&vbDesc, &vbData, &vertexBuffer);
-    if (FAILED(hr)) {
-        // Handle error
+        if (MeshProcessing::FitsIn16BitIndices(data.vertexCount)) {
+            data.indexStride = sizeof(uint16_t);
+            data.indices.resize(size_t(data.indexCount) * sizeof(uint16_t));
+            MeshProcessing::NarrowIndices(indices.data(), data.indexCount, reinterpret_cast<uint16_t*>(data.indices.data()));
+        }
+        else {
+            data.indexStride = sizeof(uint32_t);
+            data.indices.resize(size_t(data.indexCount) * sizeof(uint32_t));
+            std::memcpy(data.indices.data(), indices.data(), data.indices.size());
+        }
+    }
+
+    bool WriteBakedMesh(const std::string& bakedFile, const MeshData& data, uint64_t sourceHash, uint64_t sourceSize) {
+        std::vector<BakedMeshLod> bakedLods(data.lods.size());
+        for (size_t i = 0; i < data.lods.size(); ++i) {
+            bakedLods[i].firstIndex = data.lods[i].firstIndex;
+            bakedLods[i].indexCount = data.lods[i].indexCount;
+            bakedLods[i].error = data.lods[i].error;
+        }
+
+        // The header bounds double as the quantization range when the file is loaded
+        float boundsMin[3], boundsMax[3];
+        for (int axis = 0; axis < 3; ++axis) {
+            boundsMin[axis] = data.positionRange.offset[axis];
+            boundsMax[axis] = data.positionRange.offset[axis] + data.positionRange.scale[axis];
+        }
+
+        return BakedMeshFile::Write(bakedFile, data.GetVertexData(), Mesh::GetVertexFormat().GetStride(), data.vertexCount,
+            boundsMin, boundsMax, data.GetIndexData(), data.indexStride, data.indexCount,
+            bakedLods.data(), static_cast<uint32_t>(bakedLods.size()), sourceHash, sourceSize);
+    }
+
+    // Parses and welds an OBJ into upload-ready mesh data, optimizing and
+    // simplifying it as well when the options ask for it
+    bool ImportOBJFile(const std::string& sourceFile, const Mesh::ImportOptions& options, MeshData& data) {
+        MemoryTagScope tag(MemoryTag::Import);
+        ObjData obj;
+        if (!ObjParser::ParseFile(sourceFile, obj)) {
+            return false;
+        }
+
+        std::vector<Mesh::Vertex> vertices;
+        std::vector<uint32_t> indices;
+        Mesh::BuildFromOBJ(obj, vertices, indices);
+        uint32_t weldBytesSaved = WeldGeometry(vertices, indices);
+        if (options.optimize) {
+            Mesh::OptimizeGeometry(vertices, indices);
+        }
+
+        std::vector<MeshProcessing::Lod> lods;
+        if (options.generateLods) {
+            Mesh::GenerateLods(vertices, indices, lods);
+        }
+
+        BuildMeshData(vertices, indices, lods, data);
+        data.weldBytesSaved = weldBytesSaved;
+        return true;
+    }
+}
+
+bool Mesh::Initialize(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices) {
+    std::vector<Vertex> weldedVertices(vertices);
+    std::vector<uint32_t> weldedIndices(indices);
+    uint32_t weldBytesSaved = WeldGeometry(weldedVertices, weldedIndices);
+
+    if (!Initialize(weldedVertices.data(), static_cast<uint32_t>(weldedVertices.size()),
+        weldedIndices.data(), static_cast<uint32_t>(weldedIndices.size()))) {
         return false;
     }
 
-    // Create the index buffer
-    D3D11_BUFFER_DESC ibDesc = {};
-    ibDesc.Usage = D3D11_USAGE_DEFAULT;
-    ibDesc.ByteWidth = sizeof(UINT) * indexCount;
-    ibDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+    stats.weldBytesSaved = weldBytesSaved;
+    return true;
+}
+
+bool Mesh::Initialize(const Vertex* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount) {
+    VertexQuantization::PositionRange range =
+        VertexQuantization::ComputePositionRange(vertices, sizeof(Vertex), vertexCount);
+    std::vector<unsigned char> encoded;
+    EncodeVertices(vertices, vertexCount, range, encoded);
+
+    if (!MeshProcessing::FitsIn16BitIndices(vertexCount)) {
+        return CreateBuffers(encoded.data(), vertexCount, range, indices, indexCount, IndexFormat::UInt32);
+    }
+
+    std::vector<uint16_t> shortIndices(indexCount);
+    MeshProcessing::NarrowIndices(indices, indexCount, shortIndices.data());
+    return CreateBuffers(encoded.data(), vertexCount, range, shortIndices.data(), indexCount, IndexFormat::UInt16);
+}
+
+bool Mesh::Initialize(const Vertex* vertices, uint32_t vertexCount, const uint16_t* indices, uint32_t indexCount) {
+    VertexQuantization::PositionRange range =
+        VertexQuantization::ComputePositionRange(vertices, sizeof(Vertex), vertexCount);
+    std::vector<unsigned char> encoded;
+    EncodeVertices(vertices, vertexCount, range, encoded);
+
+    return CreateBuffers(encoded.data(), vertexCount, range, indices, indexCount, IndexFormat::UInt16);
+}
+
+const VertexFormat& Mesh::GetVertexFormat() {
+    static const VertexFormat format = VertexFormat()
+        .Add(VertexSemantic::Position, VertexEncoding::UNorm16x4)
+        .Add(VertexSemantic::Color, VertexEncoding::UNorm8x4);
+    return format;
+}
+
+void Mesh::EncodeVertices(const Vertex* vertices, uint32_t vertexCount,
+    const VertexQuantization::PositionRange& range, std::vector<unsigned char>& encoded) {
+    VertexStream streams[static_cast<int>(VertexSemantic::Count)] = {};
+    streams[static_cast<int>(VertexSemantic::Position)] = { &vertices->x, sizeof(Vertex) };
+    streams[static_cast<int>(VertexSemantic::Color)] = { &vertices->r, sizeof(Vertex) };
+
+    const VertexFormat& format = GetVertexFormat();
+    encoded.resize(size_t(format.GetStride()) * vertexCount);
+    format.Encode(encoded.data(), streams, vertexCount, range);
+}
+
+bool Mesh::CreateBuffers(const void* encodedVertices, uint32_t vertexCount, const VertexQuantization::PositionRange& range,
+    const void* indices, uint32_t indexCount, IndexFormat format) {
+    uint32_t indexSize = (format == IndexFormat::UInt16) ? sizeof(uint16_t) : sizeof(uint32_t);
+    uint32_t vertexStride = GetVertexFormat().GetStride();
+
+    // Store the index count and format
+    this->indexCount = indexCount;
+    indexFormat = format;
+
+    stats = Stats();
+    stats.vertexCount = vertexCount;
+    stats.indexCount = indexCount;
+    stats.vertexBufferBytes = vertexStride * vertexCount;
+    stats.indexBufferBytes = indexSize * indexCount;
+    stats.quantizeBytesSaved = (sizeof(Vertex) - vertexStride) * vertexCount;
+    stats.indexBytesSaved = (sizeof(uint32_t) - indexSize) * indexCount;
+    stats.lodCount = 1;
+
+    // Until a LOD table is set the whole index buffer is the only level
+    MeshProcessing::Lod fullLod = { 0, indexCount, 0.0f };
+    lods.assign(1, fullLod);
+
+    // Positions come back to mesh space through the world matrix
+    positionTransform = GetVertexFormat().GetPositionTransform(range);
+
+    // Radius around the local origin, which is where the world transform places the mesh
+    float radiusSquared = 0.0f;
+    for (int axis = 0; axis < 3; ++axis) {
+        float extent = std::max(std::fabs(range.offset[axis]), std::fabs(range.offset[axis] + range.scale[axis]));
+        radiusSquared += extent * extent;
+    }
+    boundingRadius = std::sqrt(radiusSquared);
+
+    // The quantization range is the AABB of the vertices
+    boundsExtents = XMFLOAT3(range.scale[0] * 0.5f, range.scale[1] * 0.5f, range.scale[2] * 0.5f);
+    boundsCenter = XMFLOAT3(range.offset[0] + boundsExtents.x, range.offset[1] + boundsExtents.y, range.offset[2] + boundsExtents.z);
+
+    // The occlusion rasterizer reads the same geometry from the CPU
+    if (occluder) {
+        const unsigned char* encodedPositions = static_cast<const unsigned char*>(encodedVertices) +
+            GetVertexFormat().Find(VertexSemantic::Position)->offset;
+        occluderPositions.resize(static_cast<size_t>(vertexCount) * 3);
+        VertexQuantization::DecodePositions(occluderPositions.data(), sizeof(float) * 3,
+            encodedPositions, vertexStride, vertexCount, range);
+
+        occluderIndices.resize(indexCount);
+        for (uint32_t i = 0; i < indexCount; ++i) {
+            occluderIndices[i] = (indexSize == sizeof(uint16_t)) ?
+                static_cast<const uint16_t*>(indices)[i] : static_cast<const uint32_t*>(indices)[i];
+        }
+    }
+
+    // Copy into the pool, or create the vertex and index buffers
+    if (geometryPool) {
+        geometry = geometryPool->Allocate(encodedVertices, vertexCount, indices, indexCount, format);
+        return geometry != InvalidGeometry;
+    }
 
-    D3D11_SUBRESOURCE_DATA ibData = {};
-    ibData.pSysMem = indices.data();
+    vertexBuffer = backend->CreateBuffer(BufferUsage::Vertex, encodedVertices, vertexStride * vertexCount);
+    if (vertexBuffer == InvalidBuffer) {
+        return false;
+    }
 
-    hr = device->CreateBuffer(&ibDesc, &ibData, &indexBuffer);
-    if (FAILED(hr)) {
-        // Handle error
+    indexBuffer = backend->CreateBuffer(BufferUsage::Index, indices, indexSize * indexCount);
+    if (indexBuffer == InvalidBuffer) {
         return false;
     }
 
-    // Create the constant buffer
-    D3D11_BUFFER_DESC cbDesc = {};
-    cbDesc.Usage = D3D11_USAGE_DEFAULT;
-    cbDesc.ByteWidth = sizeof(CBPerObject);
-    cbDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    return true;
+}
 
-    hr = device->CreateBuffer(&cbDesc, nullptr, &constantBuffer);
-    if (FAILED(hr)) {
-        // Handle error
+bool Mesh::SetLods(const MeshProcessing::Lod* levels, uint32_t levelCount) {
+    if (levelCount == 0) {
         return false;
     }
 
+    for (uint32_t i = 0; i < levelCount; ++i) {
+        if (levels[i].firstIndex > indexCount || levels[i].indexCount > indexCount - levels[i].firstIndex) {
+            return false;
+        }
+    }
+
+    lods.assign(levels, levels + levelCount);
+    stats.lodCount = levelCount;
     return true;
 }
 
-void Mesh::Update(float deltaTime) {
-    // Update world matrix
-    rotationMatrix = XMMatrixRotationRollPitchYaw(rotX, rotY, rotZ);
-    scaleMatrix = XMMatrixScaling(scaleX, scaleY, scaleZ);
-    translationMatrix = XMMatrixTranslation(posX, posY, posZ);
+uint32_t Mesh::SelectLod(const XMFLOAT4X4& worldMatrix, const LodView& view) const {
+    float dx = worldMatrix._41 - view.cameraPosition.x;
+    float dy = worldMatrix._42 - view.cameraPosition.y;
+    float dz = worldMatrix._43 - view.cameraPosition.z;
+
+    // Distance to the nearest point of the bounding sphere; the longest basis
+    // row is the largest scale
+    const XMFLOAT4X4& m = worldMatrix;
+    float scale = std::sqrt(std::max(m._11 * m._11 + m._12 * m._12 + m._13 * m._13,
+        std::max(m._21 * m._21 + m._22 * m._22 + m._23 * m._23, m._31 * m._31 + m._32 * m._32 + m._33 * m._33)));
+    float distance = std::sqrt(dx * dx + dy * dy + dz * dz) - boundingRadius * scale;
+    if (distance <= 0.0f) {
+        return 0;
+    }
+
+    // Errors grow with each level, so walk from the coarsest one down
+    for (uint32_t level = static_cast<uint32_t>(lods.size()) - 1; level > 0; --level) {
+        float pixelError = lods[level].error * scale * view.pixelsPerUnit / distance;
+        if (pixelError <= view.maxPixelError) {
+            return level;
+        }
+    }
+
+    return 0;
+}
 
-    worldMatrix = scaleMatrix * rotationMatrix * translationMatrix;
+void Mesh::Draw(const DirectX::XMMATRIX& worldMatrix, const DirectX::XMMATRIX& viewProjMatrix) {
+    DrawLod(worldMatrix, viewProjMatrix, lods[0]);
 }
 
-void Mesh::Draw(const DirectX::XMMATRIX& viewProjMatrix) {
-    // Bind the vertex buffer
-    UINT stride = sizeof(Vertex);
-    UINT offset = 0;
-    context->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
+void Mesh::Draw(const DirectX::XMMATRIX& worldMatrix, const DirectX::XMMATRIX& viewProjMatrix, const LodView& view) {
+    XMFLOAT4X4 world;
+    XMStoreFloat4x4(&world, worldMatrix);
+    DrawLod(worldMatrix, viewProjMatrix, lods[SelectLod(world, view)]);
+}
 
-    // Bind the index buffer
-    context->IASetIndexBuffer(indexBuffer, DXGI_FORMAT_R32_UINT, 0);
+void Mesh::BindBuffers(uint32_t& firstIndex, int32_t& baseVertex) const {
+    // The backend skips whatever is already bound, which for pooled meshes is
+    // usually everything
+    if (geometry != InvalidGeometry) {
+        const GeometryRange& range = geometryPool->GetRange(geometry);
+        backend->SetVertexBuffer(0, geometryPool->GetVertexBuffer(), GetVertexFormat().GetStride());
+        backend->SetIndexBuffer(geometryPool->GetIndexBuffer(indexFormat), indexFormat);
+        firstIndex = range.firstIndex;
+        baseVertex = range.baseVertex;
+    }
+    else {
+        backend->SetVertexBuffer(0, vertexBuffer, GetVertexFormat().GetStride());
+        backend->SetIndexBuffer(indexBuffer, indexFormat);
+        firstIndex = 0;
+        baseVertex = 0;
+    }
+}
 
-    // Set the primitive topology
-    context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+void Mesh::DrawLod(const DirectX::XMMATRIX& worldMatrix, const DirectX::XMMATRIX& viewProjMatrix, const MeshProcessing::Lod& lod) {
+    uint32_t firstIndex;
+    int32_t baseVertex;
+    BindBuffers(firstIndex, baseVertex);
 
-    // Update constant buffer
+    // Per-draw constants go into the shared ring buffer
     CBPerObject cb{};
-    cb.worldViewProj = XMMatrixTranspose(worldMatrix * viewProjMatrix);
-    cb.world = XMMatrixTranspose(worldMatrix);
-    context->UpdateSubresource(constantBuffer, 0, NULL, &cb, 0, 0);
+    XMMATRIX world = positionTransform * worldMatrix;
+    cb.worldViewProj = XMMatrixTranspose(world * viewProjMatrix);
+    cb.world = XMMatrixTranspose(world);
+    if (!backend->SetVSConstants(&cb, sizeof(cb))) {
+        return;
+    }
+
+    // Draw the level's range of the shared index buffer
+    backend->DrawIndexed(lod.indexCount, firstIndex + lod.firstIndex, baseVertex);
+}
 
-    // Bind the constant buffer
-    context->VSSetConstantBuffers(0, 1, &constantBuffer);
+void Mesh::DrawInstanced(BufferHandle instanceBuffer, uint32_t instanceCount,
+    const DirectX::XMMATRIX& viewProjMatrix, uint32_t lod) {
+    // Bind the geometry and the instance matrices
+    uint32_t firstIndex;
+    int32_t baseVertex;
+    BindBuffers(firstIndex, baseVertex);
+    backend->SetVertexBuffer(1, instanceBuffer, sizeof(XMFLOAT4X4));
 
-    // Draw the indexed vertices
-    context->DrawIndexed(indexCount, 0, 0);
+    // Shared by every instance: view-projection, then the position dequantization
+    CBPerObject cb{};
+    cb.worldViewProj = XMMatrixTranspose(viewProjMatrix);
+    cb.world = XMMatrixTranspose(positionTransform);
+    if (!backend->SetVSConstants(&cb, sizeof(cb))) {
+        return;
+    }
+
+    const MeshProcessing::Lod& level = lods[std::min<size_t>(lod, lods.size() - 1)];
+    backend->DrawIndexedInstanced(level.indexCount, instanceCount, firstIndex + level.firstIndex, baseVertex);
 }
 
 bool Mesh::LoadFromOBJFile(const std::string& filename) {
-    std::ifstream file(filename);
-    if (!file.is_open()) {
+    BOG_PROFILE_ZONE("Mesh::LoadFromOBJFile");
+    MemoryTagScope tag(MemoryTag::Import);
+    ObjData obj;
+    if (!ObjParser::ParseFile(filename, obj)) {
         return false;
     }
 
-    std::vector<XMFLOAT3> tempVertices;  // Temporary vertex array to store positions
-    std::vector<UINT> tempIndices;       // Temporary index array
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    BuildFromOBJ(obj, vertices, indices);
 
-    std::string line;
-    while (std::getline(file, line)) {
-        std::istringstream s(line);
-        std::string prefix;
-        s >> prefix;
+    return Initialize(vertices, indices);
+}
 
-        if (prefix == "v") {
-            // Parse vertex positions
-            XMFLOAT3 vertex{};
-            s >> vertex.x >> vertex.y >> vertex.z;
-            tempVertices.push_back(vertex);
-        }
-        else if (prefix == "f") {
-            // Parse face indices (supports various formats)
-            std::string vertexStr;
-            std::vector<UINT> faceIndices;
-
-            while (s >> vertexStr) {
-                std::istringstream vertexData(vertexStr);
-                std::string indexStr;
-                std::getline(vertexData, indexStr, '/');
-                UINT index = static_cast<UINT>(std::stoi(indexStr));
-                faceIndices.push_back(index - 1);  // Convert to 0-based index
-            }
-
-            // Triangulate face if necessary
-            for (size_t i = 1; i + 1 < faceIndices.size(); ++i) {
-                tempIndices.push_back(faceIndices[0]);
-                tempIndices.push_back(faceIndices[i]);
-                tempIndices.push_back(faceIndices[i + 1]);
-            }
+bool Mesh::LoadFromBakedFile(const std::string& bakedFile, const std::string& sourceFile) {
+    MeshData data;
+    return LoadMeshData(bakedFile, sourceFile, data) && Initialize(data);
+}
+
+bool Mesh::LoadMeshData(const std::string& bakedFile, const std::string& sourceFile, MeshData& data) {
+    BOG_PROFILE_ZONE("Mesh::LoadMeshData");
+    // A missing source is fine as long as a baked file ships in its place
+    uint64_t sourceHash = 0;
+    uint64_t sourceSize = 0;
+    bool haveSource = HashFile(sourceFile, sourceHash, sourceSize);
+
+    std::shared_ptr<BakedMeshFile> baked = std::make_shared<BakedMeshFile>();
+    if (baked->Open(bakedFile) && baked->GetHeader().vertexStride == GetVertexFormat().GetStride() &&
+        (!haveSource || baked->MatchesSource(sourceHash, sourceSize))) {
+        // The blobs are already in GPU layout, so the data keeps the mapping and uploads straight from it
+        const BakedMeshHeader& header = baked->GetHeader();
+        data.vertexCount = header.vertexCount;
+        data.indexStride = header.indexStride;
+        data.indexCount = header.indexCount;
+        data.positionRange = VertexQuantization::PositionRangeFromBounds(header.boundsMin, header.boundsMax);
+
+        data.lods.resize(header.lodCount);
+        const BakedMeshLod* lodData = baked->GetLodData();
+        for (uint32_t i = 0; i < header.lodCount; ++i) {
+            data.lods[i].firstIndex = lodData[i].firstIndex;
+            data.lods[i].indexCount = lodData[i].indexCount;
+            data.lods[i].error = lodData[i].error;
         }
+        data.bakedFile = baked;
+        return true;
     }
 
+    if (!haveSource) {
+        return false;
+    }
+
+    // The cache is stale or missing, so fall back to the OBJ and rebake it for
+    // the next launch. Only the cheap passes run here; optimized meshes with
+    // LODs come from the offline bake.
+    baked.reset();
+    ImportOptions options;
+    options.optimize = false;
+    options.generateLods = false;
+    if (!ImportOBJFile(sourceFile, options, data)) {
+        return false;
+    }
+
+    WriteBakedMesh(bakedFile, data, sourceHash, sourceSize);
+    return true;
+}
+
+bool Mesh::Initialize(const MeshData& data) {
+    if (data.indexStride != sizeof(uint16_t) && data.indexStride != sizeof(uint32_t)) {
+        return false;
+    }
+
+    IndexFormat format = (data.indexStride == sizeof(uint16_t)) ? IndexFormat::UInt16 : IndexFormat::UInt32;
+    if (!CreateBuffers(data.GetVertexData(), data.vertexCount, data.positionRange,
+        data.GetIndexData(), data.indexCount, format)) {
+        return false;
+    }
+
+    if (!data.lods.empty()) {
+        SetLods(data.lods.data(), static_cast<uint32_t>(data.lods.size()));
+    }
+    stats.weldBytesSaved = data.weldBytesSaved;
+    return true;
+}
+
+void Mesh::BuildFromOBJ(const ObjData& obj, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
     // Convert to vertices including default color
-    std::vector<Vertex> vertices;
-    for (const auto& v : tempVertices) {
-        Vertex vertex = { v.x, v.y, v.z, 1.0f, 1.0f, 1.0f };  // Default color: white
+    vertices.clear();
+    vertices.reserve(obj.positions.size());
+    for (const auto& p : obj.positions) {
+        Vertex vertex = { p.x, p.y, p.z, 1.0f, 1.0f, 1.0f };  // Default color: white
         vertices.push_back(vertex);
     }
 
-    return Initialize(vertices, tempIndices);
+    // Only positions are stored per vertex, so faces index them directly
+    indices.clear();
+    indices.reserve(obj.corners.size());
+    for (const auto& corner : obj.corners) {
+        indices.push_back(static_cast<uint32_t>(corner.position));
+    }
 }
 
+void Mesh::OptimizeGeometry(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+    // Allow overdraw ordering to cost up to 5% of the optimized cache efficiency
+    const float overdrawThreshold = 1.05f;
+
+    std::vector<uint32_t> cacheOrder(indices.size());
+    MeshProcessing::OptimizeVertexCache(cacheOrder.data(), indices.data(), indices.size(), vertices.size());
+    MeshProcessing::OptimizeOverdraw(indices.data(), cacheOrder.data(), cacheOrder.size(),
+        vertices.data(), vertices.size(), sizeof(Vertex), overdrawThreshold);
 
-void Mesh::SetPosition(float x, float y, float z) {
-    posX = x;
-    posY = y;
-    posZ = z;
+    std::vector<Vertex> fetchOrder(vertices.size());
+    size_t vertexCount = MeshProcessing::OptimizeVertexFetch(fetchOrder.data(), indices.data(), indices.size(),
+        vertices.data(), vertices.size(), sizeof(Vertex));
+    fetchOrder.resize(vertexCount);
+    vertices.swap(fetchOrder);
 }
 
-void Mesh::SetRotation(float pitch, float yaw, float roll) {
-    rotX = pitch;
-    rotY = yaw;
-    rotZ = roll;
+void Mesh::GenerateLods(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices,
+    std::vector<MeshProcessing::Lod>& lods) {
+    MeshProcessing::GenerateLods(indices, vertices.data(), vertices.size(), sizeof(Vertex),
+        DefaultLodErrors, sizeof(DefaultLodErrors) / sizeof(DefaultLodErrors[0]), lods);
 }
 
-void Mesh::SetScale(float x, float y, float z) {
-    scaleX = x;
-    scaleY = y;
-    scaleZ = z;
+bool Mesh::BakeOBJFile(const std::string& sourceFile, const std::string& bakedFile) {
+    uint64_t sourceHash = 0;
+    uint64_t sourceSize = 0;
+    if (!HashFile(sourceFile, sourceHash, sourceSize)) {
+        return false;
+    }
+
+    MeshData data;
+    return ImportOBJFile(sourceFile, ImportOptions(), data) && WriteBakedMesh(bakedFile, data, sourceHash, sourceSize);
+}
+
+void Mesh::GetWorldBounds(const XMFLOAT4X4& worldMatrix, XMFLOAT3& center, XMFLOAT3& extents) const {
+    const XMFLOAT4X4& m = worldMatrix;
+    XMStoreFloat3(&center, XMVector3TransformCoord(XMLoadFloat3(&boundsCenter), XMLoadFloat4x4(&m)));
+
+    // Each world axis gets the local extents weighted by the absolute matrix column
+    const XMFLOAT3& e = boundsExtents;
+    extents.x = std::fabs(m._11) * e.x + std::fabs(m._21) * e.y + std::fabs(m._31) * e.z;
+    extents.y = std::fabs(m._12) * e.x + std::fabs(m._22) * e.y + std::fabs(m._32) * e.z;
+    extents.z = std::fabs(m._13) * e.x + std::fabs(m._23) * e.y + std::fabs(m._33) * e.z;
 }
@@ -1,10 +1,17 @@
 // Mesh.h
 
 #pragma once
-#include <d3d11.h>
 #include <DirectXMath.h>
+#include <cstdint>
 #include <vector>
 #include <string>
+#include "GeometryPool.h"
+#include "MeshData.h"
+#include "MeshProcessing.h"
+#include "RenderBackend.h"
+#include "VertexFormat.h"
+
+struct ObjData;
 
 class Mesh {
 public:
@@ -13,47 +20,160 @@ public:
         float r, g, b;      // Color
     };
 
-    Mesh(ID3D11Device* device, ID3D11DeviceContext* context);
+    // Buffer sizes and the bytes saved by vertex welding, quantization and 16-bit indices
+    struct Stats {
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        uint32_t vertexBufferBytes;
+        uint32_t indexBufferBytes;
+        uint32_t weldBytesSaved;
+        uint32_t quantizeBytesSaved;
+        uint32_t indexBytesSaved;
+        uint32_t lodCount;
+    };
+
+    // Camera state used to pick a level of detail from its projected error
+    struct LodView {
+        DirectX::XMFLOAT3 cameraPosition;
+        float pixelsPerUnit;        // Viewport height over the height of the view frustum at distance 1
+        float maxPixelError;
+    };
+
+    // With a geometry pool the mesh is a range of the pool's buffers rather
+    // than buffers of its own. The pool must outlive the mesh.
+    explicit Mesh(RenderBackend* backend, GeometryPool* geometryPool = nullptr);
     ~Mesh();
 
-    bool Initialize(const std::vector<Vertex>& vertices, const std::vector<UINT>& indices);
-    void Update(float deltaTime);
-    void Draw(const DirectX::XMMATRIX& viewProjMatrix);
+    // Welds duplicate vertices before creating the buffers
+    bool Initialize(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+
+    // Vertices are quantized to GetVertexFormat(). Uses 16-bit indices whenever
+    // the vertex count allows it.
+    bool Initialize(const Vertex* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount);
+    bool Initialize(const Vertex* vertices, uint32_t vertexCount, const uint16_t* indices, uint32_t indexCount);
+
+    // Creates the buffers for mesh data that is already encoded
+    bool Initialize(const MeshData& data);
+
+    // False until the buffers exist, for meshes that are still streaming in
+    bool IsResident() const {
+        return geometry != InvalidGeometry || (vertexBuffer != InvalidBuffer && indexBuffer != InvalidBuffer);
+    }
 
-    // Transformation methods
-    void SetPosition(float x, float y, float z);
-    void SetRotation(float pitch, float yaw, float roll);
-    void SetScale(float x, float y, float z);
+    // Draws the mesh at the given world transform
+    void Draw(const DirectX::XMMATRIX& worldMatrix, const DirectX::XMMATRIX& viewProjMatrix);
+    void Draw(const DirectX::XMMATRIX& worldMatrix, const DirectX::XMMATRIX& viewProjMatrix, const LodView& view);
+
+    // Draws one LOD for every world matrix in the slot 1 instance buffer. The
+    // instanced vertex shader gets the view-projection and dequantization
+    // matrices instead of this mesh's transform.
+    void DrawInstanced(BufferHandle instanceBuffer, uint32_t instanceCount,
+        const DirectX::XMMATRIX& viewProjMatrix, uint32_t lod);
+
+    // Replaces the LOD table. Every level must lie within the index buffer.
+    bool SetLods(const MeshProcessing::Lod* levels, uint32_t levelCount);
+
+    // Returns the coarsest level whose projected error stays under the limit
+    // for the mesh drawn at the given world transform
+    uint32_t SelectLod(const DirectX::XMFLOAT4X4& worldMatrix, const LodView& view) const;
+
+    // World-space AABB as center and half extents under the given world transform
+    void GetWorldBounds(const DirectX::XMFLOAT4X4& worldMatrix, DirectX::XMFLOAT3& center, DirectX::XMFLOAT3& extents) const;
+
+    // Occluders keep a CPU copy of their triangles in mesh space for software
+    // occlusion culling. Must be set before Initialize.
+    void SetOccluder(bool enabled) { occluder = enabled; }
+    bool IsOccluder() const { return occluder; }
+    const std::vector<float>& GetOccluderPositions() const { return occluderPositions; }
+    const std::vector<uint32_t>& GetOccluderIndices() const { return occluderIndices; }
+
+    // Unique per mesh, used to group draws in render queue sort keys
+    uint32_t GetId() const { return id; }
 
     bool LoadFromOBJFile(const std::string& filename);
 
+    // Passes an OBJ import runs besides welding and index narrowing
+    struct ImportOptions {
+        bool optimize = true;           // OptimizeGeometry
+        bool generateLods = true;
+    };
+
+    // Loads a baked .bogmesh file, re-parsing and rebaking the source OBJ when
+    // the cache is missing or was baked from different source contents. That
+    // runtime rebake skips the optimization and LOD passes, which only the
+    // offline BakeOBJFile runs.
+    bool LoadFromBakedFile(const std::string& bakedFile, const std::string& sourceFile);
+
+    // The device-free half of LoadFromBakedFile, safe to call from worker threads
+    static bool LoadMeshData(const std::string& bakedFile, const std::string& sourceFile, MeshData& data);
+
+    static void BuildFromOBJ(const ObjData& obj, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+    // Optional import stage: reorders triangles for the post-transform cache and
+    // overdraw, then vertices for fetch locality. Offline bakes always go through it.
+    static void OptimizeGeometry(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+    // Appends simplified levels to indices using the default error targets
+    static void GenerateLods(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices,
+        std::vector<MeshProcessing::Lod>& lods);
+
+    // Offline bake with every import pass
+    static bool BakeOBJFile(const std::string& sourceFile, const std::string& bakedFile);
+
+    const Stats& GetStats() const { return stats; }
+
+    // Layout of the vertex buffer: positions quantized to the mesh bounds and 8-bit colors
+    static const VertexFormat& GetVertexFormat();
+
+    // Encodes vertices into GetVertexFormat() relative to the given range
+    static void EncodeVertices(const Vertex* vertices, uint32_t vertexCount,
+        const VertexQuantization::PositionRange& range, std::vector<unsigned char>& encoded);
+
 private:
     struct CBPerObject {
         DirectX::XMMATRIX worldViewProj;
         DirectX::XMMATRIX world;
     };
 
-    // Buffers
-    ID3D11Buffer* vertexBuffer;
-    ID3D11Buffer* indexBuffer;
-    ID3D11Buffer* constantBuffer;
+    bool CreateBuffers(const void* encodedVertices, uint32_t vertexCount, const VertexQuantization::PositionRange& range,
+        const void* indices, uint32_t indexCount, IndexFormat format);
+    void DrawLod(const DirectX::XMMATRIX& worldMatrix, const DirectX::XMMATRIX& viewProjMatrix, const MeshProcessing::Lod& lod);
+
+    // Binds the vertex and index buffers and returns where the mesh starts in them
+    void BindBuffers(uint32_t& firstIndex, int32_t& baseVertex) const;
+
+    // Buffers of unpooled meshes
+    BufferHandle vertexBuffer;
+    BufferHandle indexBuffer;
+
+    // Range of pooled meshes
+    GeometryPool* geometryPool;
+    GeometryHandle geometry;
+
+    // Dequantizes vertex positions
+    DirectX::XMMATRIX positionTransform;
+
+    // Creates the buffers and receives the draws
+    RenderBackend* backend;
+
+    // Index count and format
+    uint32_t indexCount;
+    IndexFormat indexFormat;
 
-    // Transformation matrices
-    DirectX::XMMATRIX worldMatrix;
-    DirectX::XMMATRIX rotationMatrix;
-    DirectX::XMMATRIX scaleMatrix;
-    DirectX::XMMATRIX translationMatrix;
+    // Levels of detail share the index buffer, level 0 is the full mesh
+    std::vector<MeshProcessing::Lod> lods;
+    float boundingRadius;
 
-    // Transformation parameters
-    float posX, posY, posZ;
-    float rotX, rotY, rotZ;
-    float scaleX, scaleY, scaleZ;
+    // Mesh-space AABB of the vertices
+    DirectX::XMFLOAT3 boundsCenter;
+    DirectX::XMFLOAT3 boundsExtents;
 
-    // Device and context
-    ID3D11Device* device;
-    ID3D11DeviceContext* context;
+    // Decoded positions (three floats each) and indices of occluder meshes
+    bool occluder;
+    std::vector<float> occluderPositions;
+    std::vector<uint32_t> occluderIndices;
 
-    // Index count
-    UINT indexCount;
+    Stats stats;
+    uint32_t id;
 
 };
@@ -0,0 +1,150 @@
+// MeshCache.cpp
+
+#include "MeshCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace {
+
+    const char BakedMeshMagic[4] = { 'B', 'O', 'G', 'M' };
+
+    inline uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    void WritePadding(std::ofstream& stream, uint64_t from, uint64_t to) {
+        static const char zeros[BakedMeshFile::BlobAlignment] = {};
+        stream.write(zeros, static_cast<std::streamsize>(to - from));
+    }
+
+}
+
+BakedMeshFile::BakedMeshFile()
+    : header(nullptr)
+{
+}
+
+bool BakedMeshFile::Write(const std::string& filename,
+    const void* vertices, uint32_t vertexStride, uint32_t vertexCount,
+    const float boundsMin[3], const float boundsMax[3],
+    const void* indices, uint32_t indexStride, uint32_t indexCount,
+    const BakedMeshLod* lods, uint32_t lodCount,
+    uint64_t sourceHash, uint64_t sourceSize) {
+
+    BakedMeshHeader fileHeader = {};
+    std::memcpy(fileHeader.magic, BakedMeshMagic, sizeof(BakedMeshMagic));
+    fileHeader.version = Version;
+    fileHeader.vertexStride = vertexStride;
+    fileHeader.vertexCount = vertexCount;
+    fileHeader.indexStride = indexStride;
+    fileHeader.indexCount = indexCount;
+    fileHeader.lodCount = lodCount;
+    fileHeader.sourceHash = sourceHash;
+    fileHeader.sourceSize = sourceSize;
+
+    uint64_t vertexBytes = uint64_t(vertexStride) * vertexCount;
+    uint64_t indexBytes = uint64_t(indexStride) * indexCount;
+    uint64_t lodBytes = uint64_t(sizeof(BakedMeshLod)) * lodCount;
+    fileHeader.vertexOffset = AlignUp(sizeof(BakedMeshHeader), BlobAlignment);
+    fileHeader.indexOffset = AlignUp(fileHeader.vertexOffset + vertexBytes, BlobAlignment);
+    fileHeader.lodOffset = AlignUp(fileHeader.indexOffset + indexBytes, BlobAlignment);
+
+    for (int axis = 0; axis < 3; ++axis) {
+        fileHeader.boundsMin[axis] = boundsMin[axis];
+        fileHeader.boundsMax[axis] = boundsMax[axis];
+    }
+
+    std::ofstream stream(filename, std::ios::binary | std::ios::trunc);
+    if (!stream.is_open()) {
+        return false;
+    }
+
+    stream.write(reinterpret_cast<const char*>(&fileHeader), sizeof(fileHeader));
+    WritePadding(stream, sizeof(fileHeader), fileHeader.vertexOffset);
+    stream.write(static_cast<const char*>(vertices), static_cast<std::streamsize>(vertexBytes));
+    WritePadding(stream, fileHeader.vertexOffset + vertexBytes, fileHeader.indexOffset);
+    stream.write(static_cast<const char*>(indices), static_cast<std::streamsize>(indexBytes));
+    WritePadding(stream, fileHeader.indexOffset + indexBytes, fileHeader.lodOffset);
+    stream.write(reinterpret_cast<const char*>(lods), static_cast<std::streamsize>(lodBytes));
+    stream.close();
+
+    if (stream.fail()) {
+        // Never leave a truncated cache behind
+        std::remove(filename.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool BakedMeshFile::Open(const std::string& filename) {
+    Close();
+
+    if (!file.Open(filename)) {
+        return false;
+    }
+
+    const uint64_t fileSize = file.GetSize();
+    if (fileSize < sizeof(BakedMeshHeader)) {
+        Close();
+        return false;
+    }
+
+    const BakedMeshHeader* candidate = reinterpret_cast<const BakedMeshHeader*>(file.GetData());
+    const uint64_t vertexBytes = uint64_t(candidate->vertexStride) * candidate->vertexCount;
+    const uint64_t indexBytes = uint64_t(candidate->indexStride) * candidate->indexCount;
+    const uint64_t lodBytes = uint64_t(sizeof(BakedMeshLod)) * candidate->lodCount;
+
+    bool valid =
+        std::memcmp(candidate->magic, BakedMeshMagic, sizeof(BakedMeshMagic)) == 0 &&
+        candidate->version == Version &&
+        (candidate->indexStride == sizeof(uint32_t) ||
+            (candidate->indexStride == sizeof(uint16_t) && candidate->vertexCount <= 0x10000)) &&
+        candidate->vertexOffset % BlobAlignment == 0 &&
+        candidate->indexOffset % BlobAlignment == 0 &&
+        candidate->vertexOffset >= sizeof(BakedMeshHeader) &&
+        candidate->vertexOffset <= fileSize && vertexBytes <= fileSize - candidate->vertexOffset &&
+        candidate->indexOffset <= fileSize && indexBytes <= fileSize - candidate->indexOffset &&
+        candidate->lodOffset % BlobAlignment == 0 &&
+        candidate->lodOffset <= fileSize && lodBytes <= fileSize - candidate->lodOffset;
+
+    // Every level has to stay inside the index blob
+    if (valid) {
+        const BakedMeshLod* lods = reinterpret_cast<const BakedMeshLod*>(file.GetData() + candidate->lodOffset);
+        for (uint32_t i = 0; i < candidate->lodCount && valid; ++i) {
+            valid = lods[i].indexCount % 3 == 0 && lods[i].firstIndex <= candidate->indexCount &&
+                lods[i].indexCount <= candidate->indexCount - lods[i].firstIndex;
+        }
+    }
+
+    if (!valid) {
+        Close();
+        return false;
+    }
+
+    header = candidate;
+    return true;
+}
+
+void BakedMeshFile::Close() {
+    file.Close();
+    header = nullptr;
+}
+
+bool BakedMeshFile::MatchesSource(uint64_t sourceHash, uint64_t sourceSize) const {
+    return header && header->sourceHash == sourceHash && header->sourceSize == sourceSize;
+}
+
+const void* BakedMeshFile::GetVertexData() const {
+    return file.GetData() + header->vertexOffset;
+}
+
+const void* BakedMeshFile::GetIndexData() const {
+    return file.GetData() + header->indexOffset;
+}
+
+const BakedMeshLod* BakedMeshFile::GetLodData() const {
+    return reinterpret_cast<const BakedMeshLod*>(file.GetData() + header->lodOffset);
+}
@@ -0,0 +1,67 @@
+// MeshCache.h
+
+#pragma once
+#include "MappedFile.h"
+#include <cstdint>
+#include <string>
+
+// On-disk layout of a baked .bogmesh file. The vertex, index and LOD blobs
+// start on 16-byte boundaries so they can be passed to the GPU straight out
+// of the file mapping.
+struct BakedMeshHeader {
+    char magic[4];              // "BOGM"
+    uint32_t version;
+    uint32_t vertexStride;
+    uint32_t vertexCount;
+    uint32_t indexStride;       // 2 or 4 bytes
+    uint32_t indexCount;
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint64_t sourceHash;        // Content hash of the file the mesh was baked from
+    uint64_t sourceSize;
+    float boundsMin[3];         // Also the range quantized positions are relative to
+    float boundsMax[3];
+    uint32_t lodCount;
+    uint32_t reserved;
+    uint64_t lodOffset;
+};
+
+// Range of the shared index blob drawn for one level of detail
+struct BakedMeshLod {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    float error;                // Simplification error in mesh units
+};
+
+// Read-only view of a memory-mapped .bogmesh file
+class BakedMeshFile {
+public:
+    static const uint32_t Version = 6;
+    static const uint32_t BlobAlignment = 16;
+
+    BakedMeshFile();
+
+    // Writes a baked mesh with vertices already in their GPU encoding. Every LOD
+    // addresses the index blob.
+    static bool Write(const std::string& filename,
+        const void* vertices, uint32_t vertexStride, uint32_t vertexCount,
+        const float boundsMin[3], const float boundsMax[3],
+        const void* indices, uint32_t indexStride, uint32_t indexCount,
+        const BakedMeshLod* lods, uint32_t lodCount,
+        uint64_t sourceHash, uint64_t sourceSize);
+
+    // Maps the file and validates its header, version, blob and LOD ranges
+    bool Open(const std::string& filename);
+    void Close();
+
+    bool MatchesSource(uint64_t sourceHash, uint64_t sourceSize) const;
+
+    const BakedMeshHeader& GetHeader() const { return *header; }
+    const void* GetVertexData() const;
+    const void* GetIndexData() const;
+    const BakedMeshLod* GetLodData() const;
+
+private:
+    MappedFile file;
+    const BakedMeshHeader* header;
+};
@@ -0,0 +1,38 @@
+// MeshData.h
+
+#pragma once
+#include "MeshCache.h"
+#include "MeshProcessing.h"
+#include "VertexQuantization.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// CPU-side mesh ready for upload. Vertices are already in Mesh::GetVertexFormat()
+// and indices are indexStride (2 or 4) bytes each. Building one needs no device,
+// so it can happen on any thread.
+struct MeshData {
+    std::vector<unsigned char> vertices;
+    uint32_t vertexCount = 0;
+    std::vector<unsigned char> indices;
+    uint32_t indexStride = 0;
+    uint32_t indexCount = 0;
+    VertexQuantization::PositionRange positionRange = {};
+    std::vector<MeshProcessing::Lod> lods;
+    uint32_t weldBytesSaved = 0;
+
+    // Set when the blobs live in a baked file instead of the vectors above. The
+    // mapping stays open until the data is destroyed, so uploads read straight
+    // out of it without a copy.
+    std::shared_ptr<const BakedMeshFile> bakedFile;
+
+    const void* GetVertexData() const { return bakedFile ? bakedFile->GetVertexData() : vertices.data(); }
+    const void* GetIndexData() const { return bakedFile ? bakedFile->GetIndexData() : indices.data(); }
+    uint64_t GetVertexBytes() const {
+        return bakedFile ? uint64_t(bakedFile->GetHeader().vertexStride) * vertexCount : vertices.size();
+    }
+    uint64_t GetIndexBytes() const { return uint64_t(indexStride) * indexCount; }
+
+    // Bytes the upload will copy to the GPU
+    uint64_t GetUploadBytes() const { return GetVertexBytes() + GetIndexBytes(); }
+};
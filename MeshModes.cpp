@@ -0,0 +1,1241 @@
+// MeshModes.cpp
+
+#include "HeadlessModes.h"
+#include "AssetStreamer.h"
+#include "GeometryPool.h"
+#include "Hash.h"
+#include "HeadlessBackend.h"
+#include "Log.h"
+#include "Mesh.h"
+#include "MeshCache.h"
+#include "MeshData.h"
+#include "MeshProcessing.h"
+#include "MeshRegistry.h"
+#include "ObjParser.h"
+#include "OffsetAllocator.h"
+#include "RenderBackend.h"
+#include "ShapeGenerator.h"
+#include "VertexQuantization.h"
+
+#include <DirectXMath.h>
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace DirectX;
+
+namespace {
+    // The line-by-line istringstream loader ObjParser replaced, kept as the
+    // baseline of the parse benchmark. Reads positions and the position index
+    // of each face corner.
+    bool LoadObjWithStreams(const std::string& filename, std::vector<XMFLOAT3>& positions, std::vector<uint32_t>& indices) {
+        std::ifstream file(filename);
+        if (!file) {
+            return false;
+        }
+
+        std::string line;
+        std::vector<uint32_t> faceIndices;
+        while (std::getline(file, line)) {
+            std::istringstream s(line);
+            std::string prefix;
+            s >> prefix;
+
+            if (prefix == "v") {
+                XMFLOAT3 position{};
+                s >> position.x >> position.y >> position.z;
+                positions.push_back(position);
+            }
+            else if (prefix == "f") {
+                std::string vertexText;
+                faceIndices.clear();
+                while (s >> vertexText) {
+                    std::istringstream vertexData(vertexText);
+                    std::string indexText;
+                    std::getline(vertexData, indexText, '/');
+                    faceIndices.push_back(static_cast<uint32_t>(std::stoi(indexText)) - 1);
+                }
+                for (size_t i = 1; i + 1 < faceIndices.size(); ++i) {
+                    indices.push_back(faceIndices[0]);
+                    indices.push_back(faceIndices[i]);
+                    indices.push_back(faceIndices[i + 1]);
+                }
+            }
+        }
+        return true;
+    }
+
+    // Writes a bumpy square grid of at least triangleCount triangles as an OBJ
+    // file with texture coordinates and normals, the way exporters write meshes.
+    // Faces are quads, so the parsers have to triangulate them.
+    bool WriteGridObj(const std::string& filename, size_t triangleCount) {
+        std::ofstream file(filename, std::ios::binary);
+        if (!file) {
+            return false;
+        }
+
+        uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(triangleCount * 0.5)));
+        uint32_t row = side + 1;
+        std::string text;
+        char line[160];
+        auto flush = [&]() {
+            file.write(text.data(), text.size());
+            text.clear();
+        };
+
+        for (uint32_t z = 0; z < row; ++z) {
+            for (uint32_t x = 0; x < row; ++x) {
+                float height = 0.25f * std::sin(x * 0.1f) * std::cos(z * 0.1f);
+                snprintf(line, sizeof(line), "v %.6f %.6f %.6f\nvt %.6f %.6f\nvn 0.000000 1.000000 0.000000\n",
+                    x * 0.01f, height, z * 0.01f, static_cast<float>(x) / side, static_cast<float>(z) / side);
+                text += line;
+            }
+            flush();
+        }
+        for (uint32_t z = 0; z < side; ++z) {
+            for (uint32_t x = 0; x < side; ++x) {
+                uint32_t a = z * row + x + 1;
+                uint32_t b = a + row;
+                snprintf(line, sizeof(line), "f %u/%u/%u %u/%u/%u %u/%u/%u %u/%u/%u\n",
+                    a, a, a, b, b, b, b + 1, b + 1, b + 1, a + 1, a + 1, a + 1);
+                text += line;
+            }
+            flush();
+        }
+        return static_cast<bool>(file);
+    }
+
+    // Geometry the mesh processing tests run their passes over
+    struct TestMesh {
+        explicit TestMesh(const char* name) : name(name) {}
+
+        const char* name;
+        std::vector<Mesh::Vertex> vertices;
+        std::vector<uint32_t> indices;
+    };
+
+    // A bumpy square grid of side * side quads, two triangles each, colored by position
+    void BuildGridMesh(uint32_t side, std::vector<Mesh::Vertex>& vertices, std::vector<uint32_t>& indices) {
+        uint32_t row = side + 1;
+        vertices.clear();
+        indices.clear();
+        for (uint32_t z = 0; z < row; ++z) {
+            for (uint32_t x = 0; x < row; ++x) {
+                float u = static_cast<float>(x) / side;
+                float v = static_cast<float>(z) / side;
+                float height = 0.05f * std::sin(x * 0.3f) * std::cos(z * 0.2f);
+                vertices.push_back(Mesh::Vertex{ u, height, v, u, 0.5f, v });
+            }
+        }
+        for (uint32_t z = 0; z < side; ++z) {
+            for (uint32_t x = 0; x < side; ++x) {
+                uint32_t a = z * row + x;
+                uint32_t b = a + row;
+                indices.insert(indices.end(), { a, b, b + 1, a, b + 1, a + 1 });
+            }
+        }
+    }
+
+}
+
+// Parse benchmark: BogEngine.exe -obj-parse-benchmark [triangles]
+// Loads icosphere.obj and a generated grid of about the given number of
+// triangles with the old istringstream loader and with ObjParser on one
+// thread, logging the time of each. Fails unless both give the same
+// positions, to float rounding, and the same indices.
+int RunObjParseBenchmark(const CommandLine& commandLine) {
+    size_t triangleCount = commandLine.GetCount(2000000);
+
+    const std::string gridFile = "obj_parse_benchmark.obj";
+    if (!WriteGridObj(gridFile, triangleCount)) {
+        LogMessage("Obj parse benchmark: failed to write the grid file\n");
+        return 1;
+    }
+
+    bool valid = true;
+    const std::string files[] = { "icosphere.obj", gridFile };
+    for (const std::string& filename : files) {
+        std::vector<XMFLOAT3> streamPositions;
+        std::vector<uint32_t> streamIndices;
+        auto streamStart = std::chrono::steady_clock::now();
+        bool streamLoaded = LoadObjWithStreams(filename, streamPositions, streamIndices);
+        std::chrono::duration<double, std::milli> streamTime = std::chrono::steady_clock::now() - streamStart;
+
+        ObjData data;
+        auto parseStart = std::chrono::steady_clock::now();
+        bool parsed = ObjParser::ParseFile(filename, data, 1);
+        std::chrono::duration<double, std::milli> parseTime = std::chrono::steady_clock::now() - parseStart;
+
+        bool same = streamLoaded && parsed && data.positions.size() == streamPositions.size() &&
+            data.corners.size() == streamIndices.size();
+        for (size_t i = 0; same && i < streamPositions.size(); ++i) {
+            const ObjData::Float3& a = data.positions[i];
+            const XMFLOAT3& b = streamPositions[i];
+            float tolerance = 1e-6f * std::max(std::max(std::fabs(b.x), std::fabs(b.y)), std::max(std::fabs(b.z), 1.0f));
+            same = std::fabs(a.x - b.x) <= tolerance && std::fabs(a.y - b.y) <= tolerance && std::fabs(a.z - b.z) <= tolerance;
+        }
+        for (size_t i = 0; same && i < streamIndices.size(); ++i) {
+            same = data.corners[i].position == static_cast<int32_t>(streamIndices[i]);
+        }
+        if (!same) {
+            valid = false;
+        }
+
+        std::ifstream sizeCheck(filename, std::ios::binary | std::ios::ate);
+        double megabytes = static_cast<double>(sizeCheck.tellg()) / (1024.0 * 1024.0);
+        LogMessage("Obj parse benchmark: %s (%.1f MB, %zu positions, %zu triangles): "
+            "istringstream %.1f ms, ObjParser %.1f ms (%.0f MB/s), %.1fx%s\n",
+            filename.c_str(), megabytes, data.positions.size(), data.corners.size() / 3,
+            streamTime.count(), parseTime.count(), parseTime.count() > 0.0 ? megabytes * 1000.0 / parseTime.count() : 0.0,
+            parseTime.count() > 0.0 ? streamTime.count() / parseTime.count() : 0.0, same ? "" : ", outputs differ");
+    }
+
+    std::remove(gridFile.c_str());
+    LogMessage(valid ? "Obj parse benchmark: passed\n" : "Obj parse benchmark: FAILED\n");
+    return valid ? 0 : 1;
+}
+
+// Mesh cache benchmark: BogEngine.exe -mesh-cache-benchmark [triangles]
+// Loads icosphere.obj and a generated grid of about the given number of
+// triangles onto the headless backend three ways: from the OBJ text, cold
+// from a missing cache (importing and baking it) and warm from the baked
+// file, averaged over several loads. Then edits the source and fails unless
+// the next load notices the stale cache and rebakes it.
+int RunMeshCacheBenchmark(const CommandLine& commandLine) {
+    size_t triangleCount = commandLine.GetCount(200000);
+
+    const std::string gridFile = "mesh_cache_benchmark.obj";
+    if (!WriteGridObj(gridFile, triangleCount)) {
+        LogMessage("Mesh cache benchmark: failed to write the grid file\n");
+        return 1;
+    }
+
+    HeadlessBackend backend;
+    if (!backend.Initialize(64, 64)) {
+        return 1;
+    }
+
+    bool valid = true;
+    auto expect = [&valid](bool condition, const char* failure) {
+        if (!condition) {
+            LogMessage("Mesh cache benchmark: %s\n", failure);
+            valid = false;
+        }
+    };
+    auto milliseconds = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    const int warmLoads = 10;
+    const std::string sources[] = { "icosphere.obj", gridFile };
+    for (const std::string& sourceFile : sources) {
+        // A scratch cache, so the one the game ships is left alone
+        const std::string bakedFile = sourceFile.substr(0, sourceFile.find_last_of('.')) + "_benchmark.bogmesh";
+        std::remove(bakedFile.c_str());
+
+        auto start = std::chrono::steady_clock::now();
+        Mesh textMesh(&backend);
+        expect(textMesh.LoadFromOBJFile(sourceFile), "text load failed");
+        double textMilliseconds = milliseconds(start);
+
+        start = std::chrono::steady_clock::now();
+        Mesh coldMesh(&backend);
+        expect(coldMesh.LoadFromBakedFile(bakedFile, sourceFile), "cold load failed");
+        double coldMilliseconds = milliseconds(start);
+
+        double warmMilliseconds = 0.0;
+        for (int load = 0; load < warmLoads; ++load) {
+            start = std::chrono::steady_clock::now();
+            Mesh warmMesh(&backend);
+            expect(warmMesh.LoadFromBakedFile(bakedFile, sourceFile), "warm load failed");
+            warmMilliseconds += milliseconds(start);
+            expect(warmMesh.GetStats().vertexCount == coldMesh.GetStats().vertexCount &&
+                warmMesh.GetStats().indexCount == coldMesh.GetStats().indexCount, "warm load differs from the cold one");
+        }
+        warmMilliseconds /= warmLoads;
+
+        LogMessage("Mesh cache benchmark: %s, %u vertices, %u indices: text %.2f ms, "
+            "cold %.2f ms (import and bake), warm %.3f ms, %.1fx faster than text\n",
+            sourceFile.c_str(), coldMesh.GetStats().vertexCount, coldMesh.GetStats().indexCount,
+            textMilliseconds, coldMilliseconds, warmMilliseconds,
+            warmMilliseconds > 0.0 ? textMilliseconds / warmMilliseconds : 0.0);
+        std::remove(bakedFile.c_str());
+    }
+
+    // A changed source makes the cache stale, so the load rebakes it from the new contents
+    const std::string bakedFile = "mesh_cache_benchmark_stale.bogmesh";
+    Mesh firstMesh(&backend);
+    expect(firstMesh.LoadFromBakedFile(bakedFile, gridFile), "load before the edit failed");
+    std::ofstream(gridFile, std::ios::app) << "# edited\n";
+    uint64_t sourceHash = 0;
+    uint64_t sourceSize = 0;
+    BakedMeshFile baked;
+    expect(HashFile(gridFile, sourceHash, sourceSize) && baked.Open(bakedFile) && !baked.MatchesSource(sourceHash, sourceSize),
+        "cache still matches the edited source");
+    baked.Close();
+    Mesh editedMesh(&backend);
+    expect(editedMesh.LoadFromBakedFile(bakedFile, gridFile), "load after the edit failed");
+    expect(baked.Open(bakedFile) && baked.MatchesSource(sourceHash, sourceSize), "stale cache was not rebaked");
+    baked.Close();
+
+    std::remove(bakedFile.c_str());
+    std::remove(gridFile.c_str());
+    LogMessage(valid ? "Mesh cache benchmark: passed\n" : "Mesh cache benchmark: FAILED\n");
+    return valid ? 0 : 1;
+}
+
+// Parse scaling benchmark: BogEngine.exe -obj-scaling-benchmark [triangles]
+// Parses a generated grid OBJ of about the given number of triangles with
+// ObjParser on 1, 2, 4, 8 and 16 threads, logging the best of three runs
+// and the speedup over one thread. Fails unless every thread count gives
+// output byte-identical to the single-threaded parse.
+int RunObjScalingBenchmark(const CommandLine& commandLine) {
+    size_t triangleCount = commandLine.GetCount(2000000);
+
+    const std::string gridFile = "obj_scaling_benchmark.obj";
+    if (!WriteGridObj(gridFile, triangleCount)) {
+        LogMessage("Parse scaling benchmark: failed to write the grid file\n");
+        return 1;
+    }
+
+    auto sameBytes = [](const auto& a, const auto& b) {
+        return a.size() == b.size() && (a.empty() || std::memcmp(a.data(), b.data(), a.size() * sizeof(a[0])) == 0);
+    };
+
+    const int runs = 3;
+    const unsigned threadCounts[] = { 1, 2, 4, 8, 16 };
+    bool valid = true;
+    ObjData serial;
+    double serialMilliseconds = 0.0;
+    for (unsigned threads : threadCounts) {
+        double bestMilliseconds = 0.0;
+        bool identical = true;
+        for (int run = 0; run < runs; ++run) {
+            ObjData data;
+            auto start = std::chrono::steady_clock::now();
+            bool parsed = ObjParser::ParseFile(gridFile, data, threads);
+            double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            bestMilliseconds = (run == 0) ? milliseconds : std::min(bestMilliseconds, milliseconds);
+
+            if (threads == 1 && run == 0) {
+                serial = std::move(data);
+                identical = parsed;
+            }
+            else {
+                identical = identical && parsed && sameBytes(data.positions, serial.positions) &&
+                    sameBytes(data.texcoords, serial.texcoords) && sameBytes(data.normals, serial.normals) &&
+                    sameBytes(data.corners, serial.corners);
+            }
+        }
+        if (threads == 1) {
+            serialMilliseconds = bestMilliseconds;
+        }
+        valid = valid && identical;
+
+        LogMessage("Parse scaling benchmark: %zu triangles, %u threads, %.1f ms, %.2fx%s\n",
+            serial.corners.size() / 3, threads, bestMilliseconds,
+            bestMilliseconds > 0.0 ? serialMilliseconds / bestMilliseconds : 0.0, identical ? "" : ", output differs");
+    }
+
+    std::remove(gridFile.c_str());
+    LogMessage(valid ? "Parse scaling benchmark: passed\n" : "Parse scaling benchmark: FAILED\n");
+    return valid ? 0 : 1;
+}
+
+// Mesh optimization test: BogEngine.exe -mesh-optimize-test [triangles]
+// Runs the vertex cache, overdraw and vertex fetch passes over icosphere.obj
+// and a grid of about the given number of triangles in shuffled order. Fails
+// unless two runs give identical output, every triangle survives with its
+// winding and the cache miss ratio does not get worse. Logs the ACMR and
+// ATVR before and after.
+int RunMeshOptimizeTest(const CommandLine& commandLine) {
+    size_t triangleCount = commandLine.GetCount(200000);
+
+    TestMesh meshes[2] = { TestMesh("icosphere.obj"), TestMesh("Shuffled grid") };
+
+    ObjData obj;
+    if (!ObjParser::ParseFile("icosphere.obj", obj)) {
+        LogMessage("Mesh optimization test: failed to load icosphere.obj\n");
+        return 1;
+    }
+    Mesh::BuildFromOBJ(obj, meshes[0].vertices, meshes[0].indices);
+
+    // Triangles in random order, the worst case for the cache
+    TestMesh& grid = meshes[1];
+    BuildGridMesh(static_cast<uint32_t>(std::ceil(std::sqrt(triangleCount * 0.5))), grid.vertices, grid.indices);
+    std::vector<uint32_t> order(grid.indices.size() / 3);
+    for (uint32_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::shuffle(order.begin(), order.end(), std::mt19937(1234));
+    std::vector<uint32_t> shuffled;
+    shuffled.reserve(grid.indices.size());
+    for (uint32_t triangle : order) {
+        shuffled.insert(shuffled.end(), grid.indices.begin() + triangle * 3, grid.indices.begin() + triangle * 3 + 3);
+    }
+    grid.indices.swap(shuffled);
+
+    // Triangles as their corner vertices, starting from the smallest corner
+    // so the winding is kept but the starting corner does not matter
+    typedef std::array<Mesh::Vertex, 3> Triangle;
+    auto less = [](const Mesh::Vertex& a, const Mesh::Vertex& b) { return std::memcmp(&a, &b, sizeof(Mesh::Vertex)) < 0; };
+    auto triangleLess = [&less](const Triangle& a, const Triangle& b) {
+        return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end(), less);
+    };
+    auto triangles = [&](const TestMesh& mesh) {
+        std::vector<Triangle> result;
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+            Triangle triangle = { mesh.vertices[mesh.indices[i]], mesh.vertices[mesh.indices[i + 1]], mesh.vertices[mesh.indices[i + 2]] };
+            std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end(), less), triangle.end());
+            result.push_back(triangle);
+        }
+        std::sort(result.begin(), result.end(), triangleLess);
+        return result;
+    };
+    auto sameBytes = [](const auto& a, const auto& b) {
+        return a.size() == b.size() && (a.empty() || std::memcmp(a.data(), b.data(), a.size() * sizeof(a[0])) == 0);
+    };
+
+    bool valid = true;
+    for (const TestMesh& mesh : meshes) {
+        TestMesh first = mesh;
+        TestMesh second = mesh;
+        auto start = std::chrono::steady_clock::now();
+        Mesh::OptimizeGeometry(first.vertices, first.indices);
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        Mesh::OptimizeGeometry(second.vertices, second.indices);
+
+        bool deterministic = sameBytes(first.vertices, second.vertices) && sameBytes(first.indices, second.indices);
+        std::vector<Triangle> before = triangles(mesh);
+        std::vector<Triangle> after = triangles(first);
+        bool sameTriangles = before.size() == after.size() && std::equal(before.begin(), before.end(), after.begin(),
+            [](const Triangle& a, const Triangle& b) { return std::memcmp(a.data(), b.data(), sizeof(Triangle)) == 0; });
+
+        MeshProcessing::VertexCacheStatistics cacheBefore =
+            MeshProcessing::AnalyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+        MeshProcessing::VertexCacheStatistics cacheAfter =
+            MeshProcessing::AnalyzeVertexCache(first.indices.data(), first.indices.size(), first.vertices.size());
+        bool improved = cacheAfter.acmr <= cacheBefore.acmr;
+        valid = valid && deterministic && sameTriangles && improved;
+
+        LogMessage("Mesh optimization test: %s, %zu triangles in %.1f ms: ACMR %.3f -> %.3f, "
+            "ATVR %.3f -> %.3f%s%s%s\n",
+            mesh.name, mesh.indices.size() / 3, milliseconds, cacheBefore.acmr, cacheAfter.acmr, cacheBefore.atvr, cacheAfter.atvr,
+            deterministic ? "" : ", runs differ", sameTriangles ? "" : ", triangles changed", improved ? "" : ", cache got worse");
+    }
+
+    LogMessage(valid ? "Mesh optimization test: passed\n" : "Mesh optimization test: FAILED\n");
+    return valid ? 0 : 1;
+}
+
+// LOD test: BogEngine.exe -lod-test [triangles]
+// Builds LOD chains for a finely tessellated sphere and a bumpy grid of
+// about the given number of triangles, logging the triangles and error of
+// every level. Fails unless each level has fewer triangles than the one
+// before and an error within its own target.
+int RunLodTest(const CommandLine& commandLine) {
+    size_t triangleCount = commandLine.GetCount(100000);
+
+    // Fractions of the bounding box diagonal, like the import defaults
+    const float errorTargets[] = { 0.005f, 0.01f, 0.02f, 0.05f };
+    const size_t levelCount = sizeof(errorTargets) / sizeof(errorTargets[0]);
+
+    TestMesh meshes[2] = { TestMesh("Sphere"), TestMesh("Bumpy grid") };
+    uint32_t sphereSlices = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(triangleCount))));
+    ShapeGenerator::CreateSphere(meshes[0].vertices, meshes[0].indices, 1.0f, sphereSlices, sphereSlices / 2);
+    BuildGridMesh(static_cast<uint32_t>(std::ceil(std::sqrt(triangleCount * 0.5))), meshes[1].vertices, meshes[1].indices);
+
+    bool valid = true;
+    for (TestMesh& mesh : meshes) {
+        float boundsMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+        float boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+        for (const Mesh::Vertex& vertex : mesh.vertices) {
+            const float position[3] = { vertex.x, vertex.y, vertex.z };
+            for (int axis = 0; axis < 3; ++axis) {
+                boundsMin[axis] = std::min(boundsMin[axis], position[axis]);
+                boundsMax[axis] = std::max(boundsMax[axis], position[axis]);
+            }
+        }
+        float size[3] = { boundsMax[0] - boundsMin[0], boundsMax[1] - boundsMin[1], boundsMax[2] - boundsMin[2] };
+        float extent = std::sqrt(size[0] * size[0] + size[1] * size[1] + size[2] * size[2]);
+
+        std::vector<MeshProcessing::Lod> lods;
+        auto start = std::chrono::steady_clock::now();
+        MeshProcessing::GenerateLods(mesh.indices, mesh.vertices.data(), mesh.vertices.size(), sizeof(Mesh::Vertex),
+            errorTargets, levelCount, lods);
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        LogMessage("LOD test: %s, %zu vertices, %zu levels in %.1f ms\n",
+            mesh.name, mesh.vertices.size(), lods.size(), milliseconds);
+        valid = valid && lods.size() > 1;
+
+        for (size_t level = 0; level < lods.size(); ++level) {
+            const MeshProcessing::Lod& lod = lods[level];
+            float target = (level > 0) ? errorTargets[level - 1] * extent : 0.0f;
+            bool withinTarget = lod.error <= target;
+            bool reduced = level == 0 || lod.indexCount < lods[level - 1].indexCount;
+            valid = valid && withinTarget && reduced;
+
+            LogMessage("LOD test:   level %zu: %u triangles (%.1f%%), error %.5f of %.5f (%.2f%% of the diagonal)%s%s\n",
+                level, lod.indexCount / 3, 100.0 * lod.indexCount / lods[0].indexCount, lod.error, target,
+                extent > 0.0f ? 100.0f * lod.error / extent : 0.0f,
+                withinTarget ? "" : ", over its target", reduced ? "" : ", not reduced");
+        }
+    }
+
+    LogMessage(valid ? "LOD test: passed\n" : "LOD test: FAILED\n");
+    return valid ? 0 : 1;
+}
+
+// Vertex quantization test: BogEngine.exe -vertex-quantization-test [vertices]
+// Round-trips random positions, normals, half float pairs and colors through
+// the encode and decode kernels, reading from and writing to strided vertex
+// structs, and logs the largest error of each. Fails when an error exceeds
+// half a quantization step (a small angle for normals), a special half value
+// does not survive, or a kernel writes past its last vertex. The count is
+// rounded up to an odd number so the tail batch is exercised.
+int RunVertexQuantizationTest(const CommandLine& commandLine) {
+    size_t vertexCount = commandLine.GetCount(100000);
+    vertexCount |= 1;
+
+    // Trailing bytes after the last encoded or decoded vertex must keep this value
+    const unsigned char Guard = 0xcd;
+    const size_t GuardSize = 16;
+    auto guardIntact = [&](const std::vector<unsigned char>& buffer, size_t used) {
+        for (size_t i = used; i < buffer.size(); ++i) {
+            if (buffer[i] != Guard) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    bool valid = true;
+
+    // Positions from Mesh::Vertex, UNORM16 x4 with w = 0
+    {
+        std::vector<Mesh::Vertex> vertices(vertexCount);
+        for (Mesh::Vertex& vertex : vertices) {
+            vertex.x = unit(random) * 100.0f + 20.0f;
+            vertex.y = unit(random) * 0.5f;
+            vertex.z = unit(random) * 3000.0f;
+            vertex.r = vertex.g = vertex.b = 0.0f;
+        }
+        VertexQuantization::PositionRange range =
+            VertexQuantization::ComputePositionRange(vertices.data(), sizeof(Mesh::Vertex), vertexCount);
+
+        const size_t encodedStride = 4 * sizeof(uint16_t);
+        std::vector<unsigned char> encoded(vertexCount * encodedStride + GuardSize, Guard);
+        VertexQuantization::EncodePositions(encoded.data(), encodedStride, vertices.data(), sizeof(Mesh::Vertex), vertexCount, range);
+        std::vector<Mesh::Vertex> decoded(vertexCount + 1);
+        std::memset(decoded.data(), Guard, decoded.size() * sizeof(Mesh::Vertex));
+        VertexQuantization::DecodePositions(decoded.data(), sizeof(Mesh::Vertex), encoded.data(), encodedStride, vertexCount, range);
+
+        float maxError[3] = {};
+        bool withinStep = true;
+        bool zeroW = true;
+        for (size_t i = 0; i < vertexCount; ++i) {
+            const float original[3] = { vertices[i].x, vertices[i].y, vertices[i].z };
+            const float result[3] = { decoded[i].x, decoded[i].y, decoded[i].z };
+            for (int axis = 0; axis < 3; ++axis) {
+                float error = std::fabs(result[axis] - original[axis]);
+                maxError[axis] = std::max(maxError[axis], error);
+                // Half a step, with slack for the float arithmetic of encoding and decoding
+                float magnitude = std::fabs(range.offset[axis]) + range.scale[axis];
+                withinStep = withinStep && error <= range.scale[axis] * (0.505f / 65535.0f) + magnitude * 4.0f * FLT_EPSILON;
+            }
+            uint16_t w;
+            std::memcpy(&w, &encoded[i * encodedStride + 3 * sizeof(uint16_t)], sizeof(w));
+            zeroW = zeroW && w == 0;
+        }
+
+        // Decoding must leave the colors of each vertex and the vertex after the last one alone
+        std::vector<unsigned char> decodedBytes(reinterpret_cast<unsigned char*>(decoded.data()),
+            reinterpret_cast<unsigned char*>(decoded.data() + decoded.size()));
+        bool untouched = guardIntact(encoded, vertexCount * encodedStride) &&
+            guardIntact(decodedBytes, vertexCount * sizeof(Mesh::Vertex));
+        for (size_t i = 0; i < vertexCount && untouched; ++i) {
+            unsigned char color[3 * sizeof(float)];
+            std::memcpy(color, &decoded[i].r, sizeof(color));
+            untouched = std::all_of(color, color + sizeof(color), [&](unsigned char byte) { return byte == Guard; });
+        }
+        valid = valid && withinStep && zeroW && untouched;
+
+        LogMessage("Vertex quantization test: positions, max error %.6f %.6f %.6f (steps %.6f %.6f %.6f)%s%s%s\n",
+            maxError[0], maxError[1], maxError[2],
+            range.scale[0] / 65535.0f, range.scale[1] / 65535.0f, range.scale[2] / 65535.0f,
+            withinStep ? "" : ", over half a step", zeroW ? "" : ", w not zero", untouched ? "" : ", wrote past a vertex");
+    }
+
+    // Normals, octahedral SNORM16 x2, including the axes and the lower hemisphere
+    {
+        struct Normal {
+            float x, y, z;
+        };
+        std::vector<Normal> normals(vertexCount);
+        const Normal axes[] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+        for (size_t i = 0; i < vertexCount; ++i) {
+            Normal n = axes[i % 6];
+            if (i >= 6) {
+                float length = 0.0f;
+                do {
+                    n = { unit(random), unit(random), unit(random) };
+                    length = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+                } while (length < 0.01f || length > 1.0f);
+                n = { n.x / length, n.y / length, n.z / length };
+            }
+            normals[i] = n;
+        }
+
+        const size_t encodedStride = 2 * sizeof(int16_t);
+        std::vector<unsigned char> encoded(vertexCount * encodedStride + GuardSize, Guard);
+        VertexQuantization::EncodeNormals(encoded.data(), encodedStride, normals.data(), sizeof(Normal), vertexCount);
+        std::vector<unsigned char> decodedBytes((vertexCount + 1) * sizeof(Normal), Guard);
+        VertexQuantization::DecodeNormals(decodedBytes.data(), sizeof(Normal), encoded.data(), encodedStride, vertexCount);
+
+        // Sixteen bits per component keep normals within about 0.006 degrees
+        const double MaxAngle = 0.0001;
+        double maxAngle = 0.0;
+        for (size_t i = 0; i < vertexCount; ++i) {
+            Normal decoded;
+            std::memcpy(&decoded, &decodedBytes[i * sizeof(Normal)], sizeof(decoded));
+            // atan2 of the cross and dot products stays accurate for tiny angles, unlike acos
+            const Normal& original = normals[i];
+            double crossX = double(decoded.y) * original.z - double(decoded.z) * original.y;
+            double crossY = double(decoded.z) * original.x - double(decoded.x) * original.z;
+            double crossZ = double(decoded.x) * original.y - double(decoded.y) * original.x;
+            double dot = double(decoded.x) * original.x + double(decoded.y) * original.y + double(decoded.z) * original.z;
+            double angle = std::atan2(std::sqrt(crossX * crossX + crossY * crossY + crossZ * crossZ), dot);
+            maxAngle = (angle == angle) ? std::max(maxAngle, angle) : 10.0;
+        }
+        bool untouched = guardIntact(encoded, vertexCount * encodedStride) && guardIntact(decodedBytes, vertexCount * sizeof(Normal));
+        valid = valid && maxAngle <= MaxAngle && untouched;
+
+        LogMessage("Vertex quantization test: normals, max error %.6f degrees%s%s\n",
+            maxAngle * 180.0 / 3.14159265358979, maxAngle <= MaxAngle ? "" : ", over the limit", untouched ? "" : ", wrote past a vertex");
+    }
+
+    // Half float pairs, random magnitudes across the half range plus special values
+    {
+        struct TexCoord {
+            float u, v, unused;
+        };
+        const float infinity = std::numeric_limits<float>::infinity();
+        const float specials[] = { 0.0f, -0.0f, 1.0f, -2.0f, 65504.0f, -65504.0f, 5.9604645e-8f, 6.1035156e-5f,
+            infinity, -infinity, 70000.0f, -1e10f };
+        const float specialResults[] = { 0.0f, -0.0f, 1.0f, -2.0f, 65504.0f, -65504.0f, 5.9604645e-8f, 6.1035156e-5f,
+            infinity, -infinity, infinity, -infinity };
+        const size_t specialCount = sizeof(specials) / sizeof(specials[0]);
+        std::uniform_real_distribution<float> exponent(-14.0f, 15.9f);
+
+        std::vector<TexCoord> values(vertexCount);
+        for (size_t i = 0; i < vertexCount; ++i) {
+            float first = (i < specialCount) ? specials[i] : std::copysign(std::exp2(exponent(random)), unit(random));
+            values[i] = { first, (i == 0) ? std::numeric_limits<float>::quiet_NaN() : unit(random) * 0.001f, 0.0f };
+        }
+
+        const size_t encodedStride = 2 * sizeof(uint16_t);
+        std::vector<unsigned char> encoded(vertexCount * encodedStride + GuardSize, Guard);
+        VertexQuantization::EncodeHalf2(encoded.data(), encodedStride, values.data(), sizeof(TexCoord), vertexCount);
+        std::vector<unsigned char> decodedBytes((vertexCount + 1) * sizeof(TexCoord), Guard);
+        VertexQuantization::DecodeHalf2(decodedBytes.data(), sizeof(TexCoord), encoded.data(), encodedStride, vertexCount);
+
+        // Normal halves keep 11 significant bits; denormals have a fixed step of 2^-24
+        float maxRelativeError = 0.0f;
+        bool withinStep = true;
+        bool specialsKept = true;
+        for (size_t i = 0; i < vertexCount; ++i) {
+            TexCoord decoded;
+            std::memcpy(&decoded, &decodedBytes[i * sizeof(TexCoord)], sizeof(decoded));
+            const float original[2] = { values[i].u, values[i].v };
+            const float result[2] = { decoded.u, decoded.v };
+            for (int c = 0; c < 2; ++c) {
+                if (c == 0 && i < specialCount) {
+                    specialsKept = specialsKept && result[c] == specialResults[i] &&
+                        std::signbit(result[c]) == std::signbit(specialResults[i]);
+                    continue;
+                }
+                if (c == 1 && i == 0) {
+                    specialsKept = specialsKept && result[c] != result[c];
+                    continue;
+                }
+                float error = std::fabs(result[c] - original[c]);
+                if (std::fabs(original[c]) >= 6.1035156e-5f) {
+                    float relativeError = error / std::fabs(original[c]);
+                    maxRelativeError = std::max(maxRelativeError, relativeError);
+                    withinStep = withinStep && relativeError <= 1.0f / 2048.0f;
+                }
+                else {
+                    withinStep = withinStep && error <= 2.9802322e-8f;
+                }
+            }
+        }
+        bool untouched = guardIntact(encoded, vertexCount * encodedStride);
+        for (size_t i = 0; i <= vertexCount && untouched; ++i) {
+            size_t first = (i < vertexCount) ? i * sizeof(TexCoord) + 2 * sizeof(float) : i * sizeof(TexCoord);
+            size_t last = (i + 1) * sizeof(TexCoord);
+            untouched = std::all_of(decodedBytes.begin() + first, decodedBytes.begin() + last, [&](unsigned char byte) { return byte == Guard; });
+        }
+        valid = valid && withinStep && specialsKept && untouched;
+
+        LogMessage("Vertex quantization test: half2, max relative error %.6f (limit %.6f)%s%s%s\n",
+            maxRelativeError, 1.0f / 2048.0f, withinStep ? "" : ", over half a step",
+            specialsKept ? "" : ", special value changed", untouched ? "" : ", wrote past a vertex");
+    }
+
+    // Colors from Mesh::Vertex, UNORM8 x4 with opaque alpha, out of range channels clamped
+    {
+        std::vector<Mesh::Vertex> vertices(vertexCount);
+        std::uniform_real_distribution<float> channel(-0.25f, 1.25f);
+        for (Mesh::Vertex& vertex : vertices) {
+            vertex.x = vertex.y = vertex.z = 0.0f;
+            vertex.r = channel(random);
+            vertex.g = channel(random);
+            vertex.b = channel(random);
+        }
+
+        const size_t encodedStride = 4;
+        std::vector<unsigned char> encoded(vertexCount * encodedStride + GuardSize, Guard);
+        VertexQuantization::EncodeColors(encoded.data(), encodedStride, &vertices[0].r, sizeof(Mesh::Vertex), vertexCount);
+        std::vector<Mesh::Vertex> decoded(vertexCount);
+        VertexQuantization::DecodeColors(&decoded[0].r, sizeof(Mesh::Vertex), encoded.data(), encodedStride, vertexCount);
+
+        float maxError = 0.0f;
+        bool opaque = true;
+        for (size_t i = 0; i < vertexCount; ++i) {
+            const float original[3] = { vertices[i].r, vertices[i].g, vertices[i].b };
+            const float result[3] = { decoded[i].r, decoded[i].g, decoded[i].b };
+            for (int c = 0; c < 3; ++c) {
+                float clamped = std::min(std::max(original[c], 0.0f), 1.0f);
+                maxError = std::max(maxError, std::fabs(result[c] - clamped));
+            }
+            opaque = opaque && encoded[i * encodedStride + 3] == 255;
+        }
+        bool withinStep = maxError <= 0.5f / 255.0f + 1e-6f;
+        bool untouched = guardIntact(encoded, vertexCount * encodedStride);
+        valid = valid && withinStep && opaque && untouched;
+
+        LogMessage("Vertex quantization test: colors, max error %.6f (step %.6f)%s%s%s\n",
+            maxError, 1.0f / 255.0f, withinStep ? "" : ", over half a step", opaque ? "" : ", alpha not opaque",
+            untouched ? "" : ", wrote past a vertex");
+    }
+
+    LogMessage(valid ? "Vertex quantization test: passed\n" : "Vertex quantization test: FAILED\n");
+    return valid ? 0 : 1;
+}
+
+// Asset streamer test: BogEngine.exe -asset-streamer-test [meshes]
+// Streams baked grids of two sizes, with every eighth request pointing at
+// missing files, into meshes on the headless backend under a per-frame byte
+// budget smaller than the large grid. Fails unless every frame uploading
+// more than one mesh stays within the budget, baked meshes reach the upload
+// still mapped instead of copied, each missing file is reported as failed
+// and every request ends resident or failed.
+int RunAssetStreamerTest(const CommandLine& commandLine) {
+    size_t meshCount = commandLine.GetCount(64);
+
+    HeadlessBackend backend;
+    if (!backend.Initialize(64, 64)) {
+        return 1;
+    }
+
+    // Baked up front, so every successful load maps a .bogmesh
+    const char* sourceFiles[2] = { "_streamer_small.obj", "_streamer_large.obj" };
+    const char* bakedFiles[2] = { "_streamer_small.bogmesh", "_streamer_large.bogmesh" };
+    const size_t triangleCounts[2] = { 2000, 50000 };
+    for (int i = 0; i < 2; ++i) {
+        if (!WriteGridObj(sourceFiles[i], triangleCounts[i]) || !Mesh::BakeOBJFile(sourceFiles[i], bakedFiles[i])) {
+            LogMessage("Asset streamer test: could not bake the test meshes\n");
+            return 1;
+        }
+    }
+
+    // Creates meshes on the headless backend in place of the GPU
+    class StubTarget : public MeshUploadTarget {
+    public:
+        explicit StubTarget(RenderBackend* backend) : backend(backend), copiedUploads(0) {}
+
+        bool UploadMesh(AssetHandle, const MeshData& data) override {
+            if (!data.bakedFile) {
+                ++copiedUploads;
+            }
+            std::unique_ptr<Mesh> mesh(new Mesh(backend, nullptr));
+            if (!mesh->Initialize(data)) {
+                return false;
+            }
+            meshes.push_back(std::move(mesh));
+            return true;
+        }
+
+        void OnMeshFailed(AssetHandle handle) override { failed.push_back(handle); }
+
+        RenderBackend* backend;
+        uint32_t copiedUploads;
+        std::vector<std::unique_ptr<Mesh>> meshes;
+        std::vector<AssetHandle> failed;
+    };
+    StubTarget target(&backend);
+
+    AssetStreamer streamer;
+    if (!streamer.Start(&Mesh::LoadMeshData)) {
+        return 1;
+    }
+
+    std::vector<AssetHandle> handles(meshCount);
+    std::vector<AssetHandle> missing;
+    for (size_t i = 0; i < meshCount; ++i) {
+        if (i % 8 == 7) {
+            handles[i] = streamer.RequestMesh("_streamer_missing.bogmesh", "_streamer_missing.obj");
+            missing.push_back(handles[i]);
+        }
+        else {
+            handles[i] = streamer.RequestMesh(bakedFiles[i % 2], sourceFiles[i % 2]);
+        }
+    }
+
+    bool valid = true;
+    auto expect = [&valid](bool condition, const char* failure) {
+        if (!condition) {
+            LogMessage("Asset streamer test: %s\n", failure);
+            valid = false;
+        }
+    };
+
+    // Frames until everything has loaded and uploaded, giving up after ten seconds
+    const AssetStreamer::UploadBudget budget = { 1000.0f, 256 * 1024 };
+    uint32_t frames = 0;
+    uint32_t uploaded = 0;
+    uint32_t failed = 0;
+    uint32_t mostPerFrame = 0;
+    uint64_t totalBytes = 0;
+    uint64_t largestFrameBytes = 0;
+    bool withinBudget = true;
+    auto start = std::chrono::steady_clock::now();
+    while (!streamer.IsIdle() && std::chrono::steady_clock::now() - start < std::chrono::seconds(10)) {
+        AssetStreamer::UploadStats stats = streamer.ProcessUploads(target, budget);
+        ++frames;
+        uploaded += stats.meshesUploaded;
+        failed += stats.meshesFailed;
+        totalBytes += stats.bytesUploaded;
+        mostPerFrame = std::max(mostPerFrame, stats.meshesUploaded);
+        largestFrameBytes = std::max(largestFrameBytes, stats.bytesUploaded);
+        withinBudget = withinBudget && (stats.meshesUploaded <= 1 || stats.bytesUploaded <= budget.maxBytes);
+        if (stats.meshesUploaded + stats.meshesFailed == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    streamer.Stop();
+
+    LogMessage("Asset streamer test: %u uploaded (%.2f MB) and %u failed in %u frames, %.1f ms, "
+        "at most %u meshes and %.1f KB per frame against a %.1f KB budget\n",
+        uploaded, totalBytes / (1024.0 * 1024.0), failed, frames, milliseconds,
+        mostPerFrame, largestFrameBytes / 1024.0, budget.maxBytes / 1024.0);
+
+    expect(streamer.IsIdle(), "requests were still pending after ten seconds");
+    expect(withinBudget, "a frame uploaded several meshes past the byte budget");
+    expect(mostPerFrame > 1, "no frame batched small meshes");
+    expect(uploaded == meshCount - missing.size() && failed == missing.size(), "upload and failure counts are wrong");
+    std::sort(target.failed.begin(), target.failed.end());
+    expect(target.failed == missing, "missing files were not reported as failed");
+    expect(target.copiedUploads == 0, "baked meshes were copied out of their mapping");
+    expect(backend.GetBufferCount() == 2 * target.meshes.size(), "meshes did not create their buffers");
+
+    bool settled = true;
+    for (size_t i = 0; i < meshCount; ++i) {
+        AssetState expected = (i % 8 == 7) ? AssetState::Failed : AssetState::Resident;
+        settled = settled && streamer.GetState(handles[i]) == expected;
+    }
+    expect(settled, "a request did not end resident or failed");
+
+    for (int i = 0; i < 2; ++i) {
+        std::remove(sourceFiles[i]);
+        std::remove(bakedFiles[i]);
+    }
+
+    LogMessage(valid ? "Asset streamer test: passed\n" : "Asset streamer test: FAILED\n");
+    return valid ? 0 : 1;
+}
+
+// Mesh registry test: BogEngine.exe -mesh-registry-test [references]
+// Spreads references over a few hundred unique meshes, some of them also
+// registered under a second name with the same geometry, and checks that
+// each unique mesh has one set of buffers. Then releases everything and
+// checks the buffers outlive the frames in flight, that a mesh acquired
+// again in time survives, and that stale handles stop resolving.
+int RunMeshRegistryTest(const CommandLine& commandLine) {
+    size_t referenceCount = commandLine.GetCount(20000);
+
+    const uint32_t uniqueCount = 300;
+    const uint32_t copyCount = 50;
+    const uint32_t framesInFlight = MeshRegistry::DefaultFramesInFlight;
+    referenceCount = std::max<size_t>(referenceCount, uniqueCount);
+
+    HeadlessBackend backend;
+    if (!backend.Initialize(64, 64)) {
+        return 1;
+    }
+    MeshRegistry registry;
+    registry.Initialize(&backend, nullptr, framesInFlight);
+
+    // Pyramids told apart by their apex color
+    std::vector<Mesh::Vertex> vertices;
+    std::vector<uint32_t> indices;
+    auto acquire = [&](const char* prefix, uint32_t mesh) {
+        char name[32];
+        snprintf(name, sizeof(name), "%s%u", prefix, mesh);
+        MeshHandle handle = registry.Acquire(name);
+        if (handle == InvalidMesh) {
+            ShapeGenerator::CreatePyramid(vertices, indices);
+            vertices[4].g = static_cast<float>(mesh) / uniqueCount;
+            handle = registry.Create(name, vertices, indices);
+        }
+        return handle;
+    };
+
+    // Copies first, so the originals acquired later share with them
+    std::vector<MeshHandle> references;
+    references.reserve(referenceCount + copyCount);
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t copy = 0; copy < copyCount; ++copy) {
+        references.push_back(acquire("Copy", copy));
+    }
+    for (size_t reference = 0; reference < referenceCount; ++reference) {
+        references.push_back(acquire("Mesh", static_cast<uint32_t>(reference % uniqueCount)));
+    }
+    std::chrono::duration<double, std::milli> acquireTime = std::chrono::steady_clock::now() - start;
+
+    bool valid = true;
+    auto expect = [&valid](bool condition, const char* failure) {
+        if (!condition) {
+            LogMessage("Mesh registry test: %s\n", failure);
+            valid = false;
+        }
+    };
+
+    MeshRegistry::Stats loaded = registry.GetStats();
+    registry.LogStats();
+    expect(loaded.resources == uniqueCount + copyCount && loaded.uniqueMeshes == uniqueCount &&
+        backend.GetBufferCount() == 2 * uniqueCount, "meshes were not shared");
+    expect(references[copyCount] != references[0] && registry.Get(references[copyCount]) == registry.Get(references[0]),
+        "identical geometry under another name was not shared");
+
+    // Resolving a handle is an index and a generation check
+    start = std::chrono::steady_clock::now();
+    uint32_t resident = 0;
+    for (MeshHandle handle : references) {
+        resident += registry.Get(handle)->IsResident() ? 1 : 0;
+    }
+    std::chrono::duration<double, std::milli> getTime = std::chrono::steady_clock::now() - start;
+    expect(resident == references.size(), "missing mesh");
+
+    // Drop everything except one reference that is taken again while its release is pending
+    MeshHandle kept = references[copyCount + 1];
+    for (MeshHandle handle : references) {
+        registry.Release(handle);
+    }
+    for (uint32_t frame = 1; frame < framesInFlight; ++frame) {
+        registry.EndFrame();
+    }
+    expect(backend.GetBufferCount() == 2 * uniqueCount, "buffers freed while in flight");
+    expect(registry.Acquire("Mesh1") == kept, "pending mesh was not acquired again");
+
+    // The copies own the shared geometry and wait for the meshes sharing it,
+    // which only release their reference when they go, so they take twice as long
+    registry.EndFrame();
+    expect(backend.GetBufferCount() == 2 * copyCount && registry.Get(references.back()) == nullptr,
+        "released meshes were not destroyed");
+    for (uint32_t frame = 0; frame < framesInFlight; ++frame) {
+        registry.EndFrame();
+    }
+    expect(backend.GetBufferCount() == 2 && registry.Get(references[0]) == nullptr && registry.Get(kept) != nullptr,
+        "shared meshes were not destroyed");
+
+    registry.Release(kept);
+    for (uint32_t frame = 0; frame < 2 * framesInFlight; ++frame) {
+        registry.EndFrame();
+    }
+    expect(backend.GetBufferCount() == 0 && registry.GetStats().resources == 0, "meshes leaked");
+
+    LogMessage(
+        "Mesh registry test: %u references to %u meshes, %llu bytes (%llu saved by sharing), %.1f ns per acquire, %.1f ns per lookup\n",
+        static_cast<uint32_t>(references.size()), loaded.uniqueMeshes,
+        static_cast<unsigned long long>(loaded.gpuBytes + loaded.cpuBytes), static_cast<unsigned long long>(loaded.savedBytes),
+        acquireTime.count() * 1e6 / references.size(), getTime.count() * 1e6 / references.size());
+    LogMessage(valid ? "Mesh registry test: passed\n" : "Mesh registry test: FAILED\n");
+    return valid ? 0 : 1;
+}
+
+// Offset allocator test: BogEngine.exe -offset-allocator-test [operations]
+// Runs random allocations and frees against a map of which allocation owns
+// each unit, checking that ranges stay inside the space and never overlap,
+// that nothing is refused while a range a size class larger is free, and
+// that freeing everything merges it back into one range. Then times
+// allocating and freeing.
+int RunOffsetAllocatorTest(const CommandLine& commandLine) {
+    size_t operationCount = commandLine.GetCount(200000);
+
+    const uint32_t size = 1 << 20;
+    OffsetAllocator allocator(size);
+    std::vector<uint32_t> owners(size, 0);
+
+    struct LiveRange {
+        OffsetAllocator::Allocation allocation;
+        uint32_t size;
+        uint32_t owner;
+    };
+    std::vector<LiveRange> live;
+
+    bool valid = true;
+    auto expect = [&valid](bool condition, const char* failure) {
+        if (!condition) {
+            LogMessage("Offset allocator test: %s\n", failure);
+            valid = false;
+        }
+    };
+
+    // Mostly small ranges with the odd large one, allocating more than
+    // freeing until the space is half full
+    std::mt19937 random(1234);
+    auto randomSize = [&random]() {
+        uint32_t sizeBits = random() % 14;
+        return 1 + random() % (1u << sizeBits);
+    };
+    uint32_t nextOwner = 1;
+    uint32_t refused = 0;
+    uint64_t usedSize = 0;
+    for (size_t operation = 0; operation < operationCount && valid; ++operation) {
+        bool allocate = live.empty() || random() % 100 < (usedSize < size / 2 ? 70u : 50u);
+        if (allocate) {
+            uint32_t rangeSize = randomSize();
+            OffsetAllocator::Allocation allocation = allocator.Allocate(rangeSize);
+            if (allocation.offset == OffsetAllocator::NoSpace) {
+                // Requests round up by at most an eighth
+                expect(allocator.GetStats().largestFree < rangeSize + rangeSize / 8 + 1, "refused with a large enough range free");
+                ++refused;
+                continue;
+            }
+
+            bool inside = static_cast<uint64_t>(allocation.offset) + rangeSize <= size &&
+                allocator.GetAllocationSize(allocation) == rangeSize;
+            expect(inside, "range outside the space");
+            for (uint32_t unit = 0; inside && unit < rangeSize; ++unit) {
+                expect(owners[allocation.offset + unit] == 0, "ranges overlap");
+                owners[allocation.offset + unit] = nextOwner;
+            }
+            live.push_back(LiveRange{ allocation, rangeSize, nextOwner++ });
+            usedSize += rangeSize;
+        }
+        else {
+            size_t pick = random() % live.size();
+            LiveRange range = live[pick];
+            live[pick] = live.back();
+            live.pop_back();
+            for (uint32_t unit = 0; unit < range.size; ++unit) {
+                expect(owners[range.allocation.offset + unit] == range.owner, "range was handed out twice");
+                owners[range.allocation.offset + unit] = 0;
+            }
+            allocator.Free(range.allocation);
+            usedSize -= range.size;
+        }
+    }
+
+    OffsetAllocator::Stats churned = allocator.GetStats();
+    float fragmentation = allocator.GetFragmentation();
+    expect(churned.usedSize == usedSize && churned.allocations == live.size(), "stats do not add up");
+
+    for (const LiveRange& range : live) {
+        allocator.Free(range.allocation);
+    }
+    OffsetAllocator::Stats freed = allocator.GetStats();
+    expect(freed.freeRegions == 1 && freed.largestFree == size && freed.allocations == 0, "free ranges were not merged");
+    expect(allocator.Allocate(size).offset == 0, "whole space refused after freeing everything");
+
+    // Throughput: fill a fresh allocator with random ranges, then free them in random order
+    const uint32_t timedCount = 100000;
+    std::vector<OffsetAllocator::Allocation> timed(timedCount);
+    std::vector<uint32_t> timedSizes(timedCount);
+    for (uint32_t& rangeSize : timedSizes) {
+        rangeSize = 1 + random() % 64;
+    }
+    allocator.Reset(size * 8);
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < timedCount; ++i) {
+        timed[i] = allocator.Allocate(timedSizes[i]);
+    }
+    std::chrono::duration<double, std::milli> allocateTime = std::chrono::steady_clock::now() - start;
+    std::shuffle(timed.begin(), timed.end(), random);
+    start = std::chrono::steady_clock::now();
+    for (const OffsetAllocator::Allocation& allocation : timed) {
+        allocator.Free(allocation);
+    }
+    std::chrono::duration<double, std::milli> freeTime = std::chrono::steady_clock::now() - start;
+    expect(allocator.GetStats().freeRegions == 1, "timed ranges were not merged");
+
+    LogMessage(
+        "Offset allocator test: %u live ranges, %.0f%% full, %u free ranges, %.0f%% fragmented, %u refused; %.1f ns per allocation, %.1f ns per free\n",
+        churned.allocations, 100.0 * churned.usedSize / size, churned.freeRegions, fragmentation * 100.0f, refused,
+        allocateTime.count() * 1e6 / timedCount, freeTime.count() * 1e6 / timedCount);
+    LogMessage(valid ? "Offset allocator test: passed\n" : "Offset allocator test: FAILED\n");
+    return valid ? 0 : 1;
+}
+
+// Geometry pool benchmark: BogEngine.exe -geometry-pool-benchmark [meshes]
+// Fills a small pool with meshes of random sizes so it has to grow, churns
+// it by replacing a third of them a few times over, and logs the
+// fragmentation, then defragments it. Every mesh's vertices and indices
+// are read back afterwards to check that moving them kept them intact, and
+// one draw per mesh checks that the buffers are bound once.
+int RunGeometryPoolBenchmark(const CommandLine& commandLine) {
+    size_t meshCount = commandLine.GetCount(4000);
+
+    // Rasterizing keeps the buffer contents around for reading back
+    HeadlessBackend backend;
+    GeometryPool pool;
+    const uint32_t stride = Mesh::GetVertexFormat().GetStride();
+    if (!backend.Initialize(64, 64, true) || !pool.Initialize(&backend, stride, 16 * 1024, 64 * 1024)) {
+        return 1;
+    }
+
+    struct PooledMesh {
+        GeometryHandle handle;
+        uint32_t seed;
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        IndexFormat format;
+    };
+
+    // Contents follow from the seed, so they can be rebuilt to compare against
+    std::vector<unsigned char> vertices, indices;
+    auto build = [&](const PooledMesh& mesh) {
+        uint32_t indexSize = (mesh.format == IndexFormat::UInt16) ? sizeof(uint16_t) : sizeof(uint32_t);
+        vertices.resize(static_cast<size_t>(mesh.vertexCount) * stride);
+        for (size_t i = 0; i < vertices.size(); ++i) {
+            vertices[i] = static_cast<unsigned char>(mesh.seed * 131 + i * 7);
+        }
+        indices.resize(static_cast<size_t>(mesh.indexCount) * indexSize);
+        for (uint32_t i = 0; i < mesh.indexCount; ++i) {
+            uint32_t index = (mesh.seed + i * 13) % mesh.vertexCount;
+            if (indexSize == sizeof(uint16_t)) {
+                uint16_t shortIndex = static_cast<uint16_t>(index);
+                std::memcpy(&indices[i * indexSize], &shortIndex, indexSize);
+            }
+            else {
+                std::memcpy(&indices[i * indexSize], &index, indexSize);
+            }
+        }
+    };
+
+    std::mt19937 random(1234);
+    uint32_t nextSeed = 0;
+    auto allocate = [&](PooledMesh& mesh) {
+        mesh.seed = nextSeed++;
+        bool large = (random() % 8 == 0);
+        mesh.vertexCount = 4 + random() % (large ? 4000 : 200);
+        mesh.indexCount = mesh.vertexCount * 3;
+        mesh.format = (random() % 10 == 0) ? IndexFormat::UInt32 : IndexFormat::UInt16;
+        build(mesh);
+        mesh.handle = pool.Allocate(vertices.data(), mesh.vertexCount, indices.data(), mesh.indexCount, mesh.format);
+        return mesh.handle != InvalidGeometry;
+    };
+
+    bool valid = true;
+    auto expect = [&valid](bool condition, const char* failure) {
+        if (!condition) {
+            LogMessage("Geometry pool benchmark: %s\n", failure);
+            valid = false;
+        }
+    };
+
+    std::vector<PooledMesh> meshes(meshCount);
+    auto start = std::chrono::steady_clock::now();
+    for (PooledMesh& mesh : meshes) {
+        expect(allocate(mesh), "allocation failed");
+    }
+    std::chrono::duration<double, std::milli> fillTime = std::chrono::steady_clock::now() - start;
+    GeometryPool::Stats filled = pool.GetStats();
+
+    // Replace a third of the meshes, a few times over
+    const uint32_t churnRounds = 8;
+    start = std::chrono::steady_clock::now();
+    for (uint32_t round = 0; round < churnRounds; ++round) {
+        std::vector<size_t> replaced;
+        for (size_t i = 0; i < meshes.size(); ++i) {
+            if (random() % 3 == 0) {
+                pool.Free(meshes[i].handle);
+                replaced.push_back(i);
+            }
+        }
+        for (size_t i : replaced) {
+            expect(allocate(meshes[i]), "allocation failed");
+        }
+    }
+    std::chrono::duration<double, std::milli> churnTime = std::chrono::steady_clock::now() - start;
+    GeometryPool::Stats churned = pool.GetStats();
+    bool fragmented = pool.IsFragmented();
+
+    start = std::chrono::steady_clock::now();
+    expect(pool.Defragment(), "defragmenting failed");
+    std::chrono::duration<double, std::milli> defragmentTime = std::chrono::steady_clock::now() - start;
+    GeometryPool::Stats defragmented = pool.GetStats();
+    expect(defragmented.fragmentation == 0.0f && !pool.IsFragmented() && defragmented.usedBytes == churned.usedBytes,
+        "defragmenting left gaps");
+
+    // Every range still holds what was written to it
+    std::vector<unsigned char> readBack;
+    for (const PooledMesh& mesh : meshes) {
+        build(mesh);
+        const GeometryRange& range = pool.GetRange(mesh.handle);
+        readBack.resize(std::max(vertices.size(), indices.size()));
+        uint32_t indexSize = static_cast<uint32_t>(indices.size() / mesh.indexCount);
+        bool intact = range.vertexCount == mesh.vertexCount && range.indexCount == mesh.indexCount &&
+            backend.ReadBuffer(pool.GetVertexBuffer(), range.baseVertex * stride, readBack.data(), static_cast<uint32_t>(vertices.size())) &&
+            std::memcmp(readBack.data(), vertices.data(), vertices.size()) == 0 &&
+            backend.ReadBuffer(pool.GetIndexBuffer(mesh.format), range.firstIndex * indexSize, readBack.data(), static_cast<uint32_t>(indices.size())) &&
+            std::memcmp(readBack.data(), indices.data(), indices.size()) == 0;
+        if (!intact) {
+            expect(false, "mesh contents changed");
+            break;
+        }
+    }
+
+    // Draws in format order, as a sorted queue would issue them
+    std::sort(meshes.begin(), meshes.end(), [](const PooledMesh& a, const PooledMesh& b) { return a.format < b.format; });
+    const float clearColor[4] = {};
+    backend.BeginFrame(clearColor);
+    for (const PooledMesh& mesh : meshes) {
+        const GeometryRange& range = pool.GetRange(mesh.handle);
+        backend.SetVertexBuffer(0, pool.GetVertexBuffer(), stride);
+        backend.SetIndexBuffer(pool.GetIndexBuffer(range.indexFormat), range.indexFormat);
+        backend.DrawIndexed(range.indexCount, range.firstIndex, range.baseVertex);
+    }
+    backend.BeginFrame(clearColor);
+    const RenderStats& drawStats = backend.GetLastFrameStats();
+    expect(drawStats.states.TotalIssued() <= 4, "buffers were rebound between meshes");
+
+    pool.LogStats();
+    LogMessage(
+        "Geometry pool benchmark: %u meshes in %u buffers instead of %u; filled in %.3f ms (%u growths), %u rounds of churn in %.3f ms "
+        "left %.0f%% fragmented%s; defragmented %llu bytes in %.3f ms; %u draws issued %u state changes, %u elided\n",
+        static_cast<uint32_t>(meshes.size()), defragmented.buffers, static_cast<uint32_t>(meshes.size() * 2),
+        fillTime.count(), filled.growths, churnRounds, churnTime.count(), churned.fragmentation * 100.0f,
+        fragmented ? " (over the defragmentation threshold)" : "",
+        static_cast<unsigned long long>(defragmented.usedBytes), defragmentTime.count(),
+        drawStats.draws, drawStats.states.TotalIssued(), drawStats.states.TotalElided());
+    LogMessage(valid ? "Geometry pool benchmark: passed\n" : "Geometry pool benchmark: FAILED\n");
+    return valid ? 0 : 1;
+}
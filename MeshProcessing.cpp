@@ -0,0 +1,735 @@
+// MeshProcessing.cpp
+
+#include "MeshProcessing.h"
+#include "Hash.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+    // Forsyth scoring parameters from "Linear-Speed Vertex Cache Optimisation"
+    const unsigned ForsythCacheSize = 32;
+    const unsigned ForsythMaxValence = 32;
+    const float ForsythCacheDecayPower = 1.5f;
+    const float ForsythLastTriangleScore = 0.75f;
+    const float ForsythValenceBoostScale = 2.0f;
+    const float ForsythValenceBoostPower = 0.5f;
+
+    // FIFO size used to find cluster boundaries for overdraw ordering
+    const unsigned ClusterCacheSize = 16;
+    const size_t MinClusterTriangles = 16;
+
+    const uint32_t InvalidIndex = UINT32_MAX;
+
+    struct ForsythTables {
+        float cacheScores[ForsythCacheSize];
+        float valenceScores[ForsythMaxValence + 1];
+
+        ForsythTables() {
+            for (unsigned i = 0; i < ForsythCacheSize; ++i) {
+                if (i < 3) {
+                    // The last triangle's vertices get a fixed score so it is not reused straight away
+                    cacheScores[i] = ForsythLastTriangleScore;
+                }
+                else {
+                    float scaler = 1.0f / (ForsythCacheSize - 3);
+                    cacheScores[i] = std::pow(1.0f - (i - 3) * scaler, ForsythCacheDecayPower);
+                }
+            }
+
+            valenceScores[0] = 0.0f;
+            for (unsigned i = 1; i <= ForsythMaxValence; ++i) {
+                valenceScores[i] = ForsythValenceBoostScale * std::pow(float(i), -ForsythValenceBoostPower);
+            }
+        }
+    };
+
+    inline float ForsythVertexScore(const ForsythTables& tables, int cachePosition, uint32_t valence) {
+        if (valence == 0) {
+            return -1.0f;   // No triangles left to use this vertex
+        }
+
+        float score = (cachePosition >= 0) ? tables.cacheScores[cachePosition] : 0.0f;
+        return score + tables.valenceScores[std::min<uint32_t>(valence, ForsythMaxValence)];
+    }
+
+    inline const float* PositionAt(const unsigned char* vertices, size_t vertexStride, uint32_t index) {
+        return reinterpret_cast<const float*>(vertices + index * vertexStride);
+    }
+
+    // Sum of squared distances to a set of weighted planes
+    struct Quadric {
+        double a2, b2, c2, d2;
+        double ab, ac, ad, bc, bd, cd;
+        double weight;
+    };
+
+    void AddPlaneQuadric(Quadric& q, double a, double b, double c, double d, double weight) {
+        q.a2 += a * a * weight;
+        q.b2 += b * b * weight;
+        q.c2 += c * c * weight;
+        q.d2 += d * d * weight;
+        q.ab += a * b * weight;
+        q.ac += a * c * weight;
+        q.ad += a * d * weight;
+        q.bc += b * c * weight;
+        q.bd += b * d * weight;
+        q.cd += c * d * weight;
+        q.weight += weight;
+    }
+
+    void AddQuadric(Quadric& q, const Quadric& other) {
+        q.a2 += other.a2;
+        q.b2 += other.b2;
+        q.c2 += other.c2;
+        q.d2 += other.d2;
+        q.ab += other.ab;
+        q.ac += other.ac;
+        q.ad += other.ad;
+        q.bc += other.bc;
+        q.bd += other.bd;
+        q.cd += other.cd;
+        q.weight += other.weight;
+    }
+
+    // Weighted mean squared distance of a point to the planes of two quadrics
+    double QuadricError(const Quadric& q0, const Quadric& q1, const float* p) {
+        double x = p[0], y = p[1], z = p[2];
+        double a2 = q0.a2 + q1.a2, b2 = q0.b2 + q1.b2, c2 = q0.c2 + q1.c2, d2 = q0.d2 + q1.d2;
+        double ab = q0.ab + q1.ab, ac = q0.ac + q1.ac, ad = q0.ad + q1.ad;
+        double bc = q0.bc + q1.bc, bd = q0.bd + q1.bd, cd = q0.cd + q1.cd;
+        double weight = q0.weight + q1.weight;
+
+        double error = x * x * a2 + y * y * b2 + z * z * c2 + d2 +
+            2.0 * (x * y * ab + x * z * ac + y * z * bc + x * ad + y * bd + z * cd);
+        return (weight > 0.0) ? std::fabs(error) / weight : 0.0;
+    }
+
+    inline void TriangleNormal(const float* p0, const float* p1, const float* p2, float* normal) {
+        float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+        float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+        normal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+        normal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+        normal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+    }
+
+    struct Collapse {
+        uint32_t from;
+        uint32_t to;
+        double error;
+    };
+
+    // Counts cache misses per triangle with a FIFO cache. A vertex is resident
+    // while fewer than cacheSize misses happened since it was loaded.
+    class FifoCacheSimulator {
+    public:
+        FifoCacheSimulator(size_t vertexCount, unsigned cacheSize)
+            : loadTimes(vertexCount, 0), time(cacheSize + 1), cacheSize(cacheSize)
+        {
+        }
+
+        unsigned Triangle(const uint32_t* triangle) {
+            unsigned misses = 0;
+            for (int k = 0; k < 3; ++k) {
+                uint32_t v = triangle[k];
+                if (time - loadTimes[v] > cacheSize) {
+                    loadTimes[v] = time++;
+                    ++misses;
+                }
+            }
+            return misses;
+        }
+
+        // Evicts everything, as if unrelated geometry was drawn in between
+        void Flush() {
+            time += cacheSize + 1;
+        }
+
+    private:
+        std::vector<uint32_t> loadTimes;
+        uint32_t time;
+        unsigned cacheSize;
+    };
+
+}
+
+size_t MeshProcessing::WeldVertices(void* vertices, size_t vertexCount, size_t vertexStride,
+    uint32_t* indices, size_t indexCount) {
+    const uint32_t EmptySlot = UINT32_MAX;
+    unsigned char* bytes = static_cast<unsigned char*>(vertices);
+
+    // Open addressing table of compacted vertex indices, kept at most half full
+    size_t tableSize = 1;
+    while (tableSize < vertexCount * 2) tableSize <<= 1;
+    const size_t tableMask = tableSize - 1;
+    std::vector<uint32_t> table(tableSize, EmptySlot);
+
+    std::vector<uint32_t> remap(vertexCount);
+    size_t uniqueCount = 0;
+
+    for (size_t i = 0; i < vertexCount; ++i) {
+        const unsigned char* vertex = bytes + i * vertexStride;
+        size_t slot = static_cast<size_t>(HashBytes(vertex, vertexStride)) & tableMask;
+
+        while (table[slot] != EmptySlot &&
+            std::memcmp(bytes + table[slot] * vertexStride, vertex, vertexStride) != 0) {
+            slot = (slot + 1) & tableMask;
+        }
+
+        if (table[slot] == EmptySlot) {
+            // First occurrence, the compacted slot always lies at or before i
+            if (uniqueCount != i) {
+                std::memcpy(bytes + uniqueCount * vertexStride, vertex, vertexStride);
+            }
+            table[slot] = static_cast<uint32_t>(uniqueCount);
+            remap[i] = static_cast<uint32_t>(uniqueCount);
+            ++uniqueCount;
+        }
+        else {
+            remap[i] = table[slot];
+        }
+    }
+
+    for (size_t i = 0; i < indexCount; ++i) {
+        if (indices[i] < vertexCount) {
+            indices[i] = remap[indices[i]];
+        }
+    }
+
+    return uniqueCount;
+}
+
+void MeshProcessing::NarrowIndices(const uint32_t* indices, size_t indexCount, uint16_t* out) {
+    for (size_t i = 0; i < indexCount; ++i) {
+        out[i] = static_cast<uint16_t>(indices[i]);
+    }
+}
+
+void MeshProcessing::OptimizeVertexCache(uint32_t* destination, const uint32_t* indices, size_t indexCount,
+    size_t vertexCount) {
+    static const ForsythTables tables;
+
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+
+    // Triangles that still use each vertex, as ranges into one adjacency array
+    std::vector<uint32_t> liveTriangles(vertexCount, 0);
+    for (size_t i = 0; i < triangleCount * 3; ++i) {
+        ++liveTriangles[indices[i]];
+    }
+
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+    }
+
+    std::vector<uint32_t> adjacency(triangleCount * 3);
+    std::vector<uint32_t> fillCounts(vertexCount, 0);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        for (int k = 0; k < 3; ++k) {
+            uint32_t v = indices[t * 3 + k];
+            adjacency[adjacencyOffsets[v] + fillCounts[v]++] = static_cast<uint32_t>(t);
+        }
+    }
+
+    std::vector<int> cachePositions(vertexCount, -1);
+    std::vector<float> vertexScores(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        vertexScores[v] = ForsythVertexScore(tables, -1, liveTriangles[v]);
+    }
+
+    std::vector<float> triangleScores(triangleCount);
+    std::vector<char> emitted(triangleCount, 0);
+    uint32_t bestTriangle = 0;
+    for (size_t t = 0; t < triangleCount; ++t) {
+        const uint32_t* triangle = indices + t * 3;
+        triangleScores[t] = vertexScores[triangle[0]] + vertexScores[triangle[1]] + vertexScores[triangle[2]];
+        if (triangleScores[t] > triangleScores[bestTriangle]) {
+            bestTriangle = static_cast<uint32_t>(t);
+        }
+    }
+
+    uint32_t cache[ForsythCacheSize + 3];
+    uint32_t newCache[ForsythCacheSize + 3];
+    size_t cacheCount = 0;
+    size_t scanCursor = 0;
+
+    for (size_t output = 0; output < triangleCount; ++output) {
+        // Nothing in the cache has live triangles, continue from the first unused one
+        if (bestTriangle == InvalidIndex) {
+            while (emitted[scanCursor]) ++scanCursor;
+            bestTriangle = static_cast<uint32_t>(scanCursor);
+        }
+
+        const uint32_t* triangle = indices + bestTriangle * 3;
+        destination[output * 3 + 0] = triangle[0];
+        destination[output * 3 + 1] = triangle[1];
+        destination[output * 3 + 2] = triangle[2];
+        emitted[bestTriangle] = 1;
+
+        // Remove the triangle from its vertices' live lists
+        for (int k = 0; k < 3; ++k) {
+            uint32_t v = triangle[k];
+            uint32_t* begin = &adjacency[adjacencyOffsets[v]];
+            uint32_t* end = begin + liveTriangles[v];
+            uint32_t* found = std::find(begin, end, bestTriangle);
+            if (found != end) {
+                *found = *(end - 1);
+                --liveTriangles[v];
+            }
+        }
+
+        // The triangle's vertices move to the front of the cache
+        size_t newCount = 0;
+        for (int k = 0; k < 3; ++k) {
+            if (std::find(newCache, newCache + newCount, triangle[k]) == newCache + newCount) {
+                newCache[newCount++] = triangle[k];
+            }
+        }
+        for (size_t i = 0; i < cacheCount; ++i) {
+            uint32_t v = cache[i];
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+                newCache[newCount++] = v;
+            }
+        }
+
+        // Rescore everything that moved, including vertices pushed out of the cache
+        for (size_t i = 0; i < newCount; ++i) {
+            uint32_t v = newCache[i];
+            cachePositions[v] = (i < ForsythCacheSize) ? static_cast<int>(i) : -1;
+            vertexScores[v] = ForsythVertexScore(tables, cachePositions[v], liveTriangles[v]);
+        }
+
+        bestTriangle = InvalidIndex;
+        float bestScore = -1.0f;
+        for (size_t i = 0; i < newCount; ++i) {
+            uint32_t v = newCache[i];
+            for (uint32_t a = 0; a < liveTriangles[v]; ++a) {
+                uint32_t t = adjacency[adjacencyOffsets[v] + a];
+                const uint32_t* candidate = indices + t * 3;
+                float score = vertexScores[candidate[0]] + vertexScores[candidate[1]] + vertexScores[candidate[2]];
+                triangleScores[t] = score;
+                if (score > bestScore) {
+                    bestScore = score;
+                    bestTriangle = t;
+                }
+            }
+        }
+
+        cacheCount = std::min<size_t>(newCount, ForsythCacheSize);
+        std::copy(newCache, newCache + cacheCount, cache);
+    }
+}
+
+void MeshProcessing::OptimizeOverdraw(uint32_t* destination, const uint32_t* indices, size_t indexCount,
+    const void* vertices, size_t vertexCount, size_t vertexStride, float threshold) {
+    const size_t triangleCount = indexCount / 3;
+    const unsigned char* vertexBytes = static_cast<const unsigned char*>(vertices);
+    if (triangleCount == 0) {
+        return;
+    }
+
+    // Hard boundaries where the cache restarts, every vertex of the triangle misses
+    std::vector<unsigned> misses(triangleCount);
+    std::vector<size_t> hardClusters;
+    FifoCacheSimulator cacheSimulator(vertexCount, ClusterCacheSize);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        misses[t] = cacheSimulator.Triangle(indices + t * 3);
+        if (t == 0 || misses[t] == 3) {
+            hardClusters.push_back(t);
+        }
+    }
+    hardClusters.push_back(triangleCount);
+
+    // Soft boundaries once a cluster, simulated from a cold cache since it may
+    // end up drawn anywhere, is about as cache-efficient as its hard cluster
+    std::vector<size_t> clusters;
+    FifoCacheSimulator clusterSimulator(vertexCount, ClusterCacheSize);
+    for (size_t c = 0; c + 1 < hardClusters.size(); ++c) {
+        size_t start = hardClusters[c];
+        size_t end = hardClusters[c + 1];
+
+        unsigned hardMisses = 0;
+        for (size_t t = start; t < end; ++t) hardMisses += misses[t];
+        float targetAcmr = float(hardMisses) / float(end - start) * threshold;
+
+        clusters.push_back(start);
+        clusterSimulator.Flush();
+        size_t clusterStart = start;
+        unsigned clusterMisses = 0;
+        for (size_t t = start; t < end; ++t) {
+            clusterMisses += clusterSimulator.Triangle(indices + t * 3);
+            size_t clusterTriangles = t + 1 - clusterStart;
+            if (clusterTriangles >= MinClusterTriangles && end - (t + 1) >= MinClusterTriangles &&
+                float(clusterMisses) / float(clusterTriangles) <= targetAcmr) {
+                clusterStart = t + 1;
+                clusterMisses = 0;
+                clusterSimulator.Flush();
+                clusters.push_back(clusterStart);
+            }
+        }
+    }
+    clusters.push_back(triangleCount);
+    const size_t clusterCount = clusters.size() - 1;
+
+    // Area-weighted centroid and normal of every cluster and of the whole mesh
+    std::vector<float> clusterData(clusterCount * 6, 0.0f);
+    float meshCentroid[3] = {};
+    float meshArea = 0.0f;
+
+    for (size_t c = 0; c < clusterCount; ++c) {
+        float* centroid = &clusterData[c * 6];
+        float* normal = &clusterData[c * 6 + 3];
+        float clusterArea = 0.0f;
+
+        for (size_t t = clusters[c]; t < clusters[c + 1]; ++t) {
+            const float* p0 = PositionAt(vertexBytes, vertexStride, indices[t * 3 + 0]);
+            const float* p1 = PositionAt(vertexBytes, vertexStride, indices[t * 3 + 1]);
+            const float* p2 = PositionAt(vertexBytes, vertexStride, indices[t * 3 + 2]);
+
+            float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+            float cross[3] = {
+                e1[1] * e2[2] - e1[2] * e2[1],
+                e1[2] * e2[0] - e1[0] * e2[2],
+                e1[0] * e2[1] - e1[1] * e2[0]
+            };
+            float area = std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+
+            for (int axis = 0; axis < 3; ++axis) {
+                float triangleCentroid = (p0[axis] + p1[axis] + p2[axis]) / 3.0f;
+                centroid[axis] += triangleCentroid * area;
+                meshCentroid[axis] += triangleCentroid * area;
+                normal[axis] += cross[axis];
+            }
+            clusterArea += area;
+        }
+
+        meshArea += clusterArea;
+        if (clusterArea > 0.0f) {
+            for (int axis = 0; axis < 3; ++axis) centroid[axis] /= clusterArea;
+        }
+
+        float normalLength = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        if (normalLength > 0.0f) {
+            for (int axis = 0; axis < 3; ++axis) normal[axis] /= normalLength;
+        }
+    }
+
+    if (meshArea > 0.0f) {
+        for (int axis = 0; axis < 3; ++axis) meshCentroid[axis] /= meshArea;
+    }
+
+    // Clusters facing away from the mesh centre are likely occluders, draw them first
+    std::vector<float> sortKeys(clusterCount);
+    std::vector<uint32_t> order(clusterCount);
+    for (size_t c = 0; c < clusterCount; ++c) {
+        const float* centroid = &clusterData[c * 6];
+        const float* normal = &clusterData[c * 6 + 3];
+        sortKeys[c] =
+            (centroid[0] - meshCentroid[0]) * normal[0] +
+            (centroid[1] - meshCentroid[1]) * normal[1] +
+            (centroid[2] - meshCentroid[2]) * normal[2];
+        order[c] = static_cast<uint32_t>(c);
+    }
+
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return sortKeys[a] > sortKeys[b];
+    });
+
+    size_t output = 0;
+    for (uint32_t c : order) {
+        size_t start = clusters[c] * 3;
+        size_t end = clusters[c + 1] * 3;
+        std::copy(indices + start, indices + end, destination + output);
+        output += end - start;
+    }
+}
+
+size_t MeshProcessing::OptimizeVertexFetch(void* destination, uint32_t* indices, size_t indexCount,
+    const void* vertices, size_t vertexCount, size_t vertexStride) {
+    const unsigned char* source = static_cast<const unsigned char*>(vertices);
+    unsigned char* target = static_cast<unsigned char*>(destination);
+
+    std::vector<uint32_t> remap(vertexCount, InvalidIndex);
+    size_t nextVertex = 0;
+
+    for (size_t i = 0; i < indexCount; ++i) {
+        uint32_t v = indices[i];
+        if (remap[v] == InvalidIndex) {
+            std::memcpy(target + nextVertex * vertexStride, source + v * vertexStride, vertexStride);
+            remap[v] = static_cast<uint32_t>(nextVertex++);
+        }
+        indices[i] = remap[v];
+    }
+
+    return nextVertex;
+}
+
+MeshProcessing::VertexCacheStatistics MeshProcessing::AnalyzeVertexCache(const uint32_t* indices, size_t indexCount,
+    size_t vertexCount, unsigned cacheSize) {
+    VertexCacheStatistics stats = {};
+    const size_t triangleCount = indexCount / 3;
+
+    FifoCacheSimulator cacheSimulator(vertexCount, cacheSize);
+    std::vector<char> referenced(vertexCount, 0);
+    size_t uniqueVertices = 0;
+
+    for (size_t t = 0; t < triangleCount; ++t) {
+        stats.verticesTransformed += cacheSimulator.Triangle(indices + t * 3);
+        for (int k = 0; k < 3; ++k) {
+            uint32_t v = indices[t * 3 + k];
+            if (!referenced[v]) {
+                referenced[v] = 1;
+                ++uniqueVertices;
+            }
+        }
+    }
+
+    stats.acmr = triangleCount ? float(stats.verticesTransformed) / float(triangleCount) : 0.0f;
+    stats.atvr = uniqueVertices ? float(stats.verticesTransformed) / float(uniqueVertices) : 0.0f;
+    return stats;
+}
+
+size_t MeshProcessing::Simplify(uint32_t* destination, const uint32_t* indices, size_t indexCount,
+    const void* vertices, size_t vertexCount, size_t vertexStride,
+    size_t targetIndexCount, float targetError, float* resultError) {
+    const unsigned char* vertexBytes = static_cast<const unsigned char*>(vertices);
+    const double maxError = double(targetError) * double(targetError);
+
+    size_t currentCount = indexCount - indexCount % 3;
+    std::copy(indices, indices + currentCount, destination);
+
+    // Plane quadrics weighted by triangle area
+    std::vector<Quadric> quadrics(vertexCount, Quadric());
+    for (size_t i = 0; i < currentCount; i += 3) {
+        const float* p0 = PositionAt(vertexBytes, vertexStride, destination[i + 0]);
+        const float* p1 = PositionAt(vertexBytes, vertexStride, destination[i + 1]);
+        const float* p2 = PositionAt(vertexBytes, vertexStride, destination[i + 2]);
+
+        float normal[3];
+        TriangleNormal(p0, p1, p2, normal);
+        double length = std::sqrt(double(normal[0]) * normal[0] + double(normal[1]) * normal[1] + double(normal[2]) * normal[2]);
+        if (length <= 0.0) {
+            continue;
+        }
+
+        double a = normal[0] / length, b = normal[1] / length, c = normal[2] / length;
+        double d = -(a * p0[0] + b * p0[1] + c * p0[2]);
+        double area = length * 0.5;
+        for (int k = 0; k < 3; ++k) {
+            AddPlaneQuadric(quadrics[destination[i + k]], a, b, c, d, area);
+        }
+    }
+
+    // Vertices on open or non-manifold edges never move, which keeps borders and seams intact
+    std::vector<char> locked(vertexCount, 0);
+    {
+        std::unordered_map<uint64_t, uint32_t> edgeUses;
+        edgeUses.reserve(currentCount);
+        for (size_t i = 0; i < currentCount; i += 3) {
+            for (int k = 0; k < 3; ++k) {
+                uint32_t a = destination[i + k];
+                uint32_t b = destination[i + (k + 1) % 3];
+                uint64_t key = (uint64_t(std::min(a, b)) << 32) | std::max(a, b);
+                ++edgeUses[key];
+            }
+        }
+        for (const auto& edge : edgeUses) {
+            if (edge.second != 2) {
+                locked[edge.first >> 32] = 1;
+                locked[edge.first & 0xffffffffu] = 1;
+            }
+        }
+    }
+
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+    std::vector<uint32_t> adjacency;
+    std::vector<Collapse> collapses;
+    std::vector<char> touched(vertexCount);
+    double worstError = 0.0;
+
+    while (currentCount > targetIndexCount) {
+        // Triangles around every vertex for this pass
+        std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+        for (size_t i = 0; i < currentCount; ++i) ++adjacencyOffsets[destination[i] + 1];
+        for (size_t v = 0; v < vertexCount; ++v) adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+        adjacency.resize(currentCount);
+        {
+            std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+            for (size_t i = 0; i < currentCount; ++i) {
+                adjacency[fill[destination[i]]++] = static_cast<uint32_t>(i / 3);
+            }
+        }
+
+        // Cheapest direction of every interior edge, each edge is visited once
+        collapses.clear();
+        for (size_t i = 0; i < currentCount; i += 3) {
+            for (int k = 0; k < 3; ++k) {
+                uint32_t a = destination[i + k];
+                uint32_t b = destination[i + (k + 1) % 3];
+                if (a >= b || (locked[a] && locked[b])) {
+                    continue;
+                }
+
+                double errorAB = locked[a] ? DBL_MAX :
+                    QuadricError(quadrics[a], quadrics[b], PositionAt(vertexBytes, vertexStride, b));
+                double errorBA = locked[b] ? DBL_MAX :
+                    QuadricError(quadrics[a], quadrics[b], PositionAt(vertexBytes, vertexStride, a));
+
+                Collapse collapse = (errorAB <= errorBA) ? Collapse{ a, b, errorAB } : Collapse{ b, a, errorBA };
+                if (collapse.error <= maxError) {
+                    collapses.push_back(collapse);
+                }
+            }
+        }
+
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& l, const Collapse& r) {
+            if (l.error != r.error) return l.error < r.error;
+            if (l.from != r.from) return l.from < r.from;
+            return l.to < r.to;
+        });
+
+        // Apply the cheapest collapses that do not share a neighbourhood
+        std::fill(touched.begin(), touched.end(), 0);
+        size_t triangleCount = currentCount / 3;
+        size_t collapsed = 0;
+
+        for (const Collapse& collapse : collapses) {
+            if (triangleCount * 3 <= targetIndexCount) {
+                break;
+            }
+            if (touched[collapse.from] || touched[collapse.to]) {
+                continue;
+            }
+
+            const uint32_t* first = &adjacency[adjacencyOffsets[collapse.from]];
+            const uint32_t* last = &adjacency[0] + adjacencyOffsets[collapse.from + 1];
+            const float* target = PositionAt(vertexBytes, vertexStride, collapse.to);
+
+            // Reject collapses that flip a surviving triangle
+            bool flips = false;
+            size_t removedTriangles = 0;
+            for (const uint32_t* t = first; t != last && !flips; ++t) {
+                const uint32_t* triangle = destination + *t * 3;
+                if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) {
+                    ++removedTriangles;
+                    continue;
+                }
+
+                const float* before[3];
+                const float* after[3];
+                for (int k = 0; k < 3; ++k) {
+                    before[k] = PositionAt(vertexBytes, vertexStride, triangle[k]);
+                    after[k] = (triangle[k] == collapse.from) ? target : before[k];
+                }
+
+                float normalBefore[3], normalAfter[3];
+                TriangleNormal(before[0], before[1], before[2], normalBefore);
+                TriangleNormal(after[0], after[1], after[2], normalAfter);
+                float dot = normalBefore[0] * normalAfter[0] + normalBefore[1] * normalAfter[1] + normalBefore[2] * normalAfter[2];
+                flips = dot <= 0.0f;
+            }
+            if (flips) {
+                continue;
+            }
+
+            // Move the triangles onto the target vertex and fence off the neighbourhood
+            for (const uint32_t* t = first; t != last; ++t) {
+                uint32_t* triangle = destination + *t * 3;
+                for (int k = 0; k < 3; ++k) {
+                    touched[triangle[k]] = 1;
+                    if (triangle[k] == collapse.from) {
+                        triangle[k] = collapse.to;
+                    }
+                }
+            }
+
+            AddQuadric(quadrics[collapse.to], quadrics[collapse.from]);
+            worstError = std::max(worstError, collapse.error);
+            triangleCount -= removedTriangles;
+            ++collapsed;
+        }
+
+        if (collapsed == 0) {
+            break;
+        }
+
+        // Drop the triangles that became degenerate
+        size_t writeCount = 0;
+        for (size_t i = 0; i < currentCount; i += 3) {
+            uint32_t a = destination[i], b = destination[i + 1], c = destination[i + 2];
+            if (a != b && b != c && a != c) {
+                destination[writeCount++] = a;
+                destination[writeCount++] = b;
+                destination[writeCount++] = c;
+            }
+        }
+        currentCount = writeCount;
+    }
+
+    if (resultError) {
+        *resultError = static_cast<float>(std::sqrt(worstError));
+    }
+    return currentCount;
+}
+
+void MeshProcessing::GenerateLods(std::vector<uint32_t>& indices, const void* vertices, size_t vertexCount,
+    size_t vertexStride, const float* errorTargets, size_t levelCount, std::vector<Lod>& lods) {
+    const unsigned char* vertexBytes = static_cast<const unsigned char*>(vertices);
+
+    // Error targets are relative to the size of the mesh
+    float boundsMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (size_t v = 0; v < vertexCount; ++v) {
+        const float* p = PositionAt(vertexBytes, vertexStride, static_cast<uint32_t>(v));
+        for (int axis = 0; axis < 3; ++axis) {
+            boundsMin[axis] = std::min(boundsMin[axis], p[axis]);
+            boundsMax[axis] = std::max(boundsMax[axis], p[axis]);
+        }
+    }
+    float extent = 0.0f;
+    if (vertexCount > 0) {
+        float size[3] = { boundsMax[0] - boundsMin[0], boundsMax[1] - boundsMin[1], boundsMax[2] - boundsMin[2] };
+        extent = std::sqrt(size[0] * size[0] + size[1] * size[1] + size[2] * size[2]);
+    }
+
+    lods.clear();
+    Lod baseLod = { 0, static_cast<uint32_t>(indices.size()), 0.0f };
+    lods.push_back(baseLod);
+
+    // Every level is simplified from the full mesh rather than the level
+    // before it, so its error is measured against the original surface and
+    // stays within its own target
+    const std::vector<uint32_t> base(indices);
+    std::vector<uint32_t> simplified(indices.size());
+    std::vector<uint32_t> ordered;
+    size_t previousCount = base.size();
+
+    for (size_t level = 0; level < levelCount; ++level) {
+        size_t targetIndexCount = (previousCount / 6) * 3;
+        float error = 0.0f;
+        size_t count = Simplify(simplified.data(), base.data(), base.size(), vertices, vertexCount, vertexStride,
+            targetIndexCount, errorTargets[level] * extent, &error);
+
+        // Not worth a level if it barely reduces the previous one
+        if (count == 0 || count * 10 > previousCount * 9) {
+            break;
+        }
+
+        ordered.resize(count);
+        OptimizeVertexCache(ordered.data(), simplified.data(), count, vertexCount);
+
+        Lod lod = { static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(count), error };
+        indices.insert(indices.end(), ordered.begin(), ordered.end());
+        lods.push_back(lod);
+        previousCount = count;
+    }
+}
@@ -0,0 +1,75 @@
+// MeshProcessing.h
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// CPU-side geometry passes run on imported meshes before they are uploaded.
+// Vertices are treated as opaque blobs of vertexStride bytes; passes that need
+// positions expect three floats at the start of every vertex. Every pass is
+// deterministic, so baking the same mesh twice gives identical output.
+class MeshProcessing {
+public:
+    // Post-transform cache behaviour of an index buffer
+    struct VertexCacheStatistics {
+        size_t verticesTransformed;
+        float acmr;     // Average cache miss ratio, transformed vertices per triangle
+        float atvr;     // Average transform to vertex ratio, 1.0 is ideal
+    };
+
+    // Level of detail stored as a range of an index buffer shared by all levels.
+    // The error is the simplification error in mesh units.
+    struct Lod {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        float error;
+    };
+
+    // Merges bit-identical vertices and remaps the indices to match. Unique
+    // vertices are compacted to the front in first-occurrence order.
+    // Returns the new vertex count.
+    static size_t WeldVertices(void* vertices, size_t vertexCount, size_t vertexStride,
+        uint32_t* indices, size_t indexCount);
+
+    // True when every vertex can be addressed by a 16-bit index
+    static bool FitsIn16BitIndices(size_t vertexCount) { return vertexCount <= 0x10000; }
+
+    static void NarrowIndices(const uint32_t* indices, size_t indexCount, uint16_t* out);
+
+    // Reorders triangles for post-transform cache locality (Forsyth's linear-speed algorithm)
+    static void OptimizeVertexCache(uint32_t* destination, const uint32_t* indices, size_t indexCount,
+        size_t vertexCount);
+
+    // Splits cache-optimized triangles into clusters and orders the clusters so
+    // outward-facing ones draw first (Tipsify-style). A threshold above 1.0
+    // trades up to that factor of ACMR for more, smaller clusters.
+    static void OptimizeOverdraw(uint32_t* destination, const uint32_t* indices, size_t indexCount,
+        const void* vertices, size_t vertexCount, size_t vertexStride, float threshold);
+
+    // Reorders vertices by first use in the index buffer and remaps the indices.
+    // Unreferenced vertices are dropped. Returns the new vertex count.
+    static size_t OptimizeVertexFetch(void* destination, uint32_t* indices, size_t indexCount,
+        const void* vertices, size_t vertexCount, size_t vertexStride);
+
+    // Quadric error metric edge collapse onto existing vertices, so every level
+    // can share the original vertex buffer. Stops at targetIndexCount or when
+    // the next collapse would exceed targetError (mesh units). Border vertices
+    // stay in place. Returns the simplified index count.
+    static size_t Simplify(uint32_t* destination, const uint32_t* indices, size_t indexCount,
+        const void* vertices, size_t vertexCount, size_t vertexStride,
+        size_t targetIndexCount, float targetError, float* resultError);
+
+    // Builds a LOD chain by halving the triangle count of each level, within an
+    // error target per level given as a fraction of the mesh's bounding box
+    // diagonal. Each level is simplified from the original indices, so its
+    // error never exceeds its own target. Levels are appended to indices and
+    // described in lods, with level 0 covering the original indices. Stops
+    // early when a level no longer reduces the mesh.
+    static void GenerateLods(std::vector<uint32_t>& indices, const void* vertices, size_t vertexCount,
+        size_t vertexStride, const float* errorTargets, size_t levelCount, std::vector<Lod>& lods);
+
+    // Simulates a FIFO post-transform cache of the given size
+    static VertexCacheStatistics AnalyzeVertexCache(const uint32_t* indices, size_t indexCount,
+        size_t vertexCount, unsigned cacheSize = 16);
+};
@@ -0,0 +1,350 @@
+// MeshRegistry.cpp
+
+#include "MeshRegistry.h"
+#include "Hash.h"
+#include "Log.h"
+
+namespace {
+
+    // Seeds keeping the two upload forms and occluder flags apart
+    const uint64_t EncodedContentSeed = 0x6d657368656e63ull;
+    const uint64_t VertexContentSeed = 0x6d6573687665ull;
+
+    // Mixed into both seeds for the second hash that confirms a match
+    const uint64_t CheckSeed = 0x636865636b736d73ull;
+
+    uint64_t FinishContentHash(uint64_t hash, bool occluder) {
+        // Occluders keep CPU triangles the same geometry without the flag lacks
+        hash = HashBytes(&occluder, sizeof(occluder), hash);
+        return hash ? hash : 1;
+    }
+
+    uint64_t HashMeshData(const MeshData& data, bool occluder, uint64_t seed) {
+        uint64_t hash = HashBytes(data.GetVertexData(), size_t(data.GetVertexBytes()), EncodedContentSeed ^ seed);
+        hash = HashBytes(data.GetIndexData(), size_t(data.GetIndexBytes()), hash);
+        hash = HashBytes(&data.indexStride, sizeof(data.indexStride), hash);
+        hash = HashBytes(&data.positionRange, sizeof(data.positionRange), hash);
+        hash = HashBytes(data.lods.data(), data.lods.size() * sizeof(MeshProcessing::Lod), hash);
+        return FinishContentHash(hash, occluder);
+    }
+
+    uint64_t HashVertices(const std::vector<Mesh::Vertex>& vertices, const std::vector<uint32_t>& indices, bool occluder,
+        uint64_t seed) {
+        uint64_t hash = HashBytes(vertices.data(), vertices.size() * sizeof(Mesh::Vertex), VertexContentSeed ^ seed);
+        hash = HashBytes(indices.data(), indices.size() * sizeof(uint32_t), hash);
+        return FinishContentHash(hash, occluder);
+    }
+
+    uint32_t GetGpuBytes(const Mesh& mesh) {
+        return mesh.GetStats().vertexBufferBytes + mesh.GetStats().indexBufferBytes;
+    }
+
+    uint32_t GetCpuBytes(const Mesh& mesh) {
+        return static_cast<uint32_t>(mesh.GetOccluderPositions().size() * sizeof(float) +
+            mesh.GetOccluderIndices().size() * sizeof(uint32_t));
+    }
+
+}
+
+MeshRegistry::MeshRegistry()
+    : backend(nullptr), geometryPool(nullptr), framesInFlight(DefaultFramesInFlight), frame(0)
+{
+}
+
+void MeshRegistry::Initialize(RenderBackend* renderBackend, GeometryPool* pool, uint32_t frames) {
+    backend = renderBackend;
+    geometryPool = pool;
+    framesInFlight = frames;
+}
+
+MeshHandle MeshRegistry::Acquire(const std::string& name) {
+    auto it = nameLookup.find(name);
+    if (it == nameLookup.end()) {
+        return InvalidMesh;
+    }
+
+    Slot& slot = slots[GetIndex(it->second)];
+    ++slot.refCount;
+    ++slot.requests;
+    return it->second;
+}
+
+MeshHandle MeshRegistry::Create(const std::string& name, bool occluder) {
+    if (nameLookup.count(name)) {
+        LogMessage("Mesh %s is already registered\n", name.c_str());
+        return InvalidMesh;
+    }
+
+    uint32_t index;
+    if (!freeIndices.empty()) {
+        index = freeIndices.back();
+        freeIndices.pop_back();
+    }
+    else {
+        index = static_cast<uint32_t>(slots.size());
+        slots.emplace_back();
+        slots.back().generation = GenerationalHandle::FirstGeneration;
+    }
+
+    Slot& slot = slots[index];
+    slot.owned.reset(new Mesh(backend, geometryPool));
+    slot.owned->SetOccluder(occluder);
+    slot.mesh = slot.owned.get();
+    slot.name = name;
+    slot.content = ContentKey();
+    slot.sharedWith = InvalidMesh;
+    slot.refCount = 1;
+    slot.requests = 1;
+
+    MeshHandle handle = MakeHandle(index);
+    nameLookup[name] = handle;
+    return handle;
+}
+
+MeshHandle MeshRegistry::Create(const std::string& name, const std::vector<Mesh::Vertex>& vertices,
+    const std::vector<uint32_t>& indices, bool occluder) {
+    MeshHandle handle = Acquire(name);
+    if (handle != InvalidMesh) {
+        return handle;
+    }
+
+    handle = Create(name, occluder);
+    if (handle != InvalidMesh && !Upload(handle, vertices, indices)) {
+        Release(handle);
+        return InvalidMesh;
+    }
+    return handle;
+}
+
+bool MeshRegistry::Upload(MeshHandle handle, const MeshData& data) {
+    Slot* slot = FindSlot(handle);
+    if (!slot || !slot->owned || slot->owned->IsResident()) {
+        return false;
+    }
+
+    bool occluder = slot->owned->IsOccluder();
+    ContentKey content = { HashMeshData(data, occluder, 0), HashMeshData(data, occluder, CheckSeed),
+        data.GetVertexBytes(), data.GetIndexBytes() };
+    if (Share(handle, *slot, content)) {
+        return true;
+    }
+    if (!slot->owned->Initialize(data)) {
+        return false;
+    }
+
+    slot->content = content;
+    contentLookup[content.hash] = handle;
+    return true;
+}
+
+bool MeshRegistry::Upload(MeshHandle handle, const std::vector<Mesh::Vertex>& vertices, const std::vector<uint32_t>& indices) {
+    Slot* slot = FindSlot(handle);
+    if (!slot || !slot->owned || slot->owned->IsResident()) {
+        return false;
+    }
+
+    bool occluder = slot->owned->IsOccluder();
+    ContentKey content = { HashVertices(vertices, indices, occluder, 0), HashVertices(vertices, indices, occluder, CheckSeed),
+        vertices.size() * sizeof(Mesh::Vertex), indices.size() * sizeof(uint32_t) };
+    if (Share(handle, *slot, content)) {
+        return true;
+    }
+    if (!slot->owned->Initialize(vertices, indices)) {
+        return false;
+    }
+
+    slot->content = content;
+    contentLookup[content.hash] = handle;
+    return true;
+}
+
+bool MeshRegistry::Share(MeshHandle handle, Slot& slot, const ContentKey& content) {
+    auto it = contentLookup.find(content.hash);
+    if (it == contentLookup.end() || it->second == handle) {
+        return false;
+    }
+
+    Slot* owner = FindSlot(it->second);
+    if (!owner || !owner->mesh->IsResident()) {
+        return false;
+    }
+
+    // A matching hash alone could be a collision
+    if (owner->content.check != content.check || owner->content.vertexBytes != content.vertexBytes ||
+        owner->content.indexBytes != content.indexBytes) {
+        return false;
+    }
+
+    // The empty mesh never had buffers or a pool range, so it can go right away
+    slot.owned.reset();
+    slot.mesh = owner->mesh;
+    slot.content = content;
+    slot.sharedWith = it->second;
+    ++owner->refCount;
+    return true;
+}
+
+void MeshRegistry::AddRef(MeshHandle handle) {
+    Slot* slot = FindSlot(handle);
+    if (slot) {
+        ++slot->refCount;
+    }
+}
+
+void MeshRegistry::Release(MeshHandle handle) {
+    Slot* slot = FindSlot(handle);
+    if (!slot || slot->refCount == 0) {
+        return;
+    }
+
+    // Frames already submitted may still draw the mesh; EndFrame destroys it
+    // once they are done unless it is acquired again before then
+    if (--slot->refCount == 0) {
+        slot->releaseFrame = frame;
+        pendingReleases.push_back(PendingRelease{ GetIndex(handle), frame });
+    }
+}
+
+void MeshRegistry::EndFrame() {
+    ++frame;
+
+    // Destroying a slot that shares another's mesh releases the owner, which
+    // appends to the list; those entries are past count and are kept
+    size_t count = pendingReleases.size();
+    size_t kept = 0;
+    for (size_t i = 0; i < count; ++i) {
+        PendingRelease release = pendingReleases[i];
+        const Slot& slot = slots[release.index];
+        if (!slot.mesh || slot.refCount > 0 || slot.releaseFrame != release.frame) {
+            continue;   // Acquired again since
+        }
+
+        if (frame - release.frame < framesInFlight) {
+            pendingReleases[kept++] = release;
+        }
+        else {
+            Destroy(release.index);
+        }
+    }
+    pendingReleases.erase(pendingReleases.begin() + kept, pendingReleases.begin() + count);
+}
+
+void MeshRegistry::Destroy(uint32_t index) {
+    Slot& slot = slots[index];
+    MeshHandle handle = MakeHandle(index);
+
+    auto name = nameLookup.find(slot.name);
+    if (name != nameLookup.end() && name->second == handle) {
+        nameLookup.erase(name);
+    }
+    auto content = contentLookup.find(slot.content.hash);
+    if (content != contentLookup.end() && content->second == handle) {
+        contentLookup.erase(content);
+    }
+
+    MeshHandle sharedWith = slot.sharedWith;
+    slot.owned.reset();
+    slot.mesh = nullptr;
+    slot.name.clear();
+    slot.sharedWith = InvalidMesh;
+
+    slot.generation = GenerationalHandle::NextGeneration(slot.generation);
+    freeIndices.push_back(index);
+
+    if (sharedWith != InvalidMesh) {
+        Release(sharedWith);
+    }
+}
+
+void MeshRegistry::Clear() {
+    slots.clear();
+    freeIndices.clear();
+    pendingReleases.clear();
+    nameLookup.clear();
+    contentLookup.clear();
+}
+
+const MeshRegistry::Slot* MeshRegistry::FindSlot(MeshHandle handle) const {
+    uint32_t index = GetIndex(handle);
+    if (index >= slots.size()) {
+        return nullptr;
+    }
+    const Slot& slot = slots[index];
+    return (slot.mesh && slot.generation == GenerationalHandle::GetGeneration(handle)) ? &slot : nullptr;
+}
+
+MeshHandle MeshRegistry::MakeHandle(uint32_t index) const {
+    return GenerationalHandle::Make(index, slots[index].generation);
+}
+
+bool MeshRegistry::GetResourceInfo(MeshHandle handle, ResourceInfo& info) const {
+    const Slot* slot = FindSlot(handle);
+    if (!slot) {
+        return false;
+    }
+
+    info.name = slot->name.c_str();
+    info.refCount = slot->refCount;
+    info.requests = slot->requests;
+    info.gpuBytes = slot->owned ? GetGpuBytes(*slot->owned) : 0;
+    info.cpuBytes = slot->owned ? GetCpuBytes(*slot->owned) : 0;
+    info.sharedWith = slot->sharedWith;
+    info.resident = slot->mesh->IsResident();
+    return true;
+}
+
+MeshRegistry::Stats MeshRegistry::GetStats() const {
+    Stats stats = {};
+    uint64_t unsharedBytes = 0;
+    for (const Slot& slot : slots) {
+        if (!slot.mesh) {
+            continue;
+        }
+
+        ++stats.resources;
+        stats.references += slot.refCount;
+        unsharedBytes += static_cast<uint64_t>(GetGpuBytes(*slot.mesh) + GetCpuBytes(*slot.mesh)) * slot.requests;
+        if (slot.refCount == 0) {
+            ++stats.pendingReleases;
+        }
+        if (!slot.owned) {
+            continue;
+        }
+
+        uint32_t gpuBytes = GetGpuBytes(*slot.owned);
+        uint32_t cpuBytes = GetCpuBytes(*slot.owned);
+        ++stats.uniqueMeshes;
+        stats.gpuBytes += gpuBytes;
+        stats.cpuBytes += cpuBytes;
+        if (slot.refCount == 0) {
+            stats.pendingBytes += gpuBytes + cpuBytes;
+        }
+    }
+
+    uint64_t ownedBytes = stats.gpuBytes + stats.cpuBytes;
+    stats.savedBytes = unsharedBytes > ownedBytes ? unsharedBytes - ownedBytes : 0;
+    return stats;
+}
+
+void MeshRegistry::LogStats() const {
+    Stats stats = GetStats();
+    LogMessage("Mesh registry: %u resources, %u unique meshes, %u references, %llu GPU bytes, %llu CPU bytes, %u pending releases (%llu bytes), %llu bytes saved by sharing\n",
+        stats.resources, stats.uniqueMeshes, stats.references,
+        static_cast<unsigned long long>(stats.gpuBytes), static_cast<unsigned long long>(stats.cpuBytes),
+        stats.pendingReleases, static_cast<unsigned long long>(stats.pendingBytes),
+        static_cast<unsigned long long>(stats.savedBytes));
+}
+
+void MeshRegistry::LogResources() const {
+    for (uint32_t index = 0; index < slots.size(); ++index) {
+        ResourceInfo info;
+        if (!GetResourceInfo(MakeHandle(index), info)) {
+            continue;
+        }
+
+        const Slot* owner = FindSlot(info.sharedWith);
+        LogMessage("  %s: %u references, %u requests, %u GPU bytes, %u CPU bytes%s%s%s\n",
+            info.name, info.refCount, info.requests, info.gpuBytes, info.cpuBytes,
+            owner ? ", shares " : "", owner ? owner->name.c_str() : "", info.resident ? "" : ", not resident");
+    }
+}
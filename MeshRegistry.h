@@ -0,0 +1,148 @@
+// MeshRegistry.h
+
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "GenerationalHandle.h"
+#include "GeometryPool.h"
+#include "Mesh.h"
+#include "MeshData.h"
+#include "RenderBackend.h"
+
+// A GenerationalHandle; 0 is never valid
+typedef uint64_t MeshHandle;
+const MeshHandle InvalidMesh = 0;
+
+// Owns every mesh and hands out reference-counted handles to them. Meshes are
+// shared by name, so requesting a loaded file again returns the same handle,
+// and by content, so two names with identical geometry share one set of
+// buffers. A mesh whose last reference goes away is only destroyed once the
+// frames that may still draw it have left the GPU.
+class MeshRegistry {
+public:
+    // Frames the backend may queue plus the one being recorded
+    static const uint32_t DefaultFramesInFlight = 3;
+
+    // Memory of one resource. A resource sharing another's geometry owns no
+    // bytes of its own.
+    struct ResourceInfo {
+        const char* name;
+        uint32_t refCount;
+        uint32_t requests;          // Create and Acquire calls it answered
+        uint32_t gpuBytes;          // Vertex and index buffers
+        uint32_t cpuBytes;          // Occluder triangles
+        MeshHandle sharedWith;      // Owner of the geometry, InvalidMesh if this is it
+        bool resident;
+    };
+
+    // Bytes saved count what every request would have cost with its own copy
+    struct Stats {
+        uint32_t resources;
+        uint32_t uniqueMeshes;
+        uint32_t references;
+        uint32_t pendingReleases;
+        uint64_t gpuBytes;
+        uint64_t cpuBytes;
+        uint64_t pendingBytes;      // Owned by meshes waiting for the GPU to finish with them
+        uint64_t savedBytes;
+    };
+
+    MeshRegistry();
+
+    // The backend and pool must outlive the registry. Without a pool every mesh
+    // gets buffers of its own.
+    void Initialize(RenderBackend* backend, GeometryPool* geometryPool = nullptr,
+        uint32_t framesInFlight = DefaultFramesInFlight);
+
+    // Adds a reference to the mesh registered under the name, or returns
+    // InvalidMesh when there is none. Brings back meshes waiting for release.
+    MeshHandle Acquire(const std::string& name);
+
+    // Registers an empty mesh under a new name with one reference, for data
+    // that streams in later. Occluders must be flagged before they are filled in.
+    MeshHandle Create(const std::string& name, bool occluder = false);
+
+    // Acquire, or Create and fill in from the vertices when the name is new
+    MeshHandle Create(const std::string& name, const std::vector<Mesh::Vertex>& vertices,
+        const std::vector<uint32_t>& indices, bool occluder = false);
+
+    // Fills in an empty mesh. Geometry identical to a resident mesh's is shared
+    // with it instead of getting buffers of its own.
+    bool Upload(MeshHandle handle, const MeshData& data);
+    bool Upload(MeshHandle handle, const std::vector<Mesh::Vertex>& vertices, const std::vector<uint32_t>& indices);
+
+    void AddRef(MeshHandle handle);
+    void Release(MeshHandle handle);
+
+    bool IsValid(MeshHandle handle) const { return FindSlot(handle) != nullptr; }
+
+    // The mesh to draw for the handle, the shared one if it has been deduplicated.
+    // Null for stale handles.
+    Mesh* Get(MeshHandle handle) const {
+        const Slot* slot = FindSlot(handle);
+        return slot ? slot->mesh : nullptr;
+    }
+
+    // Destroys meshes released more than the frames in flight ago. Call once per presented frame.
+    void EndFrame();
+
+    // Destroys every mesh, whatever its references; only safe once the GPU is idle
+    void Clear();
+
+    bool GetResourceInfo(MeshHandle handle, ResourceInfo& info) const;
+    Stats GetStats() const;
+    void LogStats() const;
+    void LogResources() const;
+
+    static uint32_t GetIndex(MeshHandle handle) { return GenerationalHandle::GetIndex(handle); }
+
+private:
+    // Two meshes share when all of this matches. The check is a second hash
+    // of the same bytes with another seed, so a false match needs two 64-bit
+    // collisions at once; nothing of the geometry itself is kept.
+    struct ContentKey {
+        uint64_t hash;                  // 0 until filled in
+        uint64_t check;
+        uint64_t vertexBytes;
+        uint64_t indexBytes;
+    };
+
+    struct Slot {
+        std::unique_ptr<Mesh> owned;    // Null for slots sharing another's mesh
+        Mesh* mesh;                     // Owned or shared; null while the slot is free
+        std::string name;
+        ContentKey content;
+        MeshHandle sharedWith;          // Holds a reference while set
+        uint32_t generation;
+        uint32_t refCount;
+        uint32_t requests;
+        uint32_t releaseFrame;
+    };
+
+    struct PendingRelease {
+        uint32_t index;
+        uint32_t frame;
+    };
+
+    const Slot* FindSlot(MeshHandle handle) const;
+    Slot* FindSlot(MeshHandle handle) { return const_cast<Slot*>(static_cast<const MeshRegistry*>(this)->FindSlot(handle)); }
+    MeshHandle MakeHandle(uint32_t index) const;
+
+    // Points the slot at a resident mesh with the same content; false when there is none
+    bool Share(MeshHandle handle, Slot& slot, const ContentKey& content);
+    void Destroy(uint32_t index);
+
+    RenderBackend* backend;
+    GeometryPool* geometryPool;
+    uint32_t framesInFlight;
+    uint32_t frame;
+
+    std::vector<Slot> slots;
+    std::vector<uint32_t> freeIndices;
+    std::vector<PendingRelease> pendingReleases;
+    std::unordered_map<std::string, MeshHandle> nameLookup;
+    std::unordered_map<uint64_t, MeshHandle> contentLookup;
+};
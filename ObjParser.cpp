@@ -0,0 +1,498 @@
+// ObjParser.cpp
+
+#include "ObjParser.h"
+#include "LinearArena.h"
+#include "MappedFile.h"
+#include "MemoryTracker.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+namespace {
+
+    // Largest mantissa that can take another digit and still be exact in a double
+    const uint64_t MaxExactMantissa = 900719925474099ULL;
+
+    const double PowersOfTen[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    inline bool IsDigit(char c) {
+        return c >= '0' && c <= '9';
+    }
+
+    inline bool IsSpace(char c) {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    inline const char* SkipSpaces(const char* p, const char* end) {
+        while (p < end && IsSpace(*p)) ++p;
+        return p;
+    }
+
+    inline const char* FindLineEnd(const char* p, const char* end) {
+        const char* newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        return newline ? newline : end;
+    }
+
+    bool ParseFloat(const char*& p, const char* end, float& out) {
+        const char* s = SkipSpaces(p, end);
+
+        bool negative = false;
+        if (s < end && (*s == '-' || *s == '+')) {
+            negative = (*s == '-');
+            ++s;
+        }
+
+        uint64_t mantissa = 0;
+        int exponent = 0;
+        bool anyDigits = false;
+
+        // Integer part, digits past double precision only shift the exponent
+        while (s < end && IsDigit(*s)) {
+            if (mantissa < MaxExactMantissa) {
+                mantissa = mantissa * 10 + static_cast<uint64_t>(*s - '0');
+            }
+            else {
+                ++exponent;
+            }
+            anyDigits = true;
+            ++s;
+        }
+
+        // Fractional part
+        if (s < end && *s == '.') {
+            ++s;
+            while (s < end && IsDigit(*s)) {
+                if (mantissa < MaxExactMantissa) {
+                    mantissa = mantissa * 10 + static_cast<uint64_t>(*s - '0');
+                    --exponent;
+                }
+                anyDigits = true;
+                ++s;
+            }
+        }
+
+        if (!anyDigits) {
+            return false;
+        }
+
+        // Exponent part
+        if (s < end && (*s == 'e' || *s == 'E')) {
+            ++s;
+            bool negativeExponent = false;
+            if (s < end && (*s == '-' || *s == '+')) {
+                negativeExponent = (*s == '-');
+                ++s;
+            }
+            if (s >= end || !IsDigit(*s)) {
+                return false;
+            }
+            int explicitExponent = 0;
+            while (s < end && IsDigit(*s)) {
+                if (explicitExponent < 10000) {
+                    explicitExponent = explicitExponent * 10 + (*s - '0');
+                }
+                ++s;
+            }
+            exponent += negativeExponent ? -explicitExponent : explicitExponent;
+        }
+
+        double value = static_cast<double>(mantissa);
+        if (mantissa != 0) {
+            while (exponent < -22) {
+                value /= PowersOfTen[22];
+                exponent += 22;
+            }
+            while (exponent > 22) {
+                value *= PowersOfTen[22];
+                exponent -= 22;
+            }
+            value = (exponent < 0) ? value / PowersOfTen[-exponent] : value * PowersOfTen[exponent];
+        }
+
+        out = static_cast<float>(negative ? -value : value);
+        p = s;
+        return true;
+    }
+
+    bool ParseInt(const char*& p, const char* end, int32_t& out) {
+        const char* s = p;
+
+        bool negative = false;
+        if (s < end && (*s == '-' || *s == '+')) {
+            negative = (*s == '-');
+            ++s;
+        }
+
+        if (s >= end || !IsDigit(*s)) {
+            return false;
+        }
+
+        int64_t value = 0;
+        while (s < end && IsDigit(*s)) {
+            value = value * 10 + (*s - '0');
+            if (value > INT32_MAX) {
+                return false;
+            }
+            ++s;
+        }
+
+        out = static_cast<int32_t>(negative ? -value : value);
+        p = s;
+        return true;
+    }
+
+    // Files are only split into chunks this large or larger
+    const size_t MinChunkSize = 1 << 20;
+
+    enum Attribute : uint32_t {
+        AttributePosition,
+        AttributeTexcoord,
+        AttributeNormal,
+        AttributeCount
+    };
+
+    // Bookkeeping of a parse comes from one arena that is freed at once when
+    // the parse ends, sized so that small files need a single block
+    const size_t ScratchCapacity = 64 * 1024;
+
+    // Output of parsing one line-aligned slice of the file. Negative indices can
+    // reach into earlier chunks, so they are stored relative to the start of the
+    // chunk and patched once the attribute counts of all chunks are known.
+    struct ObjChunk {
+        explicit ObjChunk(LinearArena& scratch)
+            : relativeRefs(ArenaAllocator<uint32_t>(scratch)), scratch(&scratch) {}
+
+        ObjData data;
+        ArenaVector<uint32_t> relativeRefs;             // Corner index << 2 | attribute
+        int64_t requiredBase[AttributeCount] = {};      // Attributes that must precede the chunk
+        LinearArena* scratch;
+    };
+
+    // Converts a 1-based or negative OBJ index into a 0-based one. Absolute
+    // indices are final, relative ones are local to the chunk and flagged in
+    // relativeMask. Either way the number of attributes that must come before
+    // the chunk is tracked so range errors are still caught once the chunk
+    // offsets are known.
+    inline bool ResolveIndex(int32_t index, size_t localCount, uint32_t attribute,
+        ObjChunk& chunk, int32_t& out, uint32_t& relativeMask) {
+        if (index == 0) {
+            return false;
+        }
+
+        int64_t required;
+        if (index > 0) {
+            out = index - 1;
+            required = int64_t(index) - int64_t(localCount);
+        }
+        else {
+            int64_t local = int64_t(localCount) + index;
+            out = static_cast<int32_t>(local);
+            required = -local;
+            relativeMask |= 1u << attribute;
+        }
+
+        if (required > chunk.requiredBase[attribute]) {
+            chunk.requiredBase[attribute] = required;
+        }
+        return true;
+    }
+
+    inline void EmitCorner(ObjChunk& chunk, const ObjData::Corner& corner, uint32_t relativeMask) {
+        uint32_t cornerIndex = static_cast<uint32_t>(chunk.data.corners.size());
+        chunk.data.corners.push_back(corner);
+
+        for (uint32_t attribute = 0; attribute < AttributeCount; ++attribute) {
+            if (relativeMask & (1u << attribute)) {
+                chunk.relativeRefs.push_back((cornerIndex << 2) | attribute);
+            }
+        }
+    }
+
+    // Checks that every index in the chunk is in range once it follows the given attribute counts
+    inline bool FitsAfter(const ObjChunk& chunk, size_t positionCount, size_t texcoordCount, size_t normalCount) {
+        return chunk.requiredBase[AttributePosition] <= int64_t(positionCount) &&
+            chunk.requiredBase[AttributeTexcoord] <= int64_t(texcoordCount) &&
+            chunk.requiredBase[AttributeNormal] <= int64_t(normalCount);
+    }
+
+    // Runs function(i) for every i in [0, count), one thread each
+    template <typename Function>
+    void RunParallel(size_t count, Function function) {
+        std::vector<std::thread> workers;
+        workers.reserve(count - 1);
+        for (size_t i = 1; i < count; ++i) {
+            workers.emplace_back(function, i);
+        }
+        function(0);
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    inline int32_t& CornerAttribute(ObjData::Corner& corner, uint32_t attribute) {
+        switch (attribute) {
+        case AttributeTexcoord: return corner.texcoord;
+        case AttributeNormal: return corner.normal;
+        default: return corner.position;
+        }
+    }
+
+    // Cheap first pass over the statement keywords so the output can be reserved
+    void CountStatements(const char* p, const char* end, ObjData& out) {
+        size_t positionCount = 0;
+        size_t texcoordCount = 0;
+        size_t normalCount = 0;
+        size_t faceCount = 0;
+
+        while (p < end) {
+            const char* lineEnd = FindLineEnd(p, end);
+            const char* s = SkipSpaces(p, lineEnd);
+            if (lineEnd - s >= 2) {
+                if (s[0] == 'v') {
+                    if (IsSpace(s[1])) ++positionCount;
+                    else if (s[1] == 't') ++texcoordCount;
+                    else if (s[1] == 'n') ++normalCount;
+                }
+                else if (s[0] == 'f' && IsSpace(s[1])) {
+                    ++faceCount;
+                }
+            }
+            p = lineEnd + 1;
+        }
+
+        out.positions.reserve(positionCount);
+        out.texcoords.reserve(texcoordCount);
+        out.normals.reserve(normalCount);
+        out.corners.reserve(faceCount * 3);
+    }
+
+    bool ParseChunk(const char* p, const char* end, ObjChunk& chunk) {
+        // Chunks past the first run on threads of their own
+        MemoryTagScope tag(MemoryTag::Import);
+        ObjData& out = chunk.data;
+        CountStatements(p, end, out);
+
+        // Reused for every face so polygons do not allocate per line
+        ArenaVector<ObjData::Corner> face(ArenaAllocator<ObjData::Corner>(*chunk.scratch));
+        ArenaVector<uint32_t> faceRelativeMasks(ArenaAllocator<uint32_t>(*chunk.scratch));
+        face.reserve(16);
+        faceRelativeMasks.reserve(16);
+
+        while (p < end) {
+            const char* lineEnd = FindLineEnd(p, end);
+            const char* s = SkipSpaces(p, lineEnd);
+
+            if (lineEnd - s >= 2 && s[0] == 'v') {
+                if (IsSpace(s[1])) {
+                    // Vertex position
+                    ObjData::Float3 position{};
+                    s += 1;
+                    if (!ParseFloat(s, lineEnd, position.x) ||
+                        !ParseFloat(s, lineEnd, position.y) ||
+                        !ParseFloat(s, lineEnd, position.z)) {
+                        return false;
+                    }
+                    out.positions.push_back(position);
+                }
+                else if (s[1] == 't' && lineEnd - s >= 3 && IsSpace(s[2])) {
+                    // Texture coordinate, an optional w component is ignored
+                    ObjData::Float2 texcoord{};
+                    s += 2;
+                    if (!ParseFloat(s, lineEnd, texcoord.x)) {
+                        return false;
+                    }
+                    const char* next = s;
+                    if (!ParseFloat(next, lineEnd, texcoord.y)) {
+                        texcoord.y = 0.0f;
+                    }
+                    out.texcoords.push_back(texcoord);
+                }
+                else if (s[1] == 'n' && lineEnd - s >= 3 && IsSpace(s[2])) {
+                    // Vertex normal
+                    ObjData::Float3 normal{};
+                    s += 2;
+                    if (!ParseFloat(s, lineEnd, normal.x) ||
+                        !ParseFloat(s, lineEnd, normal.y) ||
+                        !ParseFloat(s, lineEnd, normal.z)) {
+                        return false;
+                    }
+                    out.normals.push_back(normal);
+                }
+            }
+            else if (lineEnd - s >= 2 && s[0] == 'f' && IsSpace(s[1])) {
+                // Face corners in the v, v/vt, v//vn or v/vt/vn forms
+                face.clear();
+                faceRelativeMasks.clear();
+                s += 1;
+
+                while (true) {
+                    s = SkipSpaces(s, lineEnd);
+                    if (s >= lineEnd || *s == '#') {
+                        break;
+                    }
+
+                    ObjData::Corner corner = { -1, -1, -1 };
+                    uint32_t relativeMask = 0;
+                    int32_t index = 0;
+
+                    if (!ParseInt(s, lineEnd, index) ||
+                        !ResolveIndex(index, out.positions.size(), AttributePosition, chunk, corner.position, relativeMask)) {
+                        return false;
+                    }
+
+                    if (s < lineEnd && *s == '/') {
+                        ++s;
+                        if (s < lineEnd && *s != '/') {
+                            if (!ParseInt(s, lineEnd, index) ||
+                                !ResolveIndex(index, out.texcoords.size(), AttributeTexcoord, chunk, corner.texcoord, relativeMask)) {
+                                return false;
+                            }
+                        }
+                        if (s < lineEnd && *s == '/') {
+                            ++s;
+                            if (!ParseInt(s, lineEnd, index) ||
+                                !ResolveIndex(index, out.normals.size(), AttributeNormal, chunk, corner.normal, relativeMask)) {
+                                return false;
+                            }
+                        }
+                    }
+
+                    if (s < lineEnd && !IsSpace(*s)) {
+                        return false;
+                    }
+
+                    face.push_back(corner);
+                    faceRelativeMasks.push_back(relativeMask);
+                }
+
+                // Triangulate face if necessary
+                for (size_t i = 1; i + 1 < face.size(); ++i) {
+                    EmitCorner(chunk, face[0], faceRelativeMasks[0]);
+                    EmitCorner(chunk, face[i], faceRelativeMasks[i]);
+                    EmitCorner(chunk, face[i + 1], faceRelativeMasks[i + 1]);
+                }
+            }
+
+            p = lineEnd + 1;
+        }
+
+        return true;
+    }
+
+}
+
+bool ObjParser::ParseFile(const std::string& filename, ObjData& out, unsigned threadCount) {
+    MappedFile file;
+    if (!file.Open(filename)) {
+        return false;
+    }
+
+    return Parse(file.GetData(), file.GetSize(), out, threadCount);
+}
+
+bool ObjParser::Parse(const char* data, size_t size, ObjData& out, unsigned threadCount) {
+    MemoryTagScope tag(MemoryTag::Import);
+    LinearArena scratch(ScratchCapacity, MemoryTag::Import);
+    out = ObjData();
+
+    size_t chunkCount = threadCount;
+    if (chunkCount == 0) {
+        size_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+        chunkCount = std::min(hardwareThreads, size / MinChunkSize);
+    }
+    chunkCount = std::max<size_t>(1, std::min(chunkCount, size));
+
+    const char* end = data + size;
+
+    // Serial path, which is the single chunk case of the parallel one
+    if (chunkCount == 1) {
+        ObjChunk chunk(scratch);
+        if (!ParseChunk(data, end, chunk) || !FitsAfter(chunk, 0, 0, 0)) {
+            return false;
+        }
+        out = std::move(chunk.data);
+        return true;
+    }
+
+    // Split the file on line boundaries
+    ArenaVector<const char*> chunkStarts(chunkCount + 1, nullptr, ArenaAllocator<const char*>(scratch));
+    chunkStarts[0] = data;
+    chunkStarts[chunkCount] = end;
+    for (size_t i = 1; i < chunkCount; ++i) {
+        const char* split = std::max(data + size * i / chunkCount, chunkStarts[i - 1]);
+        const char* lineEnd = FindLineEnd(split, end);
+        chunkStarts[i] = (lineEnd < end) ? lineEnd + 1 : end;
+    }
+
+    // Parse every chunk independently
+    ArenaAllocator<ObjChunk> chunkAllocator(scratch);
+    ArenaVector<ObjChunk> chunks(chunkAllocator);
+    chunks.reserve(chunkCount);
+    for (size_t i = 0; i < chunkCount; ++i) {
+        chunks.emplace_back(scratch);
+    }
+    ArenaVector<char> succeeded(chunkCount, 0, ArenaAllocator<char>(scratch));
+    RunParallel(chunkCount, [&](size_t i) {
+        succeeded[i] = ParseChunk(chunkStarts[i], chunkStarts[i + 1], chunks[i]);
+    });
+
+    // Prefix sum of the attribute and corner counts gives each chunk its global offsets
+    ArenaAllocator<size_t> baseAllocator(scratch);
+    ArenaVector<size_t> positionBase(chunkCount, 0, baseAllocator), texcoordBase(chunkCount, 0, baseAllocator);
+    ArenaVector<size_t> normalBase(chunkCount, 0, baseAllocator), cornerBase(chunkCount, 0, baseAllocator);
+    size_t positionCount = 0, texcoordCount = 0, normalCount = 0, cornerCount = 0;
+    for (size_t i = 0; i < chunkCount; ++i) {
+        const ObjChunk& chunk = chunks[i];
+        if (!succeeded[i] || !FitsAfter(chunk, positionCount, texcoordCount, normalCount)) {
+            return false;
+        }
+
+        positionBase[i] = positionCount;
+        texcoordBase[i] = texcoordCount;
+        normalBase[i] = normalCount;
+        cornerBase[i] = cornerCount;
+
+        positionCount += chunk.data.positions.size();
+        texcoordCount += chunk.data.texcoords.size();
+        normalCount += chunk.data.normals.size();
+        cornerCount += chunk.data.corners.size();
+    }
+
+    if (positionCount > INT32_MAX || texcoordCount > INT32_MAX || normalCount > INT32_MAX) {
+        return false;
+    }
+
+    out.positions.resize(positionCount);
+    out.texcoords.resize(texcoordCount);
+    out.normals.resize(normalCount);
+    out.corners.resize(cornerCount);
+
+    // Merge the chunks into place and rebase their relative indices
+    RunParallel(chunkCount, [&](size_t i) {
+        ObjChunk& chunk = chunks[i];
+        std::copy(chunk.data.positions.begin(), chunk.data.positions.end(), out.positions.begin() + positionBase[i]);
+        std::copy(chunk.data.texcoords.begin(), chunk.data.texcoords.end(), out.texcoords.begin() + texcoordBase[i]);
+        std::copy(chunk.data.normals.begin(), chunk.data.normals.end(), out.normals.begin() + normalBase[i]);
+
+        ObjData::Corner* corners = out.corners.data() + cornerBase[i];
+        std::copy(chunk.data.corners.begin(), chunk.data.corners.end(), corners);
+
+        const int32_t bases[AttributeCount] = {
+            static_cast<int32_t>(positionBase[i]),
+            static_cast<int32_t>(texcoordBase[i]),
+            static_cast<int32_t>(normalBase[i])
+        };
+        for (uint32_t ref : chunk.relativeRefs) {
+            uint32_t attribute = ref & 3;
+            CornerAttribute(corners[ref >> 2], attribute) += bases[attribute];
+        }
+
+        chunk.data = ObjData();
+    });
+
+    return true;
+}
@@ -0,0 +1,44 @@
+// ObjParser.h
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Contents of a Wavefront OBJ file. Faces are fan-triangulated and every
+// corner is resolved to 0-based indices into the attribute arrays.
+struct ObjData {
+    struct Float2 {
+        float x, y;
+    };
+
+    struct Float3 {
+        float x, y, z;
+    };
+
+    // Attribute indices of one triangle corner, -1 when the face omits them
+    struct Corner {
+        int32_t position;
+        int32_t texcoord;
+        int32_t normal;
+    };
+
+    std::vector<Float3> positions;
+    std::vector<Float2> texcoords;
+    std::vector<Float3> normals;
+    std::vector<Corner> corners;    // Three per triangle
+};
+
+// Parses OBJ text straight out of a memory-mapped file without building
+// intermediate strings. Supports the v, vt, vn and f statements including the
+// v/vt/vn, v//vn and v/vt face forms and negative (relative) indices.
+//
+// Large files are split on line boundaries and the chunks parsed on separate
+// threads. The result is identical to parsing with a single thread. A thread
+// count of 0 picks one based on the file size and available cores.
+class ObjParser {
+public:
+    static bool ParseFile(const std::string& filename, ObjData& out, unsigned threadCount = 0);
+    static bool Parse(const char* data, size_t size, ObjData& out, unsigned threadCount = 0);
+};
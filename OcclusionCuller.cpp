@@ -0,0 +1,390 @@
+// OcclusionCuller.cpp
+
+#include "OcclusionCuller.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define BOG_OCCLUSION_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+    void MultiplyMatrices(const float a[16], const float b[16], float result[16]) {
+        for (int row = 0; row < 4; ++row) {
+            for (int column = 0; column < 4; ++column) {
+                result[row * 4 + column] =
+                    a[row * 4 + 0] * b[0 * 4 + column] + a[row * 4 + 1] * b[1 * 4 + column] +
+                    a[row * 4 + 2] * b[2 * 4 + column] + a[row * 4 + 3] * b[3 * 4 + column];
+            }
+        }
+    }
+
+    void TransformPoint(const float* point, const float m[16], float clip[4]) {
+        for (int i = 0; i < 4; ++i) {
+            clip[i] = point[0] * m[0 * 4 + i] + point[1] * m[1 * 4 + i] + point[2] * m[2 * 4 + i] + m[3 * 4 + i];
+        }
+    }
+
+    // Edge function of a -> b: positive on the inside of a counterclockwise triangle
+    void SetupEdge(float ax, float ay, float bx, float by, float edge[3]) {
+        edge[0] = ay - by;
+        edge[1] = bx - ax;
+        edge[2] = -(edge[1] * ay) - edge[0] * ax;
+    }
+
+}
+
+OcclusionCuller::OcclusionCuller()
+    : width(0), height(0), tilesX(0), tilesY(0), viewProj(), stats()
+{
+}
+
+bool OcclusionCuller::Initialize(int bufferWidth, int bufferHeight) {
+    if (bufferWidth <= 0 || bufferHeight <= 0) {
+        return false;
+    }
+
+    tilesX = (bufferWidth + TileWidth - 1) / TileWidth;
+    tilesY = (bufferHeight + TileHeight - 1) / TileHeight;
+    width = tilesX * TileWidth;
+    height = tilesY * TileHeight;
+    depth.assign(static_cast<size_t>(width) * height, 1.0f);
+    tileMaxDepth.assign(static_cast<size_t>(tilesX) * tilesY, 1.0f);
+    return true;
+}
+
+void OcclusionCuller::BeginFrame(const float matrix[16]) {
+    std::memcpy(viewProj, matrix, sizeof(viewProj));
+    occluders.clear();
+    stats = Stats();
+}
+
+void OcclusionCuller::AddOccluder(const float* positions, size_t vertexCount,
+    const uint32_t* indices, size_t indexCount, const float world[16]) {
+    Occluder occluder;
+    occluder.positions = positions;
+    occluder.vertexCount = vertexCount;
+    occluder.indices = indices;
+    occluder.indexCount = indexCount;
+    std::memcpy(occluder.world, world, sizeof(occluder.world));
+    occluders.push_back(occluder);
+
+    ++stats.occluders;
+    stats.occluderTriangles += static_cast<uint32_t>(indexCount / 3);
+}
+
+void OcclusionCuller::Rasterize(JobSystem* jobs) {
+    auto start = std::chrono::steady_clock::now();
+
+    // Bands cover disjoint rows and tiles, so they need no synchronization
+    SetupTriangles();
+    if (jobs) {
+        jobs->ParallelFor(static_cast<size_t>(tilesY), 1, [this](size_t begin, size_t end) {
+            for (size_t band = begin; band < end; ++band) {
+                RasterizeBand(static_cast<int>(band));
+            }
+        });
+    }
+    else {
+        for (int band = 0; band < tilesY; ++band) {
+            RasterizeBand(band);
+        }
+    }
+
+    std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    stats.rasterMilliseconds = elapsed.count();
+}
+
+void OcclusionCuller::SetupTriangles() {
+    triangles.clear();
+
+    for (const Occluder& occluder : occluders) {
+        float worldViewProj[16];
+        MultiplyMatrices(occluder.world, viewProj, worldViewProj);
+
+        for (size_t i = 0; i + 2 < occluder.indexCount; i += 3) {
+            float clip[3][4];
+            bool valid = true;
+            for (int corner = 0; corner < 3; ++corner) {
+                uint32_t index = occluder.indices[i + corner];
+                if (index >= occluder.vertexCount) {
+                    valid = false;
+                    break;
+                }
+                TransformPoint(occluder.positions + index * 3, worldViewProj, clip[corner]);
+            }
+            if (!valid) {
+                continue;
+            }
+
+            // Clip against the near plane (z >= 0); the other planes are handled
+            // by clamping the screen bounds
+            int inFront = 0;
+            for (int corner = 0; corner < 3; ++corner) {
+                inFront += clip[corner][2] >= 0.0f ? 1 : 0;
+            }
+            if (inFront == 0) {
+                continue;
+            }
+            if (inFront == 3) {
+                AddTriangle(clip);
+                continue;
+            }
+
+            float polygon[4][4];
+            int polygonSize = 0;
+            for (int corner = 0; corner < 3; ++corner) {
+                const float* a = clip[corner];
+                const float* b = clip[(corner + 1) % 3];
+                if (a[2] >= 0.0f) {
+                    std::memcpy(polygon[polygonSize++], a, sizeof(float) * 4);
+                }
+                if ((a[2] >= 0.0f) != (b[2] >= 0.0f)) {
+                    float t = a[2] / (a[2] - b[2]);
+                    for (int c = 0; c < 4; ++c) {
+                        polygon[polygonSize][c] = a[c] + (b[c] - a[c]) * t;
+                    }
+                    ++polygonSize;
+                }
+            }
+
+            // One triangle or a quad split into two
+            for (int fan = 1; fan + 1 < polygonSize; ++fan) {
+                float fanTriangle[3][4];
+                std::memcpy(fanTriangle[0], polygon[0], sizeof(float) * 4);
+                std::memcpy(fanTriangle[1], polygon[fan], sizeof(float) * 4);
+                std::memcpy(fanTriangle[2], polygon[fan + 1], sizeof(float) * 4);
+                AddTriangle(fanTriangle);
+            }
+        }
+    }
+
+    stats.rasterTriangles = static_cast<uint32_t>(triangles.size());
+}
+
+void OcclusionCuller::AddTriangle(const float clip[3][4]) {
+    float x[3], y[3], z[3];
+    for (int corner = 0; corner < 3; ++corner) {
+        float w = clip[corner][3];
+        if (w <= 1e-6f) {
+            return;
+        }
+        float invW = 1.0f / w;
+        x[corner] = (clip[corner][0] * invW * 0.5f + 0.5f) * width;
+        y[corner] = (0.5f - clip[corner][1] * invW * 0.5f) * height;
+        z[corner] = clip[corner][2] * invW;
+    }
+
+    // Either winding is drawn; flip clockwise triangles
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+    if (area < 0.0f) {
+        std::swap(x[1], x[2]);
+        std::swap(y[1], y[2]);
+        std::swap(z[1], z[2]);
+        area = -area;
+    }
+    if (area < 1e-6f) {
+        return;
+    }
+
+    Triangle triangle;
+    triangle.minX = std::max(0, static_cast<int>(std::floor(std::min(x[0], std::min(x[1], x[2])))));
+    triangle.maxX = std::min(width - 1, static_cast<int>(std::ceil(std::max(x[0], std::max(x[1], x[2])))));
+    triangle.minY = std::max(0, static_cast<int>(std::floor(std::min(y[0], std::min(y[1], y[2])))));
+    triangle.maxY = std::min(height - 1, static_cast<int>(std::ceil(std::max(y[0], std::max(y[1], y[2])))));
+    if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) {
+        return;
+    }
+
+    // Each edge weights the vertex opposite it
+    SetupEdge(x[1], y[1], x[2], y[2], triangle.edgeA);
+    SetupEdge(x[2], y[2], x[0], y[0], triangle.edgeB);
+    SetupEdge(x[0], y[0], x[1], y[1], triangle.edgeC);
+
+    float invArea = 1.0f / area;
+    triangle.depthA = (triangle.edgeA[0] * z[0] + triangle.edgeB[0] * z[1] + triangle.edgeC[0] * z[2]) * invArea;
+    triangle.depthB = (triangle.edgeA[1] * z[0] + triangle.edgeB[1] * z[1] + triangle.edgeC[1] * z[2]) * invArea;
+    triangle.depthC = (triangle.edgeA[2] * z[0] + triangle.edgeB[2] * z[1] + triangle.edgeC[2] * z[2]) * invArea;
+
+    triangles.push_back(triangle);
+}
+
+// Clears and draws one row of tiles, then updates its tile maxima
+void OcclusionCuller::RasterizeBand(int band) {
+    const int bandMinY = band * TileHeight;
+    const int bandMaxY = bandMinY + TileHeight - 1;
+    std::fill(depth.begin() + static_cast<size_t>(bandMinY) * width,
+        depth.begin() + static_cast<size_t>(bandMaxY + 1) * width, 1.0f);
+
+    for (const Triangle& triangle : triangles) {
+        int minY = std::max(triangle.minY, bandMinY);
+        int maxY = std::min(triangle.maxY, bandMaxY);
+        if (minY > maxY) {
+            continue;
+        }
+
+        // Four-pixel groups; the width is a multiple of the tile width, so
+        // groups never run past the end of a row
+        int minX = triangle.minX & ~3;
+
+        for (int y = minY; y <= maxY; ++y) {
+            float* row = depth.data() + static_cast<size_t>(y) * width;
+            float py = y + 0.5f;
+
+#ifdef BOG_OCCLUSION_SSE2
+            const __m128 rowA = _mm_set1_ps(triangle.edgeA[1] * py + triangle.edgeA[2]);
+            const __m128 rowB = _mm_set1_ps(triangle.edgeB[1] * py + triangle.edgeB[2]);
+            const __m128 rowC = _mm_set1_ps(triangle.edgeC[1] * py + triangle.edgeC[2]);
+            const __m128 rowDepth = _mm_set1_ps(triangle.depthB * py + triangle.depthC);
+            const __m128 slopeA = _mm_set1_ps(triangle.edgeA[0]);
+            const __m128 slopeB = _mm_set1_ps(triangle.edgeB[0]);
+            const __m128 slopeC = _mm_set1_ps(triangle.edgeC[0]);
+            const __m128 slopeDepth = _mm_set1_ps(triangle.depthA);
+            const __m128 zero = _mm_setzero_ps();
+
+            for (int x = minX; x <= triangle.maxX; x += 4) {
+                __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f));
+                __m128 inside = _mm_and_ps(
+                    _mm_and_ps(_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(slopeA, px), rowA), zero),
+                        _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(slopeB, px), rowB), zero)),
+                    _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(slopeC, px), rowC), zero));
+                if (_mm_movemask_ps(inside) == 0) {
+                    continue;
+                }
+
+                __m128 z = _mm_add_ps(_mm_mul_ps(slopeDepth, px), rowDepth);
+                __m128 previous = _mm_loadu_ps(row + x);
+                __m128 nearest = _mm_min_ps(previous, z);
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, previous)));
+            }
+#else
+            for (int x = minX; x <= triangle.maxX; ++x) {
+                float px = x + 0.5f;
+                if (triangle.edgeA[0] * px + triangle.edgeA[1] * py + triangle.edgeA[2] >= 0.0f &&
+                    triangle.edgeB[0] * px + triangle.edgeB[1] * py + triangle.edgeB[2] >= 0.0f &&
+                    triangle.edgeC[0] * px + triangle.edgeC[1] * py + triangle.edgeC[2] >= 0.0f) {
+                    float z = triangle.depthA * px + triangle.depthB * py + triangle.depthC;
+                    row[x] = std::min(row[x], z);
+                }
+            }
+#endif
+        }
+    }
+
+    for (int tileX = 0; tileX < tilesX; ++tileX) {
+        float farthest = 0.0f;
+        for (int y = bandMinY; y <= bandMaxY; ++y) {
+            const float* row = depth.data() + static_cast<size_t>(y) * width + tileX * TileWidth;
+            for (int x = 0; x < TileWidth; ++x) {
+                farthest = std::max(farthest, row[x]);
+            }
+        }
+        tileMaxDepth[static_cast<size_t>(band) * tilesX + tileX] = farthest;
+    }
+}
+
+bool OcclusionCuller::IsVisible(const float boxMin[3], const float boxMax[3]) {
+    ++stats.tested;
+
+    // Screen rectangle and nearest depth of the eight corners
+    float minX = FLT_MAX, maxX = -FLT_MAX;
+    float minY = FLT_MAX, maxY = -FLT_MAX;
+    float nearest = 1.0f;
+    for (int corner = 0; corner < 8; ++corner) {
+        float point[3] = {
+            (corner & 1) ? boxMax[0] : boxMin[0],
+            (corner & 2) ? boxMax[1] : boxMin[1],
+            (corner & 4) ? boxMax[2] : boxMin[2]
+        };
+        float clip[4];
+        TransformPoint(point, viewProj, clip);
+
+        // Boxes crossing the near plane are kept
+        if (clip[2] < 0.0f || clip[3] <= 1e-6f) {
+            return true;
+        }
+
+        float invW = 1.0f / clip[3];
+        float x = (clip[0] * invW * 0.5f + 0.5f) * width;
+        float y = (0.5f - clip[1] * invW * 0.5f) * height;
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+        nearest = std::min(nearest, clip[2] * invW);
+    }
+
+    int x0 = std::max(0, static_cast<int>(std::floor(minX)));
+    int x1 = std::min(width - 1, static_cast<int>(std::ceil(maxX)));
+    int y0 = std::max(0, static_cast<int>(std::floor(minY)));
+    int y1 = std::min(height - 1, static_cast<int>(std::ceil(maxY)));
+
+    // Off screen boxes are left to frustum culling
+    if (x0 > x1 || y0 > y1) {
+        return true;
+    }
+
+    for (int tileY = y0 / TileHeight; tileY <= y1 / TileHeight; ++tileY) {
+        for (int tileX = x0 / TileWidth; tileX <= x1 / TileWidth; ++tileX) {
+            // Every pixel of the tile is nearer than the box
+            if (tileMaxDepth[static_cast<size_t>(tileY) * tilesX + tileX] <= nearest) {
+                continue;
+            }
+
+            int pixelMinX = std::max(x0, tileX * TileWidth);
+            int pixelMaxX = std::min(x1, tileX * TileWidth + TileWidth - 1);
+            int pixelMinY = std::max(y0, tileY * TileHeight);
+            int pixelMaxY = std::min(y1, tileY * TileHeight + TileHeight - 1);
+            for (int y = pixelMinY; y <= pixelMaxY; ++y) {
+                const float* row = depth.data() + static_cast<size_t>(y) * width;
+                for (int x = pixelMinX; x <= pixelMaxX; ++x) {
+                    if (row[x] > nearest) {
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+
+    ++stats.occluded;
+    return false;
+}
+
+bool OcclusionCuller::WriteDepthImage(const std::string& filename) const {
+    FILE* file = std::fopen(filename.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+
+    // Projected depth bunches up near 1; 1 / (1 - depth) grows with view
+    // distance, so shade by how much farther than the nearest pixel each one is
+    float nearest = 1.0f;
+    for (float value : depth) {
+        nearest = std::min(nearest, value);
+    }
+    float nearestDistance = 1.0f / std::max(1.0f - nearest, 1e-7f);
+
+    // Near is bright, empty pixels are black
+    std::vector<unsigned char> pixels(depth.size());
+    for (size_t i = 0; i < depth.size(); ++i) {
+        if (depth[i] >= 1.0f) {
+            pixels[i] = 0;
+            continue;
+        }
+        float distance = 1.0f / std::max(1.0f - depth[i], 1e-7f);
+        pixels[i] = static_cast<unsigned char>(32.0f + 223.0f * nearestDistance / distance);
+    }
+
+    std::fprintf(file, "P5\n%d %d\n255\n", width, height);
+    bool written = std::fwrite(pixels.data(), 1, pixels.size(), file) == pixels.size();
+    std::fclose(file);
+    return written;
+}
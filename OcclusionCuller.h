@@ -0,0 +1,94 @@
+// OcclusionCuller.h
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class JobSystem;
+
+// Software occlusion culling. Each frame the chosen occluder meshes are
+// rasterized into a small CPU depth buffer, and occludee boxes are then tested
+// against it. Rasterization is split into bands of one tile row each, which
+// go wide over a job system, four pixels per step with SSE2 when available. Every 8x8 tile keeps the
+// farthest depth it holds, so most occludees are settled by the tiles alone.
+//
+// Matrices are 16 floats, row-major, for row vectors (as DirectXMath stores
+// them), and the projection is D3D style with clip depth from 0 to w. Nothing
+// here depends on D3D.
+class OcclusionCuller {
+public:
+    static const int TileWidth = 8;
+    static const int TileHeight = 8;
+
+    struct Stats {
+        uint32_t occluders;
+        uint32_t occluderTriangles;     // Submitted
+        uint32_t rasterTriangles;       // Left after clipping and rejection
+        uint32_t tested;
+        uint32_t occluded;
+        float rasterMilliseconds;
+    };
+
+    OcclusionCuller();
+
+    // Width and height are rounded up to whole tiles
+    bool Initialize(int width, int height);
+
+    // Clears the occluder list for a new view
+    void BeginFrame(const float viewProj[16]);
+
+    // Queues an occluder. Positions are three floats per vertex in the space
+    // world maps from; the data must stay alive until Rasterize returns.
+    void AddOccluder(const float* positions, size_t vertexCount,
+        const uint32_t* indices, size_t indexCount, const float world[16]);
+
+    // Clears the depth buffer and draws every queued occluder into it. With a
+    // job system the bands are spread over its threads.
+    void Rasterize(JobSystem* jobs = nullptr);
+
+    // False when the box is certainly hidden behind the occluders
+    bool IsVisible(const float boxMin[3], const float boxMax[3]);
+
+    const Stats& GetStats() const { return stats; }
+
+    int GetWidth() const { return width; }
+    int GetHeight() const { return height; }
+    const float* GetDepth() const { return depth.data(); }
+
+    // Writes the depth buffer as a binary PGM image, near is bright
+    bool WriteDepthImage(const std::string& filename) const;
+
+private:
+    struct Occluder {
+        const float* positions;
+        size_t vertexCount;
+        const uint32_t* indices;
+        size_t indexCount;
+        float world[16];
+    };
+
+    // Screen-space triangle with its edge and depth planes set up
+    struct Triangle {
+        float edgeA[3], edgeB[3], edgeC[3];     // Edge functions Ax + By + C
+        float depthA, depthB, depthC;           // Depth plane
+        int minX, maxX, minY, maxY;             // Clamped pixel bounds
+    };
+
+    void SetupTriangles();
+    void AddTriangle(const float clip[3][4]);
+    void RasterizeBand(int band);
+
+    int width;
+    int height;
+    int tilesX;
+    int tilesY;
+    std::vector<float> depth;           // Nearest depth per pixel, 1 when clear
+    std::vector<float> tileMaxDepth;    // Farthest depth per tile
+
+    float viewProj[16];
+    std::vector<Occluder> occluders;
+    std::vector<Triangle> triangles;
+    Stats stats;
+};
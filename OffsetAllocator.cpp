@@ -0,0 +1,266 @@
+// OffsetAllocator.cpp
+
+#include "OffsetAllocator.h"
+#include <algorithm>
+#include <cassert>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+
+    // Size classes are small floats: sizes below 8 map to themselves, larger
+    // ones keep their top 4 bits (the leading one implicit) and an exponent
+    const uint32_t MantissaBits = 3;
+    const uint32_t MantissaValue = 1 << MantissaBits;
+    const uint32_t MantissaMask = MantissaValue - 1;
+
+    // Value must not be 0
+    uint32_t HighestBit(uint32_t value) {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanReverse(&index, value);
+        return index;
+#else
+        return 31 - __builtin_clz(value);
+#endif
+    }
+
+    uint32_t LowestBit(uint32_t value) {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward(&index, value);
+        return index;
+#else
+        return __builtin_ctz(value);
+#endif
+    }
+
+    // Lowest set bit at or above start, NoSpace when there is none
+    uint32_t FindLowestBitFrom(uint32_t mask, uint32_t start) {
+        if (start >= 32) {
+            return OffsetAllocator::NoSpace;
+        }
+        uint32_t masked = mask & (~0u << start);
+        return masked ? LowestBit(masked) : OffsetAllocator::NoSpace;
+    }
+
+    // Every range in a class is at least BinToSize of it, so free ranges are
+    // filed under their size rounded down and requests look from theirs rounded up
+    uint32_t SizeToBinRoundDown(uint32_t size) {
+        if (size < MantissaValue) {
+            return size;
+        }
+        uint32_t mantissaStart = HighestBit(size) - MantissaBits;
+        return ((mantissaStart + 1) << MantissaBits) + ((size >> mantissaStart) & MantissaMask);
+    }
+
+    uint32_t SizeToBinRoundUp(uint32_t size) {
+        if (size < MantissaValue) {
+            return size;
+        }
+        uint32_t mantissaStart = HighestBit(size) - MantissaBits;
+        uint32_t bin = ((mantissaStart + 1) << MantissaBits) + ((size >> mantissaStart) & MantissaMask);
+
+        // A carry out of the mantissa moves to the next exponent, which is the right class
+        return (size & ((1u << mantissaStart) - 1)) ? bin + 1 : bin;
+    }
+
+}
+
+OffsetAllocator::OffsetAllocator(uint32_t size) {
+    Reset(size);
+}
+
+void OffsetAllocator::Reset(uint32_t newSize) {
+    size = newSize;
+    freeSize = 0;
+    freeRegions = 0;
+    allocations = 0;
+    usedBinsTop = 0;
+    std::fill(usedBins, usedBins + TopBinCount, static_cast<uint8_t>(0));
+    for (uint32_t& head : binHeads) {
+        head = Unused;
+    }
+    nodes.clear();
+    freeNodes.clear();
+
+    if (size > 0) {
+        InsertFreeNode(0, size);
+    }
+}
+
+uint32_t OffsetAllocator::InsertFreeNode(uint32_t offset, uint32_t nodeSize) {
+    uint32_t bin = SizeToBinRoundDown(nodeSize);
+    uint32_t head = binHeads[bin];
+    if (head == Unused) {
+        usedBins[bin / LeafBinCount] |= 1 << (bin % LeafBinCount);
+        usedBinsTop |= 1u << (bin / LeafBinCount);
+    }
+
+    uint32_t index;
+    if (!freeNodes.empty()) {
+        index = freeNodes.back();
+        freeNodes.pop_back();
+    }
+    else {
+        index = static_cast<uint32_t>(nodes.size());
+        nodes.emplace_back();
+    }
+
+    nodes[index] = Node{ offset, nodeSize, Unused, head, Unused, Unused, false };
+    if (head != Unused) {
+        nodes[head].binPrev = index;
+    }
+    binHeads[bin] = index;
+
+    freeSize += nodeSize;
+    ++freeRegions;
+    return index;
+}
+
+void OffsetAllocator::RemoveFreeNode(uint32_t index) {
+    const Node& node = nodes[index];
+    if (node.binPrev != Unused) {
+        nodes[node.binPrev].binNext = node.binNext;
+    }
+    else {
+        uint32_t bin = SizeToBinRoundDown(node.size);
+        binHeads[bin] = node.binNext;
+        if (node.binNext == Unused) {
+            usedBins[bin / LeafBinCount] &= ~(1 << (bin % LeafBinCount));
+            if (usedBins[bin / LeafBinCount] == 0) {
+                usedBinsTop &= ~(1u << (bin / LeafBinCount));
+            }
+        }
+    }
+    if (node.binNext != Unused) {
+        nodes[node.binNext].binPrev = node.binPrev;
+    }
+
+    freeSize -= node.size;
+    --freeRegions;
+}
+
+OffsetAllocator::Allocation OffsetAllocator::Allocate(uint32_t allocationSize) {
+    Allocation allocation = { NoSpace, Unused };
+    if (allocationSize == 0 || allocationSize > freeSize) {
+        return allocation;
+    }
+
+    // The smallest class that certainly fits, in this top bin or the next used one
+    uint32_t minBin = SizeToBinRoundUp(allocationSize);
+    uint32_t topBin = minBin / LeafBinCount;
+    uint32_t leafBin = NoSpace;
+    if (usedBinsTop & (1u << topBin)) {
+        leafBin = FindLowestBitFrom(usedBins[topBin], minBin % LeafBinCount);
+    }
+    if (leafBin == NoSpace) {
+        topBin = FindLowestBitFrom(usedBinsTop, topBin + 1);
+        if (topBin == NoSpace) {
+            return allocation;
+        }
+        leafBin = LowestBit(usedBins[topBin]);
+    }
+
+    uint32_t index = binHeads[topBin * LeafBinCount + leafBin];
+    RemoveFreeNode(index);
+
+    // The rest of the range goes back as a free range right after it
+    uint32_t remainder = nodes[index].size - allocationSize;
+    nodes[index].size = allocationSize;
+    nodes[index].used = true;
+    if (remainder > 0) {
+        uint32_t rest = InsertFreeNode(nodes[index].offset + allocationSize, remainder);
+        uint32_t next = nodes[index].neighborNext;
+        nodes[rest].neighborPrev = index;
+        nodes[rest].neighborNext = next;
+        if (next != Unused) {
+            nodes[next].neighborPrev = rest;
+        }
+        nodes[index].neighborNext = rest;
+    }
+
+    // The removed node's slot was not recycled, so the index stays valid
+    ++allocations;
+    allocation.offset = nodes[index].offset;
+    allocation.node = index;
+    return allocation;
+}
+
+void OffsetAllocator::Free(Allocation allocation) {
+    if (allocation.offset == NoSpace) {
+        return;
+    }
+    assert(allocation.node < nodes.size() && nodes[allocation.node].used);
+
+    uint32_t index = allocation.node;
+    uint32_t offset = nodes[index].offset;
+    uint32_t rangeSize = nodes[index].size;
+    uint32_t prev = nodes[index].neighborPrev;
+    uint32_t next = nodes[index].neighborNext;
+
+    // Absorb free neighbours
+    if (prev != Unused && !nodes[prev].used) {
+        offset = nodes[prev].offset;
+        rangeSize += nodes[prev].size;
+        uint32_t merged = prev;
+        prev = nodes[prev].neighborPrev;
+        RemoveFreeNode(merged);
+        freeNodes.push_back(merged);
+    }
+    if (next != Unused && !nodes[next].used) {
+        rangeSize += nodes[next].size;
+        uint32_t merged = next;
+        next = nodes[next].neighborNext;
+        RemoveFreeNode(merged);
+        freeNodes.push_back(merged);
+    }
+
+    --allocations;
+    freeNodes.push_back(index);
+
+    uint32_t combined = InsertFreeNode(offset, rangeSize);
+    nodes[combined].neighborPrev = prev;
+    nodes[combined].neighborNext = next;
+    if (prev != Unused) {
+        nodes[prev].neighborNext = combined;
+    }
+    if (next != Unused) {
+        nodes[next].neighborPrev = combined;
+    }
+}
+
+uint32_t OffsetAllocator::FindLargestFree() const {
+    if (usedBinsTop == 0) {
+        return 0;
+    }
+
+    // Only the highest used class can hold it; its ranges differ by less than a class
+    uint32_t topBin = HighestBit(usedBinsTop);
+    uint32_t bin = topBin * LeafBinCount + HighestBit(usedBins[topBin]);
+    uint32_t largest = 0;
+    for (uint32_t index = binHeads[bin]; index != Unused; index = nodes[index].binNext) {
+        largest = std::max(largest, nodes[index].size);
+    }
+    return largest;
+}
+
+OffsetAllocator::Stats OffsetAllocator::GetStats() const {
+    Stats stats;
+    stats.size = size;
+    stats.usedSize = size - freeSize;
+    stats.freeSize = freeSize;
+    stats.largestFree = FindLargestFree();
+    stats.freeRegions = freeRegions;
+    stats.allocations = allocations;
+    return stats;
+}
+
+float OffsetAllocator::GetFragmentation() const {
+    if (freeSize == 0) {
+        return 0.0f;
+    }
+    return 1.0f - static_cast<float>(FindLargestFree()) / static_cast<float>(freeSize);
+}
@@ -0,0 +1,84 @@
+// OffsetAllocator.h
+
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Hands out ranges of [0, size), such as elements of a GPU buffer, without
+// touching the memory itself. Free ranges are binned by size into 256 classes
+// (TLSF: a 5-bit exponent and a 3-bit mantissa, so a class is at most 12.5%
+// wider than its smallest size) with bitmasks of the non-empty ones, so
+// allocating is two bit scans and a list pop. Freeing merges a range with its
+// free neighbours right away. Requests are rounded up to their class, so a
+// range can be refused while a free range a little larger than it exists.
+class OffsetAllocator {
+public:
+    static const uint32_t NoSpace = 0xffffffff;
+
+    struct Allocation {
+        uint32_t offset;    // NoSpace when the allocation failed
+        uint32_t node;
+    };
+
+    struct Stats {
+        uint32_t size;
+        uint32_t usedSize;
+        uint32_t freeSize;
+        uint32_t largestFree;
+        uint32_t freeRegions;
+        uint32_t allocations;
+    };
+
+    explicit OffsetAllocator(uint32_t size = 0);
+
+    // Forgets every allocation and manages [0, size) from now on
+    void Reset(uint32_t size);
+
+    // Size must be at least 1
+    Allocation Allocate(uint32_t size);
+    void Free(Allocation allocation);
+
+    uint32_t GetSize() const { return size; }
+    uint32_t GetAllocationSize(Allocation allocation) const { return nodes[allocation.node].size; }
+    Stats GetStats() const;
+
+    // Share of the free space outside the largest free range: 0 when it is all
+    // one range, approaching 1 as it splinters
+    float GetFragmentation() const;
+
+private:
+    static const uint32_t TopBinCount = 32;
+    static const uint32_t LeafBinCount = 8;
+    static const uint32_t BinCount = TopBinCount * LeafBinCount;
+    static const uint32_t Unused = 0xffffffff;
+
+    // A used or free range. Free ones are linked into their size class's
+    // list; all of them are linked to the ranges next to them in address order.
+    struct Node {
+        uint32_t offset;
+        uint32_t size;
+        uint32_t binPrev;
+        uint32_t binNext;
+        uint32_t neighborPrev;
+        uint32_t neighborNext;
+        bool used;
+    };
+
+    uint32_t InsertFreeNode(uint32_t offset, uint32_t nodeSize);
+    void RemoveFreeNode(uint32_t index);
+    uint32_t FindLargestFree() const;
+
+    uint32_t size;
+    uint32_t freeSize;
+    uint32_t freeRegions;
+    uint32_t allocations;
+
+    // Bit t is set when any class in top bin t has a free range, and bit l of
+    // usedBins[t] when class t * 8 + l does
+    uint32_t usedBinsTop;
+    uint8_t usedBins[TopBinCount];
+    uint32_t binHeads[BinCount];
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> freeNodes;
+};
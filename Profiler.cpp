@@ -0,0 +1,223 @@
+// Profiler.cpp
+
+#include "Profiler.h"
+
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> Profiler::capturing(false);
+
+namespace {
+
+    enum class EventType : uint32_t {
+        Zone,
+        Counter,
+        Frame
+    };
+
+    struct Event {
+        const char* name;
+        int64_t time;
+        int64_t value;      // End time of a zone, value of a counter
+        EventType type;
+    };
+
+    // Single-producer ring: only the owning thread writes events, and only
+    // Collect, under the buffer mutex, consumes them
+    struct ThreadBuffer {
+        uint32_t threadId;
+        std::atomic<const char*> name;
+        std::atomic<uint32_t> head;
+        std::atomic<uint32_t> tail;
+        std::atomic<uint64_t> dropped;
+        Event events[Profiler::ThreadBufferSize];
+    };
+
+    struct CapturedEvent {
+        Event event;
+        uint32_t threadId;
+    };
+
+    // Guards the buffer list, the capture and consuming from the rings. The capture
+    // grows in blocks, so collecting never copies what was already captured.
+    std::mutex profilerMutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> threadBuffers;
+    std::deque<CapturedEvent> capture;
+    uint64_t droppedBeforeCapture = 0;
+    int64_t captureStart = 0;
+
+    // Buffers are never freed before exit, so events of finished threads can still be collected
+    ThreadBuffer* GetThreadBuffer() {
+        thread_local ThreadBuffer* buffer = nullptr;
+        if (!buffer) {
+            std::unique_ptr<ThreadBuffer> created(new ThreadBuffer());
+            created->name.store(nullptr);
+            created->head.store(0);
+            created->tail.store(0);
+            created->dropped.store(0);
+
+            std::lock_guard<std::mutex> lock(profilerMutex);
+            created->threadId = static_cast<uint32_t>(threadBuffers.size() + 1);
+            buffer = created.get();
+            threadBuffers.push_back(std::move(created));
+        }
+        return buffer;
+    }
+
+    void Push(const Event& event) {
+        ThreadBuffer* buffer = GetThreadBuffer();
+        uint32_t head = buffer->head.load(std::memory_order_relaxed);
+        if (head - buffer->tail.load(std::memory_order_acquire) >= Profiler::ThreadBufferSize) {
+            buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        buffer->events[head % Profiler::ThreadBufferSize] = event;
+        buffer->head.store(head + 1, std::memory_order_release);
+    }
+
+    // Empties every ring, keeping the events in the capture or discarding them
+    void Collect(bool keep) {
+        for (const auto& buffer : threadBuffers) {
+            uint32_t head = buffer->head.load(std::memory_order_acquire);
+            uint32_t tail = buffer->tail.load(std::memory_order_relaxed);
+            if (keep) {
+                for (; tail != head; ++tail) {
+                    capture.push_back(CapturedEvent{ buffer->events[tail % Profiler::ThreadBufferSize], buffer->threadId });
+                }
+            }
+            buffer->tail.store(head, std::memory_order_release);
+        }
+    }
+
+    uint64_t SumDropped() {
+        uint64_t dropped = 0;
+        for (const auto& buffer : threadBuffers) {
+            dropped += buffer->dropped.load(std::memory_order_relaxed);
+        }
+        return dropped;
+    }
+
+    double ToMicroseconds(int64_t ticks) {
+        typedef std::chrono::steady_clock::period Period;
+        return static_cast<double>(ticks) * 1000000.0 * Period::num / Period::den;
+    }
+
+    void WriteString(FILE* file, const char* text) {
+        std::fputc('"', file);
+        for (const char* c = text ? text : ""; *c; ++c) {
+            if (*c == '"' || *c == '\\') {
+                std::fputc('\\', file);
+            }
+            if (static_cast<unsigned char>(*c) >= 0x20) {
+                std::fputc(*c, file);
+            }
+        }
+        std::fputc('"', file);
+    }
+
+}
+
+void Profiler::BeginCapture() {
+    std::lock_guard<std::mutex> lock(profilerMutex);
+    Collect(false);
+    capture.clear();
+    droppedBeforeCapture = SumDropped();
+    captureStart = GetTimestamp();
+    capturing.store(true, std::memory_order_relaxed);
+}
+
+void Profiler::EndCapture() {
+    capturing.store(false, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(profilerMutex);
+    Collect(true);
+}
+
+void Profiler::MarkFrame() {
+    if (!IsCapturing()) {
+        return;
+    }
+    Push(Event{ "Frame", GetTimestamp(), 0, EventType::Frame });
+
+    std::lock_guard<std::mutex> lock(profilerMutex);
+    Collect(true);
+}
+
+void Profiler::RecordCounter(const char* name, int64_t value) {
+    if (IsCapturing()) {
+        Push(Event{ name, GetTimestamp(), value, EventType::Counter });
+    }
+}
+
+void Profiler::RecordZone(const char* name, int64_t start, int64_t end) {
+    Push(Event{ name, start, end, EventType::Zone });
+}
+
+void Profiler::SetThreadName(const char* name) {
+    GetThreadBuffer()->name.store(name, std::memory_order_relaxed);
+}
+
+bool Profiler::WriteChromeTrace(const char* filename) {
+    std::lock_guard<std::mutex> lock(profilerMutex);
+    if (IsCapturing()) {
+        Collect(true);
+    }
+
+    FILE* file = std::fopen(filename, "w");
+    if (!file) {
+        return false;
+    }
+
+    // Timestamps are microseconds from the start of the capture
+    std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    for (const auto& buffer : threadBuffers) {
+        const char* name = buffer->name.load(std::memory_order_relaxed);
+        if (name) {
+            std::fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+                first ? "" : ",\n", buffer->threadId);
+            WriteString(file, name);
+            std::fprintf(file, "}}");
+            first = false;
+        }
+    }
+
+    for (const CapturedEvent& captured : capture) {
+        const Event& event = captured.event;
+        std::fprintf(file, "%s{\"name\":", first ? "" : ",\n");
+        WriteString(file, event.name);
+        double time = ToMicroseconds(event.time - captureStart);
+        switch (event.type) {
+        case EventType::Zone:
+            std::fprintf(file, ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+                time, ToMicroseconds(event.value - event.time), captured.threadId);
+            break;
+        case EventType::Counter:
+            std::fprintf(file, ",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{\"value\":%lld}}",
+                time, captured.threadId, static_cast<long long>(event.value));
+            break;
+        case EventType::Frame:
+            std::fprintf(file, ",\"ph\":\"i\",\"s\":\"g\",\"ts\":%.3f,\"pid\":1,\"tid\":%u}", time, captured.threadId);
+            break;
+        }
+        first = false;
+    }
+    std::fprintf(file, "\n]}\n");
+
+    bool written = std::ferror(file) == 0;
+    std::fclose(file);
+    return written;
+}
+
+size_t Profiler::GetEventCount() {
+    std::lock_guard<std::mutex> lock(profilerMutex);
+    return capture.size();
+}
+
+uint64_t Profiler::GetDroppedCount() {
+    std::lock_guard<std::mutex> lock(profilerMutex);
+    return SumDropped() - droppedBeforeCapture;
+}
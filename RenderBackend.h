@@ -0,0 +1,86 @@
+// RenderBackend.h
+
+#pragma once
+#include <cstdint>
+#include "ConstantRingAllocator.h"
+#include "RenderStateCache.h"
+#include "VertexFormat.h"
+
+typedef uint32_t BufferHandle;
+typedef uint32_t PipelineHandle;
+const BufferHandle InvalidBuffer = 0;
+const PipelineHandle InvalidPipeline = 0;
+
+enum class BufferUsage {
+    Vertex,
+    Index,
+    DynamicVertex       // Rewritten with UpdateBuffer
+};
+
+enum class IndexFormat {
+    UInt16,
+    UInt32
+};
+
+// Shaders and vertex layout of one draw program
+struct PipelineDesc {
+    const wchar_t* vertexShaderFile;
+    const wchar_t* pixelShaderFile;
+    const VertexFormat* vertexFormat;   // Per-vertex data in slot 0
+    bool instanced;                     // Adds per-instance WORLD0-3 rows in slot 1
+};
+
+// What a frame submitted. Bytes uploaded are bufferBytes plus constants.bytes.
+struct RenderStats {
+    RenderStateCache::Counters states;
+    ConstantRingAllocator::Counters constants;
+    uint32_t draws;
+    uint32_t instances;
+    uint64_t triangles;
+    uint64_t bufferBytes;       // Buffers created or rewritten
+};
+
+// The device-facing half of the renderer. Graphics, Mesh and InstanceBatch
+// only talk to this, so the same frame can go to D3D11 or to a headless
+// backend. Draws are indexed triangle lists. Redundant binds are filtered by
+// the backend and show up as elided state changes in the stats.
+class RenderBackend {
+public:
+    virtual ~RenderBackend() {}
+
+    virtual PipelineHandle CreatePipeline(const PipelineDesc& desc) = 0;
+
+    // Data may be null for dynamic buffers. Returns InvalidBuffer on failure.
+    virtual BufferHandle CreateBuffer(BufferUsage usage, const void* data, uint32_t size) = 0;
+    virtual void DestroyBuffer(BufferHandle buffer) = 0;
+
+    // Replaces the start of a dynamic buffer, discarding the old contents
+    virtual bool UpdateBuffer(BufferHandle buffer, const void* data, uint32_t size) = 0;
+
+    // Writes part of a vertex or index buffer, ordered with the draws around it
+    virtual bool WriteBuffer(BufferHandle buffer, uint32_t offset, const void* data, uint32_t size) = 0;
+
+    // Copies between two different vertex or index buffers on the GPU
+    virtual bool CopyBuffer(BufferHandle dest, uint32_t destOffset, BufferHandle source, uint32_t sourceOffset, uint32_t size) = 0;
+
+    // Clears the targets and starts a new frame of stats
+    virtual void BeginFrame(const float clearColor[4]) = 0;
+    virtual void Present() = 0;
+
+    // Frames the CPU may queue ahead of the GPU before Present blocks
+    virtual void SetMaxFrameLatency(uint32_t frames) = 0;
+
+    virtual void SetPipeline(PipelineHandle pipeline) = 0;
+    virtual void SetVertexBuffer(uint32_t slot, BufferHandle buffer, uint32_t stride) = 0;
+    virtual void SetIndexBuffer(BufferHandle buffer, IndexFormat format) = 0;
+
+    // Per-draw constants for vertex shader slot 0
+    virtual bool SetVSConstants(const void* data, uint32_t size) = 0;
+
+    // Base vertex is added to every index read from the index buffer
+    virtual void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) = 0;
+    virtual void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex) = 0;
+
+    // Stats of the frame before the current one
+    virtual const RenderStats& GetLastFrameStats() const = 0;
+};
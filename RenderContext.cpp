@@ -0,0 +1,135 @@
+// RenderContext.cpp
+
+#include "RenderContext.h"
+
+#include <cstring>
+
+RenderContext::RenderContext()
+    : context(nullptr), context1(nullptr), ringBuffer(nullptr), draws(0), lastFrame()
+{
+}
+
+RenderContext::~RenderContext() {
+    if (ringBuffer) ringBuffer->Release();
+    if (context1) context1->Release();
+}
+
+bool RenderContext::Initialize(ID3D11Device* device, ID3D11DeviceContext* immediateContext, UINT ringBytes) {
+    context = immediateContext;
+
+    // Offsets need D3D 11.1 and NO_OVERWRITE maps on constant buffers
+    D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+    HRESULT hr = device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options));
+    bool offsetting = SUCCEEDED(hr) && options.ConstantBufferOffsetting && options.MapNoOverwriteOnDynamicConstantBuffer;
+    if (offsetting) {
+        hr = context->QueryInterface(__uuidof(ID3D11DeviceContext1), reinterpret_cast<void**>(&context1));
+        offsetting = SUCCEEDED(hr);
+    }
+
+    ring.Reset(offsetting ? ringBytes : ConstantRingAllocator::Alignment);
+
+    // Create the ring buffer
+    D3D11_BUFFER_DESC desc = {};
+    desc.Usage = D3D11_USAGE_DYNAMIC;
+    desc.ByteWidth = ring.GetCapacity();
+    desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+    hr = device->CreateBuffer(&desc, nullptr, &ringBuffer);
+    if (FAILED(hr)) {
+        return false;
+    }
+
+    stateCache.Invalidate();
+    return true;
+}
+
+void RenderContext::BeginFrame() {
+    lastFrame.states = stateCache.GetCounters();
+    lastFrame.constants = ring.GetCounters();
+    lastFrame.draws = draws;
+
+    stateCache.ResetCounters();
+    ring.ResetCounters();
+    draws = 0;
+}
+
+void RenderContext::SetInputLayout(ID3D11InputLayout* layout) {
+    if (stateCache.Update(RenderStateCache::InputLayout, reinterpret_cast<uintptr_t>(layout))) {
+        context->IASetInputLayout(layout);
+    }
+}
+
+void RenderContext::SetVertexShader(ID3D11VertexShader* shader) {
+    if (stateCache.Update(RenderStateCache::VertexShader, reinterpret_cast<uintptr_t>(shader))) {
+        context->VSSetShader(shader, nullptr, 0);
+    }
+}
+
+void RenderContext::SetPixelShader(ID3D11PixelShader* shader) {
+    if (stateCache.Update(RenderStateCache::PixelShader, reinterpret_cast<uintptr_t>(shader))) {
+        context->PSSetShader(shader, nullptr, 0);
+    }
+}
+
+void RenderContext::SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology) {
+    if (stateCache.Update(RenderStateCache::PrimitiveTopology, static_cast<uintptr_t>(topology))) {
+        context->IASetPrimitiveTopology(topology);
+    }
+}
+
+void RenderContext::SetVertexBuffer(UINT slot, ID3D11Buffer* buffer, UINT stride, UINT offset) {
+    // Only the slots the renderer uses are shadowed
+    if (slot <= 1) {
+        RenderStateCache::State state = static_cast<RenderStateCache::State>(RenderStateCache::VertexBuffer0 + slot);
+        if (!stateCache.Update(state, reinterpret_cast<uintptr_t>(buffer), stride, offset)) {
+            return;
+        }
+    }
+    context->IASetVertexBuffers(slot, 1, &buffer, &stride, &offset);
+}
+
+void RenderContext::SetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset) {
+    if (stateCache.Update(RenderStateCache::IndexBuffer, reinterpret_cast<uintptr_t>(buffer), format, offset)) {
+        context->IASetIndexBuffer(buffer, format, offset);
+    }
+}
+
+bool RenderContext::SetVSConstants(const void* data, UINT size) {
+    ConstantRingAllocator::Allocation allocation;
+    if (!ring.Allocate(size, allocation)) {
+        return false;
+    }
+
+    D3D11_MAPPED_SUBRESOURCE mapped = {};
+    D3D11_MAP mapType = allocation.discard ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE;
+    HRESULT hr = context->Map(ringBuffer, 0, mapType, 0, &mapped);
+    if (FAILED(hr)) {
+        return false;
+    }
+    std::memcpy(static_cast<unsigned char*>(mapped.pData) + allocation.offset, data, size);
+    context->Unmap(ringBuffer, 0);
+
+    // Offsets and sizes are counted in 16-byte shader constants
+    UINT firstConstant = allocation.offset / 16;
+    UINT constantCount = allocation.size / 16;
+    if (stateCache.Update(RenderStateCache::VSConstantBuffer0, reinterpret_cast<uintptr_t>(ringBuffer), firstConstant, constantCount)) {
+        if (context1) {
+            context1->VSSetConstantBuffers1(0, 1, &ringBuffer, &firstConstant, &constantCount);
+        }
+        else {
+            context->VSSetConstantBuffers(0, 1, &ringBuffer);
+        }
+    }
+    return true;
+}
+
+void RenderContext::DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex) {
+    context->DrawIndexed(indexCount, startIndex, baseVertex);
+    ++draws;
+}
+
+void RenderContext::DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance) {
+    context->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+    ++draws;
+}
@@ -0,0 +1,57 @@
+// RenderContext.h
+
+#pragma once
+#include <d3d11_1.h>
+#include "ConstantRingAllocator.h"
+#include "RenderStateCache.h"
+
+// Submission layer in front of the immediate context. State changes go
+// through a RenderStateCache so redundant calls never reach the driver, and
+// per-draw constants are written into one dynamic ring buffer that is bound at
+// an offset with VSSetConstantBuffers1. Devices without constant buffer
+// offsetting fall back to a single 256-byte buffer rewritten with DISCARD.
+class RenderContext {
+public:
+    struct FrameCounters {
+        RenderStateCache::Counters states;
+        ConstantRingAllocator::Counters constants;
+        uint32_t draws;
+    };
+
+    RenderContext();
+    ~RenderContext();
+
+    bool Initialize(ID3D11Device* device, ID3D11DeviceContext* context, UINT ringBytes = 4 * 1024 * 1024);
+
+    // Starts a new frame of counters, keeping the previous one for GetLastFrameCounters
+    void BeginFrame();
+
+    // Call after touching the context directly
+    void Invalidate() { stateCache.Invalidate(); }
+
+    void SetInputLayout(ID3D11InputLayout* layout);
+    void SetVertexShader(ID3D11VertexShader* shader);
+    void SetPixelShader(ID3D11PixelShader* shader);
+    void SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology);
+    void SetVertexBuffer(UINT slot, ID3D11Buffer* buffer, UINT stride, UINT offset);
+    void SetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset);
+
+    // Copies constants into the ring and binds them to vertex shader slot 0
+    bool SetVSConstants(const void* data, UINT size);
+
+    void DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex);
+    void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance);
+
+    ID3D11DeviceContext* GetContext() const { return context; }
+    const FrameCounters& GetLastFrameCounters() const { return lastFrame; }
+
+private:
+    ID3D11DeviceContext* context;
+    ID3D11DeviceContext1* context1;     // Null when offsets are not supported
+    ID3D11Buffer* ringBuffer;
+
+    ConstantRingAllocator ring;
+    RenderStateCache stateCache;
+    uint32_t draws;
+    FrameCounters lastFrame;
+};
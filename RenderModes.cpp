@@ -0,0 +1,804 @@
+// RenderModes.cpp
+
+#include "HeadlessModes.h"
+#include "ConstantRingAllocator.h"
+#include "DynamicAabbTree.h"
+#include "FrustumCulling.h"
+#include "Graphics.h"
+#include "HeadlessBackend.h"
+#include "HeadlessBenchmark.h"
+#include "Heightmap.h"
+#include "JobSystem.h"
+#include "Log.h"
+#include "MemoryTracker.h"
+#include "Mesh.h"
+#include "OcclusionCuller.h"
+#include "RenderQueue.h"
+#include "RenderStateCache.h"
+#include "ShaderCache.h"
+#include "Terrain.h"
+
+#include <DirectXMath.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace DirectX;
+
+// Draw submission test: BogEngine.exe -draw-submission-test [operations]
+// Drives the constant ring allocator and the render state cache with random
+// operations and checks every result against a simple model: allocations
+// are aligned, packed one after another and only discard when they wrap
+// around, and a state call is only filtered when it repeats the values the
+// cache last saw since an invalidation.
+int RunDrawSubmissionTest(const CommandLine& commandLine) {
+    size_t operationCount = commandLine.GetCount(100000);
+
+    bool valid = true;
+    auto expect = [&valid](bool condition, const char* failure) {
+        if (!condition) {
+            LogMessage("Draw submission test: %s\n", failure);
+            valid = false;
+        }
+    };
+    std::mt19937 random(1234);
+
+    // Ring allocator: edge cases first, then random sizes wrapping many times
+    const uint32_t Alignment = ConstantRingAllocator::Alignment;
+    ConstantRingAllocator ring(16 * 1024 + 100);
+    ConstantRingAllocator::Allocation allocation = {};
+    expect(ring.GetCapacity() == 16 * 1024, "the capacity was not rounded down to the alignment");
+    expect(!ring.Allocate(0, allocation) && !ring.Allocate(ring.GetCapacity() + 1, allocation),
+        "an empty or oversized allocation succeeded");
+    expect(ring.Allocate(1, allocation) && allocation.offset == 0 && allocation.size == Alignment && allocation.discard,
+        "the first allocation did not discard at offset 0");
+    expect(ring.Allocate(ring.GetCapacity(), allocation) && allocation.offset == 0 && allocation.discard,
+        "a whole-buffer allocation did not wrap around");
+    ring.Reset(ring.GetCapacity());
+    expect(ring.Allocate(Alignment, allocation) && allocation.offset == 0 && allocation.discard,
+        "the allocation after a reset did not discard");
+
+    ring.Reset(64 * 1024);
+    ring.ResetCounters();
+    std::uniform_int_distribution<uint32_t> constantSize(1, 2048);
+    uint32_t head = 0;
+    uint32_t discards = 0;
+    uint64_t bytes = 0;
+    bool firstAllocation = true;
+    bool ringValid = true;
+    for (size_t i = 0; i < operationCount && ringValid; ++i) {
+        uint32_t size = constantSize(random);
+        uint32_t alignedSize = (size + Alignment - 1) / Alignment * Alignment;
+        bool wraps = firstAllocation || head + alignedSize > ring.GetCapacity();
+        uint32_t expectedOffset = wraps ? 0 : head;
+
+        ringValid = ring.Allocate(size, allocation) && allocation.offset == expectedOffset &&
+            allocation.size == alignedSize && allocation.discard == wraps &&
+            allocation.offset % Alignment == 0 && allocation.offset + allocation.size <= ring.GetCapacity();
+        head = expectedOffset + alignedSize;
+        discards += wraps ? 1 : 0;
+        bytes += alignedSize;
+        firstAllocation = false;
+    }
+    const ConstantRingAllocator::Counters& ringCounters = ring.GetCounters();
+    expect(ringValid, "an allocation did not follow the previous one or discarded at the wrong time");
+    expect(ringCounters.allocations == operationCount && ringCounters.discards == discards && ringCounters.bytes == bytes,
+        "the allocator counters do not match");
+
+    // State cache: few distinct values, so repeats and changes both happen often
+    RenderStateCache cache;
+    uintptr_t model[RenderStateCache::StateCount][3] = {};
+    bool known[RenderStateCache::StateCount] = {};
+    uint32_t issued[RenderStateCache::StateCount] = {};
+    uint32_t elided[RenderStateCache::StateCount] = {};
+    std::uniform_int_distribution<int> stateIndex(0, RenderStateCache::StateCount - 1);
+    std::uniform_int_distribution<int> value(0, 1);
+    std::uniform_int_distribution<int> invalidation(0, 999);
+    bool cacheValid = true;
+    for (size_t i = 0; i < operationCount && cacheValid; ++i) {
+        if (invalidation(random) == 0) {
+            cache.Invalidate();
+            std::fill(known, known + RenderStateCache::StateCount, false);
+            continue;
+        }
+
+        int state = stateIndex(random);
+        uintptr_t values[3] = { uintptr_t(value(random)), uintptr_t(value(random)), uintptr_t(value(random)) };
+        bool repeat = known[state] && std::equal(values, values + 3, model[state]);
+        cacheValid = cache.Update(static_cast<RenderStateCache::State>(state), values[0], values[1], values[2]) != repeat;
+
+        std::copy(values, values + 3, model[state]);
+        known[state] = true;
+        if (repeat) {
+            ++elided[state];
+        }
+        else {
+            ++issued[state];
+        }
+    }
+    const RenderStateCache::Counters& cacheCounters = cache.GetCounters();
+    expect(cacheValid, "a state call was filtered or issued against the model");
+    expect(std::equal(issued, issued + RenderStateCache::StateCount, cacheCounters.issued) &&
+        std::equal(elided, elided + RenderStateCache::StateCount, cacheCounters.elided),
+        "the state cache counters do not match");
+    cache.ResetCounters();
+    expect(cache.GetCounters().TotalIssued() == 0 && cache.GetCounters().TotalElided() == 0,
+        "resetting the counters did not clear them");
+
+    LogMessage("Draw submission test: %u allocations with %u discards, %u state calls issued and %u filtered\n",
+        ringCounters.allocations, ringCounters.discards, std::accumulate(issued, issued + RenderStateCache::StateCount, 0u),
+        std::accumulate(elided, elided + RenderStateCache::StateCount, 0u));
+
+    LogMessage(valid ? "Draw submission test: passed\n" : "Draw submission test: FAILED\n");
+    return valid ? 0 : 1;
+}
+
+// CPU benchmark: BogEngine.exe -render-queue-benchmark [count]
+// Submits, sorts and walks count packets with a scene-like key mix and logs
+// the cost per packet.
+int RunRenderQueueBenchmark(const CommandLine& commandLine) {
+    size_t packetCount = commandLine.GetCount(100000);
+
+    // Mostly opaque draws over a few programs and many meshes
+    std::mt19937 random(1234);
+    std::uniform_int_distribution<uint32_t> programs(0, 63);
+    std::uniform_int_distribution<uint32_t> meshes(0, 4095);
+    std::uniform_real_distribution<float> depths(0.1f, 1000.0f);
+    std::vector<uint64_t> keys(packetCount);
+    for (size_t i = 0; i < packetCount; ++i) {
+        RenderPass pass = (i % 8 == 0) ? RenderPass::Transparent : RenderPass::Opaque;
+        keys[i] = RenderQueue::MakeKey(pass, programs(random), meshes(random), depths(random));
+    }
+    std::vector<uint32_t> records(packetCount);
+    for (size_t i = 0; i < packetCount; ++i) {
+        records[i] = static_cast<uint32_t>(i);
+    }
+
+    const int iterations = 50;
+    RenderQueue queue;
+    double sortNanoseconds = 0.0;
+    double walkNanoseconds = 0.0;
+    uint64_t checksum = 0;
+
+    // The first iteration warms up the queue's buffers and is not counted
+    for (int iteration = 0; iteration <= iterations; ++iteration) {
+        auto start = std::chrono::steady_clock::now();
+        queue.Clear();
+        for (size_t i = 0; i < packetCount; ++i) {
+            queue.Submit(keys[i], static_cast<uint32_t>(i));
+        }
+        queue.Sort();
+        auto sorted = std::chrono::steady_clock::now();
+
+        // Walk the packets the way Graphics::Draw does, counting state changes
+        uint64_t previousKey = ~0ull;
+        for (const DrawPacket& packet : queue.GetPackets()) {
+            if ((packet.key >> 48) != (previousKey >> 48)) {
+                ++checksum;
+            }
+            checksum += records[packet.item];
+            previousKey = packet.key;
+        }
+        auto walked = std::chrono::steady_clock::now();
+
+        if (iteration > 0) {
+            sortNanoseconds += std::chrono::duration<double, std::nano>(sorted - start).count();
+            walkNanoseconds += std::chrono::duration<double, std::nano>(walked - sorted).count();
+        }
+    }
+
+    double perPacket = static_cast<double>(packetCount) * iterations;
+    LogMessage("Render queue benchmark: %u packets, submit and sort %.2f ns, walk %.2f ns per packet (checksum %llu)\n",
+        static_cast<unsigned>(packetCount), sortNanoseconds / perPacket, walkNanoseconds / perPacket,
+        static_cast<unsigned long long>(checksum));
+    return 0;
+}
+
+// CPU benchmark: BogEngine.exe -culling-benchmark [count]
+// Culls count random objects with the SIMD and the scalar kernel and logs
+// the throughput of each.
+int RunCullingBenchmark(const CommandLine& commandLine) {
+    size_t objectCount = commandLine.GetCount(1000000);
+
+    // Objects scattered around a camera at the origin looking down +z
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> positions(-300.0f, 300.0f);
+    std::uniform_real_distribution<float> sizes(0.1f, 5.0f);
+    BoundingVolumes volumes;
+    volumes.Reserve(objectCount);
+    for (size_t i = 0; i < objectCount; ++i) {
+        float center[3] = { positions(random), positions(random), positions(random) };
+        float extents[3] = { sizes(random), sizes(random), sizes(random) };
+        volumes.Add(center, extents);
+    }
+
+    XMFLOAT4X4 viewProj;
+    XMStoreFloat4x4(&viewProj, XMMatrixPerspectiveFovLH(XM_PIDIV4, 4.0f / 3.0f, 0.1f, 200.0f));
+    const float eye[3] = { 0.0f, 0.0f, 0.0f };
+    Frustum frustum;
+    FrustumCulling::ExtractFrustum(&viewProj._11, eye, 150.0f, frustum);
+
+    const int iterations = 20;
+    std::vector<uint32_t> visible(objectCount);
+    double simdMilliseconds = 0.0;
+    double scalarMilliseconds = 0.0;
+    size_t simdVisible = 0;
+    size_t scalarVisible = 0;
+
+    for (int iteration = 0; iteration < iterations; ++iteration) {
+        auto start = std::chrono::steady_clock::now();
+        simdVisible = FrustumCulling::Cull(frustum, volumes, visible.data());
+        auto simdDone = std::chrono::steady_clock::now();
+        scalarVisible = FrustumCulling::CullScalar(frustum, volumes, visible.data());
+        auto scalarDone = std::chrono::steady_clock::now();
+
+        simdMilliseconds += std::chrono::duration<double, std::milli>(simdDone - start).count();
+        scalarMilliseconds += std::chrono::duration<double, std::milli>(scalarDone - simdDone).count();
+    }
+
+    // Millions of objects per second for each kernel
+    double objects = static_cast<double>(objectCount) * iterations;
+    LogMessage("Culling benchmark: %u objects, %u visible, SIMD %.1f M/s, scalar %.1f M/s%s\n",
+        static_cast<unsigned>(objectCount), static_cast<unsigned>(simdVisible),
+        objects / (simdMilliseconds * 1000.0), objects / (scalarMilliseconds * 1000.0),
+        simdVisible == scalarVisible ? "" : " (kernels disagree)");
+    return 0;
+}
+
+// Stress benchmark: BogEngine.exe -aabb-tree-benchmark [count]
+// Moves count objects every frame, then runs overlap, ray and frustum
+// queries, and logs the update and query cost per frame.
+int RunAabbTreeBenchmark(const CommandLine& commandLine) {
+    size_t objectCount = commandLine.GetCount(20000);
+
+    const float worldSize = 200.0f;
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> positions(-worldSize * 0.5f, worldSize * 0.5f);
+    std::uniform_real_distribution<float> velocities(-0.2f, 0.2f);
+
+    struct Mover {
+        Aabb aabb;
+        float velocity[3];
+        int32_t proxy;
+    };
+    std::vector<Mover> movers(objectCount);
+    DynamicAabbTree tree;
+    for (Mover& mover : movers) {
+        for (int axis = 0; axis < 3; ++axis) {
+            float center = positions(random);
+            mover.aabb.min[axis] = center - 0.5f;
+            mover.aabb.max[axis] = center + 0.5f;
+            mover.velocity[axis] = velocities(random);
+        }
+        mover.proxy = tree.CreateProxy(mover.aabb, &mover);
+    }
+
+    XMFLOAT4X4 viewProj;
+    XMStoreFloat4x4(&viewProj, XMMatrixPerspectiveFovLH(XM_PIDIV4, 4.0f / 3.0f, 0.1f, 200.0f));
+    const float eye[3] = { 0.0f, 0.0f, 0.0f };
+    Frustum frustum;
+    FrustumCulling::ExtractFrustum(&viewProj._11, eye, 150.0f, frustum);
+
+    const int frames = 300;
+    const int queriesPerFrame = 100;
+    double updateMilliseconds = 0.0;
+    double queryMilliseconds = 0.0;
+    uint64_t reinserts = 0;
+    uint64_t results = 0;
+
+    for (int frame = 0; frame < frames; ++frame) {
+        // Bounce every object around the world box
+        auto start = std::chrono::steady_clock::now();
+        for (Mover& mover : movers) {
+            for (int axis = 0; axis < 3; ++axis) {
+                if (mover.aabb.max[axis] > worldSize * 0.5f || mover.aabb.min[axis] < -worldSize * 0.5f) {
+                    mover.velocity[axis] = -mover.velocity[axis];
+                }
+                mover.aabb.min[axis] += mover.velocity[axis];
+                mover.aabb.max[axis] += mover.velocity[axis];
+            }
+            reinserts += tree.MoveProxy(mover.proxy, mover.aabb, mover.velocity) ? 1 : 0;
+        }
+        auto updated = std::chrono::steady_clock::now();
+
+        // Proximity checks and line-of-sight rays like enemies would make
+        for (int query = 0; query < queriesPerFrame; ++query) {
+            Aabb area;
+            for (int axis = 0; axis < 3; ++axis) {
+                float center = positions(random);
+                area.min[axis] = center - 5.0f;
+                area.max[axis] = center + 5.0f;
+            }
+            tree.QueryOverlap(area, [&](int32_t) { ++results; return true; });
+
+            float origin[3] = { positions(random), positions(random), positions(random) };
+            float direction[3] = { velocities(random), velocities(random), velocities(random) };
+            float length = std::sqrt(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+            for (float& component : direction) {
+                component /= (length > 0.0f ? length : 1.0f);
+            }
+            tree.RayCast(origin, direction, 50.0f, [&](int32_t) { ++results; return 50.0f; });
+        }
+        tree.QueryFrustum(frustum, [&](int32_t) { ++results; return true; });
+        auto queried = std::chrono::steady_clock::now();
+
+        updateMilliseconds += std::chrono::duration<double, std::milli>(updated - start).count();
+        queryMilliseconds += std::chrono::duration<double, std::milli>(queried - updated).count();
+    }
+
+    LogMessage("AABB tree benchmark: %u objects, update %.3f ms (%.1f%% reinserted), "
+        "%d overlap + %d ray queries and 1 frustum query %.3f ms per frame, height %d, area ratio %.1f (%llu results)\n",
+        static_cast<unsigned>(objectCount), updateMilliseconds / frames,
+        100.0 * reinserts / (static_cast<double>(objectCount) * frames),
+        queriesPerFrame, queriesPerFrame, queryMilliseconds / frames,
+        tree.GetHeight(), tree.GetAreaRatio(), static_cast<unsigned long long>(results));
+    return 0;
+}
+
+// Headless benchmark: BogEngine.exe -occlusion-benchmark [count]
+// Flies down a street of a synthetic city, rasterizing the buildings as
+// occluders over a job system and testing count small street objects
+// against them. Logs the cull rate and the cost per frame, and writes the
+// first frame's depth buffer to occlusion_depth.pgm.
+int RunOcclusionBenchmark(const CommandLine& commandLine) {
+    size_t objectCount = commandLine.GetCount(20000);
+
+    // Unit box standing on the ground, scaled into buildings by their world matrix
+    float boxPositions[8 * 3];
+    for (int corner = 0; corner < 8; ++corner) {
+        boxPositions[corner * 3 + 0] = (corner & 1) ? 0.5f : -0.5f;
+        boxPositions[corner * 3 + 1] = (corner & 2) ? 1.0f : 0.0f;
+        boxPositions[corner * 3 + 2] = (corner & 4) ? 0.5f : -0.5f;
+    }
+    const uint32_t boxIndices[36] = {
+        0, 1, 3, 0, 3, 2,   4, 6, 7, 4, 7, 5,   0, 4, 5, 0, 5, 1,
+        2, 3, 7, 2, 7, 6,   0, 2, 6, 0, 6, 4,   1, 5, 7, 1, 7, 3
+    };
+
+    // 20x20 blocks of 8m buildings on a 12m grid
+    struct Building {
+        XMFLOAT4X4 world;
+        float boxMin[3];
+        float boxMax[3];
+    };
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> heights(5.0f, 30.0f);
+    std::vector<Building> buildings;
+    for (int row = 0; row < 20; ++row) {
+        for (int column = 0; column < 20; ++column) {
+            float x = (column - 10) * 12.0f;
+            float z = (row - 10) * 12.0f;
+            float height = heights(random);
+
+            Building building;
+            XMStoreFloat4x4(&building.world, XMMatrixScaling(8.0f, height, 8.0f) * XMMatrixTranslation(x, 0.0f, z));
+            building.boxMin[0] = x - 4.0f; building.boxMin[1] = 0.0f; building.boxMin[2] = z - 4.0f;
+            building.boxMax[0] = x + 4.0f; building.boxMax[1] = height; building.boxMax[2] = z + 4.0f;
+            buildings.push_back(building);
+        }
+    }
+
+    std::uniform_real_distribution<float> positions(-125.0f, 125.0f);
+    std::vector<float> objects(objectCount * 6);
+    for (size_t i = 0; i < objectCount; ++i) {
+        float x = positions(random);
+        float z = positions(random);
+        float* box = &objects[i * 6];
+        box[0] = x - 0.5f; box[1] = 0.0f; box[2] = z - 0.5f;
+        box[3] = x + 0.5f; box[4] = 1.5f; box[5] = z + 0.5f;
+    }
+
+    JobSystem jobs;
+    OcclusionCuller culler;
+    if (!jobs.Initialize() || !culler.Initialize(256, 192)) {
+        return 1;
+    }
+
+    const int frames = 120;
+    XMMATRIX projection = XMMatrixPerspectiveFovLH(XM_PIDIV4, 4.0f / 3.0f, 0.1f, 500.0f);
+    double rasterMilliseconds = 0.0;
+    double testMilliseconds = 0.0;
+    uint64_t frustumVisible = 0;
+    uint64_t occluded = 0;
+
+    for (int frame = 0; frame < frames; ++frame) {
+        // Walk down the street between two columns of buildings, looking around
+        XMFLOAT3 eye(6.0f, 3.0f, -140.0f + frame * 2.0f);
+        XMVECTOR target = XMVectorSet(6.0f + std::sin(frame * 0.05f) * 40.0f, 3.0f, 0.0f, 1.0f);
+        XMMATRIX view = XMMatrixLookAtLH(XMLoadFloat3(&eye), target, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+        XMFLOAT4X4 viewProj;
+        XMStoreFloat4x4(&viewProj, view * projection);
+
+        Frustum frustum;
+        FrustumCulling::ExtractFrustum(&viewProj._11, &eye.x, 0.0f, frustum);
+
+        culler.BeginFrame(&viewProj._11);
+        for (const Building& building : buildings) {
+            if (FrustumCulling::TestAabb(frustum, building.boxMin, building.boxMax) != FrustumTest::Outside) {
+                culler.AddOccluder(boxPositions, 8, boxIndices, 36, &building.world._11);
+            }
+        }
+        culler.Rasterize(&jobs);
+        rasterMilliseconds += culler.GetStats().rasterMilliseconds;
+
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < objectCount; ++i) {
+            const float* box = &objects[i * 6];
+            if (FrustumCulling::TestAabb(frustum, box, box + 3) != FrustumTest::Outside) {
+                ++frustumVisible;
+                culler.IsVisible(box, box + 3);
+            }
+        }
+        testMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        occluded += culler.GetStats().occluded;
+
+        if (frame == 0) {
+            culler.WriteDepthImage("occlusion_depth.pgm");
+        }
+    }
+
+    LogMessage("Occlusion benchmark: %u objects, %.1f%% of frustum-visible objects hidden, "
+        "raster %.3f ms, tests %.3f ms per frame\n",
+        static_cast<unsigned>(objectCount), frustumVisible ? 100.0 * occluded / frustumVisible : 0.0,
+        rasterMilliseconds / frames, testMilliseconds / frames);
+    return 0;
+}
+
+// Shader cache test: BogEngine.exe -shader-cache-test
+// Runs the cache against a stub compiler on generated sources and checks
+// that it hits and misses when it should: repeated requests load, while
+// changed defines, targets and included files compile again. Also checks
+// that precompiled entries load with no compiler at all and that corrupt
+// entries are rebuilt.
+int RunShaderCacheTest(const CommandLine&) {
+    // "Compiles" to the entry point, target, defines and source, taking a little while like a real compiler
+    class StubCompiler : public ShaderCompiler {
+    public:
+        uint32_t compiles = 0;
+
+        uint64_t GetVersion() const override { return 1; }
+
+        bool Compile(const ShaderDesc& desc, std::vector<char>& bytecode, std::string& errors) override {
+            std::ifstream stream(desc.sourceFile, std::ios::binary);
+            if (!stream.is_open()) {
+                errors = "Cannot open " + desc.sourceFile;
+                return false;
+            }
+            std::string text = desc.entryPoint + " " + desc.target;
+            for (const ShaderDefine& define : desc.defines) {
+                text += " " + define.name + "=" + define.value;
+            }
+            text.append(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+            bytecode.assign(text.begin(), text.end());
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            ++compiles;
+            return true;
+        }
+    };
+
+    auto writeFile = [](const std::string& filename, const char* text) {
+        std::ofstream stream(filename, std::ios::binary | std::ios::trunc);
+        stream << text;
+    };
+
+    const std::string directory = "ShaderCacheTest";
+    StubCompiler compiler;
+    ShaderCache cache;
+    if (!cache.Initialize(directory, &compiler)) {
+        return 1;
+    }
+    const char* const tints[2] = { "float4 Tint() { return 1.0; }\n", "float4 Tint() { return 0.5; }\n" };
+    writeFile(directory + "/Test.hlsl", "#include \"Common.hlsli\"\nfloat4 main() : SV_TARGET { return Tint(); }\n");
+
+    ShaderDesc base;
+    base.sourceFile = directory + "/Test.hlsl";
+    base.entryPoint = "main";
+    base.target = "ps_5_0";
+    ShaderDesc defined = base;
+    defined.defines.push_back(ShaderDefine{ "FOG", "1" });
+    ShaderDesc retargeted = base;
+    retargeted.target = "ps_5_1";
+
+    // Removes the entries of every permutation with either version of the include
+    auto clearCache = [&]() {
+        for (const char* tint : tints) {
+            writeFile(directory + "/Common.hlsli", tint);
+            for (const ShaderDesc* desc : { &base, &defined, &retargeted }) {
+                uint64_t key = 0;
+                if (cache.ComputeKey(*desc, key)) {
+                    std::remove(cache.GetEntryFile(key).c_str());
+                }
+            }
+        }
+        writeFile(directory + "/Common.hlsli", tints[0]);
+    };
+    clearCache();
+
+    bool valid = true;
+    std::vector<char> first, second;
+    auto expect = [&valid](bool condition, const char* failure) {
+        if (!condition) {
+            LogMessage("Shader cache test: %s\n", failure);
+            valid = false;
+        }
+    };
+
+    expect(cache.GetBytecode(base, first) && compiler.compiles == 1, "first request did not compile");
+    expect(cache.GetBytecode(base, second) && compiler.compiles == 1 && first == second, "repeated request missed");
+    expect(cache.GetBytecode(defined, second) && compiler.compiles == 2, "new define hit");
+    expect(cache.GetBytecode(retargeted, second) && compiler.compiles == 3, "new target hit");
+
+    // Editing the include changes the key of everything that includes it
+    uint64_t oldKey = 0, newKey = 0;
+    cache.ComputeKey(base, oldKey);
+    writeFile(directory + "/Common.hlsli", tints[1]);
+    cache.ComputeKey(base, newKey);
+    expect(oldKey != newKey && cache.GetBytecode(base, second) && compiler.compiles == 4, "edited include hit");
+
+    // Offline step, then a fresh cache, as at the next launch, that must not compile anything
+    expect(cache.Precompile({ base, defined, retargeted }) && compiler.compiles == 6, "precompile did not fill the cache");
+    StubCompiler shippedCompiler;
+    ShaderCache shipped;
+    shipped.Initialize(directory, &shippedCompiler);
+    for (const ShaderDesc* desc : { &base, &defined, &retargeted }) {
+        expect(shipped.GetBytecode(*desc, second), "precompiled entry did not load");
+    }
+    expect(shipped.GetStats().hits == 3 && shippedCompiler.compiles == 0, "precompiled cache missed");
+
+    // A truncated entry is a miss that gets rebuilt
+    { std::ofstream truncated(cache.GetEntryFile(newKey), std::ios::binary | std::ios::trunc); }
+    expect(cache.GetBytecode(base, second) && compiler.compiles == 7 && shipped.GetBytecode(base, first) &&
+        shippedCompiler.compiles == 0 && first == second, "corrupt entry was not rebuilt");
+
+    cache.LogStats();
+    shipped.LogStats();
+    clearCache();
+    LogMessage(valid ? "Shader cache test: passed\n" : "Shader cache test: FAILED\n");
+    return valid ? 0 : 1;
+}
+
+// Terrain benchmark: BogEngine.exe -terrain-benchmark [frames]
+// Generates a 2049x2049 heightmap, loads the terrain where the flight
+// starts, then flies a camera low over the ground in a wide circle for the
+// given number of frames while chunks stream in and out. Frames are paced
+// at 60 Hz, so the generation jobs get the time a real frame would give them.
+// Logs generation throughput, memory and what the frames drew, and checks
+// that the resident chunks stayed within the budget, that neighbouring
+// chunks never differed by more than one level, that streaming stopped
+// allocating from the heap after the warm-up and that the chunks in range
+// were loaded once the camera stopped.
+int RunTerrainBenchmark(const CommandLine& commandLine) {
+    size_t frames = commandLine.GetCount(600);
+
+    bool valid = true;
+    auto expect = [&valid](bool condition, const char* failure) {
+        if (!condition) {
+            LogMessage("Terrain benchmark: %s\n", failure);
+            valid = false;
+        }
+    };
+
+    const uint32_t mapSize = 2049;
+    const float sampleSpacing = 2.0f;
+    const float flightRadius = 1280.0f;
+    const float flightSpeed = 4.0f;     // Units per frame
+    const std::chrono::microseconds framePeriod(16667);
+    const uint32_t warmupFrames = 60;
+    const float flightHeight = 12.0f;   // Above the ground
+    const int width = 640;
+    const int height = 360;
+
+    Heightmap heightmap;
+    auto generateStart = std::chrono::steady_clock::now();
+    if (!heightmap.GenerateFractal(mapSize, mapSize, sampleSpacing, 0.0f, 80.0f, 7)) {
+        LogMessage("Terrain benchmark: heightmap generation failed\n");
+        return 1;
+    }
+    std::chrono::duration<double, std::milli> generateTime = std::chrono::steady_clock::now() - generateStart;
+
+    HeadlessBackend backend;
+    JobSystem jobs;
+    jobs.Initialize();
+    Terrain terrain;
+    Terrain::Desc desc = Terrain::GetDefaultDesc();
+    desc.loadDistance = 640.0f;
+    desc.memoryBudget = 3 * 1024 * 1024;
+    if (!backend.Initialize(width, height) || !terrain.Initialize(&backend, &jobs, &heightmap, desc, XMFLOAT3(0.0f, 0.0f, 0.0f))) {
+        LogMessage("Terrain benchmark: terrain failed to initialize\n");
+        return 1;
+    }
+
+    const float fieldOfView = XM_PIDIV4;
+    XMMATRIX projMatrix = XMMatrixPerspectiveFovLH(fieldOfView, static_cast<float>(width) / height, 0.1f, 2000.0f);
+    Mesh::LodView lodView;
+    lodView.pixelsPerUnit = static_cast<float>(height) / (2.0f * std::tan(fieldOfView * 0.5f));
+    lodView.maxPixelError = 1.0f;
+
+    const float center = (mapSize - 1) * sampleSpacing * 0.5f;
+    auto cameraAt = [&](float angle) {
+        float x = center + std::cos(angle) * flightRadius;
+        float z = center + std::sin(angle) * flightRadius;
+        return XMFLOAT3(x, terrain.GetHeight(x, z) + flightHeight, z);
+    };
+
+    // Waits out the streaming without drawing
+    auto settle = [&](const XMFLOAT3& position) {
+        while (terrain.IsStreaming()) {
+            terrain.Update(position);
+            std::this_thread::yield();
+        }
+    };
+
+    // Every chunk within the load distance is resident, or as many as the budget holds
+    auto loadedInRange = [&](const XMFLOAT3& position) {
+        const float chunkSize = desc.chunkQuads * heightmap.GetSpacing();
+        uint32_t inRange = 0;
+        uint32_t resident = 0;
+        for (uint32_t z = 0; z < terrain.GetChunksZ(); ++z) {
+            for (uint32_t x = 0; x < terrain.GetChunksX(); ++x) {
+                float dx = std::max(std::max(x * chunkSize - position.x, position.x - (x + 1) * chunkSize), 0.0f);
+                float dz = std::max(std::max(z * chunkSize - position.z, position.z - (z + 1) * chunkSize), 0.0f);
+                if (dx * dx + dz * dz <= desc.loadDistance * desc.loadDistance) {
+                    ++inRange;
+                    resident += terrain.GetChunkLod(x, z) >= 0 ? 1 : 0;
+                }
+            }
+        }
+        return resident == std::min(inRange, terrain.GetStats().chunkCapacity);
+    };
+
+    XMFLOAT3 cameraPosition = cameraAt(0.0f);
+    auto loadStart = std::chrono::steady_clock::now();
+    settle(cameraPosition);
+    std::chrono::duration<double, std::milli> loadTime = std::chrono::steady_clock::now() - loadStart;
+    Terrain::Stats loaded = terrain.GetStats();
+    expect(loadedInRange(cameraPosition), "chunks in range were not loaded at the start");
+
+    const float clearColor[4] = {};
+    const float angleStep = flightSpeed / flightRadius;
+    double updateMilliseconds = 0.0;
+    double drawMilliseconds = 0.0;
+    uint64_t drawnChunks = 0;
+    uint64_t drawnTriangles = 0;
+    uint64_t drawnLods[Terrain::MaxLods] = {};
+    uint64_t peakResidentBytes = 0;
+    uint64_t peakStagingBytes = 0;
+    bool withinBudget = true;
+    bool balanced = true;
+    uint64_t heapBefore = MemoryTracker::GetTotalAllocations();
+    auto frameStart = std::chrono::steady_clock::now();
+    for (size_t frame = 0; frame < frames; ++frame) {
+        std::this_thread::sleep_until(frameStart + framePeriod * frame);
+        if (frame == warmupFrames) {
+            heapBefore = MemoryTracker::GetTotalAllocations();
+        }
+        float angle = frame * angleStep;
+        cameraPosition = cameraAt(angle);
+
+        // Looking along the flight path, tipped down a little
+        XMFLOAT3 ahead = cameraAt(angle + angleStep * 30.0f);
+        XMVECTOR target = XMVectorSet(ahead.x, cameraPosition.y - flightHeight * 0.5f, ahead.z, 1.0f);
+        XMMATRIX viewProjMatrix = XMMatrixLookAtLH(XMLoadFloat3(&cameraPosition), target, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)) * projMatrix;
+
+        XMFLOAT4X4 viewProj;
+        XMStoreFloat4x4(&viewProj, viewProjMatrix);
+        const float eyePosition[3] = { cameraPosition.x, cameraPosition.y, cameraPosition.z };
+        Frustum frustum;
+        FrustumCulling::ExtractFrustum(&viewProj._11, eyePosition, 2000.0f, frustum);
+        lodView.cameraPosition = cameraPosition;
+
+        backend.BeginFrame(clearColor);
+        auto updateStart = std::chrono::steady_clock::now();
+        terrain.Update(cameraPosition);
+        auto drawStart = std::chrono::steady_clock::now();
+        terrain.Draw(frustum, viewProjMatrix, lodView);
+        auto drawEnd = std::chrono::steady_clock::now();
+        backend.Present();
+        updateMilliseconds += std::chrono::duration<double, std::milli>(drawStart - updateStart).count();
+        drawMilliseconds += std::chrono::duration<double, std::milli>(drawEnd - drawStart).count();
+
+        Terrain::Stats stats = terrain.GetStats();
+        withinBudget = withinBudget && stats.residentBytes <= stats.vertexBufferBytes && stats.vertexBufferBytes <= desc.memoryBudget;
+        peakResidentBytes = std::max(peakResidentBytes, stats.residentBytes);
+        peakStagingBytes = std::max(peakStagingBytes, stats.stagingBytes);
+        drawnChunks += stats.drawnChunks;
+        drawnTriangles += stats.drawnTriangles;
+        for (uint32_t lod = 0; lod < Terrain::MaxLods; ++lod) {
+            drawnLods[lod] += stats.drawnLods[lod];
+        }
+
+        for (uint32_t z = 0; z < terrain.GetChunksZ(); ++z) {
+            for (uint32_t x = 0; x < terrain.GetChunksX(); ++x) {
+                int32_t lod = terrain.GetChunkLod(x, z);
+                int32_t east = (x + 1 < terrain.GetChunksX()) ? terrain.GetChunkLod(x + 1, z) : -1;
+                int32_t north = (z + 1 < terrain.GetChunksZ()) ? terrain.GetChunkLod(x, z + 1) : -1;
+                balanced = balanced && (lod < 0 || east < 0 || std::abs(lod - east) <= 1);
+                balanced = balanced && (lod < 0 || north < 0 || std::abs(lod - north) <= 1);
+            }
+        }
+    }
+    uint64_t flightAllocations = (frames > warmupFrames) ? MemoryTracker::GetTotalAllocations() - heapBefore : 0;
+    expect(withinBudget, "resident chunks went over the memory budget");
+    expect(flightAllocations == 0, "streaming allocated from the heap after the warm-up");
+    expect(balanced, "neighbouring chunks differ by more than one level");
+
+    settle(cameraPosition);
+    expect(loadedInRange(cameraPosition), "chunks in range were not loaded after the flight");
+    Terrain::Stats flown = terrain.GetStats();
+    expect(flown.generated > loaded.generated && flown.evicted > 0, "the flight did not stream any chunks");
+
+    uint64_t generated = flown.generated - loaded.generated;
+    size_t frameCount = std::max<size_t>(frames, 1);
+    LogMessage("Terrain benchmark: %ux%u heightmap (%.1f MB) generated in %.1f ms; %u chunks of %u quads, "
+        "%u fit the %.1f MB budget\n",
+        mapSize, mapSize, heightmap.GetMemoryBytes() / (1024.0 * 1024.0), generateTime.count(), loaded.chunks, desc.chunkQuads,
+        loaded.chunkCapacity, desc.memoryBudget / (1024.0 * 1024.0));
+    LogMessage("Terrain benchmark: start loaded %u chunks in %.1f ms (%.0f chunks/s), %.3f ms generating each\n",
+        loaded.residentChunks, loadTime.count(), loaded.residentChunks * 1000.0 / std::max(loadTime.count(), 0.001),
+        loaded.generationMilliseconds / std::max<uint64_t>(loaded.generated, 1));
+    LogMessage("Terrain benchmark: %u frames flying %.1f units each: %llu chunks generated, %llu evicted, "
+        "%llu dropped before upload, %llu heap allocations after %u warm-up frames; peak %.2f MB resident, %.2f MB staging, %.2f MB shared indices\n",
+        static_cast<unsigned>(frames), flightSpeed, static_cast<unsigned long long>(generated),
+        static_cast<unsigned long long>(flown.evicted - loaded.evicted),
+        static_cast<unsigned long long>(flown.cancelled - loaded.cancelled), static_cast<unsigned long long>(flightAllocations), warmupFrames,
+        peakResidentBytes / (1024.0 * 1024.0), peakStagingBytes / (1024.0 * 1024.0), flown.indexBytes / (1024.0 * 1024.0));
+    std::string levels;
+    for (uint32_t lod = 0; lod < Terrain::MaxLods; ++lod) {
+        char level[32];
+        snprintf(level, sizeof(level), " %.1f", static_cast<double>(drawnLods[lod]) / frameCount);
+        levels += level;
+    }
+    LogMessage("Terrain benchmark: per frame %.3f ms update, %.3f ms draw, %.1f chunks, %.0f triangles; chunks per level:%s\n",
+        updateMilliseconds / frameCount, drawMilliseconds / frameCount, static_cast<double>(drawnChunks) / frameCount,
+        static_cast<double>(drawnTriangles) / frameCount, levels.c_str());
+    if (MemoryTracker::IsEnabled()) {
+        MemoryTracker::Stats heap = MemoryTracker::GetTotalStats(MemoryTag::Terrain);
+        LogMessage("Terrain benchmark: %.2f MB of terrain heap live\n",
+            (heap.allocatedBytes - heap.freedBytes) / (1024.0 * 1024.0));
+    }
+    LogMessage(valid ? "Terrain benchmark: passed\n" : "Terrain benchmark: FAILED\n");
+    return valid ? 0 : 1;
+}
+
+namespace {
+    // Frame loop benchmark: BogEngine.exe -headless-benchmark [frames]
+    // Runs Update/Draw on the headless backend without opening a window and
+    // logs the CPU frame time and submission stats. -headless-raster-benchmark
+    // also rasterizes every frame and writes the last one to headless_frame.ppm.
+    // Both honour -instancing-benchmark, and -profile-trace writes a Chrome trace
+    // of the measured frames to headless_trace.json.
+    int RunFrameLoopBenchmark(const CommandLine& commandLine, bool rasterize) {
+        HeadlessBenchmark::Options options;
+        options.frames = static_cast<uint32_t>(commandLine.GetCount(600));
+        if (rasterize) {
+            options.rasterize = true;
+            options.imageFile = "headless_frame.ppm";
+        }
+        options.instancingCopies = ParseInstancingBenchmark(commandLine);
+        if (ParseProfileTrace(commandLine) > 0) {
+            options.traceFile = "headless_trace.json";
+        }
+
+        HeadlessBenchmark::Result result;
+        if (!HeadlessBenchmark::Run(options, result)) {
+            return 1;
+        }
+        HeadlessBenchmark::LogResult(result);
+        return 0;
+    }
+}
+
+int RunHeadlessBenchmark(const CommandLine& commandLine) {
+    return RunFrameLoopBenchmark(commandLine, false);
+}
+
+int RunHeadlessRasterBenchmark(const CommandLine& commandLine) {
+    return RunFrameLoopBenchmark(commandLine, true);
+}
@@ -0,0 +1,104 @@
+// RenderQueue.cpp
+
+#include "RenderQueue.h"
+
+#include <cstring>
+
+namespace {
+
+    // Non-negative floats order the same as their bit patterns
+    uint32_t DepthBits(float depth) {
+        if (!(depth > 0.0f)) {
+            return 0;
+        }
+        uint32_t bits;
+        std::memcpy(&bits, &depth, sizeof(bits));
+        return bits;
+    }
+
+}
+
+uint64_t RenderQueue::MakeKey(RenderPass pass, uint32_t program, uint32_t mesh, float depth) {
+    uint64_t passBits = static_cast<uint64_t>(pass) << 60;
+    uint64_t programBits = program & (MaxPrograms - 1);
+    uint64_t meshBits = mesh & (MaxMeshes - 1);
+    uint64_t depthBits = DepthBits(depth);
+
+    if (pass == RenderPass::Transparent) {
+        // pass:4 | inverted depth:32 | program:12 | mesh:16
+        return passBits | ((~depthBits & 0xFFFFFFFFull) << 28) | (programBits << 16) | meshBits;
+    }
+
+    // pass:4 | program:12 | mesh:16 | depth:32
+    return passBits | (programBits << 48) | (meshBits << 32) | depthBits;
+}
+
+void RenderQueue::Submit(uint64_t key, uint32_t item) {
+    DrawPacket packet = { key, item };
+    packets.push_back(packet);
+}
+
+DrawPacket* RenderQueue::Append(size_t count) {
+    size_t first = packets.size();
+    packets.resize(first + count);
+    return packets.data() + first;
+}
+
+void RenderQueue::Sort() {
+    RadixSort(packets, scratch);
+}
+
+void RenderQueue::RadixSort(std::vector<DrawPacket>& packets, std::vector<DrawPacket>& scratch) {
+    const size_t count = packets.size();
+    if (count < 2) {
+        return;
+    }
+    scratch.resize(count);
+
+    // Histograms for all eight bytes in one read of the keys
+    uint32_t histograms[8][256];
+    std::memset(histograms, 0, sizeof(histograms));
+    for (const DrawPacket& packet : packets) {
+        uint64_t key = packet.key;
+        for (int digit = 0; digit < 8; ++digit) {
+            ++histograms[digit][(key >> (digit * 8)) & 0xFF];
+        }
+    }
+
+    DrawPacket* source = packets.data();
+    DrawPacket* destination = scratch.data();
+    bool swapped = false;
+
+    for (int digit = 0; digit < 8; ++digit) {
+        uint32_t* histogram = histograms[digit];
+        const int shift = digit * 8;
+
+        // All keys share this byte, so the pass would not move anything
+        if (histogram[(source[0].key >> shift) & 0xFF] == count) {
+            continue;
+        }
+
+        // Exclusive prefix sum gives each bucket's first output slot
+        uint32_t offset = 0;
+        for (int bucket = 0; bucket < 256; ++bucket) {
+            uint32_t bucketCount = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += bucketCount;
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            const DrawPacket& packet = source[i];
+            destination[histogram[(packet.key >> shift) & 0xFF]++] = packet;
+        }
+
+        DrawPacket* previous = source;
+        source = destination;
+        destination = previous;
+        swapped = !swapped;
+    }
+
+    // An odd number of passes leaves the result in scratch
+    if (swapped) {
+        packets.swap(scratch);
+    }
+}
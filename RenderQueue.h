@@ -0,0 +1,51 @@
+// RenderQueue.h
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum class RenderPass {
+    Opaque,         // Sorted by state, then front to back
+    Transparent     // Sorted back to front, then by state
+};
+
+// A queued draw: the sort key and an index into the caller's own draw records
+struct DrawPacket {
+    uint64_t key;
+    uint32_t item;
+};
+
+// Collects draw packets during scene traversal and sorts them by key with an
+// LSD radix sort before they are executed. Keys put the pass in the top bits,
+// so passes run in order, and within a pass group draws by shader program and
+// mesh to cut state changes. Opaque depth increases front to back for early-Z;
+// transparent depth is inverted so the farthest draws come first.
+class RenderQueue {
+public:
+    static const uint32_t MaxPrograms = 1 << 12;
+    static const uint32_t MaxMeshes = 1 << 16;
+
+    // Program and mesh ids wrap at MaxPrograms and MaxMeshes. Depth is view-space
+    // distance; negative values count as 0.
+    static uint64_t MakeKey(RenderPass pass, uint32_t program, uint32_t mesh, float depth);
+
+    static RenderPass GetPass(uint64_t key) { return static_cast<RenderPass>(key >> 60); }
+
+    void Clear() { packets.clear(); }
+    void Submit(uint64_t key, uint32_t item);
+
+    // Adds count packets for the caller to fill in, for jobs that each write a disjoint range
+    DrawPacket* Append(size_t count);
+    void Sort();
+
+    const std::vector<DrawPacket>& GetPackets() const { return packets; }
+
+    // Stable sort by key. Skips byte positions where every key has the same
+    // digit, which with the pass and program bits is most of the high bytes.
+    static void RadixSort(std::vector<DrawPacket>& packets, std::vector<DrawPacket>& scratch);
+
+private:
+    std::vector<DrawPacket> packets;
+    std::vector<DrawPacket> scratch;
+};
@@ -0,0 +1,46 @@
+// RenderStateCache.cpp
+
+#include "RenderStateCache.h"
+
+uint32_t RenderStateCache::Counters::TotalIssued() const {
+    uint32_t total = 0;
+    for (int i = 0; i < StateCount; ++i) total += issued[i];
+    return total;
+}
+
+uint32_t RenderStateCache::Counters::TotalElided() const {
+    uint32_t total = 0;
+    for (int i = 0; i < StateCount; ++i) total += elided[i];
+    return total;
+}
+
+RenderStateCache::RenderStateCache()
+    : entries(), counters()
+{
+    Invalidate();
+}
+
+bool RenderStateCache::Update(State state, uintptr_t a, uintptr_t b, uintptr_t c) {
+    Entry& entry = entries[state];
+    if (entry.valid && entry.values[0] == a && entry.values[1] == b && entry.values[2] == c) {
+        ++counters.elided[state];
+        return false;
+    }
+
+    entry.values[0] = a;
+    entry.values[1] = b;
+    entry.values[2] = c;
+    entry.valid = true;
+    ++counters.issued[state];
+    return true;
+}
+
+void RenderStateCache::Invalidate() {
+    for (int i = 0; i < StateCount; ++i) {
+        entries[i].valid = false;
+    }
+}
+
+void RenderStateCache::ResetCounters() {
+    counters = Counters();
+}
@@ -0,0 +1,51 @@
+// RenderStateCache.h
+
+#pragma once
+#include <cstdint>
+
+// Shadow copy of the pipeline state last sent to the device context. Each
+// state is up to three values (object pointer, format, offset, ...), so the
+// cache works on plain integers and needs no graphics API to run or test.
+// Update returns true when the call has to be issued and counts the calls it
+// filtered out.
+class RenderStateCache {
+public:
+    enum State {
+        InputLayout,
+        VertexShader,
+        PixelShader,
+        PrimitiveTopology,
+        VertexBuffer0,
+        VertexBuffer1,
+        IndexBuffer,
+        VSConstantBuffer0,
+        StateCount
+    };
+
+    struct Counters {
+        uint32_t issued[StateCount];
+        uint32_t elided[StateCount];
+
+        uint32_t TotalIssued() const;
+        uint32_t TotalElided() const;
+    };
+
+    RenderStateCache();
+
+    bool Update(State state, uintptr_t a, uintptr_t b = 0, uintptr_t c = 0);
+
+    // Forgets everything, for when something else has touched the context
+    void Invalidate();
+
+    const Counters& GetCounters() const { return counters; }
+    void ResetCounters();
+
+private:
+    struct Entry {
+        uintptr_t values[3];
+        bool valid;
+    };
+
+    Entry entries[StateCount];
+    Counters counters;
+};
@@ -0,0 +1,27 @@
+// SceneComponents.h
+
+#pragma once
+#include <DirectXMath.h>
+#include <cstdint>
+#include "MeshRegistry.h"
+#include "TransformStore.h"
+
+// Components of the entities Graphics draws. Meshes are shared geometry; where
+// and how often one is drawn is up to the entities that reference it.
+
+// Position, rotation and scale, kept in Graphics' transform store
+struct TransformComponent {
+    TransformId transform;
+};
+
+// Geometry drawn at the entity's transform, holding a reference to it
+struct MeshComponent {
+    MeshHandle mesh;
+};
+
+// Proxy in the scene tree, added once the mesh is resident. The proxy's user
+// data is the entity's slot index.
+struct SceneTreeComponent {
+    int32_t proxy;
+    DirectX::XMFLOAT3 center;   // As of the last tree update
+};
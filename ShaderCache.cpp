@@ -0,0 +1,232 @@
+// ShaderCache.cpp
+
+#include "ShaderCache.h"
+#include "Hash.h"
+#include "Log.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <sys/stat.h>
+#endif
+
+namespace {
+
+    const char ShaderEntryMagic[4] = { 'B', 'O', 'G', 'S' };
+
+    struct ShaderEntryHeader {
+        char magic[4];
+        uint32_t version;
+        uint64_t key;
+        uint64_t bytecodeSize;
+        float compileMilliseconds;  // What the miss that wrote the entry cost
+        uint32_t reserved;
+    };
+
+    bool CreateDirectoryIfMissing(const std::string& path) {
+#ifdef _WIN32
+        return CreateDirectoryA(path.c_str(), nullptr) || GetLastError() == ERROR_ALREADY_EXISTS;
+#else
+        return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+#endif
+    }
+
+    std::string GetDirectory(const std::string& file) {
+        size_t slash = file.find_last_of("/\\");
+        return slash == std::string::npos ? std::string() : file.substr(0, slash + 1);
+    }
+
+    uint64_t HashString(const std::string& text, uint64_t hash) {
+        // The terminator keeps "ab" + "c" apart from "a" + "bc"
+        return HashBytes(text.c_str(), text.size() + 1, hash);
+    }
+
+    // Adds the file and, recursively, everything it includes. Conditional
+    // includes are followed as well, which at worst misses the cache more
+    // often. False when the file cannot be read.
+    bool HashIncludes(const std::string& file, std::vector<std::string>& visited, uint64_t& hash) {
+        MappedFile source;
+        if (!source.Open(file)) {
+            return false;
+        }
+        hash = HashBytes(source.GetData(), source.GetSize(), hash);
+
+        static const char Directive[] = "#include";
+        const size_t directiveLength = sizeof(Directive) - 1;
+        const char* end = source.GetData() + source.GetSize();
+        for (const char* line = source.GetData(); line < end; ) {
+            const char* lineEnd = std::find(line, end, '\n');
+            const char* c = line;
+            while (c < lineEnd && (*c == ' ' || *c == '\t')) ++c;
+
+            if (static_cast<size_t>(lineEnd - c) > directiveLength && std::memcmp(c, Directive, directiveLength) == 0) {
+                c += directiveLength;
+                while (c < lineEnd && (*c == ' ' || *c == '\t')) ++c;
+                const char* nameEnd = (c < lineEnd) ? std::find(c + 1, lineEnd, *c == '<' ? '>' : '"') : lineEnd;
+                if (nameEnd < lineEnd) {
+                    std::string name(c + 1, nameEnd);
+                    std::string include = GetDirectory(file) + name;
+                    if (std::find(visited.begin(), visited.end(), include) == visited.end()) {
+                        visited.push_back(include);
+                        hash = HashString(name, hash);
+                        HashIncludes(include, visited, hash);
+                    }
+                }
+            }
+            line = lineEnd + 1;
+        }
+        return true;
+    }
+
+}
+
+ShaderCache::ShaderCache()
+    : compiler(nullptr), stats()
+{
+}
+
+bool ShaderCache::Initialize(const std::string& cacheDirectory, ShaderCompiler* shaderCompiler) {
+    directory = cacheDirectory;
+    compiler = shaderCompiler;
+    return CreateDirectoryIfMissing(directory);
+}
+
+bool ShaderCache::ComputeKey(const ShaderDesc& desc, uint64_t& key) const {
+    uint64_t hash = compiler->GetVersion();
+    hash = HashString(desc.entryPoint, hash);
+    hash = HashString(desc.target, hash);
+    for (const ShaderDefine& define : desc.defines) {
+        hash = HashString(define.name, hash);
+        hash = HashString(define.value, hash);
+    }
+
+    std::vector<std::string> visited(1, desc.sourceFile);
+    if (!HashIncludes(desc.sourceFile, visited, hash)) {
+        return false;
+    }
+    key = hash;
+    return true;
+}
+
+std::string ShaderCache::GetEntryFile(uint64_t key) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bogshader", static_cast<unsigned long long>(key));
+    return directory.empty() ? std::string(name) : directory + "/" + name;
+}
+
+bool ShaderCache::GetBytecode(const ShaderDesc& desc, std::vector<char>& bytecode) {
+    // Hashing the sources counts towards the cost of a hit
+    typedef std::chrono::steady_clock Clock;
+    auto start = Clock::now();
+    uint64_t key = 0;
+    if (!ComputeKey(desc, key)) {
+        LogMessage("Shader source %s not found\n", desc.sourceFile.c_str());
+        ++stats.failures;
+        return false;
+    }
+
+    float compileMilliseconds = 0.0f;
+    if (LoadEntry(key, bytecode, compileMilliseconds)) {
+        double loadMilliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        ++stats.hits;
+        stats.loadMilliseconds += loadMilliseconds;
+        stats.savedMilliseconds += compileMilliseconds - loadMilliseconds;
+        return true;
+    }
+
+    std::string errors;
+    if (!compiler->Compile(desc, bytecode, errors)) {
+        LogMessage("Failed to compile %s (%s, %s)\n%s", desc.sourceFile.c_str(), desc.entryPoint.c_str(),
+            desc.target.c_str(), errors.c_str());
+        ++stats.failures;
+        return false;
+    }
+
+    compileMilliseconds = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+    ++stats.misses;
+    stats.compileMilliseconds += compileMilliseconds;
+    if (!WriteEntry(key, bytecode, compileMilliseconds)) {
+        LogMessage("Failed to write shader cache entry %s\n", GetEntryFile(key).c_str());
+    }
+    return true;
+}
+
+bool ShaderCache::Precompile(const std::vector<ShaderDesc>& shaders) {
+    bool compiled = true;
+    std::vector<char> bytecode;
+    for (const ShaderDesc& desc : shaders) {
+        compiled = GetBytecode(desc, bytecode) && compiled;
+    }
+    return compiled;
+}
+
+void ShaderCache::LogStats() const {
+    uint32_t requests = stats.hits + stats.misses;
+    LogMessage("Shader cache: %u hits, %u misses, %u failures (%.0f%% hit rate), %.3f ms loading, %.3f ms compiling, %.3f ms saved\n",
+        stats.hits, stats.misses, stats.failures, requests ? 100.0 * stats.hits / requests : 0.0,
+        stats.loadMilliseconds, stats.compileMilliseconds, stats.savedMilliseconds);
+}
+
+bool ShaderCache::LoadEntry(uint64_t key, std::vector<char>& bytecode, float& compileMilliseconds) const {
+    std::ifstream stream(GetEntryFile(key), std::ios::binary | std::ios::ate);
+    if (!stream.is_open()) {
+        return false;
+    }
+
+    // The header is checked against the file size before the bytecode is read
+    // straight into the caller's buffer
+    std::streamoff size = stream.tellg();
+    if (size < static_cast<std::streamoff>(sizeof(ShaderEntryHeader))) {
+        return false;
+    }
+    ShaderEntryHeader header;
+    stream.seekg(0);
+    if (!stream.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+        return false;
+    }
+    if (std::memcmp(header.magic, ShaderEntryMagic, sizeof(ShaderEntryMagic)) != 0 || header.version != Version ||
+        header.key != key || header.bytecodeSize != static_cast<uint64_t>(size) - sizeof(header)) {
+        return false;
+    }
+
+    bytecode.resize(static_cast<size_t>(header.bytecodeSize));
+    if (!stream.read(bytecode.data(), static_cast<std::streamsize>(bytecode.size()))) {
+        return false;
+    }
+    compileMilliseconds = header.compileMilliseconds;
+    return true;
+}
+
+bool ShaderCache::WriteEntry(uint64_t key, const std::vector<char>& bytecode, float compileMilliseconds) const {
+    ShaderEntryHeader header = {};
+    std::memcpy(header.magic, ShaderEntryMagic, sizeof(ShaderEntryMagic));
+    header.version = Version;
+    header.key = key;
+    header.bytecodeSize = bytecode.size();
+    header.compileMilliseconds = compileMilliseconds;
+
+    std::string filename = GetEntryFile(key);
+    std::ofstream stream(filename, std::ios::binary | std::ios::trunc);
+    if (!stream.is_open()) {
+        return false;
+    }
+
+    stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    stream.write(bytecode.data(), static_cast<std::streamsize>(bytecode.size()));
+    stream.close();
+
+    if (stream.fail()) {
+        // Never leave a truncated entry behind
+        std::remove(filename.c_str());
+        return false;
+    }
+    return true;
+}
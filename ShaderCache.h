@@ -0,0 +1,81 @@
+// ShaderCache.h
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct ShaderDefine {
+    std::string name;
+    std::string value;
+};
+
+// One shader permutation: a source file compiled for an entry point and
+// target with a set of preprocessor defines
+struct ShaderDesc {
+    std::string sourceFile;
+    std::string entryPoint;
+    std::string target;         // Shader model, e.g. "vs_5_0"
+    std::vector<ShaderDefine> defines;
+};
+
+// Turns HLSL into bytecode. The cache only talks to this, so it can run
+// with a stub compiler where there is no D3D compiler.
+class ShaderCompiler {
+public:
+    virtual ~ShaderCompiler() {}
+
+    // Changes whenever the compiler or its flags would produce different bytecode
+    virtual uint64_t GetVersion() const = 0;
+
+    // Errors holds the compiler's messages on failure
+    virtual bool Compile(const ShaderDesc& desc, std::vector<char>& bytecode, std::string& errors) = 0;
+};
+
+// Compiled shader bytecode stored on disk, one file per permutation. The key
+// hashes the source, every file it includes, the defines, entry point,
+// target and compiler version, so editing any of them misses the old entry.
+// A hit is a single read of the entry file; a miss compiles and writes a new
+// entry. Running Precompile over every permutation offline lets a build ship
+// without compiling anything at startup.
+class ShaderCache {
+public:
+    static const uint32_t Version = 1;
+
+    // Compile times are the ones recorded when the hit entries were written
+    struct Stats {
+        uint32_t hits;
+        uint32_t misses;
+        uint32_t failures;
+        double loadMilliseconds;
+        double compileMilliseconds;
+        double savedMilliseconds;   // Compile time of the hits less their load time
+    };
+
+    ShaderCache();
+
+    // Creates the directory if needed. The compiler must outlive the cache.
+    bool Initialize(const std::string& directory, ShaderCompiler* compiler);
+
+    bool GetBytecode(const ShaderDesc& desc, std::vector<char>& bytecode);
+
+    // Offline build step: makes sure every permutation has an entry. False if any fails to compile.
+    bool Precompile(const std::vector<ShaderDesc>& shaders);
+
+    // False when the source file cannot be read. Includes that cannot be
+    // found are keyed by name only, the compiler reports them.
+    bool ComputeKey(const ShaderDesc& desc, uint64_t& key) const;
+    std::string GetEntryFile(uint64_t key) const;
+
+    const Stats& GetStats() const { return stats; }
+    void ResetStats() { stats = Stats(); }
+    void LogStats() const;
+
+private:
+    bool LoadEntry(uint64_t key, std::vector<char>& bytecode, float& compileMilliseconds) const;
+    bool WriteEntry(uint64_t key, const std::vector<char>& bytecode, float compileMilliseconds) const;
+
+    std::string directory;
+    ShaderCompiler* compiler;
+    Stats stats;
+};
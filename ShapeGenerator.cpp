@@ -2,8 +2,12 @@
 
 #include "ShapeGenerator.h"
 #include "Mesh.h"
+#include <algorithm>
+#include <cmath>
 
-void ShapeGenerator::CreatePyramid(std::vector<Mesh::Vertex>& vertices, std::vector<UINT>& indices) {
+using namespace DirectX;
+
+void ShapeGenerator::CreatePyramid(std::vector<Mesh::Vertex>& vertices, std::vector<uint32_t>& indices) {
     // Vertex array
     vertices = {
         // Base vertices
@@ -27,3 +31,85 @@ void ShapeGenerator::CreatePyramid(std::vector<Mesh::Vertex>& vertices, std::vec
         4, 0, 3   // Side 4
     };
 }
+
+void ShapeGenerator::CreateBox(std::vector<Mesh::Vertex>& vertices, std::vector<uint32_t>& indices) {
+    // Unit cube around the origin; each corner's color is its position, like an RGB cube
+    vertices = {
+        { -0.5f, -0.5f, -0.5f, 0.0f, 0.0f, 0.0f }, // 0 Left-bottom-back
+        {  0.5f, -0.5f, -0.5f, 1.0f, 0.0f, 0.0f }, // 1 Right-bottom-back
+        { -0.5f,  0.5f, -0.5f, 0.0f, 1.0f, 0.0f }, // 2 Left-top-back
+        {  0.5f,  0.5f, -0.5f, 1.0f, 1.0f, 0.0f }, // 3 Right-top-back
+        { -0.5f, -0.5f,  0.5f, 0.0f, 0.0f, 1.0f }, // 4 Left-bottom-front
+        {  0.5f, -0.5f,  0.5f, 1.0f, 0.0f, 1.0f }, // 5 Right-bottom-front
+        { -0.5f,  0.5f,  0.5f, 0.0f, 1.0f, 1.0f }, // 6 Left-top-front
+        {  0.5f,  0.5f,  0.5f, 1.0f, 1.0f, 1.0f }  // 7 Right-top-front
+    };
+
+    // Two clockwise triangles per face, seen from outside
+    indices = {
+        2, 3, 1,  2, 1, 0,  // -Z
+        7, 6, 4,  7, 4, 5,  // +Z
+        6, 2, 0,  6, 0, 4,  // -X
+        3, 7, 5,  3, 5, 1,  // +X
+        0, 1, 5,  0, 5, 4,  // -Y
+        6, 7, 3,  6, 3, 2   // +Y
+    };
+}
+
+void ShapeGenerator::CreateSphere(std::vector<Mesh::Vertex>& vertices, std::vector<uint32_t>& indices, float radius, uint32_t sliceCount, uint32_t stackCount) {
+    sliceCount = std::max(sliceCount, 3u);
+    stackCount = std::max(stackCount, 2u);
+
+    // Rings of sliceCount + 1 vertices from the top pole to the bottom one; the
+    // first and last vertex of a ring meet at the seam. Colors follow the normal.
+    vertices.clear();
+    vertices.reserve(size_t(stackCount + 1) * (sliceCount + 1));
+    for (uint32_t stack = 0; stack <= stackCount; ++stack) {
+        float phi = XM_PI * static_cast<float>(stack) / static_cast<float>(stackCount);
+        for (uint32_t slice = 0; slice <= sliceCount; ++slice) {
+            float theta = XM_2PI * static_cast<float>(slice) / static_cast<float>(sliceCount);
+            float nx = std::sin(phi) * std::cos(theta);
+            float ny = std::cos(phi);
+            float nz = std::sin(phi) * std::sin(theta);
+            Mesh::Vertex vertex = { nx * radius, ny * radius, nz * radius,
+                nx * 0.5f + 0.5f, ny * 0.5f + 0.5f, nz * 0.5f + 0.5f };
+            vertices.push_back(vertex);
+        }
+    }
+
+    // Two triangles per quad between neighbouring rings, one at the poles
+    indices.clear();
+    indices.reserve(size_t(stackCount) * sliceCount * 6);
+    uint32_t ringSize = sliceCount + 1;
+    for (uint32_t stack = 0; stack < stackCount; ++stack) {
+        for (uint32_t slice = 0; slice < sliceCount; ++slice) {
+            uint32_t topLeft = stack * ringSize + slice;
+            uint32_t topRight = topLeft + 1;
+            uint32_t bottomLeft = topLeft + ringSize;
+            uint32_t bottomRight = bottomLeft + 1;
+            if (stack != 0) {
+                indices.insert(indices.end(), { topLeft, topRight, bottomLeft });
+            }
+            if (stack != stackCount - 1) {
+                indices.insert(indices.end(), { topRight, bottomRight, bottomLeft });
+            }
+        }
+    }
+}
+
+void ShapeGenerator::CreatePlane(std::vector<Mesh::Vertex>& vertices, std::vector<uint32_t>& indices, float width, float depth) {
+    // Flat quad on the XZ plane around the origin, facing up
+    float halfWidth = width * 0.5f;
+    float halfDepth = depth * 0.5f;
+    vertices = {
+        { -halfWidth, 0.0f, -halfDepth, 0.3f, 0.5f, 0.2f }, // 0 Left-back
+        { -halfWidth, 0.0f,  halfDepth, 0.3f, 0.5f, 0.2f }, // 1 Left-front
+        {  halfWidth, 0.0f, -halfDepth, 0.3f, 0.5f, 0.2f }, // 2 Right-back
+        {  halfWidth, 0.0f,  halfDepth, 0.3f, 0.5f, 0.2f }  // 3 Right-front
+    };
+
+    indices = {
+        0, 1, 3,
+        0, 3, 2
+    };
+}
@@ -3,8 +3,8 @@
 
 class ShapeGenerator {
 public:
-    static void CreatePyramid(std::vector<Mesh::Vertex>& vertices, std::vector<UINT>& indices);
-    static void CreateBox(std::vector<Mesh::Vertex>& vertices, std::vector<UINT>& indices);
-    static void CreateSphere(std::vector<Mesh::Vertex>& vertices, std::vector<UINT>& indices, float radius, UINT sliceCount, UINT stackCount);
-    static void CreatePlane(std::vector<Mesh::Vertex>& vertices, std::vector<UINT>& indices, float width, float depth);
+    static void CreatePyramid(std::vector<Mesh::Vertex>& vertices, std::vector<uint32_t>& indices);
+    static void CreateBox(std::vector<Mesh::Vertex>& vertices, std::vector<uint32_t>& indices);
+    static void CreateSphere(std::vector<Mesh::Vertex>& vertices, std::vector<uint32_t>& indices, float radius, uint32_t sliceCount, uint32_t stackCount);
+    static void CreatePlane(std::vector<Mesh::Vertex>& vertices, std::vector<uint32_t>& indices, float width, float depth);
 };
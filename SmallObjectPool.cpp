@@ -0,0 +1,180 @@
+// SmallObjectPool.cpp
+
+#include "SmallObjectPool.h"
+#include "MemoryTracker.h"
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+    const size_t ClassSizes[] = { 16, 32, 64, 128, 256 };
+    const size_t ClassCount = sizeof(ClassSizes) / sizeof(ClassSizes[0]);
+
+    // Blocks moved between a thread and the shared lists at a time. A thread
+    // keeps up to twice this many before handing a batch over.
+    const uint32_t BatchSize = 64;
+
+    // A free block. The first block of a shared batch also links to the next batch.
+    struct FreeBlock {
+        FreeBlock* next;
+        FreeBlock* nextBatch;
+    };
+
+    struct SharedState {
+        std::mutex mutex;
+        FreeBlock* batches[ClassCount] = {};
+        std::vector<void*> pages;
+        std::atomic<uint64_t> sharedBatches;
+
+        SharedState() : sharedBatches(0) {}
+
+        ~SharedState() {
+            for (void* page : pages) {
+                ::operator delete(page);
+            }
+        }
+    };
+
+    // Constructed on first use, so pools work during static initialization
+    SharedState& GetShared() {
+        static SharedState shared;
+        return shared;
+    }
+
+    size_t GetClass(size_t size) {
+        size_t index = 0;
+        while (ClassSizes[index] < size) {
+            ++index;
+        }
+        return index;
+    }
+
+    void PushBatch(size_t index, FreeBlock* batch) {
+        SharedState& shared = GetShared();
+        std::lock_guard<std::mutex> lock(shared.mutex);
+        batch->nextBatch = shared.batches[index];
+        shared.batches[index] = batch;
+        shared.sharedBatches.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    struct ThreadCache {
+        FreeBlock* heads[ClassCount] = {};
+        uint32_t counts[ClassCount] = {};
+
+        // Blocks outlive the thread, so they go back to the shared lists
+        ~ThreadCache() {
+            for (size_t index = 0; index < ClassCount; ++index) {
+                while (heads[index]) {
+                    PushBatch(index, TakeBatch(index));
+                }
+            }
+        }
+
+        // Unlinks up to BatchSize blocks from the front of the list
+        FreeBlock* TakeBatch(size_t index) {
+            FreeBlock* batch = heads[index];
+            FreeBlock* last = batch;
+            uint32_t taken = 1;
+            while (taken < BatchSize && last->next) {
+                last = last->next;
+                ++taken;
+            }
+            heads[index] = last->next;
+            counts[index] -= taken;
+            last->next = nullptr;
+            return batch;
+        }
+
+        bool Refill(size_t index) {
+            SharedState& shared = GetShared();
+            FreeBlock* batch = nullptr;
+            {
+                std::lock_guard<std::mutex> lock(shared.mutex);
+                batch = shared.batches[index];
+                if (batch) {
+                    shared.batches[index] = batch->nextBatch;
+                }
+            }
+
+            if (batch) {
+                heads[index] = batch;
+                for (FreeBlock* block = batch; block; block = block->next) {
+                    ++counts[index];
+                }
+                return true;
+            }
+
+            // Carve a new page into blocks of this class
+            void* page;
+            {
+                MemoryTagScope tag(MemoryTag::Pools);
+                page = ::operator new(SmallObjectPool::PageSize, std::nothrow);
+                if (!page) {
+                    return false;
+                }
+                std::lock_guard<std::mutex> lock(shared.mutex);
+                shared.pages.push_back(page);
+            }
+
+            size_t blockSize = ClassSizes[index];
+            size_t blockCount = SmallObjectPool::PageSize / blockSize;
+            char* blocks = static_cast<char*>(page);
+            for (size_t i = blockCount; i-- > 0; ) {
+                FreeBlock* block = reinterpret_cast<FreeBlock*>(blocks + i * blockSize);
+                block->next = heads[index];
+                heads[index] = block;
+            }
+            counts[index] += static_cast<uint32_t>(blockCount);
+            return true;
+        }
+    };
+
+    thread_local ThreadCache cache;
+
+}
+
+void* SmallObjectPool::Allocate(size_t size) {
+    if (size > MaxSize) {
+        return ::operator new(size, std::nothrow);
+    }
+
+    size_t index = GetClass(size);
+    ThreadCache& local = cache;
+    if (!local.heads[index] && !local.Refill(index)) {
+        return nullptr;
+    }
+
+    FreeBlock* block = local.heads[index];
+    local.heads[index] = block->next;
+    --local.counts[index];
+    return block;
+}
+
+void SmallObjectPool::Free(void* pointer, size_t size) {
+    if (!pointer) {
+        return;
+    }
+    if (size > MaxSize) {
+        ::operator delete(pointer);
+        return;
+    }
+
+    size_t index = GetClass(size);
+    ThreadCache& local = cache;
+    FreeBlock* block = static_cast<FreeBlock*>(pointer);
+    block->next = local.heads[index];
+    local.heads[index] = block;
+    if (++local.counts[index] >= 2 * BatchSize) {
+        PushBatch(index, local.TakeBatch(index));
+    }
+}
+
+SmallObjectPool::Stats SmallObjectPool::GetStats() {
+    SharedState& shared = GetShared();
+    std::lock_guard<std::mutex> lock(shared.mutex);
+    Stats stats;
+    stats.pages = shared.pages.size();
+    stats.sharedBatches = shared.sharedBatches.load(std::memory_order_relaxed);
+    return stats;
+}
@@ -0,0 +1,55 @@
+// SmallObjectPool.h
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+// Fixed-size blocks for small objects that come and go at a high rate, such
+// as jobs. Sizes round up to a few classes up to MaxSize and every thread
+// keeps its own free list per class, so allocating and freeing take no lock.
+// A block may be freed on another thread than the one that allocated it: a
+// thread whose list grows long hands a batch of blocks to a shared list, and
+// a thread that runs dry takes a batch from there before carving a new page.
+// Blocks that flow one way between threads, from the thread queuing jobs to
+// the workers running them, are recycled instead of piling up. Pages are
+// kept until exit.
+class SmallObjectPool {
+public:
+    static const size_t MaxSize = 256;
+    static const size_t PageSize = 64 * 1024;
+
+    struct Stats {
+        uint64_t pages;
+        uint64_t sharedBatches;     // Batches handed from one thread to another
+    };
+
+    // Sizes above MaxSize go to the heap
+    static void* Allocate(size_t size);
+
+    // Size must be the one the block was allocated with
+    static void Free(void* pointer, size_t size);
+
+    template <typename T, typename... Args>
+    static T* New(Args&&... args);
+
+    template <typename T>
+    static void Delete(T* object);
+
+    static Stats GetStats();
+};
+
+template <typename T, typename... Args>
+T* SmallObjectPool::New(Args&&... args) {
+    void* memory = Allocate(sizeof(T));
+    return memory ? new (memory) T(std::forward<Args>(args)...) : nullptr;
+}
+
+template <typename T>
+void SmallObjectPool::Delete(T* object) {
+    if (object) {
+        object->~T();
+        Free(object, sizeof(T));
+    }
+}
@@ -0,0 +1,663 @@
+// Terrain.cpp
+
+#include "Terrain.h"
+#include "Log.h"
+#include "MemoryTracker.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace {
+
+    // Same layout as the constants Mesh draws with
+    struct ChunkConstants {
+        XMMATRIX worldViewProj;
+        XMMATRIX world;
+    };
+
+    bool IsPowerOfTwo(uint32_t value) {
+        return value != 0 && (value & (value - 1)) == 0;
+    }
+
+}
+
+Terrain::Desc Terrain::GetDefaultDesc() {
+    Desc desc;
+    desc.chunkQuads = 32;
+    desc.loadDistance = 160.0f;
+    desc.memoryBudget = 2 * 1024 * 1024;
+    desc.maxPendingChunks = 16;
+    desc.maxUploadsPerFrame = 8;
+    return desc;
+}
+
+Terrain::Terrain()
+    : backend(nullptr), jobs(nullptr), heightmap(nullptr), desc(GetDefaultDesc()), origin(0.0f, 0.0f, 0.0f), chunkSize(0.0f),
+    lodCount(0), chunksX(0), chunksZ(0), positionRange(), positionTransform(XMMatrixIdentity()),
+    vertexBuffer(InvalidBuffer), indexBuffer(InvalidBuffer), chunkBytes(0), indexRanges(),
+    nextSequence(0), streaming(false), stats()
+{
+}
+
+Terrain::~Terrain() {
+    Shutdown();
+}
+
+bool Terrain::Initialize(RenderBackend* renderBackend, JobSystem* jobSystem, const Heightmap* map, const Desc& terrainDesc,
+    const XMFLOAT3& terrainOrigin) {
+    Shutdown();
+
+    uint32_t quads = terrainDesc.chunkQuads;
+    if (!IsPowerOfTwo(quads) || quads < 2 || quads > (1u << (MaxLods - 1))) {
+        LogMessage("Terrain chunks must be a power of two from 2 to %u quads across\n", 1u << (MaxLods - 1));
+        return false;
+    }
+    if (!map || map->GetWidth() <= quads || map->GetDepth() <= quads) {
+        LogMessage("Heightmap is smaller than one terrain chunk\n");
+        return false;
+    }
+
+    MemoryTagScope tag(MemoryTag::Terrain);
+    backend = renderBackend;
+    jobs = jobSystem;
+    heightmap = map;
+    desc = terrainDesc;
+    desc.maxPendingChunks = std::max(desc.maxPendingChunks, 1u);
+    desc.maxUploadsPerFrame = std::max(desc.maxUploadsPerFrame, 1u);
+    origin = terrainOrigin;
+    chunkSize = quads * map->GetSpacing();
+    chunksX = (map->GetWidth() - 1) / quads;
+    chunksZ = (map->GetDepth() - 1) / quads;
+    lodCount = 1;
+    while ((1u << (lodCount - 1)) < quads) {
+        ++lodCount;
+    }
+
+    // Chunk-local positions over the whole map's height range
+    const float boundsMin[3] = { 0.0f, map->GetMinHeight(), 0.0f };
+    const float boundsMax[3] = { chunkSize, map->GetMaxHeight(), chunkSize };
+    positionRange = VertexQuantization::PositionRangeFromBounds(boundsMin, boundsMax);
+    positionTransform = Mesh::GetVertexFormat().GetPositionTransform(positionRange);
+
+    std::vector<uint16_t> indices;
+    BuildIndexRanges(indices);
+    indexBuffer = backend->CreateBuffer(BufferUsage::Index, indices.data(), static_cast<uint32_t>(indices.size() * sizeof(uint16_t)));
+    if (indexBuffer == InvalidBuffer) {
+        LogMessage("Failed to create the terrain index buffer\n");
+        return false;
+    }
+
+    // As many chunk slots as the budget holds, and no more than the map has chunks
+    chunkBytes = GetVertexCount() * Mesh::GetVertexFormat().GetStride();
+    uint64_t chunkCount = uint64_t(chunksX) * chunksZ;
+    uint64_t slotCount = std::min(std::min(desc.memoryBudget / chunkBytes, chunkCount), uint64_t(0xffffffffu / chunkBytes));
+    if (slotCount == 0) {
+        LogMessage("Terrain memory budget of %llu bytes is smaller than one chunk (%u bytes)\n",
+            static_cast<unsigned long long>(desc.memoryBudget), chunkBytes);
+        Shutdown();
+        return false;
+    }
+
+    vertexBuffer = backend->CreateBuffer(BufferUsage::Vertex, nullptr, static_cast<uint32_t>(slotCount * chunkBytes));
+    if (vertexBuffer == InvalidBuffer) {
+        LogMessage("Failed to create the %llu byte terrain vertex buffer\n", static_cast<unsigned long long>(slotCount * chunkBytes));
+        Shutdown();
+        return false;
+    }
+
+    // Slots are handed out from the back, lowest first
+    freeSlots.resize(static_cast<size_t>(slotCount));
+    for (uint32_t slot = 0; slot < slotCount; ++slot) {
+        freeSlots[slot] = static_cast<uint32_t>(slotCount) - 1 - slot;
+    }
+
+    Chunk unloaded = {};
+    unloaded.state = ChunkState::Unloaded;
+    chunks.assign(static_cast<size_t>(chunkCount), unloaded);
+    residentChunks.reserve(static_cast<size_t>(slotCount));
+    evictionOrder.reserve(static_cast<size_t>(slotCount));
+    candidates.reserve(static_cast<size_t>(chunkCount));
+    readyStaging.reserve(desc.maxPendingChunks);
+
+    // Generation writes into buffers made up front
+    staging.resize(desc.maxPendingChunks);
+    for (Staging& buffer : staging) {
+        buffer.state = StagingState::Free;
+        buffer.cancelled = false;
+        buffer.vertices.resize(GetVertexCount());
+        buffer.encoded.resize(chunkBytes);
+    }
+
+    stats = Stats();
+    stats.chunks = static_cast<uint32_t>(chunkCount);
+    stats.chunkCapacity = static_cast<uint32_t>(slotCount);
+    stats.vertexBufferBytes = slotCount * chunkBytes;
+    stats.indexBytes = indices.size() * sizeof(uint16_t);
+    stats.stagingBytes = uint64_t(desc.maxPendingChunks) * (chunkBytes + GetVertexCount() * sizeof(Mesh::Vertex));
+    nextSequence = 0;
+    streaming = true;
+    return true;
+}
+
+void Terrain::Shutdown() {
+    // Jobs still running write into the staging buffers
+    if (jobs) {
+        jobs->Wait(generating);
+    }
+
+    if (backend) {
+        if (vertexBuffer != InvalidBuffer) {
+            backend->DestroyBuffer(vertexBuffer);
+        }
+        if (indexBuffer != InvalidBuffer) {
+            backend->DestroyBuffer(indexBuffer);
+        }
+    }
+    vertexBuffer = InvalidBuffer;
+    indexBuffer = InvalidBuffer;
+
+    chunks.clear();
+    residentChunks.clear();
+    freeSlots.clear();
+    staging.clear();
+    streaming = false;
+}
+
+void Terrain::BuildIndexRanges(std::vector<uint16_t>& indices) {
+    const uint32_t quads = desc.chunkQuads;
+    const uint32_t rowLength = quads + 1;
+
+    indices.clear();
+    for (uint32_t lod = 0; lod < lodCount; ++lod) {
+        const uint32_t step = 1u << lod;
+
+        // Nothing is coarser than the last level, so its one range serves every mask
+        const uint32_t maskCount = (lod + 1 < lodCount) ? static_cast<uint32_t>(EdgeMaskCount) : 1u;
+        for (uint32_t mask = 0; mask < maskCount; ++mask) {
+            // On an edge next to a coarser chunk, odd vertices fold onto the even one before them
+            auto vertex = [=](uint32_t x, uint32_t z) {
+                if ((((mask & WestEdge) && x == 0) || ((mask & EastEdge) && x == quads)) && ((z / step) & 1)) {
+                    z -= step;
+                }
+                if ((((mask & SouthEdge) && z == 0) || ((mask & NorthEdge) && z == quads)) && ((x / step) & 1)) {
+                    x -= step;
+                }
+                return static_cast<uint16_t>(z * rowLength + x);
+            };
+
+            IndexRange& range = indexRanges[lod][mask];
+            range.firstIndex = static_cast<uint32_t>(indices.size());
+            for (uint32_t z = 0; z < quads; z += step) {
+                for (uint32_t x = 0; x < quads; x += step) {
+                    // Clockwise seen from above, split along the cell's diagonal; folded triangles collapse and are left out
+                    const uint16_t corners[4] = { vertex(x, z), vertex(x, z + step), vertex(x + step, z + step), vertex(x + step, z) };
+                    const uint16_t triangles[2][3] = { { corners[0], corners[1], corners[2] }, { corners[0], corners[2], corners[3] } };
+                    for (const uint16_t* triangle : triangles) {
+                        if (triangle[0] != triangle[1] && triangle[1] != triangle[2] && triangle[0] != triangle[2]) {
+                            indices.insert(indices.end(), triangle, triangle + 3);
+                        }
+                    }
+                }
+            }
+            range.indexCount = static_cast<uint32_t>(indices.size()) - range.firstIndex;
+        }
+        std::fill(indexRanges[lod] + maskCount, indexRanges[lod] + EdgeMaskCount, indexRanges[lod][0]);
+    }
+}
+
+void Terrain::GenerateChunk(Staging& buffer) const {
+    BOG_PROFILE_ZONE("Terrain::GenerateChunk");
+    const uint32_t quads = desc.chunkQuads;
+    const uint32_t rowLength = quads + 1;
+    const uint32_t firstX = (buffer.chunk % chunksX) * quads;
+    const uint32_t firstZ = (buffer.chunk / chunksX) * quads;
+    const uint32_t lastSampleX = heightmap->GetWidth() - 1;
+    const uint32_t lastSampleZ = heightmap->GetDepth() - 1;
+    const float spacing = heightmap->GetSpacing();
+    const float heightRange = std::max(heightmap->GetMaxHeight() - heightmap->GetMinHeight(), FLT_EPSILON);
+
+    buffer.minHeight = FLT_MAX;
+    buffer.maxHeight = -FLT_MAX;
+    for (uint32_t z = 0; z <= quads; ++z) {
+        for (uint32_t x = 0; x <= quads; ++x) {
+            uint32_t sampleX = firstX + x;
+            uint32_t sampleZ = firstZ + z;
+            float height = heightmap->GetSample(sampleX, sampleZ);
+            buffer.minHeight = std::min(buffer.minHeight, height);
+            buffer.maxHeight = std::max(buffer.maxHeight, height);
+
+            // Steep ground is darker; slopes come from the map, so chunk edges agree
+            float slopeX = heightmap->GetSample(std::min(sampleX + 1, lastSampleX), sampleZ) - heightmap->GetSample(sampleX ? sampleX - 1 : 0, sampleZ);
+            float slopeZ = heightmap->GetSample(sampleX, std::min(sampleZ + 1, lastSampleZ)) - heightmap->GetSample(sampleX, sampleZ ? sampleZ - 1 : 0);
+            float light = 0.4f + 0.6f * 2.0f * spacing / std::sqrt(slopeX * slopeX + slopeZ * slopeZ + 4.0f * spacing * spacing);
+            float altitude = (height - heightmap->GetMinHeight()) / heightRange;
+
+            Mesh::Vertex& vertex = buffer.vertices[z * rowLength + x];
+            vertex = { x * spacing, height, z * spacing,
+                (0.3f + 0.4f * altitude) * light, (0.5f - 0.1f * altitude) * light, (0.2f + 0.3f * altitude) * light };
+        }
+    }
+
+    // Height error of each level: how far the full grid strays from the
+    // coarse triangles drawn over it, never less than the finer levels'
+    buffer.lodErrors[0] = 0.0f;
+    for (uint32_t lod = 1; lod < lodCount; ++lod) {
+        const uint32_t step = 1u << lod;
+        float error = buffer.lodErrors[lod - 1];
+        for (uint32_t z = 0; z <= quads; ++z) {
+            for (uint32_t x = 0; x <= quads; ++x) {
+                uint32_t x0 = std::min(x / step * step, quads - step);
+                uint32_t z0 = std::min(z / step * step, quads - step);
+                float u = static_cast<float>(x - x0) / step;
+                float v = static_cast<float>(z - z0) / step;
+
+                float h00 = buffer.vertices[z0 * rowLength + x0].y;
+                float h11 = buffer.vertices[(z0 + step) * rowLength + x0 + step].y;
+                float coarse;
+                if (u >= v) {
+                    float h10 = buffer.vertices[z0 * rowLength + x0 + step].y;
+                    coarse = h00 + (h10 - h00) * u + (h11 - h10) * v;
+                }
+                else {
+                    float h01 = buffer.vertices[(z0 + step) * rowLength + x0].y;
+                    coarse = h00 + (h01 - h00) * v + (h11 - h01) * u;
+                }
+                error = std::max(error, std::fabs(buffer.vertices[z * rowLength + x].y - coarse));
+            }
+        }
+        buffer.lodErrors[lod] = error;
+    }
+
+    Mesh::EncodeVertices(buffer.vertices.data(), GetVertexCount(), positionRange, buffer.encoded);
+}
+
+void Terrain::GenerateNextChunk() {
+    MemoryTagScope tag(MemoryTag::Terrain);
+    Staging* buffer = nullptr;
+    {
+        // The earliest request is the nearest one. There is a job for every
+        // request, so one whose request was dropped finds nothing to do.
+        std::lock_guard<std::mutex> lock(mutex);
+        for (Staging& queued : staging) {
+            if (queued.state == StagingState::Queued && (!buffer || queued.sequence < buffer->sequence)) {
+                buffer = &queued;
+            }
+        }
+        if (!buffer) {
+            return;
+        }
+        buffer->state = StagingState::Generating;
+    }
+
+    // Generation happens outside the lock
+    auto start = std::chrono::steady_clock::now();
+    GenerateChunk(*buffer);
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    buffer->state = StagingState::Ready;
+    ++stats.generated;
+    stats.generationMilliseconds += elapsed.count();
+}
+
+void Terrain::Update(const XMFLOAT3& cameraPosition) {
+    if (chunks.empty()) {
+        return;
+    }
+
+    BOG_PROFILE_ZONE("Terrain::Update");
+    UploadChunks();
+
+    // Chunks stay until they are a chunk past the load distance, so one on the
+    // boundary does not come and go as the camera moves along it
+    float evictDistance = desc.loadDistance + chunkSize;
+    for (size_t i = 0; i < residentChunks.size(); ) {
+        if (GetChunkDistance(residentChunks[i], cameraPosition) > evictDistance) {
+            EvictChunk(residentChunks[i]);
+        }
+        else {
+            ++i;
+        }
+    }
+
+    // Pending chunks that fell out of range are dropped; ones already being
+    // generated are dropped when they finish
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (Staging& buffer : staging) {
+            bool pending = buffer.state == StagingState::Queued || buffer.state == StagingState::Generating;
+            if (!pending || buffer.cancelled || GetChunkDistance(buffer.chunk, cameraPosition) <= evictDistance) {
+                continue;
+            }
+
+            if (buffer.state == StagingState::Queued) {
+                Chunk& chunk = chunks[buffer.chunk];
+                chunk.state = ChunkState::Unloaded;
+                freeSlots.push_back(chunk.slot);
+                buffer.state = StagingState::Free;
+                ++stats.cancelled;
+            }
+            else {
+                buffer.cancelled = true;
+            }
+        }
+    }
+
+    RequestChunks(cameraPosition);
+}
+
+void Terrain::UploadChunks() {
+    readyStaging.clear();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (uint32_t index = 0; index < staging.size(); ++index) {
+            if (staging[index].state == StagingState::Ready) {
+                readyStaging.push_back(index);
+            }
+        }
+    }
+
+    // Nearest first, as they were requested
+    std::sort(readyStaging.begin(), readyStaging.end(), [this](uint32_t a, uint32_t b) {
+        return staging[a].sequence < staging[b].sequence;
+    });
+
+    // Jobs leave ready buffers alone, so they are read without the lock
+    uint32_t uploads = 0;
+    for (uint32_t index : readyStaging) {
+        Staging& buffer = staging[index];
+        Chunk& chunk = chunks[buffer.chunk];
+        if (buffer.cancelled) {
+            chunk.state = ChunkState::Unloaded;
+            freeSlots.push_back(chunk.slot);
+            ++stats.cancelled;
+        }
+        else if (uploads == desc.maxUploadsPerFrame) {
+            continue;
+        }
+        else if (backend->WriteBuffer(vertexBuffer, chunk.slot * chunkBytes, buffer.encoded.data(), chunkBytes)) {
+            chunk.state = ChunkState::Resident;
+            chunk.lod = 0;
+            chunk.minHeight = buffer.minHeight;
+            chunk.maxHeight = buffer.maxHeight;
+            std::copy(buffer.lodErrors, buffer.lodErrors + MaxLods, chunk.lodErrors);
+            chunk.residentIndex = static_cast<uint32_t>(residentChunks.size());
+            residentChunks.push_back(buffer.chunk);
+            ++uploads;
+        }
+        else {
+            LogMessage("Failed to upload terrain chunk %u\n", buffer.chunk);
+            chunk.state = ChunkState::Unloaded;
+            freeSlots.push_back(chunk.slot);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        buffer.state = StagingState::Free;
+        buffer.cancelled = false;
+    }
+
+    stats.residentBytes = uint64_t(residentChunks.size()) * chunkBytes;
+    stats.peakResidentBytes = std::max(stats.peakResidentBytes, stats.residentBytes);
+}
+
+void Terrain::EvictChunk(uint32_t index) {
+    Chunk& chunk = chunks[index];
+    chunk.state = ChunkState::Unloaded;
+    freeSlots.push_back(chunk.slot);
+
+    // Queued frames may still draw the slot; later writes to it are ordered after them
+    uint32_t moved = residentChunks.back();
+    residentChunks[chunk.residentIndex] = moved;
+    chunks[moved].residentIndex = chunk.residentIndex;
+    residentChunks.pop_back();
+    stats.residentBytes = uint64_t(residentChunks.size()) * chunkBytes;
+    ++stats.evicted;
+}
+
+void Terrain::RequestChunks(const XMFLOAT3& cameraPosition) {
+    // Missing chunks in range, nearest first
+    auto chunkAt = [this](float position) { return static_cast<int32_t>(std::floor(position / chunkSize)); };
+    int32_t beginX = std::max(chunkAt(cameraPosition.x - origin.x - desc.loadDistance), 0);
+    int32_t endX = std::min(chunkAt(cameraPosition.x - origin.x + desc.loadDistance) + 1, static_cast<int32_t>(chunksX));
+    int32_t beginZ = std::max(chunkAt(cameraPosition.z - origin.z - desc.loadDistance), 0);
+    int32_t endZ = std::min(chunkAt(cameraPosition.z - origin.z + desc.loadDistance) + 1, static_cast<int32_t>(chunksZ));
+
+    candidates.clear();
+    for (int32_t z = beginZ; z < endZ; ++z) {
+        for (int32_t x = beginX; x < endX; ++x) {
+            uint32_t index = static_cast<uint32_t>(z) * chunksX + static_cast<uint32_t>(x);
+            if (chunks[index].state != ChunkState::Unloaded) {
+                continue;
+            }
+            float distance = GetChunkDistance(index, cameraPosition);
+            if (distance <= desc.loadDistance) {
+                candidates.push_back(Candidate{ distance, index });
+            }
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+        return a.distance < b.distance;
+    });
+
+    uint32_t requested = 0;
+    uint32_t pending = 0;
+    size_t nextEviction = 0;
+    evictionOrder.clear();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t nextStaging = 0;
+        for (const Candidate& candidate : candidates) {
+            while (nextStaging < staging.size() && staging[nextStaging].state != StagingState::Free) {
+                ++nextStaging;
+            }
+            if (nextStaging == staging.size()) {
+                break;
+            }
+
+            // With the budget spent, a nearer chunk takes the furthest one's
+            // slot. Resident chunks are sorted once, the first time it is.
+            if (freeSlots.empty()) {
+                if (evictionOrder.empty()) {
+                    for (uint32_t resident : residentChunks) {
+                        evictionOrder.push_back(Candidate{ GetChunkDistance(resident, cameraPosition), resident });
+                    }
+                    std::sort(evictionOrder.begin(), evictionOrder.end(), [](const Candidate& a, const Candidate& b) {
+                        return a.distance > b.distance;
+                    });
+                }
+                if (nextEviction == evictionOrder.size() || evictionOrder[nextEviction].distance <= candidate.distance) {
+                    break;
+                }
+                EvictChunk(evictionOrder[nextEviction++].chunk);
+            }
+
+            Staging& buffer = staging[nextStaging];
+            Chunk& chunk = chunks[candidate.chunk];
+            chunk.state = ChunkState::Pending;
+            chunk.slot = freeSlots.back();
+            freeSlots.pop_back();
+
+            buffer.state = StagingState::Queued;
+            buffer.cancelled = false;
+            buffer.chunk = candidate.chunk;
+            buffer.sequence = nextSequence++;
+            ++requested;
+        }
+
+        for (const Staging& buffer : staging) {
+            pending += (buffer.state != StagingState::Free) ? 1 : 0;
+        }
+    }
+
+    // Queued outside the lock, which a job run inline would take. Without
+    // workers to pick the jobs up, the chunks are generated right here.
+    for (uint32_t i = 0; i < requested; ++i) {
+        if (jobs && jobs->GetThreadCount() > 1) {
+            jobs->Run([this] { GenerateNextChunk(); }, &generating);
+        }
+        else {
+            GenerateNextChunk();
+        }
+    }
+
+    // Whatever is still missing once nothing is pending does not fit the budget
+    streaming = pending > 0;
+}
+
+float Terrain::GetChunkDistance(uint32_t chunk, const XMFLOAT3& position) const {
+    float minX = origin.x + (chunk % chunksX) * chunkSize;
+    float minZ = origin.z + (chunk / chunksX) * chunkSize;
+    float dx = std::max(std::max(minX - position.x, position.x - (minX + chunkSize)), 0.0f);
+    float dz = std::max(std::max(minZ - position.z, position.z - (minZ + chunkSize)), 0.0f);
+    return std::sqrt(dx * dx + dz * dz);
+}
+
+void Terrain::Draw(const Frustum& frustum, const XMMATRIX& viewProjMatrix, const Mesh::LodView& view) {
+    BOG_PROFILE_ZONE("Terrain::Draw");
+    stats.drawnChunks = 0;
+    stats.drawnTriangles = 0;
+    std::fill(stats.drawnLods, stats.drawnLods + MaxLods, 0u);
+    if (residentChunks.empty()) {
+        return;
+    }
+
+    auto getBounds = [this](uint32_t index, float boxMin[3], float boxMax[3]) {
+        const Chunk& chunk = chunks[index];
+        boxMin[0] = origin.x + (index % chunksX) * chunkSize;
+        boxMin[1] = origin.y + chunk.minHeight;
+        boxMin[2] = origin.z + (index / chunksX) * chunkSize;
+        boxMax[0] = boxMin[0] + chunkSize;
+        boxMax[1] = origin.y + chunk.maxHeight;
+        boxMax[2] = boxMin[2] + chunkSize;
+    };
+
+    // The coarsest level whose height error projects to less than the pixel
+    // limit, measured from the nearest point of the chunk like Mesh::SelectLod
+    for (uint32_t index : residentChunks) {
+        Chunk& chunk = chunks[index];
+        float boxMin[3], boxMax[3];
+        getBounds(index, boxMin, boxMax);
+        const float eye[3] = { view.cameraPosition.x, view.cameraPosition.y, view.cameraPosition.z };
+        float distanceSquared = 0.0f;
+        for (int axis = 0; axis < 3; ++axis) {
+            float outside = std::max(std::max(boxMin[axis] - eye[axis], eye[axis] - boxMax[axis]), 0.0f);
+            distanceSquared += outside * outside;
+        }
+
+        float distance = std::sqrt(distanceSquared);
+        chunk.lod = 0;
+        for (uint32_t lod = lodCount - 1; lod > 0 && distance > 0.0f; --lod) {
+            if (chunk.lodErrors[lod] * view.pixelsPerUnit / distance <= view.maxPixelError) {
+                chunk.lod = static_cast<uint8_t>(lod);
+                break;
+            }
+        }
+    }
+
+    // Resident neighbours, null past the map's edges and for missing chunks
+    auto getNeighbour = [this](uint32_t index, int32_t dx, int32_t dz) -> const Chunk* {
+        int32_t x = static_cast<int32_t>(index % chunksX) + dx;
+        int32_t z = static_cast<int32_t>(index / chunksX) + dz;
+        if (x < 0 || z < 0 || x >= static_cast<int32_t>(chunksX) || z >= static_cast<int32_t>(chunksZ)) {
+            return nullptr;
+        }
+        const Chunk& neighbour = chunks[static_cast<uint32_t>(z) * chunksX + static_cast<uint32_t>(x)];
+        return (neighbour.state == ChunkState::Resident) ? &neighbour : nullptr;
+    };
+    const int32_t edgeOffsets[4][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };     // West, east, south, north
+
+    // Folded edges only meet a neighbour one level coarser, so finer chunks
+    // pull their neighbours down until no two differ by more than one level.
+    // Levels only drop, so this settles.
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (uint32_t index : residentChunks) {
+            Chunk& chunk = chunks[index];
+            for (const int32_t* offset : edgeOffsets) {
+                const Chunk* neighbour = getNeighbour(index, offset[0], offset[1]);
+                if (neighbour && chunk.lod > neighbour->lod + 1) {
+                    chunk.lod = static_cast<uint8_t>(neighbour->lod + 1);
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    // Every chunk draws from the same two buffers
+    backend->SetVertexBuffer(0, vertexBuffer, Mesh::GetVertexFormat().GetStride());
+    backend->SetIndexBuffer(indexBuffer, IndexFormat::UInt16);
+
+    for (uint32_t index : residentChunks) {
+        const Chunk& chunk = chunks[index];
+        float boxMin[3], boxMax[3];
+        getBounds(index, boxMin, boxMax);
+        if (FrustumCulling::TestAabb(frustum, boxMin, boxMax) == FrustumTest::Outside) {
+            continue;
+        }
+
+        uint32_t mask = 0;
+        for (uint32_t edge = 0; edge < 4; ++edge) {
+            const Chunk* neighbour = getNeighbour(index, edgeOffsets[edge][0], edgeOffsets[edge][1]);
+            if (neighbour && neighbour->lod > chunk.lod) {
+                mask |= 1u << edge;
+            }
+        }
+
+        ChunkConstants constants;
+        XMMATRIX world = positionTransform * XMMatrixTranslation(boxMin[0], origin.y, boxMin[2]);
+        constants.worldViewProj = XMMatrixTranspose(world * viewProjMatrix);
+        constants.world = XMMatrixTranspose(world);
+        if (!backend->SetVSConstants(&constants, sizeof(constants))) {
+            return;
+        }
+
+        const IndexRange& range = indexRanges[chunk.lod][mask];
+        backend->DrawIndexed(range.indexCount, range.firstIndex, static_cast<int32_t>(chunk.slot * GetVertexCount()));
+        ++stats.drawnChunks;
+        stats.drawnTriangles += range.indexCount / 3;
+        ++stats.drawnLods[chunk.lod];
+    }
+}
+
+float Terrain::GetHeight(float x, float z) const {
+    if (!heightmap) {
+        return origin.y;
+    }
+    return origin.y + heightmap->GetHeight(x - origin.x, z - origin.z);
+}
+
+int32_t Terrain::GetChunkLod(uint32_t chunkX, uint32_t chunkZ) const {
+    if (chunkX >= chunksX || chunkZ >= chunksZ) {
+        return -1;
+    }
+    const Chunk& chunk = chunks[chunkZ * chunksX + chunkX];
+    return (chunk.state == ChunkState::Resident) ? chunk.lod : -1;
+}
+
+Terrain::Stats Terrain::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats current = stats;
+    current.residentChunks = static_cast<uint32_t>(residentChunks.size());
+    current.pendingChunks = 0;
+    for (const Staging& buffer : staging) {
+        current.pendingChunks += (buffer.state != StagingState::Free) ? 1 : 0;
+    }
+    return current;
+}
+
+void Terrain::LogStats() const {
+    Stats current = GetStats();
+    LogMessage("Terrain: %u of %u chunks resident (%u pending, room for %u), %llu of %llu vertex bytes (%llu at most), "
+        "%llu generated in %.3f ms each, %llu evicted, %llu dropped; drew %u chunks (%llu triangles)\n",
+        current.residentChunks, current.chunks, current.pendingChunks, current.chunkCapacity,
+        static_cast<unsigned long long>(current.residentBytes), static_cast<unsigned long long>(current.vertexBufferBytes),
+        static_cast<unsigned long long>(current.peakResidentBytes), static_cast<unsigned long long>(current.generated),
+        current.generated ? current.generationMilliseconds / current.generated : 0.0,
+        static_cast<unsigned long long>(current.evicted), static_cast<unsigned long long>(current.cancelled),
+        current.drawnChunks, static_cast<unsigned long long>(current.drawnTriangles));
+}
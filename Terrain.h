@@ -0,0 +1,207 @@
+// Terrain.h
+
+#pragma once
+#include <DirectXMath.h>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include "FrustumCulling.h"
+#include "Heightmap.h"
+#include "JobSystem.h"
+#include "Mesh.h"
+#include "RenderBackend.h"
+
+// Ground drawn from a heightmap as a grid of square chunks with geomipmapped
+// levels of detail. Every chunk has a vertex per heightmap sample it covers;
+// level l draws every 2^l-th of them. Chunks pick the coarsest level whose
+// height error stays under the pixel limit, and neighbours never differ by
+// more than one level. Where a neighbour is coarser, the odd vertices along
+// the shared edge fold onto the even ones, so the edges match without cracks.
+//
+// Every chunk has the same grid, so the index ranges for each level and
+// combination of coarser neighbours are built once and shared, and all chunks
+// live in fixed slots of one vertex buffer sized by the memory budget. Drawing
+// another chunk only changes the base vertex.
+//
+// Chunks within the load distance of the camera are generated as jobs,
+// nearest first, and uploaded on the main thread. Chunks that fall
+// out of range are evicted, as are the furthest ones when a nearer chunk needs
+// a slot and the budget is spent.
+class Terrain {
+public:
+    // Levels of a 128-quad chunk
+    static const uint32_t MaxLods = 8;
+
+    struct Desc {
+        uint32_t chunkQuads;        // Quads along a chunk side, a power of two from 2 to 128
+        float loadDistance;         // Chunks closer than this to the camera are loaded
+        uint64_t memoryBudget;      // Vertex bytes of resident chunks
+        uint32_t maxPendingChunks;  // Chunks generating or waiting for upload at once
+        uint32_t maxUploadsPerFrame;
+    };
+
+    struct Stats {
+        uint32_t chunks;            // In the whole grid
+        uint32_t chunkCapacity;     // Resident chunks the budget holds
+        uint32_t residentChunks;
+        uint32_t pendingChunks;
+        uint64_t residentBytes;     // Vertex bytes of resident chunks
+        uint64_t peakResidentBytes;
+        uint64_t vertexBufferBytes;
+        uint64_t indexBytes;        // Shared index ranges
+        uint64_t stagingBytes;      // CPU copies of generated chunks waiting for upload
+        uint64_t generated;         // Since Initialize, like the two below
+        uint64_t evicted;
+        uint64_t cancelled;         // Dropped before their upload
+        double generationMilliseconds;  // Summed over the jobs
+        uint32_t drawnChunks;           // By the last Draw
+        uint64_t drawnTriangles;
+        uint32_t drawnLods[MaxLods];    // Drawn chunks per level
+    };
+
+    static Desc GetDefaultDesc();
+
+    Terrain();
+    ~Terrain();
+
+    Terrain(const Terrain&) = delete;
+    Terrain& operator=(const Terrain&) = delete;
+
+    // The backend, job system and heightmap must outlive the terrain. Without
+    // a job system, or one without workers, chunks generate inside Update.
+    // The heightmap's corner sits at origin; samples past the last whole chunk
+    // are not drawn.
+    bool Initialize(RenderBackend* backend, JobSystem* jobs, const Heightmap* heightmap, const Desc& desc,
+        const DirectX::XMFLOAT3& origin);
+
+    // Waits for the generation jobs and destroys the buffers
+    void Shutdown();
+
+    // Main thread, once per frame: uploads generated chunks, evicts the ones
+    // out of range and queues the nearest missing ones
+    void Update(const DirectX::XMFLOAT3& cameraPosition);
+
+    // Draws the resident chunks inside the frustum. Expects a pipeline reading
+    // Mesh::GetVertexFormat() to be bound.
+    void Draw(const Frustum& frustum, const DirectX::XMMATRIX& viewProjMatrix, const Mesh::LodView& view);
+
+    // True until every chunk in range the budget has room for is resident
+    bool IsStreaming() const { return streaming; }
+
+    // Ground height under a world position, for walking on
+    float GetHeight(float x, float z) const;
+
+    // Level the chunk was last drawn at, -1 when it is not resident
+    int32_t GetChunkLod(uint32_t chunkX, uint32_t chunkZ) const;
+    uint32_t GetChunksX() const { return chunksX; }
+    uint32_t GetChunksZ() const { return chunksZ; }
+
+    Stats GetStats() const;
+    void LogStats() const;
+
+private:
+    // Sides of a chunk, as bits of the mask of coarser neighbours
+    enum Edge : uint32_t {
+        WestEdge = 1,       // -X
+        EastEdge = 2,       // +X
+        SouthEdge = 4,      // -Z
+        NorthEdge = 8,      // +Z
+        EdgeMaskCount = 16
+    };
+
+    enum class ChunkState : uint8_t {
+        Unloaded,
+        Pending,            // Has a staging buffer and a vertex slot
+        Resident
+    };
+
+    struct Chunk {
+        ChunkState state;
+        uint8_t lod;
+        uint32_t slot;              // Vertex slot while pending or resident
+        uint32_t residentIndex;     // Position in residentChunks while resident
+        float minHeight;
+        float maxHeight;
+        float lodErrors[MaxLods];   // Largest height difference to the full grid, per level
+    };
+
+    enum class StagingState : uint8_t {
+        Free,
+        Queued,
+        Generating,
+        Ready
+    };
+
+    // A chunk generated by a job, waiting for its upload
+    struct Staging {
+        StagingState state;
+        bool cancelled;             // Its chunk fell out of range while it was generating
+        uint32_t chunk;
+        uint64_t sequence;          // Lower ones were requested first and are nearer
+        float minHeight;
+        float maxHeight;
+        float lodErrors[MaxLods];
+        std::vector<Mesh::Vertex> vertices;
+        std::vector<unsigned char> encoded;
+    };
+
+    struct IndexRange {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+    };
+
+    struct Candidate {
+        float distance;
+        uint32_t chunk;
+    };
+
+    void BuildIndexRanges(std::vector<uint16_t>& indices);
+    void GenerateChunk(Staging& buffer) const;
+
+    // Generates the earliest queued chunk, if any are left
+    void GenerateNextChunk();
+
+    void UploadChunks();
+    void EvictChunk(uint32_t chunk);
+    void RequestChunks(const DirectX::XMFLOAT3& cameraPosition);
+
+    // Horizontal distance from a position to a chunk's square
+    float GetChunkDistance(uint32_t chunk, const DirectX::XMFLOAT3& position) const;
+    uint32_t GetVertexCount() const { return (desc.chunkQuads + 1) * (desc.chunkQuads + 1); }
+
+    RenderBackend* backend;
+    JobSystem* jobs;
+    const Heightmap* heightmap;
+    Desc desc;
+    DirectX::XMFLOAT3 origin;
+    float chunkSize;
+    uint32_t lodCount;
+    uint32_t chunksX;
+    uint32_t chunksZ;
+
+    // Chunk vertices are quantized to one range, so every chunk shares the transform
+    VertexQuantization::PositionRange positionRange;
+    DirectX::XMMATRIX positionTransform;
+
+    BufferHandle vertexBuffer;
+    BufferHandle indexBuffer;
+    uint32_t chunkBytes;
+    IndexRange indexRanges[MaxLods][EdgeMaskCount];
+
+    // Main thread state
+    std::vector<Chunk> chunks;
+    std::vector<uint32_t> residentChunks;
+    std::vector<uint32_t> freeSlots;
+    std::vector<Candidate> candidates;
+    std::vector<Candidate> evictionOrder;   // Resident chunks, furthest first
+    std::vector<uint32_t> readyStaging;
+    uint64_t nextSequence;
+    bool streaming;
+
+    // Shared with the generation jobs, which the counter tracks
+    mutable std::mutex mutex;
+    std::vector<Staging> staging;
+    JobCounter generating;
+
+    Stats stats;
+};
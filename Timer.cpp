@@ -13,3 +13,8 @@ float Timer::GetElapsedTime() const {
     std::chrono::duration<float> elapsedTime = currentTime - lastTime;
     return elapsedTime.count();
 }
+
+double Timer::GetElapsedSeconds() const {
+    std::chrono::duration<double> elapsedTime = std::chrono::steady_clock::now() - lastTime;
+    return elapsedTime.count();
+}
@@ -9,6 +9,7 @@ public:
 
     void Reset();                   // Resets the timer to the current time
     float GetElapsedTime() const;   // Returns the elapsed time in seconds since the last reset
+    double GetElapsedSeconds() const;   // Same in double precision, which stays exact over long runs
 
 private:
     std::chrono::steady_clock::time_point lastTime;
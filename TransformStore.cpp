@@ -0,0 +1,282 @@
+// TransformStore.cpp
+
+#include "TransformStore.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define BOG_TRANSFORM_SSE2 1
+#include <emmintrin.h>
+#endif
+
+using namespace DirectX;
+
+namespace {
+
+    const XMFLOAT4X4 IdentityMatrix(1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+
+    uint32_t CountBits(uint64_t bits) {
+        bits = bits - ((bits >> 1) & 0x5555555555555555ull);
+        bits = (bits & 0x3333333333333333ull) + ((bits >> 2) & 0x3333333333333333ull);
+        bits = (bits + (bits >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+        return static_cast<uint32_t>((bits * 0x0101010101010101ull) >> 56);
+    }
+
+    // One bit per group of four with any bit set
+    uint64_t GroupBits(uint64_t bits) {
+        bits |= bits >> 1;
+        bits |= bits >> 2;
+        return bits & 0x1111111111111111ull;
+    }
+
+}
+
+TransformStore::TransformStore()
+    : count(0), stats()
+{
+}
+
+TransformId TransformStore::Create(TransformId parent) {
+    if (parent == InvalidTransform && !freeIds.empty()) {
+        TransformId id = freeIds.back();
+        freeIds.pop_back();
+        MarkDirty(id);
+        return id;
+    }
+
+    TransformId id = count++;
+
+    // Grow by whole groups so the SIMD pass never reads past the end
+    size_t padded = (static_cast<size_t>(count) + 3) & ~size_t(3);
+    if (positionX.size() < padded) {
+        positionX.resize(padded, 0.0f); positionY.resize(padded, 0.0f); positionZ.resize(padded, 0.0f);
+        rotationX.resize(padded, 0.0f); rotationY.resize(padded, 0.0f); rotationZ.resize(padded, 0.0f);
+        rotationW.resize(padded, 1.0f);
+        scaleX.resize(padded, 1.0f); scaleY.resize(padded, 1.0f); scaleZ.resize(padded, 1.0f);
+        parents.resize(padded, InvalidTransform);
+        worldMatrices.resize(padded, IdentityMatrix);
+        dirtyBits.resize((padded + 63) / 64, 0);
+        changedBits.resize((padded + 63) / 64, 0);
+    }
+
+    // The new id is the largest, so the child list stays sorted
+    parents[id] = parent;
+    if (parent != InvalidTransform) {
+        children.push_back(id);
+    }
+    MarkDirty(id);
+    return id;
+}
+
+void TransformStore::Destroy(TransformId id) {
+    // Orphan the children; their world matrices lose the parent's transform
+    auto orphans = std::remove_if(children.begin(), children.end(), [this, id](TransformId child) {
+        if (parents[child] != id) {
+            return false;
+        }
+        parents[child] = InvalidTransform;
+        MarkDirty(child);
+        return true;
+    });
+    children.erase(orphans, children.end());
+    SetParent(id, InvalidTransform);
+
+    positionX[id] = positionY[id] = positionZ[id] = 0.0f;
+    rotationX[id] = rotationY[id] = rotationZ[id] = 0.0f;
+    rotationW[id] = 1.0f;
+    scaleX[id] = scaleY[id] = scaleZ[id] = 1.0f;
+    worldMatrices[id] = IdentityMatrix;
+
+    uint64_t bit = uint64_t(1) << (id % 64);
+    dirtyBits[id / 64] &= ~bit;
+    changedBits[id / 64] &= ~bit;
+    freeIds.push_back(id);
+}
+
+bool TransformStore::SetParent(TransformId id, TransformId parent) {
+    if (parent != InvalidTransform && parent >= id) {
+        return false;
+    }
+
+    auto position = std::lower_bound(children.begin(), children.end(), id);
+    bool listed = position != children.end() && *position == id;
+    if (parent == InvalidTransform && listed) {
+        children.erase(position);
+    }
+    else if (parent != InvalidTransform && !listed) {
+        children.insert(position, id);
+    }
+
+    parents[id] = parent;
+    MarkDirty(id);
+    return true;
+}
+
+void TransformStore::SetPosition(TransformId id, float x, float y, float z) {
+    positionX[id] = x;
+    positionY[id] = y;
+    positionZ[id] = z;
+    MarkDirty(id);
+}
+
+void TransformStore::SetRotation(TransformId id, float pitch, float yaw, float roll) {
+    XMFLOAT4 quaternion;
+    XMStoreFloat4(&quaternion, XMQuaternionRotationRollPitchYaw(pitch, yaw, roll));
+    SetRotation(id, quaternion);
+}
+
+void TransformStore::SetRotation(TransformId id, const XMFLOAT4& quaternion) {
+    XMFLOAT4 normalized;
+    XMStoreFloat4(&normalized, XMQuaternionNormalize(XMLoadFloat4(&quaternion)));
+    rotationX[id] = normalized.x;
+    rotationY[id] = normalized.y;
+    rotationZ[id] = normalized.z;
+    rotationW[id] = normalized.w;
+    MarkDirty(id);
+}
+
+void TransformStore::SetScale(TransformId id, float x, float y, float z) {
+    scaleX[id] = x;
+    scaleY[id] = y;
+    scaleZ[id] = z;
+    MarkDirty(id);
+}
+
+void TransformStore::UpdateWorldMatrices(JobSystem* jobs) {
+    // A parent always comes first in the child list, so one pass also reaches grandchildren
+    for (TransformId child : children) {
+        TransformId parent = parents[child];
+        if ((dirtyBits[parent / 64] >> (parent % 64)) & 1) {
+            MarkDirty(child);
+        }
+    }
+
+    stats.dirty = 0;
+    stats.composed = 0;
+    for (uint64_t bits : dirtyBits) {
+        stats.dirty += CountBits(bits);
+        stats.composed += CountBits(GroupBits(bits)) * 4;
+    }
+
+    // Local matrices first; groups are independent, so they can go wide
+    if (jobs) {
+        jobs->ParallelFor(dirtyBits.size(), 16, [this](size_t begin, size_t end) {
+            ComposeWords(begin, end);
+        });
+    }
+    else {
+        ComposeWords(0, dirtyBits.size());
+    }
+
+    // Then every parented transform in a rebuilt group gets its parent's world
+    // matrix, in id order so the parent is always final
+    for (TransformId child : children) {
+        if (IsGroupDirty(child)) {
+            const XMFLOAT4X4& parentWorld = worldMatrices[parents[child]];
+            XMStoreFloat4x4(&worldMatrices[child],
+                XMMatrixMultiply(XMLoadFloat4x4(&worldMatrices[child]), XMLoadFloat4x4(&parentWorld)));
+        }
+    }
+
+    changedBits.swap(dirtyBits);
+    std::fill(dirtyBits.begin(), dirtyBits.end(), 0);
+}
+
+void TransformStore::UpdateWorldMatrix(TransformId id) {
+    ComposeLocal(id, worldMatrices[id]);
+
+    TransformId parent = parents[id];
+    if (parent != InvalidTransform) {
+        XMStoreFloat4x4(&worldMatrices[id],
+            XMMatrixMultiply(XMLoadFloat4x4(&worldMatrices[id]), XMLoadFloat4x4(&worldMatrices[parent])));
+    }
+}
+
+void TransformStore::ComposeWords(size_t begin, size_t end) {
+    for (size_t word = begin; word < end; ++word) {
+        uint64_t bits = dirtyBits[word];
+        for (uint32_t group = 0; bits != 0; ++group, bits >>= 4) {
+            if (bits & 0xF) {
+                ComposeGroup(static_cast<TransformId>(word * 64 + group * 4));
+            }
+        }
+    }
+}
+
+void TransformStore::ComposeGroup(TransformId first) {
+#ifdef BOG_TRANSFORM_SSE2
+    // Same terms as XMMatrixRotationQuaternion, one transform per lane
+    __m128 x = _mm_loadu_ps(&rotationX[first]);
+    __m128 y = _mm_loadu_ps(&rotationY[first]);
+    __m128 z = _mm_loadu_ps(&rotationZ[first]);
+    __m128 w = _mm_loadu_ps(&rotationW[first]);
+    __m128 x2 = _mm_add_ps(x, x);
+    __m128 y2 = _mm_add_ps(y, y);
+    __m128 z2 = _mm_add_ps(z, z);
+    __m128 xx = _mm_mul_ps(x, x2), yy = _mm_mul_ps(y, y2), zz = _mm_mul_ps(z, z2);
+    __m128 xy = _mm_mul_ps(x, y2), xz = _mm_mul_ps(x, z2), yz = _mm_mul_ps(y, z2);
+    __m128 wx = _mm_mul_ps(w, x2), wy = _mm_mul_ps(w, y2), wz = _mm_mul_ps(w, z2);
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    // Scale is applied first, so it scales the rotation rows
+    __m128 sx = _mm_loadu_ps(&scaleX[first]);
+    __m128 sy = _mm_loadu_ps(&scaleY[first]);
+    __m128 sz = _mm_loadu_ps(&scaleZ[first]);
+    __m128 row0[4] = {
+        _mm_mul_ps(sx, _mm_sub_ps(one, _mm_add_ps(yy, zz))),
+        _mm_mul_ps(sx, _mm_add_ps(xy, wz)),
+        _mm_mul_ps(sx, _mm_sub_ps(xz, wy)),
+        _mm_setzero_ps()
+    };
+    __m128 row1[4] = {
+        _mm_mul_ps(sy, _mm_sub_ps(xy, wz)),
+        _mm_mul_ps(sy, _mm_sub_ps(one, _mm_add_ps(xx, zz))),
+        _mm_mul_ps(sy, _mm_add_ps(yz, wx)),
+        _mm_setzero_ps()
+    };
+    __m128 row2[4] = {
+        _mm_mul_ps(sz, _mm_add_ps(xz, wy)),
+        _mm_mul_ps(sz, _mm_sub_ps(yz, wx)),
+        _mm_mul_ps(sz, _mm_sub_ps(one, _mm_add_ps(xx, yy))),
+        _mm_setzero_ps()
+    };
+    __m128 row3[4] = {
+        _mm_loadu_ps(&positionX[first]),
+        _mm_loadu_ps(&positionY[first]),
+        _mm_loadu_ps(&positionZ[first]),
+        one
+    };
+
+    // Lanes to matrices: after the transpose, element k is row r of transform k
+    _MM_TRANSPOSE4_PS(row0[0], row0[1], row0[2], row0[3]);
+    _MM_TRANSPOSE4_PS(row1[0], row1[1], row1[2], row1[3]);
+    _MM_TRANSPOSE4_PS(row2[0], row2[1], row2[2], row2[3]);
+    _MM_TRANSPOSE4_PS(row3[0], row3[1], row3[2], row3[3]);
+    for (int k = 0; k < 4; ++k) {
+        float* matrix = &worldMatrices[first + k]._11;
+        _mm_storeu_ps(matrix + 0, row0[k]);
+        _mm_storeu_ps(matrix + 4, row1[k]);
+        _mm_storeu_ps(matrix + 8, row2[k]);
+        _mm_storeu_ps(matrix + 12, row3[k]);
+    }
+#else
+    for (TransformId id = first; id < first + 4; ++id) {
+        ComposeLocal(id, worldMatrices[id]);
+    }
+#endif
+}
+
+void TransformStore::ComposeLocal(TransformId id, XMFLOAT4X4& matrix) const {
+    float x = rotationX[id], y = rotationY[id], z = rotationZ[id], w = rotationW[id];
+    float xx = 2.0f * x * x, yy = 2.0f * y * y, zz = 2.0f * z * z;
+    float xy = 2.0f * x * y, xz = 2.0f * x * z, yz = 2.0f * y * z;
+    float wx = 2.0f * w * x, wy = 2.0f * w * y, wz = 2.0f * w * z;
+    float sx = scaleX[id], sy = scaleY[id], sz = scaleZ[id];
+
+    matrix = XMFLOAT4X4(
+        sx * (1.0f - yy - zz), sx * (xy + wz), sx * (xz - wy), 0.0f,
+        sy * (xy - wz), sy * (1.0f - xx - zz), sy * (yz + wx), 0.0f,
+        sz * (xz + wy), sz * (yz - wx), sz * (1.0f - xx - yy), 0.0f,
+        positionX[id], positionY[id], positionZ[id], 1.0f);
+}
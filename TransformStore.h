@@ -0,0 +1,99 @@
+// TransformStore.h
+
+#pragma once
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+
+typedef uint32_t TransformId;
+const TransformId InvalidTransform = 0xFFFFFFFF;
+
+// Dense structure-of-arrays storage for object transforms: position, unit
+// quaternion rotation and scale per transform, with an optional parent.
+// Setters only mark a transform dirty; UpdateWorldMatrices composes the dirty
+// world matrices once per frame, four at a time with SSE2.
+//
+// Ids are slot indices and a parent always has a smaller id than its children,
+// so slot order is a valid update order. Destroyed slots are reused only for
+// transforms created without a parent.
+class TransformStore {
+public:
+    // Counts from the last UpdateWorldMatrices
+    struct Stats {
+        uint32_t dirty;         // Transforms marked dirty, including through a parent
+        uint32_t composed;      // World matrices rebuilt; whole groups of four are rebuilt at once
+    };
+
+    TransformStore();
+
+    // Identity transform. The parent, if any, must already exist.
+    TransformId Create(TransformId parent = InvalidTransform);
+
+    // Children of a destroyed transform become roots
+    void Destroy(TransformId id);
+
+    // Fails unless the parent is older than the transform
+    bool SetParent(TransformId id, TransformId parent);
+    TransformId GetParent(TransformId id) const { return parents[id]; }
+
+    // Local transform, relative to the parent
+    void SetPosition(TransformId id, float x, float y, float z);
+    void SetRotation(TransformId id, float pitch, float yaw, float roll);
+    void SetRotation(TransformId id, const DirectX::XMFLOAT4& quaternion);
+    void SetScale(TransformId id, float x, float y, float z);
+
+    DirectX::XMFLOAT3 GetPosition(TransformId id) const { return DirectX::XMFLOAT3(positionX[id], positionY[id], positionZ[id]); }
+    DirectX::XMFLOAT4 GetRotation(TransformId id) const { return DirectX::XMFLOAT4(rotationX[id], rotationY[id], rotationZ[id], rotationW[id]); }
+    DirectX::XMFLOAT3 GetScale(TransformId id) const { return DirectX::XMFLOAT3(scaleX[id], scaleY[id], scaleZ[id]); }
+
+    // Composed scale * rotation * translation * parent world, as of the last update
+    const DirectX::XMFLOAT4X4& GetWorldMatrix(TransformId id) const { return worldMatrices[id]; }
+
+    // True when the world matrix was rebuilt for a change in the last update
+    bool WasChanged(TransformId id) const { return (changedBits[id / 64] >> (id % 64)) & 1; }
+
+    // Composes every dirty world matrix and clears the dirty bits. With a job
+    // system the composition is spread over its threads; parented transforms
+    // are then resolved in id order on the calling thread.
+    void UpdateWorldMatrices(JobSystem* jobs = nullptr);
+
+    // Composes one world matrix right away, leaving the dirty bits alone. The
+    // parent's world matrix must be up to date.
+    void UpdateWorldMatrix(TransformId id);
+
+    // Slots in use or free
+    uint32_t GetCapacity() const { return count; }
+    const Stats& GetStats() const { return stats; }
+
+private:
+    void MarkDirty(TransformId id) { dirtyBits[id / 64] |= uint64_t(1) << (id % 64); }
+    bool IsGroupDirty(TransformId id) const { return (dirtyBits[id / 64] >> (id % 64 & ~3u)) & 0xF; }
+
+    // Rebuilds the local matrices of the dirty groups in words [begin, end)
+    void ComposeWords(size_t begin, size_t end);
+
+    // Writes the local matrices of transforms first to first + 3
+    void ComposeGroup(TransformId first);
+    void ComposeLocal(TransformId id, DirectX::XMFLOAT4X4& matrix) const;
+
+    uint32_t count;
+
+    // Local transforms, padded to a multiple of four with identity
+    std::vector<float> positionX, positionY, positionZ;
+    std::vector<float> rotationX, rotationY, rotationZ, rotationW;
+    std::vector<float> scaleX, scaleY, scaleZ;
+    std::vector<TransformId> parents;
+    std::vector<DirectX::XMFLOAT4X4> worldMatrices;
+
+    // One bit per transform
+    std::vector<uint64_t> dirtyBits;
+    std::vector<uint64_t> changedBits;
+
+    // Parented transforms in id order, and slots free for reuse
+    std::vector<TransformId> children;
+    std::vector<TransformId> freeIds;
+
+    Stats stats;
+};
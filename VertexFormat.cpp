@@ -0,0 +1,93 @@
+// VertexFormat.cpp
+
+#include "VertexFormat.h"
+
+#include <cstring>
+using namespace DirectX;
+
+VertexFormat::VertexFormat()
+    : stride(0)
+{
+}
+
+VertexFormat& VertexFormat::Add(VertexSemantic semantic, VertexEncoding encoding) {
+    VertexElement element = { semantic, encoding, stride };
+    elements.push_back(element);
+    stride += GetEncodingSize(encoding);
+    return *this;
+}
+
+const VertexElement* VertexFormat::Find(VertexSemantic semantic) const {
+    for (const VertexElement& element : elements) {
+        if (element.semantic == semantic) {
+            return &element;
+        }
+    }
+    return nullptr;
+}
+
+void VertexFormat::Encode(void* destination, const VertexStream* streams, size_t vertexCount,
+    const VertexQuantization::PositionRange& range) const {
+    unsigned char* output = static_cast<unsigned char*>(destination);
+
+    for (const VertexElement& element : elements) {
+        const VertexStream& stream = streams[static_cast<int>(element.semantic)];
+        unsigned char* target = output + element.offset;
+        const unsigned char* source = static_cast<const unsigned char*>(stream.data);
+
+        switch (element.encoding) {
+        case VertexEncoding::Float2:
+        case VertexEncoding::Float3: {
+            uint32_t size = GetEncodingSize(element.encoding);
+            for (size_t i = 0; i < vertexCount; ++i) {
+                std::memcpy(target + i * stride, source + i * stream.stride, size);
+            }
+            break;
+        }
+        case VertexEncoding::UNorm16x4:
+            VertexQuantization::EncodePositions(target, stride, source, stream.stride, vertexCount, range);
+            break;
+        case VertexEncoding::OctSNorm16x2:
+            VertexQuantization::EncodeNormals(target, stride, source, stream.stride, vertexCount);
+            break;
+        case VertexEncoding::Half2:
+            VertexQuantization::EncodeHalf2(target, stride, source, stream.stride, vertexCount);
+            break;
+        case VertexEncoding::UNorm8x4:
+            VertexQuantization::EncodeColors(target, stride, source, stream.stride, vertexCount);
+            break;
+        }
+    }
+}
+
+XMMATRIX VertexFormat::GetPositionTransform(const VertexQuantization::PositionRange& range) const {
+    const VertexElement* position = Find(VertexSemantic::Position);
+    if (!position || position->encoding != VertexEncoding::UNorm16x4) {
+        return XMMatrixIdentity();
+    }
+
+    return XMMatrixScaling(range.scale[0], range.scale[1], range.scale[2]) *
+        XMMatrixTranslation(range.offset[0], range.offset[1], range.offset[2]);
+}
+
+uint32_t VertexFormat::GetEncodingSize(VertexEncoding encoding) {
+    switch (encoding) {
+    case VertexEncoding::Float2:        return 8;
+    case VertexEncoding::Float3:        return 12;
+    case VertexEncoding::UNorm16x4:     return 8;
+    case VertexEncoding::OctSNorm16x2:  return 4;
+    case VertexEncoding::Half2:         return 4;
+    case VertexEncoding::UNorm8x4:      return 4;
+    }
+    return 0;
+}
+
+const char* VertexFormat::GetSemanticName(VertexSemantic semantic) {
+    switch (semantic) {
+    case VertexSemantic::Position:  return "POSITION";
+    case VertexSemantic::Normal:    return "NORMAL";
+    case VertexSemantic::TexCoord:  return "TEXCOORD";
+    case VertexSemantic::Color:     return "COLOR";
+    default:                        return "";
+    }
+}
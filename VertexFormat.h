@@ -0,0 +1,67 @@
+// VertexFormat.h
+
+#pragma once
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+#include "VertexQuantization.h"
+
+enum class VertexSemantic {
+    Position,
+    Normal,
+    TexCoord,
+    Color,
+    Count
+};
+
+enum class VertexEncoding {
+    Float2,
+    Float3,
+    UNorm16x4,      // Position quantized to the mesh bounds, w unused
+    OctSNorm16x2,   // Octahedral unit normal
+    Half2,
+    UNorm8x4        // RGB color with opaque alpha
+};
+
+struct VertexElement {
+    VertexSemantic semantic;
+    VertexEncoding encoding;
+    uint32_t offset;
+};
+
+// Source data for one semantic: float components every stride bytes
+struct VertexStream {
+    const void* data;
+    size_t stride;
+};
+
+// Describes an interleaved GPU vertex and encodes float attributes into it.
+// Quantized positions are dequantized by GetPositionTransform, which is meant
+// to be folded into the world matrix. Octahedral normals are decoded in the
+// shader with z = 1 - |x| - |y|; xy -= sign(xy) * max(-z, 0); normalize.
+class VertexFormat {
+public:
+    VertexFormat();
+
+    // Appends an element after the previous ones. Each semantic may appear once.
+    VertexFormat& Add(VertexSemantic semantic, VertexEncoding encoding);
+
+    uint32_t GetStride() const { return stride; }
+    const std::vector<VertexElement>& GetElements() const { return elements; }
+    const VertexElement* Find(VertexSemantic semantic) const;
+
+    // Encodes vertexCount vertices from streams indexed by VertexSemantic.
+    // Semantics the format does not use are ignored and may have null data.
+    void Encode(void* destination, const VertexStream* streams, size_t vertexCount,
+        const VertexQuantization::PositionRange& range) const;
+
+    // Maps encoded positions back to mesh space, identity for float positions
+    DirectX::XMMATRIX GetPositionTransform(const VertexQuantization::PositionRange& range) const;
+
+    static uint32_t GetEncodingSize(VertexEncoding encoding);
+    static const char* GetSemanticName(VertexSemantic semantic);
+
+private:
+    std::vector<VertexElement> elements;
+    uint32_t stride;
+};
@@ -0,0 +1,623 @@
+// VertexQuantization.cpp
+
+#include "VertexQuantization.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define BOG_VERTEX_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+    // Vertices handled per kernel step, one per SIMD lane
+    const size_t BatchSize = 4;
+
+    const float Unorm16Max = 65535.0f;
+    const float Snorm16Max = 32767.0f;
+    const float Unorm8Max = 255.0f;
+
+#ifdef BOG_VERTEX_SSE2
+
+    // Vertex I/O moves each vertex with a single load or store and transposes
+    // between vertices and per-component lanes in registers. Loads never read
+    // past the components of a vertex, so strided sources can end anywhere.
+
+    inline __m128 LoadFloatVertex(const unsigned char* source, int componentCount) {
+        __m128 xy = _mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(source));
+        if (componentCount == 2) {
+            return xy;
+        }
+        return _mm_movelh_ps(xy, _mm_load_ss(reinterpret_cast<const float*>(source + 8)));
+    }
+
+    inline void StoreFloatVertex(unsigned char* destination, int componentCount, __m128 vertex) {
+        _mm_storel_pi(reinterpret_cast<__m64*>(destination), vertex);
+        if (componentCount == 3) {
+            _mm_store_ss(reinterpret_cast<float*>(destination + 8), _mm_movehl_ps(vertex, vertex));
+        }
+    }
+
+    inline __m128i LoadLanes(const int32_t* lanes) {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(lanes));
+    }
+
+    inline void StoreLanes(int32_t* lanes, __m128i value) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), value);
+    }
+
+    inline void Transpose(__m128i& a, __m128i& b, __m128i& c, __m128i& d) {
+        __m128 r0 = _mm_castsi128_ps(a), r1 = _mm_castsi128_ps(b), r2 = _mm_castsi128_ps(c), r3 = _mm_castsi128_ps(d);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        a = _mm_castps_si128(r0);
+        b = _mm_castps_si128(r1);
+        c = _mm_castps_si128(r2);
+        d = _mm_castps_si128(r3);
+    }
+
+    // Widens the low or high four 16-bit elements to 32 bits
+    inline __m128i WidenLow16(__m128i v, bool isSigned) {
+        return isSigned ? _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16) : _mm_unpacklo_epi16(v, _mm_setzero_si128());
+    }
+
+    inline __m128i WidenHigh16(__m128i v, bool isSigned) {
+        return isSigned ? _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16) : _mm_unpackhi_epi16(v, _mm_setzero_si128());
+    }
+
+    // Up to four 32-bit vertices, vertex i in element i and missing ones zero
+    inline __m128i Load32x4(const unsigned char* source, size_t stride, size_t count) {
+        __m128i v[BatchSize];
+        for (size_t lane = 0; lane < BatchSize; ++lane) {
+            int32_t bits = 0;
+            if (lane < count) {
+                std::memcpy(&bits, source + lane * stride, sizeof(bits));
+            }
+            v[lane] = _mm_cvtsi32_si128(bits);
+        }
+        return _mm_unpacklo_epi64(_mm_unpacklo_epi32(v[0], v[1]), _mm_unpacklo_epi32(v[2], v[3]));
+    }
+
+    inline void Store32x4(unsigned char* destination, size_t stride, size_t count, __m128i packed) {
+        for (size_t lane = 0; lane < count; ++lane) {
+            int32_t bits = _mm_cvtsi128_si32(packed);
+            std::memcpy(destination + lane * stride, &bits, sizeof(bits));
+            packed = _mm_srli_si128(packed, 4);
+        }
+    }
+
+    // Copies up to four vertices of componentCount floats into per-component lanes. Missing lanes are zero.
+    inline void GatherFloats(const unsigned char* source, size_t stride, size_t count, int componentCount, float lanes[][BatchSize]) {
+        __m128 v[BatchSize];
+        for (size_t lane = 0; lane < BatchSize; ++lane) {
+            v[lane] = (lane < count) ? LoadFloatVertex(source + lane * stride, componentCount) : _mm_setzero_ps();
+        }
+        _MM_TRANSPOSE4_PS(v[0], v[1], v[2], v[3]);
+        for (int c = 0; c < componentCount; ++c) {
+            _mm_storeu_ps(lanes[c], v[c]);
+        }
+    }
+
+    inline void ScatterFloats(unsigned char* destination, size_t stride, size_t count, int componentCount, const float lanes[][BatchSize]) {
+        __m128 v[BatchSize];
+        for (int c = 0; c < int(BatchSize); ++c) {
+            v[c] = (c < componentCount) ? _mm_loadu_ps(lanes[c]) : _mm_setzero_ps();
+        }
+        _MM_TRANSPOSE4_PS(v[0], v[1], v[2], v[3]);
+        for (size_t lane = 0; lane < count; ++lane) {
+            StoreFloatVertex(destination + lane * stride, componentCount, v[lane]);
+        }
+    }
+
+    // Writes the low 16 bits of each lane as two or four shorts per vertex
+    inline void StoreShorts(unsigned char* destination, size_t stride, size_t count, int componentCount, const int32_t lanes[][BatchSize]) {
+        // Sign extending the low halves lets the saturating pack keep them unchanged
+        __m128i v[4];
+        for (int c = 0; c < 4; ++c) {
+            v[c] = (c < componentCount) ? _mm_srai_epi32(_mm_slli_epi32(LoadLanes(lanes[c]), 16), 16) : _mm_setzero_si128();
+        }
+        if (componentCount == 2) {
+            Store32x4(destination, stride, count, _mm_packs_epi32(_mm_unpacklo_epi32(v[0], v[1]), _mm_unpackhi_epi32(v[0], v[1])));
+            return;
+        }
+
+        Transpose(v[0], v[1], v[2], v[3]);
+        __m128i pairs[2] = { _mm_packs_epi32(v[0], v[1]), _mm_packs_epi32(v[2], v[3]) };
+        for (size_t lane = 0; lane < count; ++lane) {
+            __m128i pair = pairs[lane / 2];
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(destination + lane * stride), (lane & 1) ? _mm_unpackhi_epi64(pair, pair) : pair);
+        }
+    }
+
+    // Reads two or four shorts per vertex into lanes. Missing lanes are zero.
+    inline void LoadShorts(const unsigned char* source, size_t stride, size_t count, int componentCount, bool isSigned, int32_t lanes[][BatchSize]) {
+        if (componentCount == 2) {
+            __m128i packed = Load32x4(source, stride, count);
+            __m128 low = _mm_castsi128_ps(WidenLow16(packed, isSigned));
+            __m128 high = _mm_castsi128_ps(WidenHigh16(packed, isSigned));
+            StoreLanes(lanes[0], _mm_castps_si128(_mm_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0))));
+            StoreLanes(lanes[1], _mm_castps_si128(_mm_shuffle_ps(low, high, _MM_SHUFFLE(3, 1, 3, 1))));
+            return;
+        }
+
+        __m128i v[BatchSize];
+        for (size_t lane = 0; lane < BatchSize; ++lane) {
+            v[lane] = (lane < count) ? _mm_loadl_epi64(reinterpret_cast<const __m128i*>(source + lane * stride)) : _mm_setzero_si128();
+        }
+        __m128i first = _mm_unpacklo_epi64(v[0], v[1]);
+        __m128i second = _mm_unpacklo_epi64(v[2], v[3]);
+        v[0] = WidenLow16(first, isSigned);
+        v[1] = WidenHigh16(first, isSigned);
+        v[2] = WidenLow16(second, isSigned);
+        v[3] = WidenHigh16(second, isSigned);
+        Transpose(v[0], v[1], v[2], v[3]);
+        for (int c = 0; c < 4; ++c) {
+            StoreLanes(lanes[c], v[c]);
+        }
+    }
+
+    // Four bytes per vertex from lanes holding 0-255
+    inline void StoreBytes(unsigned char* destination, size_t stride, size_t count, const int32_t lanes[][BatchSize]) {
+        __m128i v0 = LoadLanes(lanes[0]), v1 = LoadLanes(lanes[1]), v2 = LoadLanes(lanes[2]), v3 = LoadLanes(lanes[3]);
+        Transpose(v0, v1, v2, v3);
+        Store32x4(destination, stride, count, _mm_packus_epi16(_mm_packs_epi32(v0, v1), _mm_packs_epi32(v2, v3)));
+    }
+
+    inline void LoadBytes(const unsigned char* source, size_t stride, size_t count, int32_t lanes[][BatchSize]) {
+        const __m128i zero = _mm_setzero_si128();
+        __m128i packed = Load32x4(source, stride, count);
+        __m128i low = _mm_unpacklo_epi8(packed, zero);
+        __m128i high = _mm_unpackhi_epi8(packed, zero);
+        __m128i v0 = _mm_unpacklo_epi16(low, zero), v1 = _mm_unpackhi_epi16(low, zero);
+        __m128i v2 = _mm_unpacklo_epi16(high, zero), v3 = _mm_unpackhi_epi16(high, zero);
+        Transpose(v0, v1, v2, v3);
+        StoreLanes(lanes[0], v0);
+        StoreLanes(lanes[1], v1);
+        StoreLanes(lanes[2], v2);
+        StoreLanes(lanes[3], v3);
+    }
+
+    inline __m128 Select(__m128 mask, __m128 a, __m128 b) {
+        return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+    }
+
+    // Maps values to [0, maxValue] integers: round(saturate((v - offset) * invScale) * maxValue)
+    void QuantizeLanes(const float* values, float offset, float invScale, float maxValue, int32_t* out) {
+        __m128 v = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(values), _mm_set1_ps(offset)), _mm_set1_ps(invScale));
+        v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+        v = _mm_add_ps(_mm_mul_ps(v, _mm_set1_ps(maxValue)), _mm_set1_ps(0.5f));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_cvttps_epi32(v));
+    }
+
+    void DequantizeLanes(const int32_t* values, float scale, float offset, float* out) {
+        __m128 v = _mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(values)));
+        _mm_storeu_ps(out, _mm_add_ps(_mm_mul_ps(v, _mm_set1_ps(scale)), _mm_set1_ps(offset)));
+    }
+
+    void OctahedralEncodeLanes(const float* xs, const float* ys, const float* zs, int32_t* outX, int32_t* outY) {
+        const __m128 signMask = _mm_set1_ps(-0.0f);
+        const __m128 one = _mm_set1_ps(1.0f);
+        __m128 x = _mm_loadu_ps(xs);
+        __m128 y = _mm_loadu_ps(ys);
+        __m128 z = _mm_loadu_ps(zs);
+
+        // Project onto the octahedron |x| + |y| + |z| = 1
+        __m128 sum = _mm_add_ps(_mm_add_ps(_mm_andnot_ps(signMask, x), _mm_andnot_ps(signMask, y)), _mm_andnot_ps(signMask, z));
+        __m128 inv = _mm_div_ps(one, _mm_max_ps(sum, _mm_set1_ps(FLT_MIN)));
+        __m128 px = _mm_mul_ps(x, inv);
+        __m128 py = _mm_mul_ps(y, inv);
+
+        // Fold the lower hemisphere over the diagonals
+        __m128 signX = _mm_or_ps(_mm_and_ps(px, signMask), one);
+        __m128 signY = _mm_or_ps(_mm_and_ps(py, signMask), one);
+        __m128 foldX = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, py)), signX);
+        __m128 foldY = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, px)), signY);
+        __m128 lower = _mm_cmplt_ps(z, _mm_setzero_ps());
+        px = Select(lower, foldX, px);
+        py = Select(lower, foldY, py);
+
+        __m128 scale = _mm_set1_ps(Snorm16Max);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(outX), _mm_cvtps_epi32(_mm_mul_ps(px, scale)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(outY), _mm_cvtps_epi32(_mm_mul_ps(py, scale)));
+    }
+
+    void OctahedralDecodeLanes(const int32_t* encodedX, const int32_t* encodedY, float* xs, float* ys, float* zs) {
+        const __m128 signMask = _mm_set1_ps(-0.0f);
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 inverseScale = _mm_set1_ps(1.0f / Snorm16Max);
+        __m128 x = _mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(encodedX)));
+        __m128 y = _mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(encodedY)));
+        x = _mm_max_ps(_mm_mul_ps(x, inverseScale), _mm_sub_ps(_mm_setzero_ps(), one));
+        y = _mm_max_ps(_mm_mul_ps(y, inverseScale), _mm_sub_ps(_mm_setzero_ps(), one));
+
+        // Unfold the lower hemisphere, t is zero on the upper one
+        __m128 z = _mm_sub_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, x)), _mm_andnot_ps(signMask, y));
+        __m128 t = _mm_max_ps(_mm_sub_ps(_mm_setzero_ps(), z), _mm_setzero_ps());
+        x = _mm_sub_ps(x, _mm_or_ps(t, _mm_and_ps(x, signMask)));
+        y = _mm_sub_ps(y, _mm_or_ps(t, _mm_and_ps(y, signMask)));
+
+        __m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+        __m128 inv = _mm_div_ps(one, _mm_sqrt_ps(lengthSquared));
+        _mm_storeu_ps(xs, _mm_mul_ps(x, inv));
+        _mm_storeu_ps(ys, _mm_mul_ps(y, inv));
+        _mm_storeu_ps(zs, _mm_mul_ps(z, inv));
+    }
+
+    // Float to half with round to nearest, overflow to infinity and NaN preserved
+    void FloatToHalfLanes(const float* values, int32_t* out) {
+        const __m128i infinity = _mm_set1_epi32(255 << 23);
+        const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(int(0x80000000u)));
+        const __m128 roundMask = _mm_castsi128_ps(_mm_set1_epi32(~0xfff));
+        const __m128 magic = _mm_castsi128_ps(_mm_set1_epi32(15 << 23));
+        const __m128 clampValue = _mm_castsi128_ps(_mm_set1_epi32((31 << 23) - 0x1000));
+
+        __m128 value = _mm_loadu_ps(values);
+        __m128 sign = _mm_and_ps(value, signMask);
+        __m128 absolute = _mm_xor_ps(value, sign);
+        __m128i absoluteBits = _mm_castps_si128(absolute);
+        __m128i isNaN = _mm_cmpgt_epi32(absoluteBits, infinity);
+        __m128i isFinite = _mm_cmpgt_epi32(infinity, absoluteBits);
+        __m128i infOrNaN = _mm_or_si128(_mm_and_si128(isNaN, _mm_set1_epi32(0x200)), _mm_set1_epi32(0x7c00));
+
+        // Rebias the exponent by multiplying, which also produces half denormals
+        __m128 truncated = _mm_and_ps(absolute, roundMask);
+        __m128 scaled = _mm_min_ps(_mm_mul_ps(truncated, magic), clampValue);
+        __m128i rounded = _mm_sub_epi32(_mm_castps_si128(scaled), _mm_castps_si128(roundMask));
+        __m128i finite = _mm_and_si128(_mm_srli_epi32(rounded, 13), isFinite);
+        __m128i result = _mm_or_si128(finite, _mm_andnot_si128(isFinite, infOrNaN));
+        result = _mm_or_si128(result, _mm_srli_epi32(_mm_castps_si128(sign), 16));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), result);
+    }
+
+    void HalfToFloatLanes(const int32_t* values, float* out) {
+        const __m128 magic = _mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23));
+        const __m128 infinityExponent = _mm_castsi128_ps(_mm_set1_epi32(255 << 23));
+
+        __m128i half = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values));
+        __m128i exponentMantissa = _mm_and_si128(half, _mm_set1_epi32(0x7fff));
+        __m128i sign = _mm_slli_epi32(_mm_xor_si128(half, exponentMantissa), 16);
+        __m128 scaled = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(exponentMantissa, 13)), magic);
+        __m128i wasInfOrNaN = _mm_cmpgt_epi32(exponentMantissa, _mm_set1_epi32(0x7bff));
+        __m128 extra = _mm_or_ps(_mm_castsi128_ps(sign), _mm_and_ps(_mm_castsi128_ps(wasInfOrNaN), infinityExponent));
+        _mm_storeu_ps(out, _mm_or_ps(scaled, extra));
+    }
+
+#else
+
+    // Copies up to four vertices of componentCount floats into per-component lanes. Missing lanes are zero.
+    inline void GatherFloats(const unsigned char* source, size_t stride, size_t count, int componentCount, float lanes[][BatchSize]) {
+        for (int c = 0; c < componentCount; ++c) {
+            for (size_t lane = 0; lane < BatchSize; ++lane) {
+                lanes[c][lane] = 0.0f;
+            }
+        }
+        for (size_t lane = 0; lane < count; ++lane) {
+            float values[4];
+            std::memcpy(values, source + lane * stride, sizeof(float) * componentCount);
+            for (int c = 0; c < componentCount; ++c) {
+                lanes[c][lane] = values[c];
+            }
+        }
+    }
+
+    inline void ScatterFloats(unsigned char* destination, size_t stride, size_t count, int componentCount, const float lanes[][BatchSize]) {
+        for (size_t lane = 0; lane < count; ++lane) {
+            float values[4];
+            for (int c = 0; c < componentCount; ++c) {
+                values[c] = lanes[c][lane];
+            }
+            std::memcpy(destination + lane * stride, values, sizeof(float) * componentCount);
+        }
+    }
+
+    inline void StoreShorts(unsigned char* destination, size_t stride, size_t count, int componentCount, const int32_t lanes[][BatchSize]) {
+        for (size_t lane = 0; lane < count; ++lane) {
+            uint16_t packed[4];
+            for (int c = 0; c < componentCount; ++c) {
+                packed[c] = static_cast<uint16_t>(lanes[c][lane]);
+            }
+            std::memcpy(destination + lane * stride, packed, sizeof(uint16_t) * componentCount);
+        }
+    }
+
+    inline void LoadShorts(const unsigned char* source, size_t stride, size_t count, int componentCount, bool isSigned, int32_t lanes[][BatchSize]) {
+        for (size_t lane = 0; lane < BatchSize; ++lane) {
+            uint16_t packed[4] = {};
+            if (lane < count) {
+                std::memcpy(packed, source + lane * stride, sizeof(uint16_t) * componentCount);
+            }
+            for (int c = 0; c < componentCount; ++c) {
+                lanes[c][lane] = isSigned ? int32_t(static_cast<int16_t>(packed[c])) : int32_t(packed[c]);
+            }
+        }
+    }
+
+    inline void StoreBytes(unsigned char* destination, size_t stride, size_t count, const int32_t lanes[][BatchSize]) {
+        for (size_t lane = 0; lane < count; ++lane) {
+            uint8_t packed[4];
+            for (int c = 0; c < 4; ++c) {
+                packed[c] = static_cast<uint8_t>(lanes[c][lane]);
+            }
+            std::memcpy(destination + lane * stride, packed, sizeof(packed));
+        }
+    }
+
+    inline void LoadBytes(const unsigned char* source, size_t stride, size_t count, int32_t lanes[][BatchSize]) {
+        for (size_t lane = 0; lane < BatchSize; ++lane) {
+            uint8_t packed[4] = {};
+            if (lane < count) {
+                std::memcpy(packed, source + lane * stride, sizeof(packed));
+            }
+            for (int c = 0; c < 4; ++c) {
+                lanes[c][lane] = packed[c];
+            }
+        }
+    }
+
+    inline uint32_t FloatBits(float value) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    inline float BitsToFloat(uint32_t bits) {
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    inline float SignOf(float value) {
+        return std::signbit(value) ? -1.0f : 1.0f;
+    }
+
+    void QuantizeLanes(const float* values, float offset, float invScale, float maxValue, int32_t* out) {
+        for (size_t lane = 0; lane < BatchSize; ++lane) {
+            float v = (values[lane] - offset) * invScale;
+            v = std::min(std::max(v, 0.0f), 1.0f);
+            out[lane] = static_cast<int32_t>(v * maxValue + 0.5f);
+        }
+    }
+
+    void DequantizeLanes(const int32_t* values, float scale, float offset, float* out) {
+        for (size_t lane = 0; lane < BatchSize; ++lane) {
+            out[lane] = float(values[lane]) * scale + offset;
+        }
+    }
+
+    void OctahedralEncodeLanes(const float* xs, const float* ys, const float* zs, int32_t* outX, int32_t* outY) {
+        for (size_t lane = 0; lane < BatchSize; ++lane) {
+            float sum = std::fabs(xs[lane]) + std::fabs(ys[lane]) + std::fabs(zs[lane]);
+            float inv = 1.0f / std::max(sum, FLT_MIN);
+            float px = xs[lane] * inv;
+            float py = ys[lane] * inv;
+            if (zs[lane] < 0.0f) {
+                float foldX = (1.0f - std::fabs(py)) * SignOf(px);
+                float foldY = (1.0f - std::fabs(px)) * SignOf(py);
+                px = foldX;
+                py = foldY;
+            }
+            outX[lane] = static_cast<int32_t>(std::lrint(px * Snorm16Max));
+            outY[lane] = static_cast<int32_t>(std::lrint(py * Snorm16Max));
+        }
+    }
+
+    void OctahedralDecodeLanes(const int32_t* encodedX, const int32_t* encodedY, float* xs, float* ys, float* zs) {
+        for (size_t lane = 0; lane < BatchSize; ++lane) {
+            float x = std::max(encodedX[lane] / Snorm16Max, -1.0f);
+            float y = std::max(encodedY[lane] / Snorm16Max, -1.0f);
+            float z = 1.0f - std::fabs(x) - std::fabs(y);
+            float t = std::max(-z, 0.0f);
+            x -= std::copysign(t, x);
+            y -= std::copysign(t, y);
+            float inv = 1.0f / std::sqrt(x * x + y * y + z * z);
+            xs[lane] = x * inv;
+            ys[lane] = y * inv;
+            zs[lane] = z * inv;
+        }
+    }
+
+    // Same bit manipulation as the SSE2 path so both produce identical halves
+    void FloatToHalfLanes(const float* values, int32_t* out) {
+        const uint32_t infinity = 255u << 23;
+        for (size_t lane = 0; lane < BatchSize; ++lane) {
+            uint32_t bits = FloatBits(values[lane]);
+            uint32_t sign = bits & 0x80000000u;
+            uint32_t absolute = bits ^ sign;
+
+            uint32_t result;
+            if (absolute > infinity) {
+                result = 0x7e00;
+            }
+            else if (absolute == infinity) {
+                result = 0x7c00;
+            }
+            else {
+                float scaled = BitsToFloat(absolute & ~0xfffu) * BitsToFloat(15u << 23);
+                scaled = std::min(scaled, BitsToFloat((31u << 23) - 0x1000));
+                result = (FloatBits(scaled) + 0x1000) >> 13;
+            }
+            out[lane] = int32_t(result | (sign >> 16));
+        }
+    }
+
+    void HalfToFloatLanes(const int32_t* values, float* out) {
+        for (size_t lane = 0; lane < BatchSize; ++lane) {
+            uint32_t exponentMantissa = uint32_t(values[lane]) & 0x7fff;
+            uint32_t sign = (uint32_t(values[lane]) ^ exponentMantissa) << 16;
+            float scaled = BitsToFloat(exponentMantissa << 13) * BitsToFloat((254u - 15u) << 23);
+            uint32_t extra = sign | ((exponentMantissa > 0x7bff) ? (255u << 23) : 0u);
+            out[lane] = BitsToFloat(FloatBits(scaled) | extra);
+        }
+    }
+
+#endif
+
+}
+
+VertexQuantization::PositionRange VertexQuantization::ComputePositionRange(const void* positions, size_t stride, size_t count) {
+    const unsigned char* source = static_cast<const unsigned char*>(positions);
+    float boundsMin[3] = { 0.0f, 0.0f, 0.0f };
+    float boundsMax[3] = { 0.0f, 0.0f, 0.0f };
+
+    for (size_t i = 0; i < count; ++i) {
+        float p[3];
+        std::memcpy(p, source + i * stride, sizeof(p));
+        for (int axis = 0; axis < 3; ++axis) {
+            boundsMin[axis] = (i == 0) ? p[axis] : std::min(boundsMin[axis], p[axis]);
+            boundsMax[axis] = (i == 0) ? p[axis] : std::max(boundsMax[axis], p[axis]);
+        }
+    }
+
+    return PositionRangeFromBounds(boundsMin, boundsMax);
+}
+
+VertexQuantization::PositionRange VertexQuantization::PositionRangeFromBounds(const float boundsMin[3], const float boundsMax[3]) {
+    PositionRange range;
+    for (int axis = 0; axis < 3; ++axis) {
+        range.offset[axis] = boundsMin[axis];
+        range.scale[axis] = boundsMax[axis] - boundsMin[axis];
+    }
+    return range;
+}
+
+void VertexQuantization::EncodePositions(void* destination, size_t destinationStride,
+    const void* positions, size_t stride, size_t count, const PositionRange& range) {
+    unsigned char* output = static_cast<unsigned char*>(destination);
+    const unsigned char* source = static_cast<const unsigned char*>(positions);
+
+    // Flat axes encode as zero
+    float invScale[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        invScale[axis] = (range.scale[axis] > 0.0f) ? 1.0f / range.scale[axis] : 0.0f;
+    }
+
+    for (size_t first = 0; first < count; first += BatchSize) {
+        size_t batch = std::min(BatchSize, count - first);
+        float lanes[3][BatchSize];
+        int32_t quantized[4][BatchSize] = {};
+        GatherFloats(source + first * stride, stride, batch, 3, lanes);
+        for (int axis = 0; axis < 3; ++axis) {
+            QuantizeLanes(lanes[axis], range.offset[axis], invScale[axis], Unorm16Max, quantized[axis]);
+        }
+        StoreShorts(output + first * destinationStride, destinationStride, batch, 4, quantized);
+    }
+}
+
+void VertexQuantization::DecodePositions(void* destination, size_t destinationStride,
+    const void* encoded, size_t stride, size_t count, const PositionRange& range) {
+    unsigned char* output = static_cast<unsigned char*>(destination);
+    const unsigned char* source = static_cast<const unsigned char*>(encoded);
+
+    for (size_t first = 0; first < count; first += BatchSize) {
+        size_t batch = std::min(BatchSize, count - first);
+        int32_t quantized[4][BatchSize];
+        float lanes[3][BatchSize];
+        LoadShorts(source + first * stride, stride, batch, 4, false, quantized);
+        for (int axis = 0; axis < 3; ++axis) {
+            DequantizeLanes(quantized[axis], range.scale[axis] / Unorm16Max, range.offset[axis], lanes[axis]);
+        }
+        ScatterFloats(output + first * destinationStride, destinationStride, batch, 3, lanes);
+    }
+}
+
+void VertexQuantization::EncodeNormals(void* destination, size_t destinationStride,
+    const void* normals, size_t stride, size_t count) {
+    unsigned char* output = static_cast<unsigned char*>(destination);
+    const unsigned char* source = static_cast<const unsigned char*>(normals);
+
+    for (size_t first = 0; first < count; first += BatchSize) {
+        size_t batch = std::min(BatchSize, count - first);
+        float lanes[3][BatchSize];
+        int32_t encodedLanes[2][BatchSize];
+        GatherFloats(source + first * stride, stride, batch, 3, lanes);
+        OctahedralEncodeLanes(lanes[0], lanes[1], lanes[2], encodedLanes[0], encodedLanes[1]);
+        StoreShorts(output + first * destinationStride, destinationStride, batch, 2, encodedLanes);
+    }
+}
+
+void VertexQuantization::DecodeNormals(void* destination, size_t destinationStride,
+    const void* encoded, size_t stride, size_t count) {
+    unsigned char* output = static_cast<unsigned char*>(destination);
+    const unsigned char* source = static_cast<const unsigned char*>(encoded);
+
+    for (size_t first = 0; first < count; first += BatchSize) {
+        size_t batch = std::min(BatchSize, count - first);
+        int32_t encodedLanes[2][BatchSize];
+        float lanes[3][BatchSize];
+        LoadShorts(source + first * stride, stride, batch, 2, true, encodedLanes);
+        OctahedralDecodeLanes(encodedLanes[0], encodedLanes[1], lanes[0], lanes[1], lanes[2]);
+        ScatterFloats(output + first * destinationStride, destinationStride, batch, 3, lanes);
+    }
+}
+
+void VertexQuantization::EncodeHalf2(void* destination, size_t destinationStride,
+    const void* values, size_t stride, size_t count) {
+    unsigned char* output = static_cast<unsigned char*>(destination);
+    const unsigned char* source = static_cast<const unsigned char*>(values);
+
+    for (size_t first = 0; first < count; first += BatchSize) {
+        size_t batch = std::min(BatchSize, count - first);
+        float lanes[2][BatchSize];
+        int32_t halves[2][BatchSize];
+        GatherFloats(source + first * stride, stride, batch, 2, lanes);
+        FloatToHalfLanes(lanes[0], halves[0]);
+        FloatToHalfLanes(lanes[1], halves[1]);
+        StoreShorts(output + first * destinationStride, destinationStride, batch, 2, halves);
+    }
+}
+
+void VertexQuantization::DecodeHalf2(void* destination, size_t destinationStride,
+    const void* encoded, size_t stride, size_t count) {
+    unsigned char* output = static_cast<unsigned char*>(destination);
+    const unsigned char* source = static_cast<const unsigned char*>(encoded);
+
+    for (size_t first = 0; first < count; first += BatchSize) {
+        size_t batch = std::min(BatchSize, count - first);
+        int32_t halves[2][BatchSize];
+        float lanes[2][BatchSize];
+        LoadShorts(source + first * stride, stride, batch, 2, false, halves);
+        HalfToFloatLanes(halves[0], lanes[0]);
+        HalfToFloatLanes(halves[1], lanes[1]);
+        ScatterFloats(output + first * destinationStride, destinationStride, batch, 2, lanes);
+    }
+}
+
+void VertexQuantization::EncodeColors(void* destination, size_t destinationStride,
+    const void* colors, size_t stride, size_t count) {
+    unsigned char* output = static_cast<unsigned char*>(destination);
+    const unsigned char* source = static_cast<const unsigned char*>(colors);
+
+    for (size_t first = 0; first < count; first += BatchSize) {
+        size_t batch = std::min(BatchSize, count - first);
+        float lanes[3][BatchSize];
+        int32_t quantized[4][BatchSize];
+        GatherFloats(source + first * stride, stride, batch, 3, lanes);
+        for (int channel = 0; channel < 3; ++channel) {
+            QuantizeLanes(lanes[channel], 0.0f, 1.0f, Unorm8Max, quantized[channel]);
+        }
+        for (size_t lane = 0; lane < BatchSize; ++lane) {
+            quantized[3][lane] = 255;
+        }
+        StoreBytes(output + first * destinationStride, destinationStride, batch, quantized);
+    }
+}
+
+void VertexQuantization::DecodeColors(void* destination, size_t destinationStride,
+    const void* encoded, size_t stride, size_t count) {
+    unsigned char* output = static_cast<unsigned char*>(destination);
+    const unsigned char* source = static_cast<const unsigned char*>(encoded);
+
+    for (size_t first = 0; first < count; first += BatchSize) {
+        size_t batch = std::min(BatchSize, count - first);
+        int32_t quantized[4][BatchSize];
+        float lanes[3][BatchSize];
+        LoadBytes(source + first * stride, stride, batch, quantized);
+        for (int channel = 0; channel < 3; ++channel) {
+            DequantizeLanes(quantized[channel], 1.0f / Unorm8Max, 0.0f, lanes[channel]);
+        }
+        ScatterFloats(output + first * destinationStride, destinationStride, batch, 3, lanes);
+    }
+}
@@ -0,0 +1,47 @@
+// VertexQuantization.h
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Encode and decode kernels for compact vertex attributes. Sources and
+// destinations are strided, so the kernels read straight out of float vertex
+// structs and write into interleaved GPU vertices. Each kernel processes four
+// vertices per step with SSE2 when available: every vertex is moved with one
+// load or store and transposed into per-component lanes in registers.
+class VertexQuantization {
+public:
+    // Maps 16-bit UNORM positions back to mesh space: position = unorm * scale + offset
+    struct PositionRange {
+        float offset[3];
+        float scale[3];
+    };
+
+    // Range covering the bounds of a set of positions (three floats each)
+    static PositionRange ComputePositionRange(const void* positions, size_t stride, size_t count);
+    static PositionRange PositionRangeFromBounds(const float boundsMin[3], const float boundsMax[3]);
+
+    // Positions as four UNORM16 components relative to the range, w is zero
+    static void EncodePositions(void* destination, size_t destinationStride,
+        const void* positions, size_t stride, size_t count, const PositionRange& range);
+    static void DecodePositions(void* destination, size_t destinationStride,
+        const void* encoded, size_t stride, size_t count, const PositionRange& range);
+
+    // Unit normals folded onto an octahedron and stored as two SNORM16 components
+    static void EncodeNormals(void* destination, size_t destinationStride,
+        const void* normals, size_t stride, size_t count);
+    static void DecodeNormals(void* destination, size_t destinationStride,
+        const void* encoded, size_t stride, size_t count);
+
+    // Pairs of floats as half floats, rounded to nearest
+    static void EncodeHalf2(void* destination, size_t destinationStride,
+        const void* values, size_t stride, size_t count);
+    static void DecodeHalf2(void* destination, size_t destinationStride,
+        const void* encoded, size_t stride, size_t count);
+
+    // RGB colors as four UNORM8 components with opaque alpha
+    static void EncodeColors(void* destination, size_t destinationStride,
+        const void* colors, size_t stride, size_t count);
+    static void DecodeColors(void* destination, size_t destinationStride,
+        const void* encoded, size_t stride, size_t count);
+};
@@ -0,0 +1,32 @@
+cbuffer cbPerBatch : register(b0)
+{
+    matrix viewProj;
+    matrix meshTransform;   // Dequantizes vertex positions
+};
+
+struct VS_INPUT
+{
+    float3 position : POSITION;
+    float3 color : COLOR;
+    float4 world0 : WORLD0;
+    float4 world1 : WORLD1;
+    float4 world2 : WORLD2;
+    float4 world3 : WORLD3;
+};
+
+struct PS_INPUT
+{
+    float4 position : SV_POSITION;
+    float3 color : COLOR;
+};
+
+PS_INPUT main(VS_INPUT input)
+{
+    float4x4 world = float4x4(input.world0, input.world1, input.world2, input.world3);
+    float4 meshPosition = mul(float4(input.position, 1.0f), meshTransform);
+
+    PS_INPUT output;
+    output.position = mul(mul(meshPosition, world), viewProj);
+    output.color = (output.position + 1.0) / 2;
+    return output;
+}
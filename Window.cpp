@@ -1,6 +1,8 @@
 // Window.cpp
 
 #include "Window.h"
+#include "Log.h"
+#include "Profiler.h"
 #include "resource.h"
 
 Window::Window(HINSTANCE hInstance, int width, int height) : hInstance(hInstance), width(width), height(height) {
@@ -52,17 +54,37 @@ bool Window::Initialize(int nShowCmd) {
     ShowWindow(hwnd, nShowCmd);
     UpdateWindow(hwnd);
 
-    // Initialize Graphics
-    if (!graphics.Initialize(hwnd, width, height)) {
+    // Initialize the device, then Graphics on top of it
+    if (!backend.Initialize(hwnd, width, height)) {
+        return false;
+    }
+
+    if (!graphics.Initialize(&backend, width, height)) {
         MessageBox(nullptr, L"Failed to initialize graphics!", L"Error", MB_OK);
         return false;
     }
+    backend.GetShaderCache().LogStats();
+
+    // Keeps input-to-display latency bounded when the GPU is the bottleneck
+    backend.SetMaxFrameLatency(pipeline.GetSettings().maxFrameLatency);
 
     return true;
 }
 
+void Window::CaptureProfile(uint32_t frames, const char* traceFile) {
+    profileFrames = frames;
+    profileTraceFile = traceFile;
+}
+
 int Window::Run() {
     MSG msg = {};
+    uint32_t frame = 0;
+    if (profileFrames > 0) {
+        Profiler::BeginCapture();
+    }
+    BOG_PROFILE_THREAD("Main");
+
+    pipeline.Start();
     while (true) {
         // Process any messages in the queue
         while (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) {
@@ -73,16 +95,28 @@ int Window::Run() {
             DispatchMessage(&msg);
         }
 
-        // Calculate delta time
-        static DWORD previousTime = GetTickCount64();
-        DWORD currentTime = GetTickCount64();
-        float deltaTime = (currentTime - previousTime) / 1000.0f;
-        previousTime = currentTime;
-
-        // Update and render
-        graphics.Update(deltaTime);
-        graphics.Draw();
+        // Upload meshes that finished streaming, run the simulation steps this
+        // frame's time covers, then render between the last two and present once
+        FramePipeline::FrameTiming timing = pipeline.BeginFrame();
+        BOG_PROFILE_FRAME();
+        graphics.ProcessStreaming();
+        for (uint32_t step = 0; step < timing.steps; ++step) {
+            graphics.Update(static_cast<float>(pipeline.GetFixedStep()));
+        }
+        graphics.Draw(timing.interpolation);
         graphics.Present();
+
+        if (profileFrames > 0 && ++frame == profileFrames) {
+            Profiler::EndCapture();
+            if (Profiler::WriteChromeTrace(profileTraceFile)) {
+                LogMessage("Profile: %u frames, %u events (%u dropped) written to %s\n", profileFrames,
+                    static_cast<unsigned>(Profiler::GetEventCount()), static_cast<unsigned>(Profiler::GetDroppedCount()),
+                    profileTraceFile);
+            }
+            else {
+                LogMessage("Failed to write the profile to %s\n", profileTraceFile);
+            }
+        }
     }
 }
 
@@ -3,6 +3,8 @@
 #pragma once
 
 #include <windows.h>
+#include "D3D11Backend.h"
+#include "FramePipeline.h"
 #include "Graphics.h"
 
 class Window {
@@ -13,6 +15,11 @@ public:
     bool Initialize(int nShowCmd);
     int Run();
 
+    Graphics& GetGraphics() { return graphics; }
+
+    // Records a profile of the first frames Run draws and writes it as a Chrome trace
+    void CaptureProfile(uint32_t frames, const char* traceFile);
+
 private:
     HWND hwnd = nullptr;
     HINSTANCE hInstance = nullptr;
@@ -21,8 +28,16 @@ private:
     LPCWSTR windowClassName = L"WindowClass";
     LPCWSTR windowTitle = L"DirectX 11 Pyramid";
 
+    // Declared first so it outlives the meshes graphics releases
+    D3D11Backend backend;
     Graphics graphics;
 
+    // Fixed-step simulation and frame pacing
+    FramePipeline pipeline;
+
+    uint32_t profileFrames = 0;
+    const char* profileTraceFile = nullptr;
+
     static LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
     LRESULT CALLBACK HandleMessage(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
 };
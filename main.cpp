@@ -1,9 +1,82 @@
 // main.cpp
 
 #include <windows.h>
+#include <shellapi.h>
+#include <string>
+#include <vector>
+#include "CommandLine.h"
+#include "HeadlessModes.h"
+#include "ShaderCache.h"
 #include "Window.h" // Include the Window header file
 
+namespace {
+
+    std::string NarrowString(const wchar_t* text) {
+        int length = WideCharToMultiByte(CP_ACP, 0, text, -1, nullptr, 0, nullptr, nullptr);
+        if (length <= 1) {
+            return std::string();
+        }
+        std::string result(static_cast<size_t>(length - 1), '\0');
+        WideCharToMultiByte(CP_ACP, 0, text, -1, &result[0], length, nullptr, nullptr);
+        return result;
+    }
+
+    // The process's arguments, narrowed to the ANSI code page
+    CommandLine ReadCommandLine() {
+        std::vector<std::string> arguments;
+        int argc = 0;
+        LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+        if (argv) {
+            for (int i = 0; i < argc; ++i) {
+                arguments.push_back(NarrowString(argv[i]));
+            }
+            LocalFree(argv);
+        }
+        return CommandLine(arguments);
+    }
+
+    // Offline shader build step: BogEngine.exe -precompile-shaders [directory]
+    // Compiles every shader permutation the renderer uses into the shader
+    // cache.
+    int RunPrecompileShadersCommand(const CommandLine& commandLine) {
+        std::string directory = commandLine.GetArgument(0);
+        if (directory.empty()) {
+            directory = D3D11Backend::ShaderCacheDirectory;
+        }
+
+        std::vector<PipelineDesc> pipelines;
+        Graphics::GetPipelineDescs(pipelines);
+        std::vector<ShaderDesc> shaders;
+        for (const PipelineDesc& pipeline : pipelines) {
+            ShaderDesc vertexShader, pixelShader;
+            D3D11Backend::GetPipelineShaders(pipeline, vertexShader, pixelShader);
+            shaders.push_back(vertexShader);
+            shaders.push_back(pixelShader);
+        }
+
+        D3DShaderCompiler compiler;
+        ShaderCache cache;
+        if (!cache.Initialize(directory, &compiler)) {
+            return 1;
+        }
+        bool compiled = cache.Precompile(shaders);
+        cache.LogStats();
+        return compiled ? 0 : 1;
+    }
+
+}
+
 int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine, int nShowCmd) {
+    // Tools, tests and benchmarks exit without opening a window
+    CommandLine commandLine = ReadCommandLine();
+    if (commandLine.IsCommand("-precompile-shaders")) {
+        return RunPrecompileShadersCommand(commandLine);
+    }
+    int modeResult = RunHeadlessMode(commandLine);
+    if (modeResult >= 0) {
+        return modeResult;
+    }
+
     // Create an instance of the Window class
     Window mainWindow(hInstance, 800, 600);
 
@@ -13,6 +86,16 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine
         return -1;
     }
 
+    uint32_t benchmarkInstances = ParseInstancingBenchmark(commandLine);
+    if (benchmarkInstances > 0) {
+        mainWindow.GetGraphics().EnableInstancingBenchmark(benchmarkInstances);
+    }
+
+    uint32_t profileFrames = ParseProfileTrace(commandLine);
+    if (profileFrames > 0) {
+        mainWindow.CaptureProfile(profileFrames, "bogengine_trace.json");
+    }
+
     // Run the message loop
     return mainWindow.Run();
 }